@@ -0,0 +1,502 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#if !defined(_WIN32) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+#include "fossil/ai/audit.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* =========================================================
+ * Workload
+ * ========================================================= */
+
+typedef struct fossil_ai_audit_bench_part {
+    void* ctx;
+    size_t records;
+    size_t size;
+    unsigned seed;
+    uint32_t* latency;          /* per-record ns, NULL = untimed */
+    int rc;
+} fossil_ai_audit_bench_part_t;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Records inference-shaped payloads that differ per call, so sampling has something to hash. */
+static void* bench_worker(void* arg)
+{
+    fossil_ai_audit_bench_part_t* p = (fossil_ai_audit_bench_part_t*)arg;
+    size_t half = p->size / 2;
+    uint8_t* buf = (uint8_t*)malloc(p->size ? p->size : 1);
+    if (!buf) {
+        p->rc = -2;
+        return NULL;
+    }
+    for (size_t i = 0; i < p->size; ++i)
+        buf[i] = (uint8_t)(i * 131u + p->seed);
+
+    for (size_t i = 0; i < p->records && p->rc == 0; ++i) {
+        memcpy(buf, &i, p->size < sizeof(i) ? p->size : sizeof(i));
+        if (!p->latency) {
+            p->rc = fossil_ai_audit_record_inference(p->ctx, NULL, buf, half, buf + half, p->size - half);
+            continue;
+        }
+        uint64_t t0 = now_ns();
+        p->rc = fossil_ai_audit_record_inference(p->ctx, NULL, buf, half, buf + half, p->size - half);
+        uint64_t dt = now_ns() - t0;
+        p->latency[i] = dt > UINT32_MAX ? UINT32_MAX : (uint32_t)dt;
+    }
+    free(buf);
+    return NULL;
+}
+
+/* Splits records over threads, the caller being the first; latency, if set, gets one slot per record. */
+static int bench_run(void* ctx, size_t records, size_t size, size_t threads, uint32_t* latency)
+{
+    fossil_ai_audit_bench_part_t parts[64];
+    pthread_t tids[64];
+    int started[64];
+    size_t first = 0;
+
+    for (size_t t = 0; t < threads; ++t) {
+        parts[t].ctx = ctx;
+        parts[t].records = records / threads + (t < records % threads);
+        parts[t].size = size;
+        parts[t].seed = (unsigned)t;
+        parts[t].latency = latency ? latency + first : NULL;
+        parts[t].rc = 0;
+        first += parts[t].records;
+        started[t] = t > 0 && pthread_create(&tids[t], NULL, bench_worker, &parts[t]) == 0;
+        if (t > 0 && !started[t])
+            parts[t].rc = -1;
+    }
+    bench_worker(&parts[0]);
+    int rc = parts[0].rc;
+    for (size_t t = 1; t < threads; ++t) {
+        if (started[t])
+            pthread_join(tids[t], NULL);
+        if (rc == 0)
+            rc = parts[t].rc;
+    }
+    return rc;
+}
+
+static int bench_level(int level, double rate, size_t records, size_t size, size_t threads,
+                       double* record_ns, double* commit_ns, fossil_ai_audit_stats_t* stats)
+{
+    fossil_ai_audit_config_t config;
+    void* ctx = NULL;
+
+    memset(&config, 0, sizeof(config));
+    config.level = level;
+    config.sample_rate = rate;
+    if (fossil_ai_audit_begin_ex(&ctx, &config) != 0)
+        return -1;
+
+    uint64_t start = now_ns();
+    int rc = bench_run(ctx, records, size, threads, NULL);
+    uint64_t recorded = now_ns();
+    fossil_ai_audit_flush(ctx);
+    uint64_t committed = now_ns();
+
+    /* Time in the recording call alone, and until everything was committed. */
+    *record_ns = records ? (double)(recorded - start) / (double)records : 0.0;
+    *commit_ns = records ? (double)(committed - start) / (double)records : 0.0;
+    fossil_ai_audit_stats(ctx, stats);
+    fossil_ai_audit_end(ctx);
+    return rc;
+}
+
+
+/* =========================================================
+ * Suite
+ * ========================================================= */
+
+typedef struct fossil_ai_audit_bench_suite {
+    FILE* out;
+    const char* dir;
+    size_t records;
+    size_t size;
+    size_t max_threads;
+    char a[512];
+    char b[512];
+} fossil_ai_audit_bench_suite_t;
+
+static int cmp_u32(const void* x, const void* y)
+{
+    uint32_t a = *(const uint32_t*)x, b = *(const uint32_t*)y;
+    return (a > b) - (a < b);
+}
+
+static uint32_t percentile(const uint32_t* sorted, size_t n, double p)
+{
+    return n ? sorted[(size_t)(p * (double)(n - 1) + 0.5)] : 0;
+}
+
+static uint64_t file_bytes(const char* path)
+{
+    struct stat sb;
+    return stat(path, &sb) == 0 ? (uint64_t)sb.st_size : 0;
+}
+
+static double mb_per_s(uint64_t bytes, uint64_t ns)
+{
+    return ns ? (double)bytes * 1e3 / (double)ns : 0.0;
+}
+
+/* Latency of each record call, and how fast the flusher commits behind the recording threads. */
+static int suite_record(fossil_ai_audit_bench_suite_t* s)
+{
+    uint32_t* latency = (uint32_t*)malloc(s->records * sizeof(uint32_t) + 1);
+    if (!latency)
+        return -2;
+
+    int rc = 0;
+    fprintf(s->out, "  \"record\": [");
+    for (size_t threads = 1; threads <= s->max_threads && rc == 0; threads *= 2) {
+        fossil_ai_audit_config_t config;
+        fossil_ai_audit_stats_t stats;
+        void* ctx = NULL;
+
+        memset(&config, 0, sizeof(config));
+        if (fossil_ai_audit_begin_ex(&ctx, &config) != 0) {
+            rc = -1;
+            break;
+        }
+        uint64_t start = now_ns();
+        rc = bench_run(ctx, s->records, s->size, threads, latency);
+        uint64_t recorded = now_ns();
+        fossil_ai_audit_flush(ctx);
+        uint64_t committed = now_ns();
+        fossil_ai_audit_stats(ctx, &stats);
+        fossil_ai_audit_end(ctx);
+
+        double sum = 0.0;
+        for (size_t i = 0; i < s->records; ++i)
+            sum += latency[i];
+        qsort(latency, s->records, sizeof(uint32_t), cmp_u32);
+        fprintf(s->out,
+                "%s\n    {\"threads\": %zu, \"records\": %zu, \"mean_ns\": %.1f, \"p50_ns\": %u, "
+                "\"p90_ns\": %u, \"p99_ns\": %u, \"p999_ns\": %u, \"max_ns\": %u, "
+                "\"record_per_s\": %.0f, \"commit_per_s\": %.0f, \"commit_mb_per_s\": %.1f, "
+                "\"stalls\": %llu}",
+                threads > 1 ? "," : "", threads, s->records,
+                s->records ? sum / (double)s->records : 0.0,
+                percentile(latency, s->records, 0.50), percentile(latency, s->records, 0.90),
+                percentile(latency, s->records, 0.99), percentile(latency, s->records, 0.999),
+                s->records ? latency[s->records - 1] : 0,
+                recorded > start ? (double)s->records * 1e9 / (double)(recorded - start) : 0.0,
+                committed > start ? (double)stats.records * 1e9 / (double)(committed - start) : 0.0,
+                mb_per_s(stats.bytes, committed - start), (unsigned long long)stats.stalls);
+    }
+    fprintf(s->out, "\n  ],\n");
+    free(latency);
+    return rc;
+}
+
+/* Commit throughput from a single writer: in memory, journaled, and journaled with a sync per group. */
+static int suite_flush(fossil_ai_audit_bench_suite_t* s)
+{
+    static const struct {
+        const char* name;
+        int journal;
+        int sync;
+    } modes[] = {
+        { "memory", 0, 0 },
+        { "journal", 1, 0 },
+        { "journal-sync", 1, 1 },
+    };
+
+    fprintf(s->out, "  \"flush\": [");
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m) {
+        fossil_ai_audit_config_t config;
+        fossil_ai_audit_stats_t stats;
+        void* ctx = NULL;
+
+        memset(&config, 0, sizeof(config));
+        config.journal = modes[m].journal ? s->a : NULL;
+        config.sync = modes[m].sync;
+        if (fossil_ai_audit_begin_ex(&ctx, &config) != 0)
+            return -1;
+        uint64_t start = now_ns();
+        int rc = bench_run(ctx, s->records, s->size, 1, NULL);
+        uint64_t recorded = now_ns();
+        fossil_ai_audit_flush(ctx);
+        uint64_t committed = now_ns();
+        fossil_ai_audit_stats(ctx, &stats);
+        fossil_ai_audit_end(ctx);
+        remove(s->a);
+        if (rc != 0)
+            return rc;
+
+        fprintf(s->out,
+                "%s\n    {\"mode\": \"%s\", \"records\": %llu, \"groups\": %llu, \"syncs\": %llu, "
+                "\"drain_ms\": %.3f, \"commit_per_s\": %.0f, \"commit_mb_per_s\": %.1f}",
+                m ? "," : "", modes[m].name, (unsigned long long)stats.records,
+                (unsigned long long)stats.groups, (unsigned long long)stats.syncs,
+                (double)(committed - recorded) / 1e6,
+                committed > start ? (double)stats.records * 1e9 / (double)(committed - start) : 0.0,
+                mb_per_s(stats.bytes, committed - start));
+    }
+    fprintf(s->out, "\n  ],\n");
+    return 0;
+}
+
+/*
+ * Verify over logs of growing size, and diff of each log against later
+ * exports of the same context (the differences are the records added since)
+ * and against an unrelated log of the same length, where every record differs.
+ */
+static int suite_logs(fossil_ai_audit_bench_suite_t* s)
+{
+    static const size_t extra[] = { 0, 1, 64, 4096 };
+    FILE* sink = fopen("/dev/null", "w");
+    int rc = sink ? 0 : -1;
+    int row = 0;
+
+    fprintf(s->out, "  \"verify\": [");
+    for (size_t n = s->records / 100; n <= s->records && rc == 0; n *= 10) {
+        void* ctx = NULL;
+        if (fossil_ai_audit_begin(&ctx) != 0 || bench_run(ctx, n, s->size, 1, NULL) != 0 ||
+            fossil_ai_audit_export(ctx, s->a) != 0) {
+            fossil_ai_audit_end(ctx);
+            rc = -1;
+            break;
+        }
+        fossil_ai_audit_end(ctx);
+
+        uint64_t bytes = file_bytes(s->a);
+        uint64_t t0 = now_ns();
+        rc = fossil_ai_audit_verify(s->a);
+        uint64_t dt = now_ns() - t0;
+        fprintf(s->out,
+                "%s\n    {\"records\": %zu, \"bytes\": %llu, \"ms\": %.3f, \"gb_per_s\": %.3f}",
+                row++ ? "," : "", n, (unsigned long long)bytes, (double)dt / 1e6,
+                mb_per_s(bytes, dt) / 1e3);
+        if (n == 0)
+            break;
+    }
+    fprintf(s->out, "\n  ],\n");
+    remove(s->a);
+
+    row = 0;
+    fprintf(s->out, "  \"diff\": [");
+    for (size_t n = s->records / 100; n <= s->records && rc == 0; n *= 10) {
+        void* ctx = NULL;
+        void* other = NULL;
+        size_t added = 0;
+
+        if (fossil_ai_audit_begin(&ctx) != 0 || bench_run(ctx, n, s->size, 1, NULL) != 0 ||
+            fossil_ai_audit_export(ctx, s->a) != 0) {
+            fossil_ai_audit_end(ctx);
+            rc = -1;
+            break;
+        }
+        for (size_t e = 0; e <= sizeof(extra) / sizeof(extra[0]) && rc == 0; ++e) {
+            int unrelated = e == sizeof(extra) / sizeof(extra[0]);
+            if (unrelated) {
+                rc = fossil_ai_audit_begin(&other) != 0 || bench_run(other, n, s->size, 1, NULL) != 0 ||
+                     fossil_ai_audit_export(other, s->b) != 0 ? -1 : 0;
+                fossil_ai_audit_end(other);
+            } else {
+                rc = bench_run(ctx, extra[e] - added, s->size, 1, NULL) != 0 ||
+                     fossil_ai_audit_export(ctx, s->b) != 0 ? -1 : 0;
+                added = extra[e];
+            }
+            if (rc != 0)
+                break;
+
+            uint64_t t0 = now_ns();
+            int differ = fossil_ai_audit_diff(s->a, s->b, sink);
+            uint64_t dt = now_ns() - t0;
+            if (differ < 0) {
+                rc = differ;
+                break;
+            }
+            fprintf(s->out,
+                    "%s\n    {\"records\": %zu, \"differences\": %zu, \"unrelated\": %s, \"ms\": %.3f}",
+                    row++ ? "," : "", n, unrelated ? n : added, unrelated ? "true" : "false",
+                    (double)dt / 1e6);
+        }
+        fossil_ai_audit_end(ctx);
+        if (n == 0)
+            break;
+    }
+    fprintf(s->out, "\n  ]\n");
+    remove(s->a);
+    remove(s->b);
+    if (sink)
+        fclose(sink);
+    return rc;
+}
+
+static int suite_run(fossil_ai_audit_bench_suite_t* s)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    snprintf(s->a, sizeof(s->a), "%s/fossil-ai-audit-bench-%ld-a.log", s->dir, (long)getpid());
+    snprintf(s->b, sizeof(s->b), "%s/fossil-ai-audit-bench-%ld-b.log", s->dir, (long)getpid());
+
+    fprintf(s->out,
+            "{\n  \"benchmark\": \"fossil-ai-audit\",\n"
+            "  \"config\": {\"records\": %zu, \"size\": %zu, \"max_threads\": %zu, \"cpus\": %ld},\n",
+            s->records, s->size, s->max_threads, cpus);
+    int rc = suite_record(s);
+    if (rc == 0)
+        rc = suite_flush(s);
+    if (rc == 0)
+        rc = suite_logs(s);
+    fprintf(s->out, "}\n");
+    return rc;
+}
+
+
+/* =========================================================
+ * Entry Point
+ * ========================================================= */
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --records N             records per level or suite run (default 200000)\n"
+        "  --size BYTES            payload bytes per record (default 512)\n"
+        "  --threads N             recording threads, up to 64 (default 1)\n"
+        "  --rate P                share kept at the sampled level (default 0.1)\n"
+        "  --suite                 record latency, flush, verify and diff, as JSON\n"
+        "  --max-threads N         suite thread counts double up to N (default 64)\n"
+        "  --json FILE             write the suite results to FILE (default stdout)\n"
+        "  --dir DIR               where the suite puts its logs (default /tmp)\n",
+        argv0);
+}
+
+int main(int argc, char** argv)
+{
+    size_t records = 200000, size = 512, threads = 1, max_threads = 64;
+    double rate = 0.1;
+    const char* json = NULL;
+    const char* dir = getenv("TMPDIR");
+    int suite = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* val = i + 1 < argc ? argv[i + 1] : NULL;
+        int bad = 0;
+
+        if (strcmp(arg, "--suite") == 0) {
+            suite = 1;
+            continue;
+        } else if (!val) {
+            bad = 1;
+        } else if (strcmp(arg, "--records") == 0) {
+            records = (size_t)strtoull(val, NULL, 10);
+        } else if (strcmp(arg, "--size") == 0) {
+            size = (size_t)strtoull(val, NULL, 10);
+        } else if (strcmp(arg, "--threads") == 0) {
+            threads = (size_t)strtoull(val, NULL, 10);
+        } else if (strcmp(arg, "--rate") == 0) {
+            rate = strtod(val, NULL);
+        } else if (strcmp(arg, "--max-threads") == 0) {
+            max_threads = (size_t)strtoull(val, NULL, 10);
+        } else if (strcmp(arg, "--json") == 0) {
+            json = val;
+        } else if (strcmp(arg, "--dir") == 0) {
+            dir = val;
+        } else {
+            bad = 1;
+        }
+
+        if (bad) {
+            usage(argv[0]);
+            return 2;
+        }
+        ++i;
+    }
+
+    if (threads == 0 || threads > 64 || max_threads == 0 || max_threads > 64 ||
+        !(rate >= 0.0 && rate <= 1.0)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (suite) {
+        fossil_ai_audit_bench_suite_t s;
+        memset(&s, 0, sizeof(s));
+        s.out = json ? fopen(json, "w") : stdout;
+        s.dir = dir && *dir ? dir : "/tmp";
+        s.records = records;
+        s.size = size;
+        s.max_threads = max_threads;
+        if (!s.out) {
+            fprintf(stderr, "fossil-ai-audit-bench: cannot write %s\n", json);
+            return 1;
+        }
+        int rc = suite_run(&s);
+        if (json && fclose(s.out) != 0)
+            rc = -1;
+        if (rc != 0) {
+            fprintf(stderr, "fossil-ai-audit-bench: suite failed (%d)\n", rc);
+            return 1;
+        }
+        return 0;
+    }
+
+    static const struct {
+        const char* name;
+        int level;
+    } levels[] = {
+        { "full", FOSSIL_AI_AUDIT_FULL },
+        { "sampled", FOSSIL_AI_AUDIT_SAMPLED },
+        { "hash-only", FOSSIL_AI_AUDIT_HASH_ONLY },
+        { "off", FOSSIL_AI_AUDIT_OFF },
+    };
+
+    printf("%-10s %-12s %-12s %-12s %-12s %s\n",
+           "level", "record_ns", "commit_ns", "records", "omitted", "log_bytes");
+    for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); ++l) {
+        fossil_ai_audit_stats_t stats;
+        double record_ns = 0.0, commit_ns = 0.0;
+        memset(&stats, 0, sizeof(stats));
+        if (bench_level(levels[l].level, rate, records, size, threads, &record_ns, &commit_ns,
+                        &stats) != 0) {
+            fprintf(stderr, "fossil-ai-audit-bench: %s level failed\n", levels[l].name);
+            return 1;
+        }
+        printf("%-10s %-12.1f %-12.1f %-12llu %-12llu %llu\n", levels[l].name, record_ns, commit_ns,
+               (unsigned long long)stats.records, (unsigned long long)stats.omitted,
+               (unsigned long long)stats.bytes);
+    }
+    return 0;
+}
@@ -0,0 +1,204 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#include "fossil/ai/sweep.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* =========================================================
+ * Argument Parsing
+ * ========================================================= */
+
+#define FOSSIL_AI_SWEEP_MAX_VALUES 16
+
+typedef struct fossil_ai_sweep_axis {
+    double values[FOSSIL_AI_SWEEP_MAX_VALUES];
+    size_t count;
+} fossil_ai_sweep_axis_t;
+
+static int parse_axis(const char* text, fossil_ai_sweep_axis_t* axis)
+{
+    char* end = NULL;
+    axis->count = 0;
+
+    while (*text) {
+        if (axis->count == FOSSIL_AI_SWEEP_MAX_VALUES)
+            return -1;
+        axis->values[axis->count++] = strtod(text, &end);
+        if (end == text)
+            return -1;
+        text = *end == ',' ? end + 1 : end;
+    }
+    return axis->count ? 0 : -1;
+}
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr,
+        "usage: %s --data FILE --input N --output M [options]\n"
+        "  --holdout FILE          validation rows (default: --data)\n"
+        "  --batch ROWS            rows per step (default 4096)\n"
+        "  --steps N               maximum steps per variant (default 256)\n"
+        "  --rung N                steps before the first halving (default 16)\n"
+        "  --eta N                 keep 1/eta variants per rung (default 2)\n"
+        "  --workers N             worker threads (default: online cores)\n"
+        "  --lr A,B,...            learning rates to sweep (default 0.5)\n"
+        "  --resolution A,B,...    input resolutions to sweep (default 0.5)\n"
+        "  --capacity A,B,...      block capacities to sweep (default 0)\n"
+        "  --seed N                seed shared by every variant\n",
+        argv0);
+}
+
+
+/* =========================================================
+ * Entry Point
+ * ========================================================= */
+
+int main(int argc, char** argv)
+{
+    const char* data_path = NULL;
+    const char* holdout_path = NULL;
+    size_t input_dim = 0, output_dim = 0;
+    fossil_ai_sweep_config_t config;
+    fossil_ai_sweep_axis_t lr = { {0.5}, 1 };
+    fossil_ai_sweep_axis_t res = { {0.5}, 1 };
+    fossil_ai_sweep_axis_t cap = { {0.0}, 1 };
+    uint64_t seed = 0;
+
+    memset(&config, 0, sizeof(config));
+    config.batch_rows = 4096;
+    config.max_steps = 256;
+    config.rung_steps = 16;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* val = i + 1 < argc ? argv[i + 1] : NULL;
+        int bad = 0;
+
+        if (!val) {
+            bad = 1;
+        } else if (strcmp(arg, "--data") == 0) {
+            data_path = val;
+        } else if (strcmp(arg, "--holdout") == 0) {
+            holdout_path = val;
+        } else if (strcmp(arg, "--input") == 0) {
+            input_dim = (size_t)strtoull(val, NULL, 10);
+        } else if (strcmp(arg, "--output") == 0) {
+            output_dim = (size_t)strtoull(val, NULL, 10);
+        } else if (strcmp(arg, "--batch") == 0) {
+            config.batch_rows = (size_t)strtoull(val, NULL, 10);
+        } else if (strcmp(arg, "--steps") == 0) {
+            config.max_steps = (size_t)strtoull(val, NULL, 10);
+        } else if (strcmp(arg, "--rung") == 0) {
+            config.rung_steps = (size_t)strtoull(val, NULL, 10);
+        } else if (strcmp(arg, "--eta") == 0) {
+            config.eta = (size_t)strtoull(val, NULL, 10);
+        } else if (strcmp(arg, "--workers") == 0) {
+            config.workers = (size_t)strtoull(val, NULL, 10);
+        } else if (strcmp(arg, "--seed") == 0) {
+            seed = strtoull(val, NULL, 10);
+        } else if (strcmp(arg, "--lr") == 0) {
+            bad = parse_axis(val, &lr);
+        } else if (strcmp(arg, "--resolution") == 0) {
+            bad = parse_axis(val, &res);
+        } else if (strcmp(arg, "--capacity") == 0) {
+            bad = parse_axis(val, &cap);
+        } else {
+            bad = 1;
+        }
+
+        if (bad) {
+            usage(argv[0]);
+            return 2;
+        }
+        ++i;
+    }
+
+    if (!data_path || input_dim == 0 || output_dim == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    fossil_ai_sweep_dataset_t data, holdout;
+    if (fossil_ai_sweep_dataset_map(data_path, input_dim + output_dim, &data) != 0) {
+        fprintf(stderr, "fossil-ai-sweep: cannot map %s\n", data_path);
+        return 1;
+    }
+    if (holdout_path &&
+        fossil_ai_sweep_dataset_map(holdout_path, input_dim + output_dim, &holdout) != 0) {
+        fprintf(stderr, "fossil-ai-sweep: cannot map %s\n", holdout_path);
+        fossil_ai_sweep_dataset_unmap(&data);
+        return 1;
+    }
+
+    size_t n = lr.count * res.count * cap.count;
+    fossil_ai_train_config_t* variants = (fossil_ai_train_config_t*)calloc(n, sizeof(*variants));
+    fossil_ai_sweep_result_t* results = (fossil_ai_sweep_result_t*)calloc(n, sizeof(*results));
+    if (!variants || !results) {
+        fprintf(stderr, "fossil-ai-sweep: out of memory\n");
+        return 1;
+    }
+
+    size_t v = 0;
+    for (size_t a = 0; a < lr.count; ++a) {
+        for (size_t b = 0; b < res.count; ++b) {
+            for (size_t c = 0; c < cap.count; ++c, ++v) {
+                variants[v].input_dim = input_dim;
+                variants[v].output_dim = output_dim;
+                variants[v].learning_rate = (float)lr.values[a];
+                variants[v].resolution = (float)res.values[b];
+                variants[v].capacity = (size_t)cap.values[c];
+                variants[v].seed = seed;
+            }
+        }
+    }
+
+    config.variants = variants;
+    config.variant_count = n;
+    config.data = &data;
+    config.holdout = holdout_path ? &holdout : NULL;
+
+    int best = fossil_ai_sweep_run(&config, results);
+    if (best < 0) {
+        fprintf(stderr, "fossil-ai-sweep: sweep failed (%d)\n", best);
+    } else {
+        printf("%-8s %-10s %-10s %-10s %-12s %-10s %-8s %s\n",
+               "variant", "lr", "resolution", "capacity", "loss", "hit_rate", "steps", "status");
+        for (v = 0; v < n; ++v) {
+            printf("%-8zu %-10g %-10g %-10zu %-12.6g %-10.4f %-8llu %s\n",
+                   v, variants[v].learning_rate, variants[v].resolution, variants[v].capacity,
+                   results[v].loss, results[v].hit_rate, (unsigned long long)results[v].steps,
+                   (int)v == best ? "best" : results[v].stopped ? "stopped" : "finished");
+        }
+    }
+
+    free(results);
+    free(variants);
+    if (holdout_path)
+        fossil_ai_sweep_dataset_unmap(&holdout);
+    fossil_ai_sweep_dataset_unmap(&data);
+    return best < 0 ? 1 : 0;
+}
@@ -0,0 +1,4062 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#if !defined(_WIN32) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "fossil/ai/audit.h"
+#include "io.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if !defined(_WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define FOSSIL_AI_AUDIT_HAS_FSYNC 1
+#define FOSSIL_AI_AUDIT_HAS_SYSCONF 1
+#define FOSSIL_AI_AUDIT_HAS_MMAP 1
+#define FOSSIL_AI_AUDIT_HAS_FD 1
+#endif
+
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#define FOSSIL_AI_AUDIT_HAS_SPLICE 1
+#endif
+
+/* =========================================================
+ * Internal State
+ * ========================================================= */
+
+#define FOSSIL_AI_AUDIT_RING_BYTES   (256u * 1024u)
+#define FOSSIL_AI_AUDIT_FLUSH_US     1000u
+#define FOSSIL_AI_AUDIT_TLS_SLOTS    8u
+#define FOSSIL_AI_AUDIT_PAD          UINT32_MAX
+#define FOSSIL_AI_AUDIT_OMITTED      1u     /* frame flag: payload replaced by its digest */
+#define FOSSIL_AI_AUDIT_HASH_BYTES   32u
+#define FOSSIL_AI_AUDIT_LOG_MAGIC    "FAIAUDT\0"
+#define FOSSIL_AI_AUDIT_END_MAGIC    "FAIAEND\0"
+#define FOSSIL_AI_AUDIT_SEG_MAGIC    "FAISEGM\0"
+#define FOSSIL_AI_AUDIT_LOG_VERSION  6u
+#define FOSSIL_AI_AUDIT_SEGMENT_BYTES (64u * 1024u * 1024u)
+#define FOSSIL_AI_AUDIT_TREE_LEVELS  64u
+#define FOSSIL_AI_AUDIT_VERIFY_SHIFT 12u    /* leaves per verification task, as a power of two */
+#define FOSSIL_AI_AUDIT_MAX_WORKERS  64u
+#define FOSSIL_AI_AUDIT_KEY_BLOCK    128u   /* key entries per block */
+#define FOSSIL_AI_AUDIT_BLOOM_BITS   10u    /* per distinct key, about 1% false positives */
+#define FOSSIL_AI_AUDIT_BLOOM_HASHES 7u
+#define FOSSIL_AI_AUDIT_Z_MAGIC      "FAIAUDZ\0"
+#define FOSSIL_AI_AUDIT_Z_BLOCK      (48u * 1024u)  /* with the dictionary, fits 16-bit offsets */
+#define FOSSIL_AI_AUDIT_Z_DICT       (16u * 1024u - 1u)
+#define FOSSIL_AI_AUDIT_Z_FRAGMENT   192u
+#define FOSSIL_AI_AUDIT_LZ_MIN       4u
+#define FOSSIL_AI_AUDIT_LZ_HASH_BITS 14
+#define FOSSIL_AI_AUDIT_REPLAY_CHUNK 64u    /* records claimed at a time by a replay worker */
+#define FOSSIL_AI_AUDIT_LEVEL_MASK   3ull   /* low bits of the packed mode word */
+#define FOSSIL_AI_AUDIT_STREAM_CHUNK (256u * 1024u)
+
+/* One record as laid out in the rings, the committed log and the journal. */
+typedef struct fossil_ai_audit_frame {
+    uint64_t seq;
+    uint64_t time_ns;
+    uint32_t key_len;       /* FOSSIL_AI_AUDIT_PAD marks padding up to the ring end */
+    uint32_t size;
+    uint32_t flags;
+    uint32_t reserved;
+} fossil_ai_audit_frame_t;
+
+/* Stored in place of a payload the audit level left out; the leaf commits to it either way. */
+typedef struct fossil_ai_audit_digest {
+    uint64_t size;
+    uint8_t hash[FOSSIL_AI_AUDIT_HASH_BYTES];
+} fossil_ai_audit_digest_t;
+
+/*
+ * One per recording thread, shared by that thread's rings in every context.
+ * The thread-exit destructor clears alive; the last ring to go frees it.
+ */
+typedef struct fossil_ai_audit_thread {
+    uint64_t id;
+    atomic_int alive;
+    atomic_size_t refs;
+} fossil_ai_audit_thread_t;
+
+/* Single producer (the recording thread), single consumer (the flusher). */
+typedef struct fossil_ai_audit_ring {
+    _Alignas(64) atomic_size_t head;
+    _Alignas(64) atomic_size_t tail;
+    size_t size;
+    uint8_t* data;
+    fossil_ai_audit_thread_t* owner;
+    struct fossil_ai_audit_ring* next;
+    struct fossil_ai_audit_ring* chain;     /* next in the same table bucket */
+} fossil_ai_audit_ring_t;
+
+typedef struct fossil_ai_audit_bytes {
+    uint8_t* data;
+    size_t len;
+    size_t cap;
+} fossil_ai_audit_bytes_t;
+
+/* Where rendered logs go: the I/O engine, a memory image, or a stream. */
+typedef struct fossil_ai_audit_out {
+    int (*put)(void* user, const void* data, size_t size);
+    void* user;
+    int rc;
+} fossil_ai_audit_out_t;
+
+typedef struct fossil_ai_audit_pending {
+    uint64_t seq;
+    size_t off;
+    size_t len;
+} fossil_ai_audit_pending_t;
+
+typedef struct fossil_ai_audit_ctx {
+    uint64_t id;
+    fossil_ai_audit_config_t config;
+    FILE* journal;
+
+    atomic_uint_fast64_t seq;           /* next sequence number to hand out */
+    _Atomic(fossil_ai_audit_ring_t*) rings;
+    pthread_mutex_t rings_lock;         /* adding and removing rings, and the table */
+    fossil_ai_audit_ring_t** table;     /* rings by owning thread id */
+    size_t table_cap;
+    size_t ring_count;
+    atomic_uint_fast64_t stalls;
+    atomic_uint_fast64_t mode;          /* level in the low bits, sample threshold above them */
+    atomic_uint_fast64_t omitted;
+    atomic_uint_fast64_t dropped;
+
+    pthread_mutex_t overflow_lock;      /* records too large for a ring */
+    fossil_ai_audit_bytes_t overflow;
+
+    /* Owned by the flusher thread. */
+    fossil_ai_audit_bytes_t staging;
+    fossil_ai_audit_pending_t* pending;
+    size_t pending_count;
+    size_t pending_cap;
+    fossil_ai_audit_bytes_t leaves;     /* leaf hashes of the group being committed */
+    size_t seg_first;                   /* first record of the open segment */
+    uint64_t seg_started;
+    uint64_t seg_number;
+    uint64_t seg_base;                  /* first segment this context sealed */
+    uint8_t seg_prev[FOSSIL_AI_AUDIT_HASH_BYTES]; /* seal of the last segment */
+
+    pthread_mutex_t lock;               /* guards everything below */
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    fossil_ai_audit_bytes_t log;        /* committed frames from log_first on, in sequence order */
+    size_t* offsets;                    /* of record log_first + i in log */
+    size_t count;
+    size_t log_first;                   /* records before it are only in sealed segments */
+    uint64_t log_segments;              /* segments seg_base up to this hold them */
+    size_t offsets_cap;
+    uint64_t committed;                 /* every sequence number below is committed */
+    fossil_ai_audit_bytes_t levels[FOSSIL_AI_AUDIT_TREE_LEVELS]; /* Merkle nodes, see below */
+    fossil_ai_audit_stats_t stats;
+    size_t pins;                        /* exports reading the committed prefix unlocked */
+    void** retired;                     /* buffers outgrown while pinned */
+    size_t retired_count;
+    size_t retired_cap;
+    int urgent;
+    int stop;
+    atomic_int error;                   /* first failed commit or seal, sticky; nothing commits after it */
+    pthread_t flusher;
+} fossil_ai_audit_ctx_t;
+
+/* The committed prefix at one moment, readable without the lock while pinned. */
+typedef struct fossil_ai_audit_view {
+    const uint8_t* log;
+    const size_t* offsets;
+    fossil_ai_audit_bytes_t levels[FOSSIL_AI_AUDIT_TREE_LEVELS];
+    size_t count;
+    size_t log_first;
+    uint64_t log_segments;
+} fossil_ai_audit_view_t;
+
+/*
+ * Exported log or segment: header, length-prefixed records carrying their
+ * leaf hash, an index of record offsets, the Merkle tree levels, the key
+ * index, then a footer. Every part is 8-byte aligned so a mapped file is
+ * read in place.
+ */
+typedef struct fossil_ai_audit_log_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t count;
+    uint64_t first_seq;
+    uint64_t index_offset;
+    uint64_t tree_offset;
+    uint64_t key_offset;
+    uint64_t file_size;
+} fossil_ai_audit_log_header_t;
+
+typedef struct fossil_ai_audit_log_record {
+    uint32_t length;        /* whole record including padding */
+    uint32_t key_len;
+    uint64_t seq;
+    uint64_t time_ns;
+    uint32_t size;
+    uint32_t flags;
+    uint8_t hash[FOSSIL_AI_AUDIT_HASH_BYTES];
+} fossil_ai_audit_log_record_t;
+
+typedef struct fossil_ai_audit_log_footer {
+    char magic[8];
+    uint64_t count;
+    uint64_t index_offset;
+    uint64_t segment;
+    uint8_t root[FOSSIL_AI_AUDIT_HASH_BYTES];
+    uint8_t prev[FOSSIL_AI_AUDIT_HASH_BYTES];   /* seal of the previous segment, zero for exports */
+    uint8_t seal[FOSSIL_AI_AUDIT_HASH_BYTES];
+} fossil_ai_audit_log_footer_t;
+
+/*
+ * Key index: every record sorted by key then position, in blocks of
+ * KEY_BLOCK entries. Each entry is followed by its key padded to 8 bytes.
+ * A fence per block gives its offset, so a lookup binary-searches the
+ * fences' first keys and reads one or two blocks. The Bloom filter over
+ * distinct keys answers most misses without touching a block.
+ */
+typedef struct fossil_ai_audit_key_index {
+    uint64_t blocks;
+    uint64_t fence_offset;
+    uint64_t bloom_offset;
+    uint64_t bloom_bits;    /* power of two */
+    uint64_t bloom_hashes;
+} fossil_ai_audit_key_index_t;
+
+typedef struct fossil_ai_audit_key_entry {
+    uint64_t record;
+    uint64_t time_ns;
+    uint64_t key_len;
+} fossil_ai_audit_key_entry_t;
+
+typedef struct fossil_ai_audit_key_fence {
+    uint64_t offset;
+    uint64_t entries;
+} fossil_ai_audit_key_fence_t;
+
+/*
+ * Side index, appended once per sealed segment: this entry, then `keys`
+ * key entries each followed by the key padded to 8 bytes. Offsets are file
+ * offsets of records inside the segment.
+ */
+typedef struct fossil_ai_audit_index_segment {
+    char magic[8];
+    uint64_t segment;
+    uint64_t first_seq;
+    uint64_t count;
+    uint64_t time_min;
+    uint64_t time_max;
+    uint64_t keys;
+    uint8_t seal[FOSSIL_AI_AUDIT_HASH_BYTES];
+} fossil_ai_audit_index_segment_t;
+
+typedef struct fossil_ai_audit_index_key {
+    uint64_t first;
+    uint64_t last;
+    uint64_t time_min;
+    uint64_t time_max;
+    uint64_t count;
+    uint64_t key_len;
+} fossil_ai_audit_index_key_t;
+
+/*
+ * Level k holds the hash of every complete, aligned run of 2^k leaves, so
+ * level k has size >> k nodes. Any RFC 6962 subtree hash is then at most
+ * O(log n) stored nodes away.
+ */
+typedef struct fossil_ai_audit_tree {
+    const uint8_t* levels[FOSSIL_AI_AUDIT_TREE_LEVELS];
+    uint64_t size;
+} fossil_ai_audit_tree_t;
+
+/* A record as the key index sees it, while a file is being written. */
+typedef struct fossil_ai_audit_key_rec {
+    const uint8_t* key;
+    size_t key_len;
+    uint64_t record;
+    uint64_t offset;        /* in the file being written */
+    uint64_t time_ns;
+} fossil_ai_audit_key_rec_t;
+
+typedef struct fossil_ai_audit_entry {
+    uint64_t seq;
+    uint64_t time_ns;
+    const uint8_t* key;
+    size_t key_len;
+    const uint8_t* data;
+    size_t size;
+    uint32_t flags;
+    const uint8_t* hash;
+} fossil_ai_audit_entry_t;
+
+typedef struct fossil_ai_audit_reader {
+    const uint8_t* base;
+    size_t size;
+    int mapped;
+    const fossil_ai_audit_log_header_t* header;
+    const uint64_t* index;
+    size_t count;
+    fossil_ai_audit_tree_t tree;
+    const fossil_ai_audit_key_index_t* keys;
+    const fossil_ai_audit_key_fence_t* fences;
+    const uint8_t* bloom;
+} fossil_ai_audit_reader_t;
+
+static atomic_uint_fast64_t g_audit_ids = 1;
+
+static atomic_uint_fast64_t g_audit_thread_ids = 1;
+static pthread_once_t g_audit_thread_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_audit_thread_key;
+
+/*
+ * Per-thread cache in front of each context's ring table; contexts are
+ * matched by id so a reused address never aliases, and the least recently
+ * used slot makes way.
+ */
+static _Thread_local struct {
+    uint64_t id;
+    uint64_t used;
+    fossil_ai_audit_ring_t* ring;
+} g_audit_tls[FOSSIL_AI_AUDIT_TLS_SLOTS];
+static _Thread_local uint64_t g_audit_tls_clock;
+static _Thread_local fossil_ai_audit_thread_t* g_audit_thread;
+
+
+/* =========================================================
+ * Helpers
+ * ========================================================= */
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static size_t align8(size_t n)
+{
+    return (n + 7) & ~(size_t)7;
+}
+
+static size_t frame_bytes(size_t key_len, size_t size)
+{
+    return align8(sizeof(fossil_ai_audit_frame_t) + key_len + size);
+}
+
+static int bytes_reserve(fossil_ai_audit_bytes_t* b, size_t extra)
+{
+    if (b->len + extra <= b->cap)
+        return 0;
+    size_t cap = b->cap ? b->cap : 4096;
+    while (cap < b->len + extra)
+        cap *= 2;
+    uint8_t* data = (uint8_t*)realloc(b->data, cap);
+    if (!data)
+        return -2;
+    b->data = data;
+    b->cap = cap;
+    return 0;
+}
+
+static int bytes_append(fossil_ai_audit_bytes_t* b, const void* p, size_t n)
+{
+    if (bytes_reserve(b, n) != 0)
+        return -2;
+    memcpy(b->data + b->len, p, n);
+    b->len += n;
+    return 0;
+}
+
+/* Keeps the first error; later puts are dropped. */
+static void out_put(fossil_ai_audit_out_t* o, const void* data, size_t size)
+{
+    if (o->rc == 0 && size)
+        o->rc = o->put(o->user, data, size);
+}
+
+static int out_bytes(void* user, const void* data, size_t size)
+{
+    return bytes_append((fossil_ai_audit_bytes_t*)user, data, size);
+}
+
+static int out_io(void* user, const void* data, size_t size)
+{
+    return fossil_ai_io_write(user, data, size);
+}
+
+static size_t online_workers(void)
+{
+#ifdef FOSSIL_AI_AUDIT_HAS_SYSCONF
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (size_t)n : 1;
+#else
+    return 1;
+#endif
+}
+
+/* Gathers the pieces straight into the slot; this is the only copy a record takes. */
+static void frame_write(uint8_t* dst, uint64_t seq, uint64_t time_ns, const char* key,
+                        size_t key_len, const fossil_ai_audit_iovec_t* iov, size_t iovcnt,
+                        size_t size, uint32_t flags)
+{
+    fossil_ai_audit_frame_t f = { seq, time_ns, (uint32_t)key_len, (uint32_t)size, flags, 0 };
+    size_t used = sizeof(f) + key_len;
+
+    memcpy(dst, &f, sizeof(f));
+    memcpy(dst + sizeof(f), key, key_len);
+    for (size_t i = 0; i < iovcnt; ++i) {
+        if (iov[i].len)
+            memcpy(dst + used, iov[i].base, iov[i].len);
+        used += iov[i].len;
+    }
+    memset(dst + used, 0, align8(used) - used);
+}
+
+
+/* =========================================================
+ * Hashing
+ * ========================================================= */
+
+typedef struct fossil_ai_audit_sha256 {
+    uint32_t h[8];
+    uint8_t block[64];
+    size_t used;
+    uint64_t total;
+} fossil_ai_audit_sha256_t;
+
+static const uint32_t g_sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define FOSSIL_AI_AUDIT_ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_block(fossil_ai_audit_sha256_t* s, const uint8_t* p)
+{
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i)
+        w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 |
+               (uint32_t)p[4 * i + 2] << 8 | (uint32_t)p[4 * i + 3];
+    for (int i = 16; i < 64; ++i) {
+        uint32_t s0 = FOSSIL_AI_AUDIT_ROR(w[i - 15], 7) ^ FOSSIL_AI_AUDIT_ROR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = FOSSIL_AI_AUDIT_ROR(w[i - 2], 17) ^ FOSSIL_AI_AUDIT_ROR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = s->h[0], b = s->h[1], c = s->h[2], d = s->h[3];
+    uint32_t e = s->h[4], f = s->h[5], g = s->h[6], h = s->h[7];
+    for (int i = 0; i < 64; ++i) {
+        uint32_t t1 = h + (FOSSIL_AI_AUDIT_ROR(e, 6) ^ FOSSIL_AI_AUDIT_ROR(e, 11) ^ FOSSIL_AI_AUDIT_ROR(e, 25))
+                    + ((e & f) ^ (~e & g)) + g_sha256_k[i] + w[i];
+        uint32_t t2 = (FOSSIL_AI_AUDIT_ROR(a, 2) ^ FOSSIL_AI_AUDIT_ROR(a, 13) ^ FOSSIL_AI_AUDIT_ROR(a, 22))
+                    + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    s->h[0] += a; s->h[1] += b; s->h[2] += c; s->h[3] += d;
+    s->h[4] += e; s->h[5] += f; s->h[6] += g; s->h[7] += h;
+}
+
+static void sha256_init(fossil_ai_audit_sha256_t* s)
+{
+    static const uint32_t iv[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy(s->h, iv, sizeof(iv));
+    s->used = 0;
+    s->total = 0;
+}
+
+static void sha256_update(fossil_ai_audit_sha256_t* s, const void* data, size_t n)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    s->total += n;
+    while (n) {
+        size_t take = 64 - s->used < n ? 64 - s->used : n;
+        if (s->used == 0 && n >= 64) {
+            sha256_block(s, p);
+            take = 64;
+        } else {
+            memcpy(s->block + s->used, p, take);
+            s->used += take;
+            if (s->used == 64) {
+                sha256_block(s, s->block);
+                s->used = 0;
+            }
+        }
+        p += take;
+        n -= take;
+    }
+}
+
+static void sha256_final(fossil_ai_audit_sha256_t* s, uint8_t out[FOSSIL_AI_AUDIT_HASH_BYTES])
+{
+    uint64_t bits = s->total * 8;
+    uint8_t pad = 0x80;
+    sha256_update(s, &pad, 1);
+    pad = 0;
+    while (s->used != 56)
+        sha256_update(s, &pad, 1);
+    uint8_t len[8];
+    for (int i = 0; i < 8; ++i)
+        len[i] = (uint8_t)(bits >> (56 - 8 * i));
+    sha256_update(s, len, 8);
+    for (int i = 0; i < 8; ++i) {
+        out[4 * i] = (uint8_t)(s->h[i] >> 24);
+        out[4 * i + 1] = (uint8_t)(s->h[i] >> 16);
+        out[4 * i + 2] = (uint8_t)(s->h[i] >> 8);
+        out[4 * i + 3] = (uint8_t)s->h[i];
+    }
+}
+
+/*
+ * The leaf commits to the payload through its digest, so a record kept by
+ * hash only has the same leaf as the full record would have had.
+ */
+static void leaf_hash(uint64_t seq, uint64_t time_ns, const void* key, size_t key_len,
+                      const void* data, size_t size, uint32_t flags,
+                      uint8_t out[FOSSIL_AI_AUDIT_HASH_BYTES])
+{
+    fossil_ai_audit_sha256_t s;
+    fossil_ai_audit_digest_t d;
+    uint8_t head[25];
+    uint64_t kl = key_len;
+
+    if (flags & FOSSIL_AI_AUDIT_OMITTED) {
+        memcpy(&d, data, sizeof(d));
+    } else {
+        d.size = size;
+        sha256_init(&s);
+        sha256_update(&s, data, size);
+        sha256_final(&s, d.hash);
+    }
+
+    head[0] = 0x00;
+    for (int i = 0; i < 8; ++i) {
+        head[1 + i] = (uint8_t)(seq >> (8 * i));
+        head[9 + i] = (uint8_t)(time_ns >> (8 * i));
+        head[17 + i] = (uint8_t)(kl >> (8 * i));
+    }
+    sha256_init(&s);
+    sha256_update(&s, head, sizeof(head));
+    sha256_update(&s, key, key_len);
+    for (int i = 0; i < 8; ++i)
+        head[i] = (uint8_t)(d.size >> (8 * i));
+    sha256_update(&s, head, 8);
+    sha256_update(&s, d.hash, sizeof(d.hash));
+    sha256_final(&s, out);
+}
+
+/* Interior node: H(0x01 || left || right). */
+static void node_hash(const uint8_t* left, const uint8_t* right, uint8_t out[FOSSIL_AI_AUDIT_HASH_BYTES])
+{
+    fossil_ai_audit_sha256_t s;
+    uint8_t tag = 0x01;
+
+    sha256_init(&s);
+    sha256_update(&s, &tag, 1);
+    sha256_update(&s, left, FOSSIL_AI_AUDIT_HASH_BYTES);
+    sha256_update(&s, right, FOSSIL_AI_AUDIT_HASH_BYTES);
+    sha256_final(&s, out);
+}
+
+/* Segment seal: H(0x02 || prev || root || first seq || count), linking each segment to the last. */
+static void seal_hash(const uint8_t* prev, const uint8_t* root, uint64_t first_seq, uint64_t count,
+                      uint8_t out[FOSSIL_AI_AUDIT_HASH_BYTES])
+{
+    fossil_ai_audit_sha256_t s;
+    uint8_t tail[16];
+    uint8_t tag = 0x02;
+
+    for (int i = 0; i < 8; ++i) {
+        tail[i] = (uint8_t)(first_seq >> (8 * i));
+        tail[8 + i] = (uint8_t)(count >> (8 * i));
+    }
+    sha256_init(&s);
+    sha256_update(&s, &tag, 1);
+    sha256_update(&s, prev, FOSSIL_AI_AUDIT_HASH_BYTES);
+    sha256_update(&s, root, FOSSIL_AI_AUDIT_HASH_BYTES);
+    sha256_update(&s, tail, sizeof(tail));
+    sha256_final(&s, out);
+}
+
+
+/* =========================================================
+ * Merkle Tree
+ * ========================================================= */
+
+static uint64_t split_point(uint64_t n)
+{
+    uint64_t k = 1;
+    while (k << 1 < n)
+        k <<= 1;
+    return k;
+}
+
+static int tree_levels(uint64_t size)
+{
+    int levels = 0;
+    while (size >> levels)
+        levels++;
+    return levels;
+}
+
+/* MTH(D[lo:hi]) from stored complete subtrees plus O(log n) combining steps. */
+static void tree_hash(const fossil_ai_audit_tree_t* t, uint64_t lo, uint64_t hi,
+                      uint8_t out[FOSSIL_AI_AUDIT_HASH_BYTES])
+{
+    uint64_t n = hi - lo;
+    if (n == 0) {
+        fossil_ai_audit_sha256_t s;
+        sha256_init(&s);
+        sha256_final(&s, out);
+        return;
+    }
+    if ((n & (n - 1)) == 0 && lo % n == 0) {
+        int k = 0;
+        while ((1ull << k) < n)
+            k++;
+        memcpy(out, t->levels[k] + (lo >> k) * FOSSIL_AI_AUDIT_HASH_BYTES, FOSSIL_AI_AUDIT_HASH_BYTES);
+        return;
+    }
+
+    uint8_t left[FOSSIL_AI_AUDIT_HASH_BYTES], right[FOSSIL_AI_AUDIT_HASH_BYTES];
+    uint64_t k = split_point(n);
+    tree_hash(t, lo, lo + k, left);
+    tree_hash(t, lo + k, hi, right);
+    node_hash(left, right, out);
+}
+
+/* RFC 6962 PATH(m, D[lo:hi]); hashes are appended leaf-side first. */
+static void inclusion_path(const fossil_ai_audit_tree_t* t, uint64_t m, uint64_t lo, uint64_t hi,
+                           uint8_t* proof, size_t* count)
+{
+    uint64_t n = hi - lo;
+    if (n <= 1)
+        return;
+    uint64_t k = split_point(n);
+    if (m < k) {
+        inclusion_path(t, m, lo, lo + k, proof, count);
+        tree_hash(t, lo + k, hi, proof + (*count)++ * FOSSIL_AI_AUDIT_HASH_BYTES);
+    } else {
+        inclusion_path(t, m - k, lo + k, hi, proof, count);
+        tree_hash(t, lo, lo + k, proof + (*count)++ * FOSSIL_AI_AUDIT_HASH_BYTES);
+    }
+}
+
+/* RFC 6962 SUBPROOF(m, D[lo:hi], b). */
+static void consistency_path(const fossil_ai_audit_tree_t* t, uint64_t m, uint64_t lo, uint64_t hi,
+                             int whole, uint8_t* proof, size_t* count)
+{
+    uint64_t n = hi - lo;
+    if (m == n) {
+        if (!whole)
+            tree_hash(t, lo, hi, proof + (*count)++ * FOSSIL_AI_AUDIT_HASH_BYTES);
+        return;
+    }
+    uint64_t k = split_point(n);
+    if (m <= k) {
+        consistency_path(t, m, lo, lo + k, whole, proof, count);
+        tree_hash(t, lo + k, hi, proof + (*count)++ * FOSSIL_AI_AUDIT_HASH_BYTES);
+    } else {
+        consistency_path(t, m - k, lo + k, hi, 0, proof, count);
+        tree_hash(t, lo, lo + k, proof + (*count)++ * FOSSIL_AI_AUDIT_HASH_BYTES);
+    }
+}
+
+/* Appends one leaf and every parent it completes. */
+static int tree_append(fossil_ai_audit_bytes_t* levels, const uint8_t leaf[FOSSIL_AI_AUDIT_HASH_BYTES])
+{
+    uint8_t node[FOSSIL_AI_AUDIT_HASH_BYTES];
+    memcpy(node, leaf, sizeof(node));
+
+    for (size_t k = 0; k < FOSSIL_AI_AUDIT_TREE_LEVELS; ++k) {
+        if (bytes_append(&levels[k], node, sizeof(node)) != 0)
+            return -2;
+        size_t nodes = levels[k].len / FOSSIL_AI_AUDIT_HASH_BYTES;
+        if (nodes & 1)
+            break;
+        node_hash(levels[k].data + levels[k].len - 2 * sizeof(node),
+                  levels[k].data + levels[k].len - sizeof(node), node);
+    }
+    return 0;
+}
+
+static void tree_view(fossil_ai_audit_ctx_t* ac, fossil_ai_audit_tree_t* t)
+{
+    t->size = ac->count;
+    for (size_t k = 0; k < FOSSIL_AI_AUDIT_TREE_LEVELS; ++k)
+        t->levels[k] = ac->levels[k].data;
+}
+
+
+/* =========================================================
+ * Recording
+ * ========================================================= */
+
+static int level_valid(int level, double sample_rate)
+{
+    return level >= FOSSIL_AI_AUDIT_FULL && level <= FOSSIL_AI_AUDIT_OFF &&
+           sample_rate >= 0.0 && sample_rate <= 1.0;
+}
+
+static uint64_t sample_threshold(double sample_rate)
+{
+    if (sample_rate >= 1.0)
+        return UINT64_MAX;
+    return (uint64_t)(sample_rate * 18446744073709551616.0);
+}
+
+/*
+ * Level and threshold share one word so a record never pairs a new level
+ * with an old rate. The threshold loses its two low bits; all ones still
+ * means every payload is kept.
+ */
+static uint64_t mode_pack(int level, double sample_rate)
+{
+    return (sample_threshold(sample_rate) & ~FOSSIL_AI_AUDIT_LEVEL_MASK) | (uint64_t)level;
+}
+
+static uint64_t mode_below(uint64_t mode)
+{
+    uint64_t below = mode & ~FOSSIL_AI_AUDIT_LEVEL_MASK;
+    return below == ~FOSSIL_AI_AUDIT_LEVEL_MASK ? UINT64_MAX : below;
+}
+
+/* Deterministic: the same key and payload are always kept or always hashed. */
+static int sample_keep(uint64_t below, const char* key, size_t key_len,
+                       const fossil_ai_audit_iovec_t* iov, size_t iovcnt)
+{
+    if (below == UINT64_MAX)
+        return 1;
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < key_len; ++i)
+        h = (h ^ (uint8_t)key[i]) * 1099511628211ull;
+    for (size_t i = 0; i < iovcnt; ++i) {
+        const uint8_t* p = (const uint8_t*)iov[i].base;
+        for (size_t j = 0; j < iov[i].len; ++j)
+            h = (h ^ p[j]) * 1099511628211ull;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h < below;
+}
+
+static void iov_digest(const fossil_ai_audit_iovec_t* iov, size_t iovcnt, size_t size,
+                       fossil_ai_audit_digest_t* d)
+{
+    fossil_ai_audit_sha256_t s;
+    sha256_init(&s);
+    for (size_t i = 0; i < iovcnt; ++i)
+        sha256_update(&s, iov[i].base, iov[i].len);
+    sha256_final(&s, d->hash);
+    d->size = size;
+}
+
+static void thread_release(fossil_ai_audit_thread_t* t)
+{
+    if (atomic_fetch_sub_explicit(&t->refs, 1, memory_order_acq_rel) == 1)
+        free(t);
+}
+
+static void thread_exit(void* arg)
+{
+    fossil_ai_audit_thread_t* t = (fossil_ai_audit_thread_t*)arg;
+    atomic_store_explicit(&t->alive, 0, memory_order_release);
+    thread_release(t);
+}
+
+static void thread_key_init(void)
+{
+    pthread_key_create(&g_audit_thread_key, thread_exit);
+}
+
+static fossil_ai_audit_thread_t* thread_self(void)
+{
+    if (g_audit_thread)
+        return g_audit_thread;
+
+    pthread_once(&g_audit_thread_once, thread_key_init);
+    fossil_ai_audit_thread_t* t = (fossil_ai_audit_thread_t*)malloc(sizeof(*t));
+    if (!t)
+        return NULL;
+    t->id = atomic_fetch_add(&g_audit_thread_ids, 1);
+    atomic_init(&t->alive, 1);
+    atomic_init(&t->refs, 1);
+    if (pthread_setspecific(g_audit_thread_key, t) != 0) {
+        free(t);
+        return NULL;
+    }
+    g_audit_thread = t;
+    return t;
+}
+
+static size_t table_slot(uint64_t id, size_t cap)
+{
+    return (size_t)((id * 0x9E3779B97F4A7C15ull) >> 32) & (cap - 1);
+}
+
+/* Keeps the table at most one ring per bucket on average; called with rings_lock held. */
+static int table_grow(fossil_ai_audit_ctx_t* ac)
+{
+    if (ac->ring_count < ac->table_cap)
+        return 0;
+
+    size_t cap = ac->table_cap ? ac->table_cap * 2 : 16;
+    fossil_ai_audit_ring_t** table = (fossil_ai_audit_ring_t**)calloc(cap, sizeof(*table));
+    if (!table)
+        return -2;
+    for (size_t i = 0; i < ac->table_cap; ++i) {
+        fossil_ai_audit_ring_t* r = ac->table[i];
+        while (r) {
+            fossil_ai_audit_ring_t* chain = r->chain;
+            size_t slot = table_slot(r->owner->id, cap);
+            r->chain = table[slot];
+            table[slot] = r;
+            r = chain;
+        }
+    }
+    free(ac->table);
+    ac->table = table;
+    ac->table_cap = cap;
+    return 0;
+}
+
+static fossil_ai_audit_ring_t* ring_create(fossil_ai_audit_ctx_t* ac, fossil_ai_audit_thread_t* t)
+{
+    fossil_ai_audit_ring_t* r = (fossil_ai_audit_ring_t*)calloc(1, sizeof(*r));
+    if (!r)
+        return NULL;
+    r->size = ac->config.buffer_bytes;
+    r->data = (uint8_t*)malloc(r->size);
+    if (!r->data || table_grow(ac) != 0) {
+        free(r->data);
+        free(r);
+        return NULL;
+    }
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    r->owner = t;
+    atomic_fetch_add_explicit(&t->refs, 1, memory_order_relaxed);
+
+    size_t slot = table_slot(t->id, ac->table_cap);
+    r->chain = ac->table[slot];
+    ac->table[slot] = r;
+    ac->ring_count++;
+    /* Only the flusher walks the list, and only it removes rings, so a release store publishes. */
+    r->next = atomic_load_explicit(&ac->rings, memory_order_relaxed);
+    atomic_store_explicit(&ac->rings, r, memory_order_release);
+    return r;
+}
+
+static fossil_ai_audit_ring_t* ring_for_thread(fossil_ai_audit_ctx_t* ac)
+{
+    unsigned lru = 0;
+    for (unsigned i = 0; i < FOSSIL_AI_AUDIT_TLS_SLOTS; ++i) {
+        if (g_audit_tls[i].id == ac->id) {
+            g_audit_tls[i].used = ++g_audit_tls_clock;
+            return g_audit_tls[i].ring;
+        }
+        if (g_audit_tls[i].used < g_audit_tls[lru].used)
+            lru = i;
+    }
+
+    fossil_ai_audit_thread_t* t = thread_self();
+    if (!t)
+        return NULL;
+
+    pthread_mutex_lock(&ac->rings_lock);
+    fossil_ai_audit_ring_t* r = ac->table_cap ? ac->table[table_slot(t->id, ac->table_cap)] : NULL;
+    while (r && r->owner != t)
+        r = r->chain;
+    if (!r)
+        r = ring_create(ac, t);
+    pthread_mutex_unlock(&ac->rings_lock);
+    if (!r)
+        return NULL;
+
+    g_audit_tls[lru].id = ac->id;
+    g_audit_tls[lru].used = ++g_audit_tls_clock;
+    g_audit_tls[lru].ring = r;
+    return r;
+}
+
+static void ring_free(fossil_ai_audit_ring_t* r)
+{
+    thread_release(r->owner);
+    free(r->data);
+    free(r);
+}
+
+/* Unlinks a drained ring whose thread has exited; flusher only. */
+static void ring_reclaim(fossil_ai_audit_ctx_t* ac, fossil_ai_audit_ring_t* r)
+{
+    pthread_mutex_lock(&ac->rings_lock);
+    fossil_ai_audit_ring_t* head = atomic_load_explicit(&ac->rings, memory_order_relaxed);
+    if (head == r) {
+        atomic_store_explicit(&ac->rings, r->next, memory_order_relaxed);
+    } else {
+        while (head->next != r)
+            head = head->next;
+        head->next = r->next;
+    }
+    fossil_ai_audit_ring_t** at = &ac->table[table_slot(r->owner->id, ac->table_cap)];
+    while (*at != r)
+        at = &(*at)->chain;
+    *at = r->chain;
+    ac->ring_count--;
+    pthread_mutex_unlock(&ac->rings_lock);
+    ring_free(r);
+}
+
+static void wake_flusher(fossil_ai_audit_ctx_t* ac)
+{
+    pthread_mutex_lock(&ac->lock);
+    ac->urgent = 1;
+    pthread_cond_signal(&ac->wake);
+    pthread_mutex_unlock(&ac->lock);
+}
+
+/* Large records bypass the rings through a short locked section. */
+static int record_overflow(fossil_ai_audit_ctx_t* ac, const char* key, size_t key_len,
+                           const fossil_ai_audit_iovec_t* iov, size_t iovcnt, size_t size,
+                           uint32_t flags)
+{
+    size_t need = frame_bytes(key_len, size);
+
+    pthread_mutex_lock(&ac->overflow_lock);
+    int rc = bytes_reserve(&ac->overflow, need);
+    if (rc == 0) {
+        uint64_t seq = atomic_fetch_add_explicit(&ac->seq, 1, memory_order_relaxed);
+        frame_write(ac->overflow.data + ac->overflow.len, seq, now_ns(), key, key_len, iov, iovcnt,
+                    size, flags);
+        ac->overflow.len += need;
+    }
+    pthread_mutex_unlock(&ac->overflow_lock);
+    if (rc == 0)
+        wake_flusher(ac);
+    return rc;
+}
+
+/*
+ * Hot path: no locks. The sequence number is taken once space is secured
+ * so a stalled writer never holds back the committed prefix for long.
+ */
+static int record_ring(fossil_ai_audit_ctx_t* ac, fossil_ai_audit_ring_t* r, const char* key,
+                       size_t key_len, const fossil_ai_audit_iovec_t* iov, size_t iovcnt,
+                       size_t size, uint32_t flags)
+{
+    size_t need = frame_bytes(key_len, size);
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    size_t off = head & (r->size - 1);
+    size_t skip = r->size - off < need ? r->size - off : 0;
+    int stalled = 0;
+
+    while (head + skip + need - atomic_load_explicit(&r->tail, memory_order_acquire) > r->size) {
+        if (!stalled) {
+            stalled = 1;
+            atomic_fetch_add_explicit(&ac->stalls, 1, memory_order_relaxed);
+        }
+        wake_flusher(ac);
+        sched_yield();
+    }
+
+    if (skip >= sizeof(fossil_ai_audit_frame_t)) {
+        fossil_ai_audit_frame_t pad = { 0, 0, FOSSIL_AI_AUDIT_PAD, 0, 0, 0 };
+        memcpy(r->data + off, &pad, sizeof(pad));
+    }
+
+    uint64_t seq = atomic_fetch_add_explicit(&ac->seq, 1, memory_order_relaxed);
+    frame_write(r->data + ((head + skip) & (r->size - 1)), seq, now_ns(), key, key_len, iov, iovcnt,
+                size, flags);
+    atomic_store_explicit(&r->head, head + skip + need, memory_order_release);
+
+    /* Nudge the flusher when the ring crosses half full. */
+    size_t used = head + skip + need - atomic_load_explicit(&r->tail, memory_order_relaxed);
+    if (used > r->size / 2 && used - need <= r->size / 2)
+        pthread_cond_signal(&ac->wake);
+    return 0;
+}
+
+
+/* =========================================================
+ * Group Commit
+ * ========================================================= */
+
+/* Called with the lock held. While pinned, a buffer is copied and the old one kept for readers. */
+static void* pinned_realloc(fossil_ai_audit_ctx_t* ac, void* old, size_t used, size_t bytes)
+{
+    if (!ac->pins || !old)
+        return realloc(old, bytes);
+
+    if (ac->retired_count == ac->retired_cap) {
+        size_t cap = ac->retired_cap ? ac->retired_cap * 2 : 16;
+        void** retired = (void**)realloc(ac->retired, cap * sizeof(void*));
+        if (!retired)
+            return NULL;
+        ac->retired = retired;
+        ac->retired_cap = cap;
+    }
+    void* fresh = malloc(bytes);
+    if (!fresh)
+        return NULL;
+    memcpy(fresh, old, used);
+    ac->retired[ac->retired_count++] = old;
+    return fresh;
+}
+
+static int pinned_reserve(fossil_ai_audit_ctx_t* ac, fossil_ai_audit_bytes_t* b, size_t extra)
+{
+    if (b->len + extra <= b->cap)
+        return 0;
+    size_t cap = b->cap ? b->cap : 4096;
+    while (cap < b->len + extra)
+        cap *= 2;
+    uint8_t* data = (uint8_t*)pinned_realloc(ac, b->data, b->len, cap);
+    if (!data)
+        return -2;
+    b->data = data;
+    b->cap = cap;
+    return 0;
+}
+
+static void view_pin(fossil_ai_audit_ctx_t* ac, fossil_ai_audit_view_t* v)
+{
+    pthread_mutex_lock(&ac->lock);
+    ac->pins++;
+    v->log = ac->log.data;
+    v->offsets = ac->offsets;
+    memcpy(v->levels, ac->levels, sizeof(v->levels));
+    v->count = ac->count;
+    v->log_first = ac->log_first;
+    v->log_segments = ac->log_segments;
+    pthread_mutex_unlock(&ac->lock);
+}
+
+static void view_release(fossil_ai_audit_ctx_t* ac)
+{
+    pthread_mutex_lock(&ac->lock);
+    if (--ac->pins == 0) {
+        for (size_t i = 0; i < ac->retired_count; ++i)
+            free(ac->retired[i]);
+        ac->retired_count = 0;
+    }
+    pthread_mutex_unlock(&ac->lock);
+}
+
+static int stage_frame(fossil_ai_audit_ctx_t* ac, const uint8_t* p)
+{
+    fossil_ai_audit_frame_t f;
+    memcpy(&f, p, sizeof(f));
+    size_t len = frame_bytes(f.key_len, f.size);
+
+    if (ac->pending_count == ac->pending_cap) {
+        size_t cap = ac->pending_cap ? ac->pending_cap * 2 : 1024;
+        fossil_ai_audit_pending_t* pending = (fossil_ai_audit_pending_t*)
+            realloc(ac->pending, cap * sizeof(*pending));
+        if (!pending)
+            return -2;
+        ac->pending = pending;
+        ac->pending_cap = cap;
+    }
+    fossil_ai_audit_pending_t* e = &ac->pending[ac->pending_count];
+    e->seq = f.seq;
+    e->off = ac->staging.len;
+    e->len = len;
+    if (bytes_append(&ac->staging, p, len) != 0)
+        return -2;
+    ac->pending_count++;
+    return 0;
+}
+
+static int drain_ring(fossil_ai_audit_ctx_t* ac, fossil_ai_audit_ring_t* r)
+{
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    int rc = 0;
+
+    while (tail < head && rc == 0) {
+        size_t off = tail & (r->size - 1);
+        size_t rem = r->size - off;
+        fossil_ai_audit_frame_t f;
+
+        if (rem < sizeof(f)) {
+            tail += rem;
+            continue;
+        }
+        memcpy(&f, r->data + off, sizeof(f));
+        if (f.key_len == FOSSIL_AI_AUDIT_PAD) {
+            tail += rem;
+            continue;
+        }
+        size_t len = frame_bytes(f.key_len, f.size);
+        if (len > rem) {
+            tail += rem;
+            continue;
+        }
+        rc = stage_frame(ac, r->data + off);
+        tail += len;
+    }
+    atomic_store_explicit(&r->tail, tail, memory_order_release);
+    return rc;
+}
+
+static int drain_overflow(fossil_ai_audit_ctx_t* ac)
+{
+    fossil_ai_audit_bytes_t taken;
+    int rc = 0;
+
+    pthread_mutex_lock(&ac->overflow_lock);
+    taken = ac->overflow;
+    memset(&ac->overflow, 0, sizeof(ac->overflow));
+    pthread_mutex_unlock(&ac->overflow_lock);
+
+    for (size_t off = 0; off < taken.len && rc == 0;) {
+        fossil_ai_audit_frame_t f;
+        memcpy(&f, taken.data + off, sizeof(f));
+        rc = stage_frame(ac, taken.data + off);
+        off += frame_bytes(f.key_len, f.size);
+    }
+    free(taken.data);
+    return rc;
+}
+
+static int pending_cmp(const void* a, const void* b)
+{
+    uint64_t x = ((const fossil_ai_audit_pending_t*)a)->seq;
+    uint64_t y = ((const fossil_ai_audit_pending_t*)b)->seq;
+    return (x > y) - (x < y);
+}
+
+/* Commits the contiguous run of staged records; later ones wait for the gap to fill. */
+static int commit_group(fossil_ai_audit_ctx_t* ac)
+{
+    if (!ac->pending_count)
+        return 0;
+    qsort(ac->pending, ac->pending_count, sizeof(*ac->pending), pending_cmp);
+
+    pthread_mutex_lock(&ac->lock);
+    uint64_t next = ac->committed;
+    pthread_mutex_unlock(&ac->lock);
+
+    size_t n = 0;
+    while (n < ac->pending_count && ac->pending[n].seq == next + n)
+        n++;
+    if (n == 0)
+        return 0;
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < n; ++i)
+        bytes += ac->pending[i].len;
+
+    /*
+     * Only the flusher grows the log and readers stop at log.len, so frames
+     * can be laid into the tail outside the lock and published afterwards.
+     * Tree levels get room for the whole group here, so appending never
+     * moves a buffer a pinned export is reading.
+     */
+    pthread_mutex_lock(&ac->lock);
+    size_t held = ac->count - ac->log_first;
+    int rc = pinned_reserve(ac, &ac->log, bytes);
+    if (rc == 0 && held + n > ac->offsets_cap) {
+        size_t cap = ac->offsets_cap ? ac->offsets_cap : 1024;
+        while (cap < held + n)
+            cap *= 2;
+        size_t* offsets = (size_t*)pinned_realloc(ac, ac->offsets, held * sizeof(size_t),
+                                                  cap * sizeof(size_t));
+        if (offsets) {
+            ac->offsets = offsets;
+            ac->offsets_cap = cap;
+        } else {
+            rc = -2;
+        }
+    }
+    for (size_t k = 0; rc == 0 && (ac->count + n) >> k; ++k)
+        rc = pinned_reserve(ac, &ac->levels[k], ((n >> k) + 1) * FOSSIL_AI_AUDIT_HASH_BYTES);
+    uint8_t* tail = ac->log.data + ac->log.len;
+    pthread_mutex_unlock(&ac->lock);
+    if (rc != 0)
+        return rc;
+
+    ac->leaves.len = 0;
+    if (bytes_reserve(&ac->leaves, n * FOSSIL_AI_AUDIT_HASH_BYTES) != 0)
+        return -2;
+    for (size_t i = 0, at = 0; i < n; at += ac->pending[i].len, ++i) {
+        const uint8_t* p = ac->staging.data + ac->pending[i].off;
+        fossil_ai_audit_frame_t fr;
+        memcpy(&fr, p, sizeof(fr));
+        memcpy(tail + at, p, ac->pending[i].len);
+        leaf_hash(fr.seq, fr.time_ns, p + sizeof(fr), fr.key_len, p + sizeof(fr) + fr.key_len,
+                  fr.size, fr.flags, ac->leaves.data + ac->leaves.len);
+        ac->leaves.len += FOSSIL_AI_AUDIT_HASH_BYTES;
+    }
+
+    /* A group that is not durable is not committed; the caller latches the error. */
+    int synced = 0;
+    if (ac->journal) {
+        if (fwrite(tail, 1, bytes, ac->journal) != bytes || fflush(ac->journal) != 0)
+            return -1;
+#ifdef FOSSIL_AI_AUDIT_HAS_FSYNC
+        if (ac->config.sync) {
+            if (fdatasync(fileno(ac->journal)) != 0)
+                return -1;
+            synced = 1;
+        }
+#endif
+    }
+
+    pthread_mutex_lock(&ac->lock);
+    size_t at = ac->log.len;
+    for (size_t i = 0; i < n && rc == 0; ++i) {
+        rc = tree_append(ac->levels, ac->leaves.data + i * FOSSIL_AI_AUDIT_HASH_BYTES);
+        ac->offsets[ac->count++ - ac->log_first] = at;
+        at += ac->pending[i].len;
+    }
+    if (rc == 0) {
+        ac->log.len += bytes;
+        ac->committed = next + n;
+        ac->stats.records += n;
+        ac->stats.groups++;
+        ac->stats.syncs += (uint64_t)synced;
+        ac->stats.bytes += bytes;
+        pthread_cond_broadcast(&ac->done);
+    }
+    pthread_mutex_unlock(&ac->lock);
+    if (rc != 0)
+        return rc;
+
+    /* Compact whatever is still waiting on a gap. */
+    fossil_ai_audit_bytes_t rest = { NULL, 0, 0 };
+    for (size_t i = n; i < ac->pending_count; ++i) {
+        if (bytes_append(&rest, ac->staging.data + ac->pending[i].off, ac->pending[i].len) != 0) {
+            free(rest.data);
+            return -2;
+        }
+        ac->pending[i - n] = ac->pending[i];
+        ac->pending[i - n].off = rest.len - ac->pending[i].len;
+    }
+    ac->pending_count -= n;
+    free(ac->staging.data);
+    ac->staging = rest;
+    return 0;
+}
+
+
+/* =========================================================
+ * Compression
+ * ========================================================= */
+
+/*
+ * A compressed segment wraps the plain log image: header, the dictionary,
+ * blocks of BLOCK_BYTES compressed independently against the dictionary,
+ * then a table of blocks. Hashes stay over the plain image, so a reader
+ * inflates it and everything else is unchanged.
+ */
+typedef struct fossil_ai_audit_z_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_bytes;
+    uint64_t raw_size;
+    uint64_t blocks;
+    uint64_t dict_size;
+    uint64_t table_offset;
+} fossil_ai_audit_z_header_t;
+
+typedef struct fossil_ai_audit_z_block {
+    uint64_t offset;
+    uint32_t size;
+    uint32_t stored;        /* 1 = kept as is, it did not shrink */
+} fossil_ai_audit_z_block_t;
+
+typedef struct fossil_ai_audit_z_job {
+    const uint8_t* dict;
+    size_t dict_size;
+    uint8_t* raw;           /* source when packing, destination when unpacking */
+    size_t raw_size;
+    const uint8_t* packed;  /* whole compressed file when unpacking */
+    size_t packed_size;
+    uint8_t* slots;         /* one BLOCK_BYTES slot per block when packing */
+    fossil_ai_audit_z_block_t* table;
+} fossil_ai_audit_z_job_t;
+
+typedef struct fossil_ai_audit_z_part {
+    const fossil_ai_audit_z_job_t* job;
+    size_t first;
+    size_t last;
+    int rc;
+} fossil_ai_audit_z_part_t;
+
+static uint32_t lz_hash(const uint8_t* p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return (v * 2654435761u) >> (32 - FOSSIL_AI_AUDIT_LZ_HASH_BITS);
+}
+
+static int lz_length(uint8_t* dst, size_t cap, size_t* at, size_t n)
+{
+    for (; n >= 255; n -= 255) {
+        if (*at >= cap)
+            return -1;
+        dst[(*at)++] = 255;
+    }
+    if (*at >= cap)
+        return -1;
+    dst[(*at)++] = (uint8_t)n;
+    return 0;
+}
+
+/* One sequence: token, literal run, then a 16-bit offset and match length unless it ends the block. */
+static int lz_sequence(uint8_t* dst, size_t cap, size_t* at, const uint8_t* lit, size_t lit_len,
+                       size_t offset, size_t match)
+{
+    size_t ml = match ? match - FOSSIL_AI_AUDIT_LZ_MIN : 0;
+    if (*at >= cap)
+        return -1;
+    dst[(*at)++] = (uint8_t)((lit_len < 15 ? lit_len : 15) << 4 | (ml < 15 ? ml : 15));
+    if (lit_len >= 15 && lz_length(dst, cap, at, lit_len - 15) != 0)
+        return -1;
+    if (lit_len > cap - *at)
+        return -1;
+    memcpy(dst + *at, lit, lit_len);
+    *at += lit_len;
+    if (!match)
+        return 0;
+    if (cap - *at < 2)
+        return -1;
+    dst[(*at)++] = (uint8_t)offset;
+    dst[(*at)++] = (uint8_t)(offset >> 8);
+    return ml >= 15 ? lz_length(dst, cap, at, ml - 15) : 0;
+}
+
+/*
+ * Greedy LZ77 over win[start, end), where win[0, start) is the dictionary
+ * and may be matched against. Returns the packed size, 0 if it would not
+ * fit in cap.
+ */
+static size_t lz_pack(const uint8_t* win, size_t start, size_t end, uint8_t* dst, size_t cap, uint32_t* table)
+{
+    size_t at = 0, anchor = start, i = start;
+    memset(table, 0, sizeof(uint32_t) << FOSSIL_AI_AUDIT_LZ_HASH_BITS);
+    for (size_t d = 0; d + FOSSIL_AI_AUDIT_LZ_MIN <= start; ++d)
+        table[lz_hash(win + d)] = (uint32_t)d + 1;
+
+    while (i + FOSSIL_AI_AUDIT_LZ_MIN <= end) {
+        uint32_t h = lz_hash(win + i);
+        size_t cand = table[h];
+        table[h] = (uint32_t)i + 1;
+        if (!cand || i - (cand - 1) > 65535 || memcmp(win + cand - 1, win + i, FOSSIL_AI_AUDIT_LZ_MIN) != 0) {
+            i++;
+            continue;
+        }
+        cand--;
+        size_t len = FOSSIL_AI_AUDIT_LZ_MIN;
+        while (i + len < end && win[cand + len] == win[i + len])
+            len++;
+        if (lz_sequence(dst, cap, &at, win + anchor, i - anchor, i - cand, len) != 0)
+            return 0;
+        i += len;
+        anchor = i;
+        if (i >= 2 && i + FOSSIL_AI_AUDIT_LZ_MIN <= end)
+            table[lz_hash(win + i - 2)] = (uint32_t)(i - 2) + 1;
+    }
+    if (anchor < end && lz_sequence(dst, cap, &at, win + anchor, end - anchor, 0, 0) != 0)
+        return 0;
+    return at < end - start ? at : 0;
+}
+
+static int lz_read_length(const uint8_t* src, size_t n, size_t* p, size_t* len)
+{
+    uint8_t b;
+    do {
+        if (*p >= n)
+            return -1;
+        b = src[(*p)++];
+        *len += b;
+    } while (b == 255);
+    return 0;
+}
+
+/* Inverse of lz_pack: fills win[start, end) from src; -3 on any malformed input. */
+static int lz_unpack(uint8_t* win, size_t start, size_t end, const uint8_t* src, size_t n)
+{
+    size_t o = start, p = 0;
+    while (o < end) {
+        if (p >= n)
+            return -3;
+        uint8_t token = src[p++];
+        size_t lit = token >> 4;
+        if (lit == 15 && lz_read_length(src, n, &p, &lit) != 0)
+            return -3;
+        if (lit > end - o || lit > n - p)
+            return -3;
+        memcpy(win + o, src + p, lit);
+        o += lit;
+        p += lit;
+        if (o == end)
+            break;
+
+        if (n - p < 2)
+            return -3;
+        size_t offset = (size_t)src[p] | (size_t)src[p + 1] << 8;
+        p += 2;
+        size_t len = token & 15;
+        if (len == 15 && lz_read_length(src, n, &p, &len) != 0)
+            return -3;
+        len += FOSSIL_AI_AUDIT_LZ_MIN;
+        if (offset == 0 || offset > o || len > end - o)
+            return -3;
+        for (size_t k = 0; k < len; ++k, ++o)
+            win[o] = win[o - offset];
+    }
+    return p == n ? 0 : -3;
+}
+
+static void* z_pack_worker(void* arg)
+{
+    fossil_ai_audit_z_part_t* p = (fossil_ai_audit_z_part_t*)arg;
+    const fossil_ai_audit_z_job_t* job = p->job;
+    uint8_t* win = (uint8_t*)malloc(job->dict_size + FOSSIL_AI_AUDIT_Z_BLOCK);
+    uint32_t* table = (uint32_t*)malloc(sizeof(uint32_t) << FOSSIL_AI_AUDIT_LZ_HASH_BITS);
+    if (!win || !table) {
+        p->rc = -2;
+    } else {
+        memcpy(win, job->dict, job->dict_size);
+        for (size_t b = p->first; b < p->last; ++b) {
+            size_t at = b * FOSSIL_AI_AUDIT_Z_BLOCK;
+            size_t n = job->raw_size - at < FOSSIL_AI_AUDIT_Z_BLOCK ? job->raw_size - at : FOSSIL_AI_AUDIT_Z_BLOCK;
+            uint8_t* slot = job->slots + at;
+            memcpy(win + job->dict_size, job->raw + at, n);
+            size_t packed = lz_pack(win, job->dict_size, job->dict_size + n, slot, n, table);
+            job->table[b].stored = packed == 0;
+            job->table[b].size = (uint32_t)(packed ? packed : n);
+            if (!packed)
+                memcpy(slot, job->raw + at, n);
+        }
+    }
+    free(win);
+    free(table);
+    return NULL;
+}
+
+static void* z_unpack_worker(void* arg)
+{
+    fossil_ai_audit_z_part_t* p = (fossil_ai_audit_z_part_t*)arg;
+    const fossil_ai_audit_z_job_t* job = p->job;
+    uint8_t* win = (uint8_t*)malloc(job->dict_size + FOSSIL_AI_AUDIT_Z_BLOCK);
+    if (!win) {
+        p->rc = -2;
+        return NULL;
+    }
+    memcpy(win, job->dict, job->dict_size);
+    for (size_t b = p->first; b < p->last && p->rc == 0; ++b) {
+        const fossil_ai_audit_z_block_t* e = &job->table[b];
+        size_t at = b * FOSSIL_AI_AUDIT_Z_BLOCK;
+        size_t n = job->raw_size - at < FOSSIL_AI_AUDIT_Z_BLOCK ? job->raw_size - at : FOSSIL_AI_AUDIT_Z_BLOCK;
+        if (e->offset > job->packed_size || e->size > job->packed_size - e->offset ||
+            (e->stored && e->size != n)) {
+            p->rc = -3;
+        } else if (e->stored) {
+            memcpy(job->raw + at, job->packed + e->offset, n);
+        } else {
+            p->rc = lz_unpack(win, job->dict_size, job->dict_size + n, job->packed + e->offset, e->size);
+            if (p->rc == 0)
+                memcpy(job->raw + at, win + job->dict_size, n);
+        }
+    }
+    free(win);
+    return NULL;
+}
+
+/* Splits the blocks over all cores; worker 0 runs on the caller. */
+static int z_run(const fossil_ai_audit_z_job_t* job, size_t blocks, void* (*worker)(void*))
+{
+    fossil_ai_audit_z_part_t parts[FOSSIL_AI_AUDIT_MAX_WORKERS];
+    pthread_t threads[FOSSIL_AI_AUDIT_MAX_WORKERS];
+    int started[FOSSIL_AI_AUDIT_MAX_WORKERS];
+    size_t workers = online_workers();
+    if (workers > FOSSIL_AI_AUDIT_MAX_WORKERS)
+        workers = FOSSIL_AI_AUDIT_MAX_WORKERS;
+    if (workers > blocks)
+        workers = blocks ? blocks : 1;
+
+    for (size_t w = 0; w < workers; ++w) {
+        parts[w].job = job;
+        parts[w].first = blocks * w / workers;
+        parts[w].last = blocks * (w + 1) / workers;
+        parts[w].rc = 0;
+        started[w] = w > 0 && pthread_create(&threads[w], NULL, worker, &parts[w]) == 0;
+        if (w > 0 && !started[w])
+            worker(&parts[w]);
+    }
+    worker(&parts[0]);
+
+    int rc = 0;
+    for (size_t w = 0; w < workers; ++w) {
+        if (w > 0 && started[w])
+            pthread_join(threads[w], NULL);
+        if (parts[w].rc != 0 && rc == 0)
+            rc = parts[w].rc;
+    }
+    return rc;
+}
+
+/* Compresses the log image raw into f. */
+static int z_write(const uint8_t* raw, size_t raw_size, const uint8_t* dict, size_t dict_size,
+                   fossil_ai_audit_out_t* out)
+{
+    fossil_ai_audit_z_header_t h;
+    fossil_ai_audit_z_job_t job;
+    size_t blocks = (raw_size + FOSSIL_AI_AUDIT_Z_BLOCK - 1) / FOSSIL_AI_AUDIT_Z_BLOCK;
+
+    memset(&job, 0, sizeof(job));
+    job.dict = dict;
+    job.dict_size = dict_size;
+    job.raw = (uint8_t*)raw;
+    job.raw_size = raw_size;
+    job.slots = (uint8_t*)malloc(raw_size ? raw_size : 1);
+    job.table = (fossil_ai_audit_z_block_t*)calloc(blocks ? blocks : 1, sizeof(*job.table));
+    int rc = job.slots && job.table ? z_run(&job, blocks, z_pack_worker) : -2;
+
+    if (rc == 0) {
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, FOSSIL_AI_AUDIT_Z_MAGIC, sizeof(h.magic));
+        h.version = 1;
+        h.block_bytes = FOSSIL_AI_AUDIT_Z_BLOCK;
+        h.raw_size = raw_size;
+        h.blocks = blocks;
+        h.dict_size = dict_size;
+        uint64_t off = sizeof(h) + align8(dict_size);
+        for (size_t b = 0; b < blocks; ++b) {
+            job.table[b].offset = off;
+            off += align8(job.table[b].size);
+        }
+        h.table_offset = off;
+
+        static const uint8_t zeros[8];
+        out_put(out, &h, sizeof(h));
+        out_put(out, dict, dict_size);
+        out_put(out, zeros, align8(dict_size) - dict_size);
+        for (size_t b = 0; b < blocks; ++b) {
+            out_put(out, job.slots + b * FOSSIL_AI_AUDIT_Z_BLOCK, job.table[b].size);
+            out_put(out, zeros, align8(job.table[b].size) - job.table[b].size);
+        }
+        out_put(out, job.table, sizeof(*job.table) * blocks);
+        rc = out->rc;
+    }
+    free(job.slots);
+    free(job.table);
+    return rc;
+}
+
+/* Inflates a compressed file into a fresh buffer; -3 if it is damaged. */
+static int z_read(const uint8_t* base, size_t size, uint8_t** out, size_t* out_size)
+{
+    const fossil_ai_audit_z_header_t* h = (const fossil_ai_audit_z_header_t*)base;
+    fossil_ai_audit_z_job_t job;
+    *out = NULL;
+    if (h->version != 1 || h->block_bytes != FOSSIL_AI_AUDIT_Z_BLOCK ||
+        h->dict_size > FOSSIL_AI_AUDIT_Z_DICT || h->raw_size > SIZE_MAX - FOSSIL_AI_AUDIT_Z_BLOCK ||
+        h->blocks != (h->raw_size + FOSSIL_AI_AUDIT_Z_BLOCK - 1) / FOSSIL_AI_AUDIT_Z_BLOCK ||
+        h->table_offset < sizeof(*h) + h->dict_size || h->table_offset > size ||
+        h->blocks > (size - h->table_offset) / sizeof(fossil_ai_audit_z_block_t) ||
+        h->table_offset + h->blocks * sizeof(fossil_ai_audit_z_block_t) != size)
+        return -3;
+
+    memset(&job, 0, sizeof(job));
+    job.dict = base + sizeof(*h);
+    job.dict_size = (size_t)h->dict_size;
+    job.raw_size = (size_t)h->raw_size;
+    job.packed = base;
+    job.packed_size = (size_t)h->table_offset;
+    job.table = (fossil_ai_audit_z_block_t*)(base + h->table_offset);
+    job.raw = (uint8_t*)malloc(job.raw_size ? job.raw_size : 1);
+    if (!job.raw)
+        return -2;
+    int rc = z_run(&job, (size_t)h->blocks, z_unpack_worker);
+    if (rc != 0) {
+        free(job.raw);
+        return rc;
+    }
+    *out = job.raw;
+    *out_size = job.raw_size;
+    return 0;
+}
+
+
+/* =========================================================
+ * Log Format
+ * ========================================================= */
+
+static const char g_hex[] = "0123456789abcdef";
+
+/* Keys are written verbatim except whitespace, '%' and non-ASCII, which become %XX. */
+static void write_key(FILE* f, const uint8_t* p, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        if (p[i] <= 0x20 || p[i] >= 0x7f || p[i] == '%') {
+            fputc('%', f);
+            fputc(g_hex[p[i] >> 4], f);
+            fputc(g_hex[p[i] & 15], f);
+        } else {
+            fputc(p[i], f);
+        }
+    }
+}
+
+static size_t record_bytes(size_t key_len, size_t size)
+{
+    return align8(sizeof(fossil_ai_audit_log_record_t) + key_len + size);
+}
+
+static int key_cmp(const uint8_t* a, size_t a_len, const uint8_t* b, size_t b_len)
+{
+    int c = memcmp(a, b, a_len < b_len ? a_len : b_len);
+    return c ? c : (a_len > b_len) - (a_len < b_len);
+}
+
+static int key_rec_cmp(const void* a, const void* b)
+{
+    const fossil_ai_audit_key_rec_t* x = (const fossil_ai_audit_key_rec_t*)a;
+    const fossil_ai_audit_key_rec_t* y = (const fossil_ai_audit_key_rec_t*)b;
+    int c = key_cmp(x->key, x->key_len, y->key, y->key_len);
+    return c ? c : (x->record > y->record) - (x->record < y->record);
+}
+
+/*
+ * Records [first, end) with the offsets write_log gives them, sorted by key
+ * then position. The caller frees the array.
+ */
+static int key_recs(const uint8_t* log, const size_t* offsets, size_t first, size_t end,
+                    fossil_ai_audit_key_rec_t** out)
+{
+    size_t count = end - first;
+    fossil_ai_audit_key_rec_t* recs = (fossil_ai_audit_key_rec_t*)malloc((count ? count : 1) * sizeof(*recs));
+    *out = recs;
+    if (!recs)
+        return -2;
+
+    uint64_t off = sizeof(fossil_ai_audit_log_header_t);
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t* p = log + offsets[first + i];
+        fossil_ai_audit_frame_t fr;
+        memcpy(&fr, p, sizeof(fr));
+        recs[i].key = p + sizeof(fr);
+        recs[i].key_len = fr.key_len;
+        recs[i].record = i;
+        recs[i].offset = off;
+        recs[i].time_ns = fr.time_ns;
+        off += record_bytes(fr.key_len, fr.size);
+    }
+    qsort(recs, count, sizeof(*recs), key_rec_cmp);
+    return 0;
+}
+
+static void bloom_hashes(const uint8_t* key, size_t key_len, uint64_t* h1, uint64_t* h2)
+{
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < key_len; ++i)
+        h = (h ^ key[i]) * 1099511628211ull;
+    *h1 = h;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    *h2 = h | 1;
+}
+
+static int bloom_test(const uint8_t* bits, uint64_t nbits, uint64_t hashes, const uint8_t* key, size_t key_len)
+{
+    uint64_t h1, h2;
+    bloom_hashes(key, key_len, &h1, &h2);
+    for (uint64_t i = 0; i < hashes; ++i) {
+        uint64_t b = (h1 + i * h2) & (nbits - 1);
+        if (!(bits[b >> 3] & (1u << (b & 7))))
+            return 0;
+    }
+    return 1;
+}
+
+/* Bytes the key index takes for sorted recs, also filling in its layout. */
+static uint64_t key_index_layout(const fossil_ai_audit_key_rec_t* recs, size_t count,
+                                 fossil_ai_audit_key_index_t* ki)
+{
+    uint64_t distinct = 0, bytes = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (i == 0 || key_cmp(recs[i - 1].key, recs[i - 1].key_len, recs[i].key, recs[i].key_len) != 0)
+            distinct++;
+        bytes += sizeof(fossil_ai_audit_key_entry_t) + align8(recs[i].key_len);
+    }
+    memset(ki, 0, sizeof(*ki));
+    ki->blocks = (count + FOSSIL_AI_AUDIT_KEY_BLOCK - 1) / FOSSIL_AI_AUDIT_KEY_BLOCK;
+    ki->bloom_bits = 64;
+    while (ki->bloom_bits < distinct * FOSSIL_AI_AUDIT_BLOOM_BITS)
+        ki->bloom_bits *= 2;
+    ki->bloom_hashes = FOSSIL_AI_AUDIT_BLOOM_HASHES;
+    ki->fence_offset = sizeof(*ki) + bytes;
+    ki->bloom_offset = ki->fence_offset + ki->blocks * sizeof(fossil_ai_audit_key_fence_t);
+    return ki->bloom_offset + ki->bloom_bits / 8;
+}
+
+/* Writes the key index laid out by key_index_layout; offsets in it are relative to `base`. */
+static int write_key_index(const fossil_ai_audit_key_rec_t* recs, size_t count,
+                           fossil_ai_audit_key_index_t* ki, uint64_t base,
+                           fossil_ai_audit_out_t* out)
+{
+    static const uint8_t zeros[8];
+    fossil_ai_audit_key_fence_t* fences = (fossil_ai_audit_key_fence_t*)
+        malloc((ki->blocks ? ki->blocks : 1) * sizeof(*fences));
+    uint8_t* bloom = (uint8_t*)calloc((size_t)(ki->bloom_bits / 8), 1);
+    if (!fences || !bloom) {
+        free(fences);
+        free(bloom);
+        return -2;
+    }
+
+    ki->fence_offset += base;
+    ki->bloom_offset += base;
+    out_put(out, ki, sizeof(*ki));
+    uint64_t off = base + sizeof(*ki);
+    for (size_t i = 0; i < count; ++i) {
+        fossil_ai_audit_key_entry_t e = { recs[i].record, recs[i].time_ns, recs[i].key_len };
+        if (i % FOSSIL_AI_AUDIT_KEY_BLOCK == 0) {
+            fences[i / FOSSIL_AI_AUDIT_KEY_BLOCK].offset = off;
+            fences[i / FOSSIL_AI_AUDIT_KEY_BLOCK].entries =
+                count - i < FOSSIL_AI_AUDIT_KEY_BLOCK ? count - i : FOSSIL_AI_AUDIT_KEY_BLOCK;
+        }
+        uint64_t h1, h2;
+        bloom_hashes(recs[i].key, recs[i].key_len, &h1, &h2);
+        for (uint64_t k = 0; k < ki->bloom_hashes; ++k) {
+            uint64_t b = (h1 + k * h2) & (ki->bloom_bits - 1);
+            bloom[b >> 3] |= (uint8_t)(1u << (b & 7));
+        }
+        out_put(out, &e, sizeof(e));
+        out_put(out, recs[i].key, recs[i].key_len);
+        out_put(out, zeros, align8(recs[i].key_len) - recs[i].key_len);
+        off += sizeof(e) + align8(recs[i].key_len);
+    }
+    out_put(out, fences, sizeof(*fences) * (size_t)ki->blocks);
+    out_put(out, bloom, (size_t)(ki->bloom_bits / 8));
+    free(fences);
+    free(bloom);
+    return 0;
+}
+
+/*
+ * Writes records [first, end) with the tree in `levels` and the sorted
+ * `recs` from key_recs, both built over exactly those records. Segments
+ * pass their number and the previous seal; the new seal is returned
+ * through `seal` if not NULL.
+ */
+static int write_log(const uint8_t* log, const size_t* offsets, const fossil_ai_audit_bytes_t* levels,
+                     const fossil_ai_audit_key_rec_t* recs, size_t first, size_t end,
+                     uint64_t segment, const uint8_t* prev, fossil_ai_audit_out_t* out,
+                     uint8_t* seal)
+{
+    fossil_ai_audit_log_header_t h;
+    fossil_ai_audit_log_footer_t foot;
+    fossil_ai_audit_tree_t tree;
+    fossil_ai_audit_key_index_t ki;
+    size_t count = end - first;
+    uint64_t* index = (uint64_t*)malloc((count ? count : 1) * sizeof(uint64_t));
+    if (!index)
+        return -2;
+
+    uint64_t off = sizeof(h);
+    for (size_t i = 0; i < count; ++i) {
+        fossil_ai_audit_frame_t fr;
+        memcpy(&fr, log + offsets[first + i], sizeof(fr));
+        index[i] = off;
+        off += record_bytes(fr.key_len, fr.size);
+    }
+
+    int depth = tree_levels(count);
+    uint64_t tree_nodes = 0;
+    for (int k = 0; k < depth; ++k)
+        tree_nodes += (uint64_t)count >> k;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, FOSSIL_AI_AUDIT_LOG_MAGIC, sizeof(h.magic));
+    h.version = FOSSIL_AI_AUDIT_LOG_VERSION;
+    h.header_size = sizeof(h);
+    h.count = count;
+    h.index_offset = off;
+    h.tree_offset = off + count * sizeof(uint64_t);
+    h.key_offset = h.tree_offset + tree_nodes * FOSSIL_AI_AUDIT_HASH_BYTES;
+    h.file_size = h.key_offset + key_index_layout(recs, count, &ki) + sizeof(foot);
+    if (count) {
+        fossil_ai_audit_frame_t fr;
+        memcpy(&fr, log + offsets[first], sizeof(fr));
+        h.first_seq = fr.seq;
+    }
+    out_put(out, &h, sizeof(h));
+
+    static const uint8_t zeros[8];
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t* p = log + offsets[first + i];
+        fossil_ai_audit_frame_t fr;
+        fossil_ai_audit_log_record_t rec;
+        memcpy(&fr, p, sizeof(fr));
+        const uint8_t* key = p + sizeof(fr);
+
+        memset(&rec, 0, sizeof(rec));
+        rec.length = (uint32_t)record_bytes(fr.key_len, fr.size);
+        rec.key_len = fr.key_len;
+        rec.seq = fr.seq;
+        rec.time_ns = fr.time_ns;
+        rec.size = fr.size;
+        rec.flags = fr.flags;
+        memcpy(rec.hash, levels[0].data + i * FOSSIL_AI_AUDIT_HASH_BYTES, sizeof(rec.hash));
+
+        size_t used = sizeof(rec) + fr.key_len + fr.size;
+        out_put(out, &rec, sizeof(rec));
+        out_put(out, key, fr.key_len + fr.size);
+        out_put(out, zeros, rec.length - used);
+    }
+
+    out_put(out, index, sizeof(uint64_t) * count);
+    for (int k = 0; k < depth; ++k)
+        out_put(out, levels[k].data, FOSSIL_AI_AUDIT_HASH_BYTES * (count >> k));
+    if (write_key_index(recs, count, &ki, h.key_offset, out) != 0) {
+        free(index);
+        return -2;
+    }
+
+    tree.size = count;
+    for (size_t k = 0; k < FOSSIL_AI_AUDIT_TREE_LEVELS; ++k)
+        tree.levels[k] = levels[k].data;
+    memset(&foot, 0, sizeof(foot));
+    memcpy(foot.magic, FOSSIL_AI_AUDIT_END_MAGIC, sizeof(foot.magic));
+    foot.count = count;
+    foot.index_offset = h.index_offset;
+    foot.segment = segment;
+    tree_hash(&tree, 0, count, foot.root);
+    if (prev)
+        memcpy(foot.prev, prev, sizeof(foot.prev));
+    seal_hash(foot.prev, foot.root, h.first_seq, count, foot.seal);
+    if (seal)
+        memcpy(seal, foot.seal, sizeof(foot.seal));
+    out_put(out, &foot, sizeof(foot));
+
+    free(index);
+    return out->rc;
+}
+
+static void reader_close(fossil_ai_audit_reader_t* r)
+{
+#ifdef FOSSIL_AI_AUDIT_HAS_MMAP
+    if (r->mapped) {
+        munmap((void*)r->base, r->size);
+        r->base = NULL;
+    }
+#endif
+    free((void*)r->base);
+    memset(r, 0, sizeof(*r));
+}
+
+/* Maps the log and checks its framing; record contents are checked by verify. */
+static int reader_open(fossil_ai_audit_reader_t* r, const char* path)
+{
+    memset(r, 0, sizeof(*r));
+
+#ifdef FOSSIL_AI_AUDIT_HAS_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    struct stat sb;
+    if (fstat(fd, &sb) != 0) {
+        close(fd);
+        return -1;
+    }
+    r->size = (size_t)sb.st_size;
+    if (r->size) {
+        void* base = mmap(NULL, r->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (base == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        madvise(base, r->size, MADV_SEQUENTIAL);
+        r->base = (const uint8_t*)base;
+        r->mapped = 1;
+    }
+    close(fd);
+#else
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return -1;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t* buf = len > 0 ? (uint8_t*)malloc((size_t)len) : NULL;
+    if (len > 0 && (!buf || fread(buf, 1, (size_t)len, f) != (size_t)len)) {
+        free(buf);
+        fclose(f);
+        return buf ? -1 : -2;
+    }
+    fclose(f);
+    r->base = buf;
+    r->size = len > 0 ? (size_t)len : 0;
+#endif
+
+    if (r->size >= sizeof(fossil_ai_audit_z_header_t) &&
+        memcmp(r->base, FOSSIL_AI_AUDIT_Z_MAGIC, 8) == 0) {
+        uint8_t* raw;
+        size_t raw_size;
+        int rc = z_read(r->base, r->size, &raw, &raw_size);
+        reader_close(r);
+        if (rc != 0)
+            return rc;
+        r->base = raw;
+        r->size = raw_size;
+    }
+
+    const fossil_ai_audit_log_header_t* h = (const fossil_ai_audit_log_header_t*)r->base;
+    if (r->size < sizeof(*h) + sizeof(fossil_ai_audit_log_footer_t) ||
+        memcmp(h->magic, FOSSIL_AI_AUDIT_LOG_MAGIC, sizeof(h->magic)) != 0 ||
+        h->version != FOSSIL_AI_AUDIT_LOG_VERSION || h->header_size != sizeof(*h) ||
+        h->file_size != r->size || h->index_offset > r->size ||
+        h->count > (r->size - h->index_offset) / sizeof(uint64_t) ||
+        h->tree_offset != h->index_offset + h->count * sizeof(uint64_t)) {
+        reader_close(r);
+        return -3;
+    }
+
+    /* Level k has count >> k nodes, so the whole tree is under 2 * count hashes. */
+    uint64_t nodes = 0;
+    int levels = tree_levels(h->count);
+    for (int k = 0; k < levels; ++k)
+        nodes += h->count >> k;
+    size_t tail = sizeof(fossil_ai_audit_key_index_t) + sizeof(fossil_ai_audit_log_footer_t);
+    if (nodes > (r->size - h->tree_offset) / FOSSIL_AI_AUDIT_HASH_BYTES ||
+        h->key_offset != h->tree_offset + nodes * FOSSIL_AI_AUDIT_HASH_BYTES ||
+        h->key_offset > r->size - tail) {
+        reader_close(r);
+        return -3;
+    }
+
+    const fossil_ai_audit_key_index_t* ki = (const fossil_ai_audit_key_index_t*)(r->base + h->key_offset);
+    uint64_t end = r->size - sizeof(fossil_ai_audit_log_footer_t);
+    if (ki->blocks != (h->count + FOSSIL_AI_AUDIT_KEY_BLOCK - 1) / FOSSIL_AI_AUDIT_KEY_BLOCK ||
+        ki->fence_offset < h->key_offset + sizeof(*ki) || ki->fence_offset % 8 || ki->fence_offset > end ||
+        ki->blocks > (end - ki->fence_offset) / sizeof(fossil_ai_audit_key_fence_t) ||
+        ki->bloom_offset != ki->fence_offset + ki->blocks * sizeof(fossil_ai_audit_key_fence_t) ||
+        ki->bloom_bits < 64 || (ki->bloom_bits & (ki->bloom_bits - 1)) ||
+        ki->bloom_hashes == 0 || ki->bloom_hashes > 32 ||
+        ki->bloom_bits / 8 != end - ki->bloom_offset) {
+        reader_close(r);
+        return -3;
+    }
+
+    const fossil_ai_audit_log_footer_t* foot = (const fossil_ai_audit_log_footer_t*)
+        (r->base + r->size - sizeof(*foot));
+    if (memcmp(foot->magic, FOSSIL_AI_AUDIT_END_MAGIC, sizeof(foot->magic)) != 0 ||
+        foot->count != h->count || foot->index_offset != h->index_offset) {
+        reader_close(r);
+        return -3;
+    }
+
+    r->header = h;
+    r->index = (const uint64_t*)(r->base + h->index_offset);
+    r->count = (size_t)h->count;
+    r->keys = ki;
+    r->fences = (const fossil_ai_audit_key_fence_t*)(r->base + ki->fence_offset);
+    r->bloom = r->base + ki->bloom_offset;
+    r->tree.size = h->count;
+    const uint8_t* level = r->base + h->tree_offset;
+    for (int k = 0; k < levels; ++k) {
+        r->tree.levels[k] = level;
+        level += (h->count >> k) * FOSSIL_AI_AUDIT_HASH_BYTES;
+    }
+    return 0;
+}
+
+/* Bounds-checked view of record i; -3 if its framing is damaged. */
+static int reader_entry(const fossil_ai_audit_reader_t* r, size_t i, fossil_ai_audit_entry_t* e)
+{
+    uint64_t off = r->index[i];
+    uint64_t limit = r->header->index_offset;
+    if (off < sizeof(fossil_ai_audit_log_header_t) || off % 8 ||
+        off + sizeof(fossil_ai_audit_log_record_t) > limit)
+        return -3;
+
+    const fossil_ai_audit_log_record_t* rec = (const fossil_ai_audit_log_record_t*)(r->base + off);
+    if (rec->length != record_bytes(rec->key_len, (size_t)rec->size) || off + rec->length > limit ||
+        (rec->flags & ~FOSSIL_AI_AUDIT_OMITTED) ||
+        ((rec->flags & FOSSIL_AI_AUDIT_OMITTED) && rec->size != sizeof(fossil_ai_audit_digest_t)))
+        return -3;
+
+    e->seq = rec->seq;
+    e->time_ns = rec->time_ns;
+    e->key = (const uint8_t*)(rec + 1);
+    e->key_len = rec->key_len;
+    e->data = e->key + rec->key_len;
+    e->size = (size_t)rec->size;
+    e->flags = rec->flags;
+    e->hash = rec->hash;
+    return 0;
+}
+
+/* What a query callback sees; an omitted payload shows as its size and digest. */
+static void entry_item(const fossil_ai_audit_entry_t* e, fossil_ai_audit_item_t* item)
+{
+    item->seq = e->seq;
+    item->time_ns = e->time_ns;
+    item->key = (const char*)e->key;
+    item->key_len = e->key_len;
+    item->data = e->data;
+    item->size = e->size;
+    item->digest = NULL;
+    if (e->flags & FOSSIL_AI_AUDIT_OMITTED) {
+        uint64_t size;
+        memcpy(&size, e->data, sizeof(size));
+        item->data = NULL;
+        item->size = (size_t)size;
+        item->digest = e->data + offsetof(fossil_ai_audit_digest_t, hash);
+    }
+}
+
+/* Key entry at off, bounds-checked against the key blocks; NULL if damaged. */
+static const fossil_ai_audit_key_entry_t* key_entry_at(const fossil_ai_audit_reader_t* r, uint64_t off)
+{
+    uint64_t lo = r->header->key_offset + sizeof(fossil_ai_audit_key_index_t);
+    uint64_t hi = r->keys->fence_offset;
+    if (off < lo || off % 8 || off > hi || hi - off < sizeof(fossil_ai_audit_key_entry_t))
+        return NULL;
+    const fossil_ai_audit_key_entry_t* e = (const fossil_ai_audit_key_entry_t*)(r->base + off);
+    if (e->key_len > hi - off - sizeof(*e) || align8((size_t)e->key_len) > hi - off - sizeof(*e) ||
+        e->record >= r->count)
+        return NULL;
+    return e;
+}
+
+static int key_matches(const uint8_t* key, size_t key_len, const char* prefix, size_t prefix_len)
+{
+    return prefix_len == 0 || (key_len >= prefix_len && memcmp(key, prefix, prefix_len) == 0);
+}
+
+/*
+ * Calls fn for records whose key equals (exact) or starts with key, in key
+ * order. Exact lookups ask the Bloom filter first; then a binary search
+ * over the fences finds the block where the keys begin.
+ */
+static int key_scan(const fossil_ai_audit_reader_t* r, const char* key, size_t key_len, int exact,
+                    uint64_t t0, uint64_t t1, fossil_ai_audit_query_fn fn, void* user, int* stop)
+{
+    const fossil_ai_audit_key_index_t* ki = r->keys;
+    if (exact && !bloom_test(r->bloom, ki->bloom_bits, ki->bloom_hashes, (const uint8_t*)key, key_len))
+        return 0;
+
+    size_t lo = 0, hi = (size_t)ki->blocks;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const fossil_ai_audit_key_entry_t* e = key_entry_at(r, r->fences[mid].offset);
+        if (!e)
+            return -3;
+        if (key_cmp((const uint8_t*)(e + 1), (size_t)e->key_len, (const uint8_t*)key, key_len) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    for (size_t b = lo ? lo - 1 : 0; b < ki->blocks && !*stop; ++b) {
+        uint64_t off = r->fences[b].offset;
+        for (uint64_t n = 0; n < r->fences[b].entries && !*stop; ++n) {
+            const fossil_ai_audit_key_entry_t* e = key_entry_at(r, off);
+            if (!e)
+                return -3;
+            const uint8_t* k = (const uint8_t*)(e + 1);
+            off += sizeof(*e) + align8((size_t)e->key_len);
+
+            int c = key_cmp(k, (size_t)e->key_len, (const uint8_t*)key, key_len);
+            if (c < 0)
+                continue;
+            if (exact ? c != 0 : !key_matches(k, (size_t)e->key_len, key, key_len))
+                return 0;
+            if (e->time_ns < t0 || e->time_ns > t1)
+                continue;
+
+            fossil_ai_audit_entry_t rec;
+            if (reader_entry(r, (size_t)e->record, &rec) != 0)
+                return -3;
+            fossil_ai_audit_item_t item;
+            entry_item(&rec, &item);
+            *stop = fn(&item, user) != 0;
+        }
+    }
+    return 0;
+}
+
+
+/* =========================================================
+ * Segments
+ * ========================================================= */
+
+static char* segment_path(const char* prefix, uint64_t segment)
+{
+    size_t n = strlen(prefix) + 32;
+    char* path = (char*)malloc(n);
+    if (path)
+        snprintf(path, n, "%s.%08llu.log", prefix, (unsigned long long)segment);
+    return path;
+}
+
+static char* index_path(const char* prefix)
+{
+    size_t n = strlen(prefix) + 5;
+    char* path = (char*)malloc(n);
+    if (path)
+        snprintf(path, n, "%s.idx", prefix);
+    return path;
+}
+
+/* Writes go through the I/O engine, so rendering overlaps the disk. */
+static int tmp_open(const char* path, char** tmp, fossil_ai_audit_out_t* out)
+{
+    fossil_ai_io_config_t io;
+    size_t n = strlen(path);
+    *tmp = (char*)malloc(n + 5);
+    if (!*tmp)
+        return -2;
+    memcpy(*tmp, path, n);
+    memcpy(*tmp + n, ".tmp", 5);
+
+    memset(&io, 0, sizeof(io));
+    io.sync = 1;
+    memset(out, 0, sizeof(*out));
+    out->put = out_io;
+    if (fossil_ai_io_create(&out->user, *tmp, &io) != 0) {
+        free(*tmp);
+        *tmp = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/* Syncs and renames over path when rc is 0, otherwise discards the file. */
+static int tmp_commit(fossil_ai_audit_out_t* out, char* tmp, const char* path, int rc)
+{
+    if (fossil_ai_io_close(out->user) != 0 && rc == 0)
+        rc = -1;
+
+    if (rc == 0 && rename(tmp, path) != 0)
+        rc = -1;
+    if (rc != 0)
+        remove(tmp);
+    free(tmp);
+    return rc;
+}
+
+/* The side index is small, a few entries per segment, so it is read whole. */
+static int index_load(const char* prefix, fossil_ai_audit_bytes_t* out)
+{
+    uint8_t buf[65536];
+    size_t n;
+    memset(out, 0, sizeof(*out));
+    char* path = index_path(prefix);
+    if (!path)
+        return -2;
+    FILE* f = fopen(path, "rb");
+    free(path);
+    if (!f)
+        return -1;
+
+    int rc = 0;
+    while (rc == 0 && (n = fread(buf, 1, sizeof(buf), f)) > 0)
+        rc = bytes_append(out, buf, n);
+    if (rc == 0 && ferror(f))
+        rc = -1;
+    fclose(f);
+    if (rc != 0) {
+        free(out->data);
+        memset(out, 0, sizeof(*out));
+    }
+    return rc;
+}
+
+/* Steps to the segment entry at *pos; 1 past the last one, -3 if the index is damaged. */
+static int index_next(const fossil_ai_audit_bytes_t* idx, size_t* pos,
+                      const fossil_ai_audit_index_segment_t** seg, const uint8_t** keys)
+{
+    if (*pos == idx->len)
+        return 1;
+    if (idx->len - *pos < sizeof(**seg))
+        return -3;
+    const fossil_ai_audit_index_segment_t* s = (const fossil_ai_audit_index_segment_t*)(idx->data + *pos);
+    if (memcmp(s->magic, FOSSIL_AI_AUDIT_SEG_MAGIC, sizeof(s->magic)) != 0)
+        return -3;
+
+    size_t at = *pos + sizeof(*s);
+    for (uint64_t k = 0; k < s->keys; ++k) {
+        if (idx->len - at < sizeof(fossil_ai_audit_index_key_t))
+            return -3;
+        const fossil_ai_audit_index_key_t* e = (const fossil_ai_audit_index_key_t*)(idx->data + at);
+        at += sizeof(*e);
+        if (e->key_len > idx->len - at || align8((size_t)e->key_len) > idx->len - at)
+            return -3;
+        at += align8((size_t)e->key_len);
+    }
+    *seg = s;
+    *keys = idx->data + *pos + sizeof(*s);
+    *pos = at;
+    return 0;
+}
+
+/* One key entry per distinct key of the sorted recs, in key order. */
+static int index_append(const char* prefix, fossil_ai_audit_index_segment_t* entry,
+                        const fossil_ai_audit_key_rec_t* recs, size_t count)
+{
+    static const uint8_t zeros[8];
+    entry->keys = 0;
+    for (size_t i = 0; i < count; ++i)
+        if (i == 0 || key_cmp(recs[i].key, recs[i].key_len, recs[i - 1].key, recs[i - 1].key_len) != 0)
+            entry->keys++;
+
+    char* path = index_path(prefix);
+    if (!path)
+        return -2;
+    FILE* f = fopen(path, "ab");
+    free(path);
+    if (!f)
+        return -1;
+
+    fwrite(entry, sizeof(*entry), 1, f);
+    for (size_t i = 0; i < count;) {
+        fossil_ai_audit_index_key_t k;
+        size_t j = i;
+        memset(&k, 0, sizeof(k));
+        k.first = recs[i].offset;
+        k.time_min = UINT64_MAX;
+        for (; j < count && key_cmp(recs[j].key, recs[j].key_len, recs[i].key, recs[i].key_len) == 0; ++j) {
+            k.last = recs[j].offset;
+            k.time_min = recs[j].time_ns < k.time_min ? recs[j].time_ns : k.time_min;
+            k.time_max = recs[j].time_ns > k.time_max ? recs[j].time_ns : k.time_max;
+        }
+        k.count = j - i;
+        k.key_len = recs[i].key_len;
+        fwrite(&k, sizeof(k), 1, f);
+        fwrite(recs[i].key, 1, recs[i].key_len, f);
+        fwrite(zeros, 1, align8(recs[i].key_len) - recs[i].key_len, f);
+        i = j;
+    }
+
+    int rc = fflush(f) != 0 || ferror(f) ? -1 : 0;
+#ifdef FOSSIL_AI_AUDIT_HAS_FSYNC
+    if (rc == 0)
+        fsync(fileno(f));
+#endif
+    fclose(f);
+    return rc;
+}
+
+typedef struct fossil_ai_audit_key_group {
+    size_t first;
+    size_t count;
+} fossil_ai_audit_key_group_t;
+
+static int key_group_cmp(const void* a, const void* b)
+{
+    const fossil_ai_audit_key_group_t* x = (const fossil_ai_audit_key_group_t*)a;
+    const fossil_ai_audit_key_group_t* y = (const fossil_ai_audit_key_group_t*)b;
+    if (x->count != y->count)
+        return x->count > y->count ? -1 : 1;
+    return (x->first > y->first) - (x->first < y->first);
+}
+
+/*
+ * Trains the dictionary for one segment image: the leading bytes of one
+ * record for each of the most frequent keys, most frequent last. Record
+ * headers, keys and payload shapes repeat, so every block can reference
+ * them from its first byte.
+ */
+static size_t dict_train(const uint8_t* image, size_t image_size, const fossil_ai_audit_key_rec_t* recs,
+                         size_t count, uint8_t* dict)
+{
+    fossil_ai_audit_key_group_t* groups = (fossil_ai_audit_key_group_t*)malloc((count ? count : 1) * sizeof(*groups));
+    if (!groups)
+        return 0;
+    size_t n = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (i == 0 || key_cmp(recs[i].key, recs[i].key_len, recs[i - 1].key, recs[i - 1].key_len) != 0)
+            groups[n++] = (fossil_ai_audit_key_group_t){ i, 0 };
+        groups[n - 1].count++;
+    }
+    qsort(groups, n, sizeof(*groups), key_group_cmp);
+
+    size_t chosen = 0, size = 0;
+    for (; chosen < n; ++chosen) {
+        const fossil_ai_audit_log_record_t* rec = (const fossil_ai_audit_log_record_t*)
+            (image + recs[groups[chosen].first].offset);
+        size_t len = rec->length < FOSSIL_AI_AUDIT_Z_FRAGMENT ? rec->length : FOSSIL_AI_AUDIT_Z_FRAGMENT;
+        if (size + len > FOSSIL_AI_AUDIT_Z_DICT)
+            break;
+        size += len;
+    }
+    size_t at = 0;
+    while (chosen-- > 0) {
+        uint64_t off = recs[groups[chosen].first].offset;
+        const fossil_ai_audit_log_record_t* rec = (const fossil_ai_audit_log_record_t*)(image + off);
+        size_t len = rec->length < FOSSIL_AI_AUDIT_Z_FRAGMENT ? rec->length : FOSSIL_AI_AUDIT_Z_FRAGMENT;
+        if (off + len <= image_size) {
+            memcpy(dict + at, image + off, len);
+            at += len;
+        }
+    }
+    free(groups);
+    return at;
+}
+
+/* Renders the segment image, then writes it compressed against a dictionary trained on it. */
+static int write_packed(fossil_ai_audit_ctx_t* ac, const size_t* offsets, const fossil_ai_audit_bytes_t* levels,
+                        const fossil_ai_audit_key_rec_t* recs, size_t count,
+                        fossil_ai_audit_out_t* out, uint8_t* seal)
+{
+    uint8_t* dict = (uint8_t*)malloc(FOSSIL_AI_AUDIT_Z_DICT);
+    fossil_ai_audit_bytes_t image = { NULL, 0, 0 };
+    fossil_ai_audit_out_t raw = { out_bytes, &image, 0 };
+    int rc = dict ? 0 : -2;
+    if (rc == 0)
+        rc = write_log(ac->log.data, offsets, levels, recs, 0, count, ac->seg_number, ac->seg_prev,
+                       &raw, seal);
+    if (rc == 0) {
+        size_t dict_size = dict_train(image.data, image.len, recs, count, dict);
+        rc = z_write(image.data, image.len, dict, dict_size, out);
+    }
+
+    free(image.data);
+    free(dict);
+    return rc;
+}
+
+/*
+ * Called by the flusher: once the open segment reaches its size or age,
+ * writes it as a sealed log with its own tree, compressed if configured,
+ * then appends its index entry. Leaf hashes and tree levels stay in memory
+ * for proofs; log_trim then drops the records, and export reads them back.
+ */
+static int seal_segment(fossil_ai_audit_ctx_t* ac, int force)
+{
+    size_t first = ac->seg_first, end = ac->count;
+    if (!ac->config.segments || end == first)
+        return 0;
+    const size_t* offsets = ac->offsets + (first - ac->log_first);
+    uint64_t now = now_ns();
+    if (!force && ac->log.len - offsets[0] < ac->config.segment_bytes &&
+        !(ac->config.segment_seconds &&
+          now - ac->seg_started >= (uint64_t)ac->config.segment_seconds * 1000000000ull))
+        return 0;
+
+    size_t count = end - first;
+    fossil_ai_audit_bytes_t levels[FOSSIL_AI_AUDIT_TREE_LEVELS];
+    fossil_ai_audit_index_segment_t entry;
+    fossil_ai_audit_key_rec_t* recs;
+    memset(levels, 0, sizeof(levels));
+    memset(&entry, 0, sizeof(entry));
+    memcpy(entry.magic, FOSSIL_AI_AUDIT_SEG_MAGIC, sizeof(entry.magic));
+    entry.segment = ac->seg_number;
+    entry.count = count;
+    entry.time_min = UINT64_MAX;
+
+    int rc = key_recs(ac->log.data, offsets, 0, count, &recs);
+    for (size_t i = 0; i < count && rc == 0; ++i) {
+        rc = tree_append(levels, ac->levels[0].data + (first + i) * FOSSIL_AI_AUDIT_HASH_BYTES);
+        entry.time_min = recs[i].time_ns < entry.time_min ? recs[i].time_ns : entry.time_min;
+        entry.time_max = recs[i].time_ns > entry.time_max ? recs[i].time_ns : entry.time_max;
+    }
+    if (rc == 0) {
+        fossil_ai_audit_frame_t fr;
+        memcpy(&fr, ac->log.data + offsets[0], sizeof(fr));
+        entry.first_seq = fr.seq;
+    }
+
+    char* path = rc == 0 ? segment_path(ac->config.segments, ac->seg_number) : NULL;
+    if (rc == 0 && !path)
+        rc = -2;
+    if (rc == 0) {
+        char* tmp;
+        fossil_ai_audit_out_t out;
+        rc = tmp_open(path, &tmp, &out);
+        if (rc == 0 && ac->config.compress)
+            rc = tmp_commit(&out, tmp, path, write_packed(ac, offsets, levels, recs, count, &out, entry.seal));
+        else if (rc == 0)
+            rc = tmp_commit(&out, tmp, path,
+                            write_log(ac->log.data, offsets, levels, recs, 0, count,
+                                      ac->seg_number, ac->seg_prev, &out, entry.seal));
+    }
+    if (rc == 0)
+        rc = index_append(ac->config.segments, &entry, recs, count);
+    if (rc == 0) {
+        ac->seg_first = end;
+        ac->seg_number++;
+        ac->seg_started = now;
+        memcpy(ac->seg_prev, entry.seal, sizeof(ac->seg_prev));
+        pthread_mutex_lock(&ac->lock);
+        ac->stats.segments++;
+        pthread_mutex_unlock(&ac->lock);
+    }
+
+    free(path);
+    free(recs);
+    for (size_t k = 0; k < FOSSIL_AI_AUDIT_TREE_LEVELS; ++k)
+        free(levels[k].data);
+    return rc;
+}
+
+/*
+ * Drops sealed records from the log, moving the open segment to its front.
+ * An export reading the log unlocked keeps it whole until the next pass.
+ */
+static void log_trim(fossil_ai_audit_ctx_t* ac)
+{
+    pthread_mutex_lock(&ac->lock);
+    size_t drop = ac->seg_first - ac->log_first;
+    if (drop && !ac->pins) {
+        size_t held = ac->count - ac->seg_first;
+        size_t base = held ? ac->offsets[drop] : ac->log.len;
+        memmove(ac->log.data, ac->log.data + base, ac->log.len - base);
+        ac->log.len -= base;
+        for (size_t i = 0; i < held; ++i)
+            ac->offsets[i] = ac->offsets[drop + i] - base;
+        ac->log_first = ac->seg_first;
+        ac->log_segments = ac->seg_number;
+    }
+    pthread_mutex_unlock(&ac->lock);
+}
+
+/* Continues numbering and the seal chain from an existing index. */
+static int segments_resume(fossil_ai_audit_ctx_t* ac)
+{
+    fossil_ai_audit_bytes_t idx;
+    const fossil_ai_audit_index_segment_t* seg;
+    const uint8_t* keys;
+    size_t pos = 0;
+    int rc = index_load(ac->config.segments, &idx);
+    if (rc == -1)
+        return 0;
+    while (rc == 0 && (rc = index_next(&idx, &pos, &seg, &keys)) == 0) {
+        ac->seg_number = seg->segment + 1;
+        memcpy(ac->seg_prev, seg->seal, sizeof(ac->seg_prev));
+    }
+    free(idx.data);
+    return rc < 0 ? rc : 0;
+}
+
+
+/* =========================================================
+ * Flusher
+ * ========================================================= */
+
+/*
+ * After a failure the journal may hold part of a group, or the segments
+ * part of a seal, so nothing more is committed or sealed: waiters are
+ * woken and every later call reports the error.
+ */
+static void fail(fossil_ai_audit_ctx_t* ac, int rc)
+{
+    pthread_mutex_lock(&ac->lock);
+    if (!atomic_load_explicit(&ac->error, memory_order_relaxed))
+        atomic_store_explicit(&ac->error, rc, memory_order_release);
+    pthread_cond_broadcast(&ac->done);
+    pthread_mutex_unlock(&ac->lock);
+}
+
+static void* flusher_main(void* arg)
+{
+    fossil_ai_audit_ctx_t* ac = (fossil_ai_audit_ctx_t*)arg;
+
+    for (;;) {
+        fossil_ai_audit_ring_t* next;
+        for (fossil_ai_audit_ring_t* r = atomic_load(&ac->rings); r; r = next) {
+            /* Seen dead before the drain, the ring holds nothing the drain missed. */
+            int dead = !atomic_load_explicit(&r->owner->alive, memory_order_acquire);
+            next = r->next;
+            if (drain_ring(ac, r) == 0 && dead &&
+                atomic_load_explicit(&r->tail, memory_order_relaxed) ==
+                atomic_load_explicit(&r->head, memory_order_relaxed))
+                ring_reclaim(ac, r);
+        }
+        drain_overflow(ac);
+        if (!atomic_load_explicit(&ac->error, memory_order_relaxed)) {
+            int rc = commit_group(ac);
+            if (rc == 0)
+                rc = seal_segment(ac, 0);
+            if (rc != 0)
+                fail(ac, rc);
+            log_trim(ac);
+        }
+
+        pthread_mutex_lock(&ac->lock);
+        int quit = ac->stop &&
+                   (ac->committed == atomic_load_explicit(&ac->seq, memory_order_relaxed) ||
+                    atomic_load_explicit(&ac->error, memory_order_relaxed));
+        if (!quit && !ac->urgent) {
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            uint64_t ns = (uint64_t)until.tv_nsec + (uint64_t)ac->config.flush_interval_us * 1000ull;
+            until.tv_sec += (time_t)(ns / 1000000000ull);
+            until.tv_nsec = (long)(ns % 1000000000ull);
+            pthread_cond_timedwait(&ac->wake, &ac->lock, &until);
+        }
+        ac->urgent = 0;
+        pthread_mutex_unlock(&ac->lock);
+        if (quit) {
+            if (!atomic_load_explicit(&ac->error, memory_order_relaxed)) {
+                int rc = seal_segment(ac, 1);
+                if (rc != 0)
+                    fail(ac, rc);
+            }
+            break;
+        }
+    }
+    return NULL;
+}
+
+
+/* =========================================================
+ * Lifecycle
+ * ========================================================= */
+
+int fossil_ai_audit_begin_ex(void** ctx, const fossil_ai_audit_config_t* config)
+{
+    if (!ctx)
+        return -1;
+    *ctx = NULL;
+    if (config && !level_valid(config->level, config->sample_rate))
+        return -1;
+
+    fossil_ai_audit_ctx_t* ac = (fossil_ai_audit_ctx_t*)calloc(1, sizeof(*ac));
+    if (!ac)
+        return -2;
+    if (config)
+        ac->config = *config;
+    ac->config.journal = NULL;
+
+    /* Rings are a power of two so positions wrap with a mask. */
+    size_t want = ac->config.buffer_bytes ? ac->config.buffer_bytes : FOSSIL_AI_AUDIT_RING_BYTES;
+    size_t size = 4096;
+    while (size < want)
+        size *= 2;
+    ac->config.buffer_bytes = size;
+    if (!ac->config.flush_interval_us)
+        ac->config.flush_interval_us = FOSSIL_AI_AUDIT_FLUSH_US;
+
+    if (!ac->config.segment_bytes)
+        ac->config.segment_bytes = FOSSIL_AI_AUDIT_SEGMENT_BYTES;
+    if (config && config->segments) {
+        size_t n = strlen(config->segments) + 1;
+        char* prefix = (char*)malloc(n);
+        if (!prefix) {
+            free(ac);
+            return -2;
+        }
+        memcpy(prefix, config->segments, n);
+        ac->config.segments = prefix;
+        ac->seg_started = now_ns();
+        int rc = segments_resume(ac);
+        if (rc != 0) {
+            free(prefix);
+            free(ac);
+            return rc;
+        }
+        ac->seg_base = ac->seg_number;
+        ac->log_segments = ac->seg_number;
+    }
+
+    if (config && config->journal) {
+        ac->journal = fopen(config->journal, "ab");
+        if (!ac->journal) {
+            free((void*)ac->config.segments);
+            free(ac);
+            return -1;
+        }
+    }
+
+    ac->id = atomic_fetch_add(&g_audit_ids, 1);
+    atomic_init(&ac->seq, 0);
+    atomic_init(&ac->rings, NULL);
+    atomic_init(&ac->stalls, 0);
+    atomic_init(&ac->mode, mode_pack(ac->config.level, ac->config.sample_rate));
+    atomic_init(&ac->omitted, 0);
+    atomic_init(&ac->dropped, 0);
+    atomic_init(&ac->error, 0);
+    pthread_mutex_init(&ac->rings_lock, NULL);
+    pthread_mutex_init(&ac->overflow_lock, NULL);
+    pthread_mutex_init(&ac->lock, NULL);
+    pthread_cond_init(&ac->wake, NULL);
+    pthread_cond_init(&ac->done, NULL);
+
+    if (pthread_create(&ac->flusher, NULL, flusher_main, ac) != 0) {
+        if (ac->journal)
+            fclose(ac->journal);
+        pthread_cond_destroy(&ac->done);
+        pthread_cond_destroy(&ac->wake);
+        pthread_mutex_destroy(&ac->lock);
+        pthread_mutex_destroy(&ac->overflow_lock);
+        pthread_mutex_destroy(&ac->rings_lock);
+        free((void*)ac->config.segments);
+        free(ac);
+        return -2;
+    }
+
+    *ctx = ac;
+    return 0;
+}
+
+int fossil_ai_audit_begin(void** ctx)
+{
+    return fossil_ai_audit_begin_ex(ctx, NULL);
+}
+
+int fossil_ai_audit_recordv(void* ctx, const char* key, const fossil_ai_audit_iovec_t* iov,
+                            size_t iovcnt)
+{
+    fossil_ai_audit_ctx_t* ac = (fossil_ai_audit_ctx_t*)ctx;
+    if (!ac || !key || (!iov && iovcnt))
+        return -1;
+
+    size_t size = 0;
+    for (size_t i = 0; i < iovcnt; ++i) {
+        if ((!iov[i].base && iov[i].len) || iov[i].len > UINT32_MAX - 1 - size)
+            return -1;
+        size += iov[i].len;
+    }
+
+    int err = atomic_load_explicit(&ac->error, memory_order_acquire);
+    if (err)
+        return err;
+
+    uint64_t mode = atomic_load_explicit(&ac->mode, memory_order_relaxed);
+    int level = (int)(mode & FOSSIL_AI_AUDIT_LEVEL_MASK);
+    if (level == FOSSIL_AI_AUDIT_OFF) {
+        atomic_fetch_add_explicit(&ac->dropped, 1, memory_order_relaxed);
+        return 0;
+    }
+
+    size_t key_len = strlen(key);
+    uint32_t flags = 0;
+    fossil_ai_audit_digest_t d;
+    fossil_ai_audit_iovec_t piece = { &d, sizeof(d) };
+    if (level == FOSSIL_AI_AUDIT_HASH_ONLY ||
+        (level == FOSSIL_AI_AUDIT_SAMPLED &&
+         !sample_keep(mode_below(mode), key, key_len, iov, iovcnt))) {
+        iov_digest(iov, iovcnt, size, &d);
+        iov = &piece;
+        iovcnt = 1;
+        size = sizeof(d);
+        flags = FOSSIL_AI_AUDIT_OMITTED;
+        atomic_fetch_add_explicit(&ac->omitted, 1, memory_order_relaxed);
+    }
+
+    if (frame_bytes(key_len, size) > ac->config.buffer_bytes / 4)
+        return record_overflow(ac, key, key_len, iov, iovcnt, size, flags);
+
+    fossil_ai_audit_ring_t* r = ring_for_thread(ac);
+    if (!r)
+        return -2;
+    return record_ring(ac, r, key, key_len, iov, iovcnt, size, flags);
+}
+
+int fossil_ai_audit_record(void* ctx, const char* key, const void* data, size_t size)
+{
+    fossil_ai_audit_iovec_t piece = { data, size };
+    return fossil_ai_audit_recordv(ctx, key, &piece, 1);
+}
+
+/* Payload: input and output sizes as two uint32, the input, then the output. */
+int fossil_ai_audit_record_inference(void* ctx, const char* key, const void* input, size_t input_size,
+                                     const void* output, size_t output_size)
+{
+    if (input_size > UINT32_MAX / 2 || output_size > UINT32_MAX / 2)
+        return -1;
+
+    uint32_t head[2] = { (uint32_t)input_size, (uint32_t)output_size };
+    fossil_ai_audit_iovec_t pieces[3] = {
+        { head, sizeof(head) }, { input, input_size }, { output, output_size }
+    };
+    return fossil_ai_audit_recordv(ctx, key ? key : FOSSIL_AI_AUDIT_INFER_KEY, pieces, 3);
+}
+
+
+/* Applies to records made after the call; records already queued keep their level. */
+int fossil_ai_audit_set_level(void* ctx, int level, double sample_rate)
+{
+    fossil_ai_audit_ctx_t* ac = (fossil_ai_audit_ctx_t*)ctx;
+    if (!ac || !level_valid(level, sample_rate))
+        return -1;
+
+    atomic_store_explicit(&ac->mode, mode_pack(level, sample_rate), memory_order_relaxed);
+    return 0;
+}
+
+/* Returns once every record made before the call is committed. */
+int fossil_ai_audit_flush(void* ctx)
+{
+    fossil_ai_audit_ctx_t* ac = (fossil_ai_audit_ctx_t*)ctx;
+    if (!ac)
+        return -1;
+
+    uint64_t target = atomic_load(&ac->seq);
+    pthread_mutex_lock(&ac->lock);
+    ac->urgent = 1;
+    pthread_cond_signal(&ac->wake);
+    while (ac->committed < target && !atomic_load_explicit(&ac->error, memory_order_relaxed))
+        pthread_cond_wait(&ac->done, &ac->lock);
+    pthread_mutex_unlock(&ac->lock);
+    return atomic_load_explicit(&ac->error, memory_order_acquire);
+}
+
+int fossil_ai_audit_stats(void* ctx, fossil_ai_audit_stats_t* out)
+{
+    fossil_ai_audit_ctx_t* ac = (fossil_ai_audit_ctx_t*)ctx;
+    if (!ac || !out)
+        return -1;
+
+    pthread_mutex_lock(&ac->lock);
+    *out = ac->stats;
+    pthread_mutex_unlock(&ac->lock);
+    out->stalls = atomic_load(&ac->stalls);
+    out->omitted = atomic_load(&ac->omitted);
+    out->dropped = atomic_load(&ac->dropped);
+    return 0;
+}
+
+int fossil_ai_audit_end(void* ctx)
+{
+    fossil_ai_audit_ctx_t* ac = (fossil_ai_audit_ctx_t*)ctx;
+    if (!ac)
+        return -1;
+
+    pthread_mutex_lock(&ac->lock);
+    ac->stop = 1;
+    pthread_cond_signal(&ac->wake);
+    pthread_mutex_unlock(&ac->lock);
+    pthread_join(ac->flusher, NULL);
+    int rc = atomic_load(&ac->error);
+
+    fossil_ai_audit_ring_t* r = atomic_load(&ac->rings);
+    while (r) {
+        fossil_ai_audit_ring_t* next = r->next;
+        ring_free(r);
+        r = next;
+    }
+    free(ac->table);
+    if (ac->journal)
+        fclose(ac->journal);
+    free(ac->overflow.data);
+    free(ac->staging.data);
+    free(ac->pending);
+    free(ac->leaves.data);
+    for (size_t k = 0; k < FOSSIL_AI_AUDIT_TREE_LEVELS; ++k)
+        free(ac->levels[k].data);
+    free(ac->log.data);
+    free(ac->offsets);
+    free(ac->retired);
+    free((void*)ac->config.segments);
+    pthread_cond_destroy(&ac->done);
+    pthread_cond_destroy(&ac->wake);
+    pthread_mutex_destroy(&ac->lock);
+    pthread_mutex_destroy(&ac->overflow_lock);
+    pthread_mutex_destroy(&ac->rings_lock);
+    free(ac);
+    return rc;
+}
+
+
+/* =========================================================
+ * Export and Verification
+ * ========================================================= */
+
+/*
+ * Frames of the records log_trim dropped, read back from the segments this
+ * context sealed. Each leaf must match the tree in memory, so a segment
+ * changed on disk is not exported as if it were committed.
+ */
+static int sealed_frames(fossil_ai_audit_ctx_t* ac, const fossil_ai_audit_view_t* v,
+                         fossil_ai_audit_bytes_t* log, size_t* offsets)
+{
+    static const uint8_t zeros[8];
+    size_t at = 0;
+    int rc = 0;
+
+    for (uint64_t segment = ac->seg_base; rc == 0 && segment < v->log_segments; ++segment) {
+        fossil_ai_audit_reader_t r;
+        char* path = segment_path(ac->config.segments, segment);
+        if (!path)
+            return -2;
+        rc = reader_open(&r, path);
+        free(path);
+        for (size_t i = 0; rc == 0 && i < r.count; ++i) {
+            fossil_ai_audit_entry_t e;
+            fossil_ai_audit_frame_t fr;
+            uint8_t leaf[FOSSIL_AI_AUDIT_HASH_BYTES];
+            rc = reader_entry(&r, i, &e);
+            if (rc == 0 && at < v->log_first)
+                leaf_hash(e.seq, e.time_ns, e.key, e.key_len, e.data, e.size, e.flags, leaf);
+            if (rc == 0 && (at == v->log_first ||
+                            memcmp(leaf, v->levels[0].data + at * FOSSIL_AI_AUDIT_HASH_BYTES,
+                                   sizeof(leaf)) != 0))
+                rc = -3;
+            if (rc != 0)
+                break;
+
+            memset(&fr, 0, sizeof(fr));
+            fr.seq = e.seq;
+            fr.time_ns = e.time_ns;
+            fr.key_len = (uint32_t)e.key_len;
+            fr.size = (uint32_t)e.size;
+            fr.flags = e.flags;
+            offsets[at++] = log->len;
+            size_t used = sizeof(fr) + e.key_len + e.size;
+            if (bytes_append(log, &fr, sizeof(fr)) != 0 ||
+                bytes_append(log, e.key, e.key_len + e.size) != 0 ||
+                bytes_append(log, zeros, frame_bytes(e.key_len, e.size) - used) != 0)
+                rc = -2;
+        }
+        reader_close(&r);
+    }
+    return rc == 0 && at != v->log_first ? -3 : rc;
+}
+
+/*
+ * Renders the committed log without holding the lock, so commits go on
+ * meanwhile. Sealed records no longer in memory are read back first.
+ */
+static int export_render(fossil_ai_audit_ctx_t* ac, fossil_ai_audit_out_t* out)
+{
+    fossil_ai_audit_view_t v;
+    fossil_ai_audit_key_rec_t* recs = NULL;
+    fossil_ai_audit_bytes_t whole = { NULL, 0, 0 };
+    size_t* all = NULL;
+
+    view_pin(ac, &v);
+    const uint8_t* log = v.log;
+    const size_t* offsets = v.offsets;
+    int rc = 0;
+    if (v.log_first) {
+        all = (size_t*)malloc(v.count * sizeof(size_t));
+        rc = all ? sealed_frames(ac, &v, &whole, all) : -2;
+        for (size_t i = v.log_first; rc == 0 && i < v.count; ++i) {
+            const uint8_t* p = v.log + v.offsets[i - v.log_first];
+            fossil_ai_audit_frame_t fr;
+            memcpy(&fr, p, sizeof(fr));
+            all[i] = whole.len;
+            if (bytes_append(&whole, p, frame_bytes(fr.key_len, fr.size)) != 0)
+                rc = -2;
+        }
+        log = whole.data;
+        offsets = all;
+    }
+    if (rc == 0)
+        rc = key_recs(log, offsets, 0, v.count, &recs);
+    if (rc == 0)
+        rc = write_log(log, offsets, v.levels, recs, 0, v.count, 0, NULL, out, NULL);
+    free(recs);
+    free(whole.data);
+    free(all);
+    view_release(ac);
+    return rc;
+}
+
+int fossil_ai_audit_export(void* ctx, const char* path)
+{
+    fossil_ai_audit_ctx_t* ac = (fossil_ai_audit_ctx_t*)ctx;
+    if (!ac || !path)
+        return -1;
+
+    int rc = fossil_ai_audit_flush(ac);
+    if (rc != 0)
+        return rc;
+
+    char* tmp;
+    fossil_ai_audit_out_t out;
+    rc = tmp_open(path, &tmp, &out);
+    if (rc != 0)
+        return rc;
+    return tmp_commit(&out, tmp, path, export_render(ac, &out));
+}
+
+/* Bounded staging for streamed exports; long pieces are handed over in place. */
+typedef struct fossil_ai_audit_stream {
+    uint8_t* buf;
+    size_t len;
+    fossil_ai_audit_write_fn fn;
+    void* user;
+} fossil_ai_audit_stream_t;
+
+static int stream_flush(fossil_ai_audit_stream_t* st)
+{
+    size_t n = st->len;
+    st->len = 0;
+    return n && st->fn(st->buf, n, st->user) != 0 ? -1 : 0;
+}
+
+static int out_stream(void* user, const void* data, size_t size)
+{
+    fossil_ai_audit_stream_t* st = (fossil_ai_audit_stream_t*)user;
+    const uint8_t* p = (const uint8_t*)data;
+
+    if (size >= FOSSIL_AI_AUDIT_STREAM_CHUNK) {
+        if (stream_flush(st) != 0)
+            return -1;
+        while (size) {
+            size_t k = size < FOSSIL_AI_AUDIT_STREAM_CHUNK ? size : FOSSIL_AI_AUDIT_STREAM_CHUNK;
+            if (st->fn(p, k, st->user) != 0)
+                return -1;
+            p += k;
+            size -= k;
+        }
+        return 0;
+    }
+    while (size) {
+        size_t k = FOSSIL_AI_AUDIT_STREAM_CHUNK - st->len < size ? FOSSIL_AI_AUDIT_STREAM_CHUNK - st->len : size;
+        memcpy(st->buf + st->len, p, k);
+        st->len += k;
+        p += k;
+        size -= k;
+        if (st->len == FOSSIL_AI_AUDIT_STREAM_CHUNK && stream_flush(st) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+/*
+ * Same bytes as export, never more than one chunk buffered. The log is
+ * rendered from a pinned view, so a slow reader holds back only its own
+ * export; commits, flushes and proofs carry on.
+ */
+int fossil_ai_audit_export_stream(void* ctx, fossil_ai_audit_write_fn fn, void* user)
+{
+    fossil_ai_audit_ctx_t* ac = (fossil_ai_audit_ctx_t*)ctx;
+    if (!ac || !fn)
+        return -1;
+
+    int rc = fossil_ai_audit_flush(ac);
+    if (rc != 0)
+        return rc;
+
+    fossil_ai_audit_stream_t st = { (uint8_t*)malloc(FOSSIL_AI_AUDIT_STREAM_CHUNK), 0, fn, user };
+    fossil_ai_audit_out_t out = { out_stream, &st, 0 };
+    if (!st.buf)
+        return -2;
+    rc = export_render(ac, &out);
+    if (rc == 0)
+        rc = stream_flush(&st);
+    free(st.buf);
+    return rc;
+}
+
+#ifdef FOSSIL_AI_AUDIT_HAS_FD
+/* Waits out a full pipe or socket buffer rather than failing on EAGAIN. */
+static int fd_ready(int fd)
+{
+    struct pollfd pfd = { fd, POLLOUT, 0 };
+    return poll(&pfd, 1, -1) >= 0 || errno == EINTR ? 0 : -1;
+}
+
+static int fd_write(const void* data, size_t size, void* user)
+{
+    int fd = *(const int*)user;
+    const uint8_t* p = (const uint8_t*)data;
+    while (size) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (fd_ready(fd) != 0)
+                return -1;
+            continue;
+        }
+        if (n <= 0)
+            return -1;
+        p += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+#endif
+
+int fossil_ai_audit_export_fd(void* ctx, int fd)
+{
+#ifdef FOSSIL_AI_AUDIT_HAS_FD
+    if (fd < 0)
+        return -1;
+    return fossil_ai_audit_export_stream(ctx, fd_write, &fd);
+#else
+    (void)ctx;
+    (void)fd;
+    return -1;
+#endif
+}
+
+/*
+ * Files are already laid out, so the kernel moves them: splice into pipes,
+ * sendfile elsewhere. A bounded copy loop covers targets that refuse both.
+ */
+int fossil_ai_audit_send(const char* path, int fd)
+{
+#ifdef FOSSIL_AI_AUDIT_HAS_FD
+    struct stat sb;
+    if (!path || fd < 0)
+        return -1;
+    int in = open(path, O_RDONLY);
+    if (in < 0)
+        return -1;
+    if (fstat(in, &sb) != 0) {
+        close(in);
+        return -1;
+    }
+
+    uint64_t left = (uint64_t)sb.st_size;
+    int rc = 0;
+#ifdef FOSSIL_AI_AUDIT_HAS_SPLICE
+    struct stat ob;
+    int to_pipe = fstat(fd, &ob) == 0 && S_ISFIFO(ob.st_mode);
+    while (left && rc == 0) {
+        size_t want = left < FOSSIL_AI_AUDIT_STREAM_CHUNK * 4 ? (size_t)left : FOSSIL_AI_AUDIT_STREAM_CHUNK * 4;
+        ssize_t n = to_pipe ? splice(in, NULL, fd, NULL, want, SPLICE_F_MOVE | SPLICE_F_MORE)
+                            : sendfile(fd, in, NULL, want);
+        if (n > 0)
+            left -= (uint64_t)n;
+        else if (n < 0 && errno == EINTR)
+            continue;
+        else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            rc = fd_ready(fd);
+        else if (n < 0 && (errno == EINVAL || errno == ENOSYS))
+            break;
+        else
+            rc = -1;
+    }
+#endif
+
+    uint8_t* buf = left && rc == 0 ? (uint8_t*)malloc(FOSSIL_AI_AUDIT_STREAM_CHUNK) : NULL;
+    if (left && rc == 0 && !buf)
+        rc = -2;
+    while (left && rc == 0) {
+        size_t want = left < FOSSIL_AI_AUDIT_STREAM_CHUNK ? (size_t)left : FOSSIL_AI_AUDIT_STREAM_CHUNK;
+        ssize_t n = read(in, buf, want);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0 || fd_write(buf, (size_t)n, &fd) != 0)
+            rc = -1;
+        else
+            left -= (uint64_t)n;
+    }
+    free(buf);
+    close(in);
+    return rc;
+#else
+    (void)path;
+    (void)fd;
+    return -1;
+#endif
+}
+
+typedef struct fossil_ai_audit_verify_part {
+    const fossil_ai_audit_reader_t* reader;
+    uint64_t from;          /* leaves below are already trusted */
+    size_t first;           /* chunk range [first, last) */
+    size_t last;
+    int rc;
+} fossil_ai_audit_verify_part_t;
+
+/* Framing and leaf hash of record i. Records must sit back to back so nothing hides between them. */
+static int verify_leaf(const fossil_ai_audit_reader_t* r, size_t i)
+{
+    fossil_ai_audit_entry_t e;
+    uint8_t hash[FOSSIL_AI_AUDIT_HASH_BYTES];
+    if (reader_entry(r, i, &e) != 0)
+        return -3;
+    uint64_t next = r->index[i] + record_bytes(e.key_len, e.size);
+    if ((i == 0 && r->index[0] != sizeof(fossil_ai_audit_log_header_t)) ||
+        (i + 1 < r->count ? r->index[i + 1] : r->header->index_offset) != next)
+        return -3;
+    leaf_hash(e.seq, e.time_ns, e.key, e.key_len, e.data, e.size, e.flags, hash);
+    if (memcmp(hash, e.hash, sizeof(hash)) != 0 ||
+        memcmp(hash, r->tree.levels[0] + i * FOSSIL_AI_AUDIT_HASH_BYTES, sizeof(hash)) != 0)
+        return 1;
+    return 0;
+}
+
+/* Stored node j of level k against its two children one level down. */
+static int verify_node(const fossil_ai_audit_tree_t* t, int k, uint64_t j)
+{
+    uint8_t hash[FOSSIL_AI_AUDIT_HASH_BYTES];
+    const uint8_t* child = t->levels[k - 1] + 2 * j * FOSSIL_AI_AUDIT_HASH_BYTES;
+    node_hash(child, child + FOSSIL_AI_AUDIT_HASH_BYTES, hash);
+    return memcmp(hash, t->levels[k] + j * FOSSIL_AI_AUDIT_HASH_BYTES, sizeof(hash)) != 0;
+}
+
+/*
+ * Each chunk of 2^SHIFT leaves is a complete subtree, so its leaves and
+ * the nodes above them up to the chunk root are checked without touching
+ * any other chunk. Nodes wholly below `from` are skipped.
+ */
+static void* verify_worker(void* arg)
+{
+    fossil_ai_audit_verify_part_t* p = (fossil_ai_audit_verify_part_t*)arg;
+    const fossil_ai_audit_reader_t* r = p->reader;
+
+    for (size_t c = p->first; c < p->last && p->rc >= 0; ++c) {
+        uint64_t begin = (uint64_t)c << FOSSIL_AI_AUDIT_VERIFY_SHIFT;
+        uint64_t end = begin + (1ull << FOSSIL_AI_AUDIT_VERIFY_SHIFT);
+        if (end > r->count)
+            end = r->count;
+
+        for (uint64_t i = begin > p->from ? begin : p->from; i < end; ++i) {
+            int rc = verify_leaf(r, (size_t)i);
+            if (rc < 0 || (rc > 0 && p->rc == 0))
+                p->rc = rc;
+            if (rc < 0)
+                break;
+        }
+        for (int k = 1; k <= (int)FOSSIL_AI_AUDIT_VERIFY_SHIFT && p->rc >= 0; ++k) {
+            uint64_t lo = begin >> k > p->from >> k ? begin >> k : p->from >> k;
+            for (uint64_t j = lo; j < end >> k; ++j)
+                if (verify_node(&r->tree, k, j))
+                    p->rc = p->rc ? p->rc : 1;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * The key index must list every record exactly once: entries strictly
+ * ordered by key then record, each matching its record's key and time,
+ * with full blocks laid back to back and every key in the Bloom filter.
+ */
+static int verify_keys(const fossil_ai_audit_reader_t* r)
+{
+    const fossil_ai_audit_key_index_t* ki = r->keys;
+    const fossil_ai_audit_key_entry_t* prev = NULL;
+    uint64_t off = r->header->key_offset + sizeof(*ki);
+
+    for (size_t b = 0; b < ki->blocks; ++b) {
+        uint64_t left = r->count - b * FOSSIL_AI_AUDIT_KEY_BLOCK;
+        if (r->fences[b].offset != off ||
+            r->fences[b].entries != (left < FOSSIL_AI_AUDIT_KEY_BLOCK ? left : FOSSIL_AI_AUDIT_KEY_BLOCK))
+            return 1;
+        for (uint64_t n = 0; n < r->fences[b].entries; ++n) {
+            const fossil_ai_audit_key_entry_t* e = key_entry_at(r, off);
+            fossil_ai_audit_entry_t rec;
+            if (!e || reader_entry(r, (size_t)e->record, &rec) != 0)
+                return -3;
+            const uint8_t* k = (const uint8_t*)(e + 1);
+            if (rec.key_len != e->key_len || memcmp(rec.key, k, rec.key_len) != 0 || rec.time_ns != e->time_ns ||
+                !bloom_test(r->bloom, ki->bloom_bits, ki->bloom_hashes, k, rec.key_len))
+                return 1;
+            if (prev) {
+                int c = key_cmp((const uint8_t*)(prev + 1), (size_t)prev->key_len, k, (size_t)e->key_len);
+                if (c > 0 || (c == 0 && prev->record >= e->record))
+                    return 1;
+            }
+            prev = e;
+            off += sizeof(*e) + align8((size_t)e->key_len);
+        }
+    }
+    return off == ki->fence_offset ? 0 : 1;
+}
+
+/*
+ * Checks leaves [from, count) and every stored node not wholly inside the
+ * first `from` leaves. The old prefix is vouched for by `trusted`: its root
+ * is rebuilt from the maximal complete subtrees of [0, from), which are
+ * exactly the old children the new nodes hash over. The key index is only
+ * checked on a full pass.
+ */
+static int verify_log(const char* path, uint64_t from, const uint8_t* trusted)
+{
+    fossil_ai_audit_reader_t r;
+    fossil_ai_audit_verify_part_t parts[FOSSIL_AI_AUDIT_MAX_WORKERS];
+    pthread_t threads[FOSSIL_AI_AUDIT_MAX_WORKERS];
+    int started[FOSSIL_AI_AUDIT_MAX_WORKERS];
+    uint8_t root[FOSSIL_AI_AUDIT_HASH_BYTES];
+
+    int rc = reader_open(&r, path);
+    if (rc != 0)
+        return rc;
+    if (from > r.count) {
+        reader_close(&r);
+        return 1;
+    }
+    if (trusted) {
+        tree_hash(&r.tree, 0, from, root);
+        if (memcmp(root, trusted, sizeof(root)) != 0) {
+            reader_close(&r);
+            return 1;
+        }
+    }
+    if (from > 0 && from < r.count) {
+        fossil_ai_audit_entry_t e;
+        if (reader_entry(&r, (size_t)from - 1, &e) != 0 ||
+            r.index[from - 1] + record_bytes(e.key_len, e.size) != r.index[from]) {
+            reader_close(&r);
+            return -3;
+        }
+    }
+
+    size_t first = (size_t)(from >> FOSSIL_AI_AUDIT_VERIFY_SHIFT);
+    size_t chunks = (size_t)((r.count + (1ull << FOSSIL_AI_AUDIT_VERIFY_SHIFT) - 1) >> FOSSIL_AI_AUDIT_VERIFY_SHIFT);
+    size_t todo = chunks > first ? chunks - first : 0;
+    size_t workers = online_workers();
+    if (workers > FOSSIL_AI_AUDIT_MAX_WORKERS)
+        workers = FOSSIL_AI_AUDIT_MAX_WORKERS;
+    if (workers > todo)
+        workers = todo ? todo : 1;
+
+    for (size_t w = 0; w < workers; ++w) {
+        parts[w].reader = &r;
+        parts[w].from = from;
+        parts[w].first = first + todo * w / workers;
+        parts[w].last = first + todo * (w + 1) / workers;
+        parts[w].rc = 0;
+        started[w] = w > 0 && pthread_create(&threads[w], NULL, verify_worker, &parts[w]) == 0;
+        if (w > 0 && !started[w])
+            verify_worker(&parts[w]);
+    }
+    verify_worker(&parts[0]);
+
+    for (size_t w = 0; w < workers; ++w) {
+        if (w > 0 && started[w])
+            pthread_join(threads[w], NULL);
+        if (parts[w].rc < 0 || (parts[w].rc > 0 && rc == 0))
+            rc = parts[w].rc;
+    }
+    if (rc == 0 && r.count == 0 && r.header->index_offset != sizeof(fossil_ai_audit_log_header_t))
+        rc = -3;
+    if (rc >= 0 && from == 0) {
+        int keys = verify_keys(&r);
+        if (keys < 0 || (keys > 0 && rc == 0))
+            rc = keys;
+    }
+
+    /* Above the chunk roots there are only count >> SHIFT nodes left. */
+    int levels = tree_levels(r.count);
+    for (int k = FOSSIL_AI_AUDIT_VERIFY_SHIFT + 1; k < levels && rc == 0; ++k)
+        for (uint64_t j = from >> k; j < r.count >> k && rc == 0; ++j)
+            rc = verify_node(&r.tree, k, j);
+
+    const fossil_ai_audit_log_footer_t* foot = (const fossil_ai_audit_log_footer_t*)
+        (r.base + r.size - sizeof(*foot));
+    tree_hash(&r.tree, 0, r.count, root);
+    if (rc == 0 && memcmp(foot->root, root, sizeof(root)) != 0)
+        rc = 1;
+    seal_hash(foot->prev, root, r.header->first_seq, r.count, root);
+    if (rc == 0 && memcmp(foot->seal, root, sizeof(root)) != 0)
+        rc = 1;
+    reader_close(&r);
+    return rc;
+}
+
+/* 0 = intact, 1 = hash mismatch, -3 = unreadable. Subtrees are checked on all cores. */
+int fossil_ai_audit_verify(const char* path)
+{
+    if (!path)
+        return -1;
+    return verify_log(path, 0, NULL);
+}
+
+/* Like verify, but only reads what was appended after a tree of trusted_size leaves and trusted_root. */
+int fossil_ai_audit_verify_from(const char* path, uint64_t trusted_size, const uint8_t* trusted_root)
+{
+    if (!path || !trusted_root)
+        return -1;
+    return verify_log(path, trusted_size, trusted_root);
+}
+
+static void diff_line(FILE* out, char side, const fossil_ai_audit_entry_t* e)
+{
+    fprintf(out, "%c %llu ", side, (unsigned long long)e->seq);
+    write_key(out, e->key, e->key_len);
+    fputc('\n', out);
+}
+
+typedef struct fossil_ai_audit_diff_state {
+    const fossil_ai_audit_reader_t* a;
+    const fossil_ai_audit_reader_t* b;
+    FILE* out;
+    uint64_t run_lo;        /* differing leaf positions not yet written */
+    uint64_t run_hi;
+    int differ;
+} fossil_ai_audit_diff_state_t;
+
+/* Merges a[i, i_end) and b[j, j_end) by sequence number, writing records that differ. */
+static int diff_run(const fossil_ai_audit_reader_t* ra, size_t i, size_t i_end,
+                    const fossil_ai_audit_reader_t* rb, size_t j, size_t j_end, FILE* f)
+{
+    int differ = 0;
+    while (i < i_end || j < j_end) {
+        fossil_ai_audit_entry_t ex, ey;
+        const fossil_ai_audit_entry_t* x = NULL;
+        const fossil_ai_audit_entry_t* y = NULL;
+        if (i < i_end) {
+            if (reader_entry(ra, i, &ex) != 0)
+                return -3;
+            x = &ex;
+        }
+        if (j < j_end) {
+            if (reader_entry(rb, j, &ey) != 0)
+                return -3;
+            y = &ey;
+        }
+
+        if (x && (!y || x->seq < y->seq)) {
+            diff_line(f, '-', x);
+            i++;
+        } else if (y && (!x || y->seq < x->seq)) {
+            diff_line(f, '+', y);
+            j++;
+        } else {
+            if (x->key_len != y->key_len || x->size != y->size || x->flags != y->flags ||
+                memcmp(x->key, y->key, x->key_len) != 0 ||
+                memcmp(x->data, y->data, x->size) != 0) {
+                diff_line(f, '-', x);
+                diff_line(f, '+', y);
+                differ = 1;
+            }
+            i++;
+            j++;
+            continue;
+        }
+        differ = 1;
+    }
+    return differ;
+}
+
+static void diff_flush(fossil_ai_audit_diff_state_t* st)
+{
+    if (st->run_lo == st->run_hi || st->differ < 0)
+        return;
+    uint64_t ia = st->run_hi < st->a->count ? st->run_hi : st->a->count;
+    uint64_t ib = st->run_hi < st->b->count ? st->run_hi : st->b->count;
+    int rc = diff_run(st->a, (size_t)(st->run_lo < ia ? st->run_lo : ia), (size_t)ia,
+                      st->b, (size_t)(st->run_lo < ib ? st->run_lo : ib), (size_t)ib, st->out);
+    if (rc < 0 || (rc > 0 && st->differ == 0))
+        st->differ = rc;
+    st->run_lo = st->run_hi;
+}
+
+/*
+ * Walks the aligned block j of level k. Blocks both trees store with equal
+ * hashes are skipped whole; differing leaves gather into runs that are
+ * merged and written as soon as an equal block follows them.
+ */
+static void diff_descend(fossil_ai_audit_diff_state_t* st, int k, uint64_t j)
+{
+    uint64_t lo = j << k;
+    if (st->differ < 0 || (lo >= st->a->count && lo >= st->b->count))
+        return;
+
+    if (j < st->a->count >> k && j < st->b->count >> k &&
+        memcmp(st->a->tree.levels[k] + j * FOSSIL_AI_AUDIT_HASH_BYTES,
+               st->b->tree.levels[k] + j * FOSSIL_AI_AUDIT_HASH_BYTES, FOSSIL_AI_AUDIT_HASH_BYTES) == 0) {
+        diff_flush(st);
+        return;
+    }
+    if (k == 0) {
+        if (st->run_hi != lo)
+            diff_flush(st);
+        if (st->run_lo == st->run_hi)
+            st->run_lo = lo;
+        st->run_hi = lo + 1;
+        return;
+    }
+    diff_descend(st, k - 1, 2 * j);
+    diff_descend(st, k - 1, 2 * j + 1);
+}
+
+/*
+ * Writes one line per record that differs to out (a FILE*, NULL = stdout):
+ * "-" for records only or differently in a, "+" for b. 0 = same, 1 = differ,
+ * -3 = a damaged log. Only subtrees whose stored hashes differ are read, so
+ * near-identical logs cost O(d log n) for d differing records; records are
+ * still compared by sequence, key and payload, so timestamps alone never
+ * show up as a difference. Stored hashes are trusted; run verify first on
+ * logs that may have been tampered with.
+ */
+int fossil_ai_audit_diff(const char* a, const char* b, void* out)
+{
+    fossil_ai_audit_reader_t ra, rb;
+    fossil_ai_audit_diff_state_t st;
+    if (!a || !b)
+        return -1;
+
+    int rc = reader_open(&ra, a);
+    if (rc != 0)
+        return rc;
+    rc = reader_open(&rb, b);
+    if (rc != 0) {
+        reader_close(&ra);
+        return rc;
+    }
+
+    memset(&st, 0, sizeof(st));
+    st.a = &ra;
+    st.b = &rb;
+    st.out = out ? (FILE*)out : stdout;
+    diff_descend(&st, tree_levels(ra.count > rb.count ? ra.count : rb.count), 0);
+    diff_flush(&st);
+
+    reader_close(&ra);
+    reader_close(&rb);
+    return st.differ;
+}
+
+/* First record at or after file offset off. */
+static size_t reader_seek(const fossil_ai_audit_reader_t* r, uint64_t off)
+{
+    size_t lo = 0, hi = r->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (r->index[mid] < off)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Records of one log matching key and [t0, t1]; without a key, those at file offsets [lo, hi]. */
+static int query_file(const fossil_ai_audit_reader_t* r, const char* key, size_t key_len, int exact,
+                      uint64_t t0, uint64_t t1, uint64_t lo, uint64_t hi,
+                      fossil_ai_audit_query_fn fn, void* user, int* stop)
+{
+    if (key_len || exact)
+        return key_scan(r, key, key_len, exact, t0, t1, fn, user, stop);
+
+    for (size_t i = reader_seek(r, lo); i < r->count && r->index[i] <= hi && !*stop; ++i) {
+        fossil_ai_audit_entry_t e;
+        if (reader_entry(r, i, &e) != 0)
+            return -3;
+        if (e.time_ns < t0 || e.time_ns > t1)
+            continue;
+        fossil_ai_audit_item_t item;
+        entry_item(&e, &item);
+        *stop = fn(&item, user) != 0;
+    }
+    return 0;
+}
+
+/*
+ * path is an exported log or a segment prefix. For segments the side index
+ * picks the segments, and the offset span to read when there is no key;
+ * nothing else is opened.
+ */
+static int query_path(const char* path, const char* key, int exact, uint64_t t0, uint64_t t1,
+                      fossil_ai_audit_query_fn fn, void* user)
+{
+    fossil_ai_audit_reader_t r;
+    fossil_ai_audit_bytes_t idx;
+    const fossil_ai_audit_index_segment_t* seg;
+    const uint8_t* keys;
+    size_t key_len = key ? strlen(key) : 0;
+    int stop = 0;
+
+    int rc = reader_open(&r, path);
+    if (rc == 0) {
+        rc = query_file(&r, key, key_len, exact, t0, t1, 0, UINT64_MAX, fn, user, &stop);
+        reader_close(&r);
+        return rc;
+    }
+    if (rc != -1)
+        return rc;
+    rc = index_load(path, &idx);
+    if (rc != 0)
+        return rc;
+
+    size_t pos = 0;
+    while (!stop && (rc = index_next(&idx, &pos, &seg, &keys)) == 0) {
+        if (seg->time_max < t0 || seg->time_min > t1)
+            continue;
+        uint64_t lo = UINT64_MAX, hi = 0;
+        const uint8_t* p = keys;
+        for (uint64_t k = 0; k < seg->keys; ++k) {
+            const fossil_ai_audit_index_key_t* e = (const fossil_ai_audit_index_key_t*)p;
+            p += sizeof(*e);
+            int match = exact ? key_cmp(p, (size_t)e->key_len, (const uint8_t*)key, key_len) == 0
+                              : key_matches(p, (size_t)e->key_len, key, key_len);
+            if (match && e->time_max >= t0 && e->time_min <= t1) {
+                lo = e->first < lo ? e->first : lo;
+                hi = e->last > hi ? e->last : hi;
+            }
+            p += align8((size_t)e->key_len);
+        }
+        if (lo > hi)
+            continue;
+
+        char* file = segment_path(path, seg->segment);
+        if (!file) {
+            rc = -2;
+            break;
+        }
+        rc = reader_open(&r, file);
+        free(file);
+        if (rc != 0)
+            break;
+        rc = query_file(&r, key, key_len, exact, t0, t1, lo, hi, fn, user, &stop);
+        reader_close(&r);
+        if (rc != 0)
+            break;
+    }
+    free(idx.data);
+    return rc < 0 ? rc : 0;
+}
+
+/*
+ * Calls fn for every record whose key starts with key_prefix (NULL = any)
+ * and whose time lies in [t0, t1]. With a key the key index is used and
+ * records arrive in key order, otherwise in log order.
+ */
+int fossil_ai_audit_query(const char* path, const char* key_prefix, uint64_t t0, uint64_t t1,
+                          fossil_ai_audit_query_fn fn, void* user)
+{
+    if (!path || !fn)
+        return -1;
+    return query_path(path, key_prefix, 0, t0, t1, fn, user);
+}
+
+/* Like query for one exact key; Bloom filters skip logs that cannot hold it. */
+int fossil_ai_audit_lookup(const char* path, const char* key, uint64_t t0, uint64_t t1,
+                           fossil_ai_audit_query_fn fn, void* user)
+{
+    if (!path || !key || !fn)
+        return -1;
+    return query_path(path, key, 1, t0, t1, fn, user);
+}
+
+/* Verifies every segment and that each seal chains to the one before. 0 / 1 / -3 as verify. */
+int fossil_ai_audit_verify_segments(const char* prefix)
+{
+    fossil_ai_audit_bytes_t idx;
+    const fossil_ai_audit_index_segment_t* seg;
+    const uint8_t* keys;
+    uint8_t prev[FOSSIL_AI_AUDIT_HASH_BYTES];
+    if (!prefix)
+        return -1;
+    int rc = index_load(prefix, &idx);
+    if (rc != 0)
+        return rc;
+
+    memset(prev, 0, sizeof(prev));
+    size_t pos = 0;
+    int result = 0, step, seen = 0;
+    uint64_t expect = 0;
+    while ((step = index_next(&idx, &pos, &seg, &keys)) == 0) {
+        fossil_ai_audit_reader_t r;
+        char* path = segment_path(prefix, seg->segment);
+        if (!path) {
+            result = -2;
+            break;
+        }
+        rc = verify_log(path, 0, NULL);
+        if (rc == 0)
+            rc = reader_open(&r, path);
+        free(path);
+        if (rc < 0) {
+            result = rc;
+            break;
+        }
+        if (rc == 0) {
+            const fossil_ai_audit_log_footer_t* foot = (const fossil_ai_audit_log_footer_t*)
+                (r.base + r.size - sizeof(*foot));
+            if ((seen && seg->segment != expect) ||
+                foot->segment != seg->segment || foot->count != seg->count ||
+                r.header->first_seq != seg->first_seq ||
+                memcmp(foot->prev, prev, sizeof(prev)) != 0 ||
+                memcmp(foot->seal, seg->seal, sizeof(prev)) != 0)
+                rc = 1;
+            reader_close(&r);
+        }
+        if (rc > 0)
+            result = 1;
+        seen = 1;
+        expect = seg->segment + 1;
+        memcpy(prev, seg->seal, sizeof(prev));
+    }
+    if (step < 0 && result >= 0)
+        result = step;
+    free(idx.data);
+    return result;
+}
+
+
+/* =========================================================
+ * Replay
+ * ========================================================= */
+
+typedef struct fossil_ai_audit_replay_miss {
+    uint64_t record;
+    size_t offset;          /* replayed output in the worker's buffer */
+    size_t size;
+    int failed;
+} fossil_ai_audit_replay_miss_t;
+
+typedef struct fossil_ai_audit_replay_part {
+    const fossil_ai_audit_reader_t* reader;
+    const fossil_ai_audit_replay_t* options;
+    void* model;
+    const char* key;
+    size_t key_len;
+    atomic_size_t* next;    /* next unclaimed chunk */
+    fossil_ai_audit_replay_stats_t stats;
+    fossil_ai_audit_replay_miss_t* misses;
+    size_t miss_count;
+    size_t miss_cap;
+    fossil_ai_audit_bytes_t outputs;
+    uint8_t* scratch;
+    size_t scratch_cap;
+    int rc;
+} fossil_ai_audit_replay_part_t;
+
+static int replay_split(const fossil_ai_audit_entry_t* e, const uint8_t** input, size_t* input_size,
+                        const uint8_t** output, size_t* output_size)
+{
+    uint32_t head[2];
+    if (e->size < sizeof(head))
+        return -1;
+    memcpy(head, e->data, sizeof(head));
+    if ((uint64_t)head[0] + head[1] != e->size - sizeof(head))
+        return -1;
+    *input = e->data + sizeof(head);
+    *input_size = head[0];
+    *output = *input + head[0];
+    *output_size = head[1];
+    return 0;
+}
+
+static int replay_miss(fossil_ai_audit_replay_part_t* p, uint64_t record, const void* out, size_t size, int failed)
+{
+    if (p->miss_count == p->miss_cap) {
+        size_t cap = p->miss_cap ? p->miss_cap * 2 : 16;
+        fossil_ai_audit_replay_miss_t* m = (fossil_ai_audit_replay_miss_t*)
+            realloc(p->misses, cap * sizeof(*m));
+        if (!m)
+            return -2;
+        p->misses = m;
+        p->miss_cap = cap;
+    }
+    fossil_ai_audit_replay_miss_t* m = &p->misses[p->miss_count++];
+    m->record = record;
+    m->offset = p->outputs.len;
+    m->size = size;
+    m->failed = failed;
+    return size ? bytes_append(&p->outputs, out, size) : 0;
+}
+
+/* Claims chunks of records until none are left, so slow inferences never idle a core. */
+static void* replay_worker(void* arg)
+{
+    fossil_ai_audit_replay_part_t* p = (fossil_ai_audit_replay_part_t*)arg;
+    const fossil_ai_audit_reader_t* r = p->reader;
+    const fossil_ai_audit_replay_t* o = p->options;
+
+    for (;;) {
+        size_t first = atomic_fetch_add(p->next, 1) * FOSSIL_AI_AUDIT_REPLAY_CHUNK;
+        if (first >= r->count || p->rc != 0)
+            break;
+        size_t last = first + FOSSIL_AI_AUDIT_REPLAY_CHUNK < r->count ? first + FOSSIL_AI_AUDIT_REPLAY_CHUNK : r->count;
+
+        for (size_t i = first; i < last && p->rc == 0; ++i) {
+            fossil_ai_audit_entry_t e;
+            const uint8_t *input, *recorded;
+            size_t input_size, recorded_size, size = 0;
+            if (reader_entry(r, i, &e) != 0) {
+                p->rc = -3;
+                break;
+            }
+            if (!key_matches(e.key, e.key_len, p->key, p->key_len) ||
+                (e.flags & FOSSIL_AI_AUDIT_OMITTED))
+                continue;
+            if (replay_split(&e, &input, &input_size, &recorded, &recorded_size) != 0) {
+                p->stats.failed++;
+                p->rc = replay_miss(p, i, NULL, 0, 1);
+                continue;
+            }
+
+            size_t cap = o->output_cap ? o->output_cap : recorded_size + 4096;
+            if (cap > p->scratch_cap) {
+                uint8_t* s = (uint8_t*)realloc(p->scratch, cap);
+                if (!s) {
+                    p->rc = -2;
+                    break;
+                }
+                p->scratch = s;
+                p->scratch_cap = cap;
+            }
+            p->stats.replayed++;
+            if (o->infer(p->model, input, input_size, p->scratch, cap, &size, o->user) != 0 || size > cap) {
+                p->stats.failed++;
+                p->rc = replay_miss(p, i, NULL, 0, 1);
+            } else if (size != recorded_size || memcmp(p->scratch, recorded, size) != 0) {
+                p->stats.mismatched++;
+                p->rc = replay_miss(p, i, p->scratch, size, 0);
+            } else {
+                p->stats.matched++;
+            }
+        }
+    }
+    return NULL;
+}
+
+static int replay_miss_cmp(const void* a, const void* b)
+{
+    uint64_t x = (*(const fossil_ai_audit_replay_miss_t* const*)a)->record;
+    uint64_t y = (*(const fossil_ai_audit_replay_miss_t* const*)b)->record;
+    return (x > y) - (x < y);
+}
+
+/* Replays one log on all workers, then reports its misses in record order. */
+static int replay_file(const fossil_ai_audit_reader_t* r, void* model, const fossil_ai_audit_replay_t* o,
+                       const char* key, fossil_ai_audit_replay_stats_t* total)
+{
+    fossil_ai_audit_replay_part_t parts[FOSSIL_AI_AUDIT_MAX_WORKERS];
+    pthread_t threads[FOSSIL_AI_AUDIT_MAX_WORKERS];
+    int started[FOSSIL_AI_AUDIT_MAX_WORKERS];
+    atomic_size_t next;
+    size_t chunks = (r->count + FOSSIL_AI_AUDIT_REPLAY_CHUNK - 1) / FOSSIL_AI_AUDIT_REPLAY_CHUNK;
+    size_t workers = o->workers ? o->workers : online_workers();
+    if (workers > FOSSIL_AI_AUDIT_MAX_WORKERS)
+        workers = FOSSIL_AI_AUDIT_MAX_WORKERS;
+    if (workers > chunks)
+        workers = chunks ? chunks : 1;
+
+    atomic_init(&next, 0);
+    memset(parts, 0, workers * sizeof(parts[0]));
+    for (size_t w = 0; w < workers; ++w) {
+        parts[w].reader = r;
+        parts[w].options = o;
+        parts[w].model = model;
+        parts[w].key = key;
+        parts[w].key_len = strlen(key);
+        parts[w].next = &next;
+        started[w] = w > 0 && pthread_create(&threads[w], NULL, replay_worker, &parts[w]) == 0;
+        if (w > 0 && !started[w])
+            replay_worker(&parts[w]);
+    }
+    replay_worker(&parts[0]);
+
+    int rc = 0;
+    size_t misses = 0;
+    for (size_t w = 0; w < workers; ++w) {
+        if (w > 0 && started[w])
+            pthread_join(threads[w], NULL);
+        if (parts[w].rc != 0 && rc == 0)
+            rc = parts[w].rc;
+        total->replayed += parts[w].stats.replayed;
+        total->matched += parts[w].stats.matched;
+        total->mismatched += parts[w].stats.mismatched;
+        total->failed += parts[w].stats.failed;
+        misses += parts[w].miss_count;
+    }
+
+    const fossil_ai_audit_replay_miss_t** order = (const fossil_ai_audit_replay_miss_t**)
+        malloc((misses ? misses : 1) * sizeof(*order));
+    if (!order && rc == 0)
+        rc = -2;
+    if (rc == 0 && o->mismatch) {
+        size_t n = 0;
+        for (size_t w = 0; w < workers; ++w)
+            for (size_t i = 0; i < parts[w].miss_count; ++i)
+                order[n++] = &parts[w].misses[i];
+        qsort(order, n, sizeof(*order), replay_miss_cmp);
+
+        for (size_t i = 0; i < n && rc == 0; ++i) {
+            const fossil_ai_audit_replay_miss_t* m = order[i];
+            const fossil_ai_audit_replay_part_t* owner = NULL;
+            for (size_t w = 0; w < workers && !owner; ++w)
+                if (m >= parts[w].misses && m < parts[w].misses + parts[w].miss_count)
+                    owner = &parts[w];
+
+            fossil_ai_audit_entry_t e;
+            const uint8_t *input, *recorded = NULL;
+            size_t input_size, recorded_size = 0;
+            if (reader_entry(r, (size_t)m->record, &e) != 0) {
+                rc = -3;
+                break;
+            }
+            replay_split(&e, &input, &input_size, &recorded, &recorded_size);
+            fossil_ai_audit_item_t item;
+            entry_item(&e, &item);
+            o->mismatch(&item, recorded, recorded_size,
+                        m->failed ? NULL : owner->outputs.data + m->offset, m->size, o->user);
+        }
+    }
+
+    free(order);
+    for (size_t w = 0; w < workers; ++w) {
+        free(parts[w].misses);
+        free(parts[w].outputs.data);
+        free(parts[w].scratch);
+    }
+    return rc;
+}
+
+/*
+ * Re-runs every recorded inference under key_prefix against model, on all
+ * cores, and compares each output with the recorded decision byte for
+ * byte. path is an exported log or a segment prefix; segments are taken
+ * in order and skipped when their index holds no matching key. 0 = every
+ * decision reproduced, 1 = some differed or failed.
+ */
+int fossil_ai_audit_replay(const char* path, void* model, const fossil_ai_audit_replay_t* options)
+{
+    fossil_ai_audit_replay_stats_t total;
+    fossil_ai_audit_reader_t r;
+    if (!path || !options || !options->infer)
+        return -1;
+
+    const char* key = options->key_prefix ? options->key_prefix : FOSSIL_AI_AUDIT_INFER_KEY;
+    size_t key_len = strlen(key);
+    memset(&total, 0, sizeof(total));
+
+    int rc = reader_open(&r, path);
+    if (rc == 0) {
+        rc = replay_file(&r, model, options, key, &total);
+        reader_close(&r);
+    } else if (rc == -1) {
+        fossil_ai_audit_bytes_t idx;
+        const fossil_ai_audit_index_segment_t* seg;
+        const uint8_t* keys;
+        size_t pos = 0;
+        rc = index_load(path, &idx);
+        while (rc == 0 && (rc = index_next(&idx, &pos, &seg, &keys)) == 0) {
+            int wanted = 0;
+            const uint8_t* p = keys;
+            for (uint64_t k = 0; k < seg->keys && !wanted; ++k) {
+                const fossil_ai_audit_index_key_t* e = (const fossil_ai_audit_index_key_t*)p;
+                p += sizeof(*e);
+                wanted = key_matches(p, (size_t)e->key_len, key, key_len);
+                p += align8((size_t)e->key_len);
+            }
+            if (!wanted)
+                continue;
+
+            char* file = segment_path(path, seg->segment);
+            if (!file) {
+                rc = -2;
+                break;
+            }
+            rc = reader_open(&r, file);
+            free(file);
+            if (rc == 0) {
+                rc = replay_file(&r, model, options, key, &total);
+                reader_close(&r);
+            }
+        }
+        if (rc > 0)
+            rc = 0;
+        free(idx.data);
+    }
+
+    if (options->stats)
+        *options->stats = total;
+    if (rc < 0)
+        return rc;
+    return total.mismatched || total.failed ? 1 : 0;
+}
+
+
+/* =========================================================
+ * Proofs
+ * ========================================================= */
+
+/* Flushes, then reports the committed tree size and its root. */
+int fossil_ai_audit_root(void* ctx, uint64_t* size, uint8_t* root)
+{
+    fossil_ai_audit_ctx_t* ac = (fossil_ai_audit_ctx_t*)ctx;
+    fossil_ai_audit_tree_t t;
+    if (!ac || !root)
+        return -1;
+
+    fossil_ai_audit_flush(ac);
+    pthread_mutex_lock(&ac->lock);
+    tree_view(ac, &t);
+    tree_hash(&t, 0, t.size, root);
+    if (size)
+        *size = t.size;
+    pthread_mutex_unlock(&ac->lock);
+    return 0;
+}
+
+int fossil_ai_audit_leaf(void* ctx, uint64_t index, uint8_t* hash)
+{
+    fossil_ai_audit_ctx_t* ac = (fossil_ai_audit_ctx_t*)ctx;
+    if (!ac || !hash)
+        return -1;
+
+    pthread_mutex_lock(&ac->lock);
+    int rc = index < ac->count ? 0 : -1;
+    if (rc == 0)
+        memcpy(hash, ac->levels[0].data + index * FOSSIL_AI_AUDIT_HASH_BYTES, FOSSIL_AI_AUDIT_HASH_BYTES);
+    pthread_mutex_unlock(&ac->lock);
+    return rc;
+}
+
+/* Audit path for leaf `index` in the tree of the first `size` committed records. */
+int fossil_ai_audit_inclusion_proof(void* ctx, uint64_t index, uint64_t size, uint8_t* proof, size_t* count)
+{
+    fossil_ai_audit_ctx_t* ac = (fossil_ai_audit_ctx_t*)ctx;
+    fossil_ai_audit_tree_t t;
+    if (!ac || !proof || !count)
+        return -1;
+
+    pthread_mutex_lock(&ac->lock);
+    int rc = index < size && size <= ac->count ? 0 : -1;
+    *count = 0;
+    if (rc == 0) {
+        tree_view(ac, &t);
+        inclusion_path(&t, index, 0, size, proof, count);
+    }
+    pthread_mutex_unlock(&ac->lock);
+    return rc;
+}
+
+/* Proof that the tree of old_size records is a prefix of the tree of new_size. */
+int fossil_ai_audit_consistency_proof(void* ctx, uint64_t old_size, uint64_t new_size,
+                                      uint8_t* proof, size_t* count)
+{
+    fossil_ai_audit_ctx_t* ac = (fossil_ai_audit_ctx_t*)ctx;
+    fossil_ai_audit_tree_t t;
+    if (!ac || !proof || !count)
+        return -1;
+
+    pthread_mutex_lock(&ac->lock);
+    int rc = old_size <= new_size && new_size <= ac->count ? 0 : -1;
+    *count = 0;
+    if (rc == 0 && old_size > 0) {
+        tree_view(ac, &t);
+        consistency_path(&t, old_size, 0, new_size, 1, proof, count);
+    }
+    pthread_mutex_unlock(&ac->lock);
+    return rc;
+}
+
+/* RFC 9162 section 2.1.3.2. 0 = proven, 1 = not. */
+int fossil_ai_audit_verify_inclusion(const uint8_t* leaf, uint64_t index, uint64_t size,
+                                     const uint8_t* proof, size_t count, const uint8_t* root)
+{
+    uint8_t r[FOSSIL_AI_AUDIT_HASH_BYTES];
+    if (!leaf || !root || (count && !proof))
+        return -1;
+    if (index >= size)
+        return 1;
+
+    uint64_t fn = index, sn = size - 1;
+    memcpy(r, leaf, sizeof(r));
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t* p = proof + i * FOSSIL_AI_AUDIT_HASH_BYTES;
+        if (sn == 0)
+            return 1;
+        if ((fn & 1) || fn == sn) {
+            node_hash(p, r, r);
+            while (!(fn & 1) && fn != 0) {
+                fn >>= 1;
+                sn >>= 1;
+            }
+        } else {
+            node_hash(r, p, r);
+        }
+        fn >>= 1;
+        sn >>= 1;
+    }
+    return sn == 0 && memcmp(r, root, sizeof(r)) == 0 ? 0 : 1;
+}
+
+/* RFC 9162 section 2.1.4.2. 0 = proven, 1 = not. */
+int fossil_ai_audit_verify_consistency(uint64_t old_size, const uint8_t* old_root, uint64_t new_size,
+                                       const uint8_t* new_root, const uint8_t* proof, size_t count)
+{
+    uint8_t fr[FOSSIL_AI_AUDIT_HASH_BYTES], sr[FOSSIL_AI_AUDIT_HASH_BYTES];
+    if (!old_root || !new_root || (count && !proof))
+        return -1;
+    if (old_size > new_size)
+        return 1;
+    if (old_size == 0)
+        return count == 0 ? 0 : 1;
+    if (old_size == new_size)
+        return count == 0 && memcmp(old_root, new_root, sizeof(fr)) == 0 ? 0 : 1;
+
+    /* A power-of-two old tree is itself a node of the new one, so it leads the path. */
+    size_t i = 0;
+    if ((old_size & (old_size - 1)) == 0) {
+        memcpy(fr, old_root, sizeof(fr));
+    } else {
+        if (count == 0)
+            return 1;
+        memcpy(fr, proof, sizeof(fr));
+        i = 1;
+    }
+    memcpy(sr, fr, sizeof(sr));
+
+    uint64_t fn = old_size - 1, sn = new_size - 1;
+    while (fn & 1) {
+        fn >>= 1;
+        sn >>= 1;
+    }
+    for (; i < count; ++i) {
+        const uint8_t* c = proof + i * FOSSIL_AI_AUDIT_HASH_BYTES;
+        if (sn == 0)
+            return 1;
+        if ((fn & 1) || fn == sn) {
+            node_hash(c, fr, fr);
+            node_hash(c, sr, sr);
+            while (!(fn & 1) && fn != 0) {
+                fn >>= 1;
+                sn >>= 1;
+            }
+        } else {
+            node_hash(sr, c, sr);
+        }
+        fn >>= 1;
+        sn >>= 1;
+    }
+    return sn == 0 && memcmp(fr, old_root, sizeof(fr)) == 0 &&
+           memcmp(sr, new_root, sizeof(sr)) == 0 ? 0 : 1;
+}
@@ -0,0 +1,310 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#include "fossil/ai/chat.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FOSSIL_AI_CHAT_CHUNK 65536      /* arena chunk; longer messages get a chunk of their own */
+#define FOSSIL_AI_CHAT_RING  64         /* initial descriptors, a power of two */
+#define FOSSIL_AI_CHAT_NONE  UINT64_MAX
+
+/* =========================================================
+ * Internal State
+ * ========================================================= */
+
+/* Message bytes, appended and never moved; freed once every message in it is pruned. */
+typedef struct fossil_ai_chat_chunk {
+    struct fossil_ai_chat_chunk* next;
+    size_t size;
+    size_t used;
+    size_t live;
+    char data[];
+} fossil_ai_chat_chunk_t;
+
+typedef struct fossil_ai_chat_msg {
+    fossil_ai_chat_chunk_t* chunk;
+    const char* role;
+    const char* text;
+    size_t role_len;
+    size_t text_len;
+} fossil_ai_chat_msg_t;
+
+/*
+ * History is a ring of descriptors over a chunked byte arena: sending
+ * appends at the tail, pruning advances the head and hands back chunks
+ * whose messages are all gone, so nothing is ever shifted or copied.
+ */
+typedef struct fossil_ai_chat_session {
+    fossil_ai_chat_msg_t* ring;
+    size_t mask;
+    size_t head;
+    size_t count;
+    uint64_t pruned;            /* messages dropped from the head so far */
+    uint64_t reply;             /* absolute index of the newest non-user message */
+
+    fossil_ai_chat_chunk_t* first;
+    fossil_ai_chat_chunk_t* last;
+    fossil_ai_chat_chunk_t* spare;
+} fossil_ai_chat_session_t;
+
+
+/* =========================================================
+ * Arena
+ * ========================================================= */
+
+static char* arena_alloc(fossil_ai_chat_session_t* cs, size_t size, fossil_ai_chat_chunk_t** chunk)
+{
+    fossil_ai_chat_chunk_t* c = cs->last;
+    if (!c || c->size - c->used < size) {
+        if (size <= FOSSIL_AI_CHAT_CHUNK && cs->spare) {
+            c = cs->spare;
+            cs->spare = NULL;
+        } else {
+            size_t cap = size > FOSSIL_AI_CHAT_CHUNK ? size : FOSSIL_AI_CHAT_CHUNK;
+            c = (fossil_ai_chat_chunk_t*)malloc(sizeof(*c) + cap);
+            if (!c)
+                return NULL;
+            c->size = cap;
+        }
+        c->next = NULL;
+        c->used = 0;
+        c->live = 0;
+        if (cs->last)
+            cs->last->next = c;
+        else
+            cs->first = c;
+        cs->last = c;
+    }
+
+    char* p = c->data + c->used;
+    c->used += size;
+    c->live++;
+    *chunk = c;
+    return p;
+}
+
+/* Drops emptied chunks from the front, keeping one standard chunk back for reuse. */
+static void arena_release(fossil_ai_chat_session_t* cs)
+{
+    while (cs->first && cs->first->live == 0 && cs->first != cs->last) {
+        fossil_ai_chat_chunk_t* c = cs->first;
+        cs->first = c->next;
+        if (!cs->spare && c->size == FOSSIL_AI_CHAT_CHUNK) {
+            cs->spare = c;
+        } else {
+            free(c);
+        }
+    }
+    if (cs->first && cs->first == cs->last && cs->first->live == 0)
+        cs->first->used = 0;
+}
+
+
+/* =========================================================
+ * Session
+ * ========================================================= */
+
+int fossil_ai_chat_session_open(void** out)
+{
+    if (!out)
+        return -1;
+
+    *out = NULL;
+    fossil_ai_chat_session_t* cs = (fossil_ai_chat_session_t*)calloc(1, sizeof(*cs));
+    if (!cs)
+        return -2;
+    cs->ring = (fossil_ai_chat_msg_t*)malloc(FOSSIL_AI_CHAT_RING * sizeof(*cs->ring));
+    if (!cs->ring) {
+        free(cs);
+        return -2;
+    }
+    cs->mask = FOSSIL_AI_CHAT_RING - 1;
+    cs->reply = FOSSIL_AI_CHAT_NONE;
+    *out = cs;
+    return 0;
+}
+
+int fossil_ai_chat_session_close(void* s)
+{
+    fossil_ai_chat_session_t* cs = (fossil_ai_chat_session_t*)s;
+    if (!cs)
+        return -1;
+
+    while (cs->first) {
+        fossil_ai_chat_chunk_t* c = cs->first;
+        cs->first = c->next;
+        free(c);
+    }
+    free(cs->spare);
+    free(cs->ring);
+    free(cs);
+    return 0;
+}
+
+
+/* =========================================================
+ * Messages
+ * ========================================================= */
+
+static const fossil_ai_chat_msg_t* msg_at(const fossil_ai_chat_session_t* cs, size_t i)
+{
+    return &cs->ring[(cs->head + i) & cs->mask];
+}
+
+/* Doubles the ring, unrolling it so the head lands at slot 0. */
+static int ring_grow(fossil_ai_chat_session_t* cs)
+{
+    size_t cap = (cs->mask + 1) * 2;
+    fossil_ai_chat_msg_t* ring = (fossil_ai_chat_msg_t*)malloc(cap * sizeof(*ring));
+    if (!ring)
+        return -2;
+
+    size_t part = cs->mask + 1 - cs->head;
+    if (part > cs->count)
+        part = cs->count;
+    memcpy(ring, cs->ring + cs->head, part * sizeof(*ring));
+    memcpy(ring + part, cs->ring, (cs->count - part) * sizeof(*ring));
+    free(cs->ring);
+    cs->ring = ring;
+    cs->mask = cap - 1;
+    cs->head = 0;
+    return 0;
+}
+
+int fossil_ai_chat_send(void* s, const char* role, const char* msg)
+{
+    fossil_ai_chat_session_t* cs = (fossil_ai_chat_session_t*)s;
+    if (!cs || !role || !msg)
+        return -1;
+
+    if (cs->count > cs->mask && ring_grow(cs) != 0)
+        return -2;
+
+    size_t role_len = strlen(role), text_len = strlen(msg);
+    fossil_ai_chat_chunk_t* chunk;
+    char* p = arena_alloc(cs, role_len + text_len + 2, &chunk);
+    if (!p)
+        return -2;
+    memcpy(p, role, role_len + 1);
+    memcpy(p + role_len + 1, msg, text_len + 1);
+
+    fossil_ai_chat_msg_t* m = &cs->ring[(cs->head + cs->count) & cs->mask];
+    m->chunk = chunk;
+    m->role = p;
+    m->text = p + role_len + 1;
+    m->role_len = role_len;
+    m->text_len = text_len;
+    if (strcmp(role, "user") != 0)
+        cs->reply = cs->pruned + cs->count;
+    cs->count++;
+    return 0;
+}
+
+/* Copies the newest message not sent by the user; 1 if there is none. */
+int fossil_ai_chat_receive(void* s, char* out, size_t n)
+{
+    fossil_ai_chat_session_t* cs = (fossil_ai_chat_session_t*)s;
+    if (!cs || !out || n == 0)
+        return -1;
+
+    out[0] = '\0';
+    if (cs->reply == FOSSIL_AI_CHAT_NONE || cs->reply < cs->pruned)
+        return 1;
+
+    const fossil_ai_chat_msg_t* m = msg_at(cs, (size_t)(cs->reply - cs->pruned));
+    size_t len = m->text_len < n - 1 ? m->text_len : n - 1;
+    memcpy(out, m->text, len);
+    out[len] = '\0';
+    return 0;
+}
+
+
+/* =========================================================
+ * History
+ * ========================================================= */
+
+/* Writes "role: text" lines to a FILE* (NULL = stdout). */
+int fossil_ai_chat_history_get(void* s, void* out)
+{
+    fossil_ai_chat_session_t* cs = (fossil_ai_chat_session_t*)s;
+    if (!cs)
+        return -1;
+
+    FILE* f = out ? (FILE*)out : stdout;
+    for (size_t i = 0; i < cs->count; ++i) {
+        const fossil_ai_chat_msg_t* m = msg_at(cs, i);
+        if (fwrite(m->role, 1, m->role_len, f) != m->role_len || fputs(": ", f) < 0 ||
+            fwrite(m->text, 1, m->text_len, f) != m->text_len || fputc('\n', f) == EOF)
+            return -1;
+    }
+    return 0;
+}
+
+int fossil_ai_chat_history_prune(void* s, size_t keep)
+{
+    fossil_ai_chat_session_t* cs = (fossil_ai_chat_session_t*)s;
+    if (!cs)
+        return -1;
+    if (keep >= cs->count)
+        return 0;
+
+    size_t drop = cs->count - keep;
+    for (size_t i = 0; i < drop; ++i)
+        msg_at(cs, i)->chunk->live--;
+    cs->head = (cs->head + drop) & cs->mask;
+    cs->count = keep;
+    cs->pruned += drop;
+    arena_release(cs);
+    return 0;
+}
+
+/* Same lines as history_get, NUL-terminated; 1 if out was too small and the text was cut. */
+int fossil_ai_chat_render(void* s, char* out, size_t n)
+{
+    fossil_ai_chat_session_t* cs = (fossil_ai_chat_session_t*)s;
+    if (!cs || !out || n == 0)
+        return -1;
+
+    size_t pos = 0, room = n - 1;
+    for (size_t i = 0; i < cs->count; ++i) {
+        const fossil_ai_chat_msg_t* m = msg_at(cs, i);
+        const char* parts[4] = { m->role, ": ", m->text, "\n" };
+        size_t lens[4] = { m->role_len, 2, m->text_len, 1 };
+        for (int k = 0; k < 4; ++k) {
+            size_t len = lens[k] < room - pos ? lens[k] : room - pos;
+            memcpy(out + pos, parts[k], len);
+            pos += len;
+            if (len < lens[k]) {
+                out[pos] = '\0';
+                return 1;
+            }
+        }
+    }
+    out[pos] = '\0';
+    return 0;
+}
@@ -26,20 +26,158 @@
 #define FOSSIL_AI_AUDIT_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define FOSSIL_AI_AUDIT_HASH_SIZE 32
+#define FOSSIL_AI_AUDIT_PROOF_MAX 65    /* hashes in the longest proof */
+
+/*
+ * Audit levels. HASH_ONLY keeps each record's key, time and size but only
+ * the SHA-256 of its payload; SAMPLED keeps the payload of a deterministic
+ * sample_rate share of records (by a hash of key and payload) and hashes
+ * the rest. Every level commits the same leaf to the chain, so proofs and
+ * verification work unchanged; OFF records nothing.
+ */
+#define FOSSIL_AI_AUDIT_FULL      0
+#define FOSSIL_AI_AUDIT_SAMPLED   1
+#define FOSSIL_AI_AUDIT_HASH_ONLY 2
+#define FOSSIL_AI_AUDIT_OFF       3
+
+/*
+ * Records land in a per-thread buffer; a background flusher merges them in
+ * sequence order and commits them in groups, with one sync per group.
+ */
+typedef struct fossil_ai_audit_config {
+    const char* journal;        /* group-committed append log, NULL = memory only */
+    size_t buffer_bytes;        /* per-thread buffer, 0 = 256 KiB */
+    unsigned flush_interval_us; /* 0 = 1000 */
+    int sync;                   /* fdatasync once per group */
+    const char* segments;       /* sealed segment files and index under this prefix, NULL = none;
+                                   sealed records leave memory and export reads them back */
+    size_t segment_bytes;       /* rotate after this much committed data, 0 = 64 MiB */
+    unsigned segment_seconds;   /* also rotate after this long, 0 = by size only */
+    int compress;               /* LZ-compress sealed segments against a per-segment dictionary */
+    int level;                  /* FOSSIL_AI_AUDIT_FULL, ... */
+    double sample_rate;         /* share of payloads kept at FOSSIL_AI_AUDIT_SAMPLED, 0..1 */
+} fossil_ai_audit_config_t;
+
+typedef struct fossil_ai_audit_stats {
+    uint64_t records;           /* committed */
+    uint64_t groups;
+    uint64_t syncs;
+    uint64_t stalls;            /* records that waited for buffer space */
+    uint64_t bytes;
+    uint64_t segments;          /* sealed */
+    uint64_t omitted;           /* recorded by payload hash only */
+    uint64_t dropped;           /* not recorded at FOSSIL_AI_AUDIT_OFF */
+} fossil_ai_audit_stats_t;
+
+/* A record handed to a query callback; key is not NUL-terminated. */
+typedef struct fossil_ai_audit_item {
+    uint64_t seq;
+    uint64_t time_ns;
+    const char* key;
+    size_t key_len;
+    const void* data;           /* NULL when the payload was omitted */
+    size_t size;
+    const uint8_t* digest;      /* SHA-256 of an omitted payload, else NULL */
+} fossil_ai_audit_item_t;
+
+/* One piece of a gathered record; same layout as POSIX struct iovec. */
+typedef struct fossil_ai_audit_iovec {
+    const void* base;
+    size_t len;
+} fossil_ai_audit_iovec_t;
+
+/*
+ * Streamed exports hand over the log in pieces of at most 256 KiB, in file
+ * order. Blocking here holds back the export; return nonzero to abort it.
+ */
+typedef int (*fossil_ai_audit_write_fn)(const void* data,size_t size,void* user);
+
+/* Return nonzero to stop the query. */
+typedef int (*fossil_ai_audit_query_fn)(const fossil_ai_audit_item_t* item,void* user);
+
+/*
+ * Replay: inference records hold the input and the decision the model made.
+ * infer must be safe to call from several threads on the same model; it
+ * returns 0 and sets *output_size, or nonzero on failure.
+ */
+#define FOSSIL_AI_AUDIT_INFER_KEY "fossil.infer"
+
+typedef int (*fossil_ai_audit_infer_fn)(void* model,const void* input,size_t input_size,
+                                       void* output,size_t output_cap,size_t* output_size,void* user);
+typedef void (*fossil_ai_audit_mismatch_fn)(const fossil_ai_audit_item_t* item,
+                                           const void* recorded,size_t recorded_size,
+                                           const void* replayed,size_t replayed_size,void* user);
+
+typedef struct fossil_ai_audit_replay_stats {
+    uint64_t replayed;
+    uint64_t matched;
+    uint64_t mismatched;
+    uint64_t failed;            /* inference error or malformed record */
+} fossil_ai_audit_replay_stats_t;
+
+typedef struct fossil_ai_audit_replay {
+    const char* key_prefix;     /* NULL = FOSSIL_AI_AUDIT_INFER_KEY */
+    fossil_ai_audit_infer_fn infer;
+    fossil_ai_audit_mismatch_fn mismatch;   /* in record order, NULL = count only */
+    void* user;
+    size_t workers;             /* 0 = one per core */
+    size_t output_cap;          /* 0 = recorded size + 4 KiB */
+    fossil_ai_audit_replay_stats_t* stats;  /* optional */
+} fossil_ai_audit_replay_t;
+
 int fossil_ai_audit_begin(void** ctx);
+int fossil_ai_audit_begin_ex(void** ctx,const fossil_ai_audit_config_t* config);
 int fossil_ai_audit_record(void* ctx,const char* key,const void* data,size_t size);
+int fossil_ai_audit_recordv(void* ctx,const char* key,const fossil_ai_audit_iovec_t* iov,size_t iovcnt);
+int fossil_ai_audit_record_inference(void* ctx,const char* key,const void* input,size_t input_size,
+                                     const void* output,size_t output_size);
+int fossil_ai_audit_set_level(void* ctx,int level,double sample_rate);
+int fossil_ai_audit_flush(void* ctx);
+int fossil_ai_audit_stats(void* ctx,fossil_ai_audit_stats_t* out);
 int fossil_ai_audit_end(void* ctx);
 
 int fossil_ai_audit_export(void* ctx,const char* path);
+int fossil_ai_audit_export_fd(void* ctx,int fd);
+int fossil_ai_audit_export_stream(void* ctx,fossil_ai_audit_write_fn fn,void* user);
+/* Copies a sealed segment or exported log to fd, with splice or sendfile where available. */
+int fossil_ai_audit_send(const char* path,int fd);
 int fossil_ai_audit_verify(const char* path);
 
 int fossil_ai_audit_diff(const char* a,const char* b,void* out);
 
+/*
+ * path is an exported log or a segment prefix. Query matches keys starting
+ * with key_prefix (NULL = any), lookup one exact key; both with time in [t0, t1].
+ */
+int fossil_ai_audit_query(const char* path,const char* key_prefix,uint64_t t0,uint64_t t1,
+                          fossil_ai_audit_query_fn fn,void* user);
+int fossil_ai_audit_lookup(const char* path,const char* key,uint64_t t0,uint64_t t1,
+                           fossil_ai_audit_query_fn fn,void* user);
+int fossil_ai_audit_verify_segments(const char* prefix);
+
+int fossil_ai_audit_replay(const char* path,void* model,const fossil_ai_audit_replay_t* options);
+
+/*
+ * Committed records form an RFC 6962 Merkle tree. Proofs hold `count`
+ * hashes of FOSSIL_AI_AUDIT_HASH_SIZE bytes each, at most PROOF_MAX.
+ */
+int fossil_ai_audit_root(void* ctx,uint64_t* size,uint8_t* root);
+int fossil_ai_audit_leaf(void* ctx,uint64_t index,uint8_t* hash);
+int fossil_ai_audit_inclusion_proof(void* ctx,uint64_t index,uint64_t size,uint8_t* proof,size_t* count);
+int fossil_ai_audit_consistency_proof(void* ctx,uint64_t old_size,uint64_t new_size,uint8_t* proof,size_t* count);
+int fossil_ai_audit_verify_inclusion(const uint8_t* leaf,uint64_t index,uint64_t size,
+                                     const uint8_t* proof,size_t count,const uint8_t* root);
+int fossil_ai_audit_verify_consistency(uint64_t old_size,const uint8_t* old_root,uint64_t new_size,
+                                       const uint8_t* new_root,const uint8_t* proof,size_t count);
+int fossil_ai_audit_verify_from(const char* path,uint64_t trusted_size,const uint8_t* trusted_root);
+
 #ifdef __cplusplus
 }
 #endif
@@ -50,17 +188,63 @@ namespace fossil::ai {
 class Audit {
 public:
     static void* begin(){ void* c=nullptr; fossil_ai_audit_begin(&c); return c; }
+    static void* begin(const fossil_ai_audit_config_t& cfg){
+        void* c=nullptr; fossil_ai_audit_begin_ex(&c,&cfg); return c;
+    }
     static int record(void* c,const char* k,const void* d,size_t s){
         return fossil_ai_audit_record(c,k,d,s);
     }
+    static int recordv(void* c,const char* k,const fossil_ai_audit_iovec_t* v,size_t n){
+        return fossil_ai_audit_recordv(c,k,v,n);
+    }
+    static int record_inference(void* c,const char* k,const void* i,size_t is,const void* o,size_t os){
+        return fossil_ai_audit_record_inference(c,k,i,is,o,os);
+    }
+    static int set_level(void* c,int l,double r=1.0){ return fossil_ai_audit_set_level(c,l,r); }
+    static int flush(void* c){ return fossil_ai_audit_flush(c); }
+    static int stats(void* c,fossil_ai_audit_stats_t* o){ return fossil_ai_audit_stats(c,o); }
     static int end(void* c){ return fossil_ai_audit_end(c); }
 
     static int export_log(void* c,const char* p){ return fossil_ai_audit_export(c,p); }
+    static int export_fd(void* c,int fd){ return fossil_ai_audit_export_fd(c,fd); }
+    static int export_stream(void* c,fossil_ai_audit_write_fn f,void* u){
+        return fossil_ai_audit_export_stream(c,f,u);
+    }
+    static int send(const char* p,int fd){ return fossil_ai_audit_send(p,fd); }
     static int verify(const char* p){ return fossil_ai_audit_verify(p); }
 
     static int diff(const char* a,const char* b,void* o){
         return fossil_ai_audit_diff(a,b,o);
     }
+
+    static int query(const char* p,const char* k,uint64_t t0,uint64_t t1,fossil_ai_audit_query_fn f,void* u){
+        return fossil_ai_audit_query(p,k,t0,t1,f,u);
+    }
+    static int lookup(const char* p,const char* k,uint64_t t0,uint64_t t1,fossil_ai_audit_query_fn f,void* u){
+        return fossil_ai_audit_lookup(p,k,t0,t1,f,u);
+    }
+    static int verify_segments(const char* p){ return fossil_ai_audit_verify_segments(p); }
+    static int replay(const char* p,void* m,const fossil_ai_audit_replay_t& o){
+        return fossil_ai_audit_replay(p,m,&o);
+    }
+
+    static int root(void* c,uint64_t* n,uint8_t* r){ return fossil_ai_audit_root(c,n,r); }
+    static int leaf(void* c,uint64_t i,uint8_t* h){ return fossil_ai_audit_leaf(c,i,h); }
+    static int inclusion_proof(void* c,uint64_t i,uint64_t n,uint8_t* p,size_t* k){
+        return fossil_ai_audit_inclusion_proof(c,i,n,p,k);
+    }
+    static int consistency_proof(void* c,uint64_t m,uint64_t n,uint8_t* p,size_t* k){
+        return fossil_ai_audit_consistency_proof(c,m,n,p,k);
+    }
+    static int verify_inclusion(const uint8_t* l,uint64_t i,uint64_t n,const uint8_t* p,size_t k,const uint8_t* r){
+        return fossil_ai_audit_verify_inclusion(l,i,n,p,k,r);
+    }
+    static int verify_consistency(uint64_t m,const uint8_t* a,uint64_t n,const uint8_t* b,const uint8_t* p,size_t k){
+        return fossil_ai_audit_verify_consistency(m,a,n,b,p,k);
+    }
+    static int verify_from(const char* p,uint64_t n,const uint8_t* r){
+        return fossil_ai_audit_verify_from(p,n,r);
+    }
 };
 
 }
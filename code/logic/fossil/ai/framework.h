@@ -27,6 +27,7 @@
 
 #include "kernal.h"
 #include "train.h"
+#include "sweep.h"
 #include "model.h"
 #include "infer.h"
 #include "audit.h"
@@ -0,0 +1,95 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#ifndef FOSSIL_AI_SWEEP_H
+#define FOSSIL_AI_SWEEP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "train.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A flat float32 row file mapped read-only and shared by every variant. */
+typedef struct fossil_ai_sweep_dataset {
+    const float* rows;
+    size_t count;
+    size_t width;
+    void* base;
+    size_t size;
+} fossil_ai_sweep_dataset_t;
+
+typedef struct fossil_ai_sweep_config {
+    const fossil_ai_train_config_t* variants;
+    size_t variant_count;
+    const fossil_ai_sweep_dataset_t* data;
+    const fossil_ai_sweep_dataset_t* holdout;   /* NULL validates on data */
+    size_t batch_rows;
+    size_t rung_steps;      /* steps before the first halving */
+    size_t eta;             /* keep 1/eta of the variants at each rung, 0 = 2 */
+    size_t max_steps;
+    size_t workers;         /* 0 = one per online core */
+} fossil_ai_sweep_config_t;
+
+typedef struct fossil_ai_sweep_result {
+    double loss;
+    double hit_rate;
+    uint64_t steps;
+    size_t rungs;           /* rungs survived */
+    int stopped;            /* eliminated before max_steps */
+    int finished;           /* ended by its own early-stop policy */
+} fossil_ai_sweep_result_t;
+
+int fossil_ai_sweep_dataset_map(const char* path,size_t width,fossil_ai_sweep_dataset_t* out);
+int fossil_ai_sweep_dataset_unmap(fossil_ai_sweep_dataset_t* ds);
+
+/* results holds variant_count entries; returns the winning variant index or a negative error. */
+int fossil_ai_sweep_run(const fossil_ai_sweep_config_t* config,fossil_ai_sweep_result_t* results);
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef __cplusplus
+namespace fossil::ai {
+
+class Sweep {
+public:
+    static int dataset_map(const char* p,size_t w,fossil_ai_sweep_dataset_t* o){
+        return fossil_ai_sweep_dataset_map(p,w,o);
+    }
+    static int dataset_unmap(fossil_ai_sweep_dataset_t* d){ return fossil_ai_sweep_dataset_unmap(d); }
+
+    static int run(const fossil_ai_sweep_config_t* c,fossil_ai_sweep_result_t* r){
+        return fossil_ai_sweep_run(c,r);
+    }
+};
+
+}
+#endif
+
+#endif
@@ -26,20 +26,202 @@
 #define FOSSIL_AI_TRAIN_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-int fossil_ai_train_begin(void* model);
+#define FOSSIL_AI_TRAIN_METRIC_LOSS      0
+#define FOSSIL_AI_TRAIN_METRIC_HIT_RATE  1
+
+/*
+ * Validation runs inside step on an interval that doubles while the metric
+ * improves by more than a few min_delta and halves once it flattens. After
+ * patience validations without improvement the session finalizes itself
+ * and that step returns 1. In a ring every rank must use the same settings;
+ * the metric is averaged over all ranks' holdouts, so they stop together.
+ */
+typedef struct fossil_ai_train_early_stop {
+    size_t patience;        /* validations without improvement, 0 = off */
+    double min_delta;       /* smallest change counted as improvement */
+    int metric;             /* FOSSIL_AI_TRAIN_METRIC_* */
+    uint64_t min_interval;  /* steps between validations, 0 = 1 */
+    uint64_t max_interval;  /* 0 = 64 * min_interval */
+    size_t sample_rows;     /* 0 = full pass over the holdout */
+} fossil_ai_train_early_stop_t;
+
+typedef struct fossil_ai_train_early_stop_status {
+    double best;
+    uint64_t best_step;
+    size_t bad;             /* validations since the last improvement */
+    uint64_t interval;
+    uint64_t next_step;
+    uint64_t validations;
+    int stopped;
+} fossil_ai_train_early_stop_status_t;
+
+/* Rows are flat float records: input_dim inputs followed by output_dim targets. */
+typedef struct fossil_ai_train_config {
+    size_t input_dim;
+    size_t output_dim;
+    size_t capacity;        /* max memory blocks, 0 = unbounded */
+    float learning_rate;    /* blend factor applied when a block is revisited */
+    float resolution;       /* input quantization step used to key blocks */
+    uint64_t seed;
+    fossil_ai_train_early_stop_t early_stop;
+} fossil_ai_train_config_t;
+
+typedef struct fossil_ai_train_metrics {
+    double loss;            /* mean squared error of recalled outputs */
+    double hit_rate;        /* fraction of rows recalled from memory */
+    double loss_ci;         /* confidence half-width, 0 for full passes */
+    double hit_rate_ci;
+    size_t rows;
+    uint64_t step;
+    int sampled;
+} fossil_ai_train_metrics_t;
+
+typedef void (*fossil_ai_train_metrics_fn)(void* model,const fossil_ai_train_metrics_t* metrics,void* user);
+
+typedef struct fossil_ai_train_validation {
+    size_t workers;         /* 0 = one per online core */
+    size_t sample_rows;     /* 0 = full pass over the holdout */
+    double z;               /* normal quantile for intervals, 0 = 1.96 */
+    fossil_ai_train_metrics_fn on_done;
+    void* user;
+} fossil_ai_train_validation_t;
+
+/*
+ * Loader order for attached rows: row groups are permuted, then rows are
+ * shuffled inside bounded windows, so reads stay near-sequential.
+ */
+typedef struct fossil_ai_train_shuffle {
+    size_t group_rows;      /* rows per permuted group, 0 = keep group order */
+    size_t window_rows;     /* rows shuffled together, 0 = keep row order */
+    uint64_t seed;
+    int stratify;           /* draw evenly across strata, 0 = off */
+    int stratify_output;    /* output column whose rounded value is the stratum */
+    const float* weights;   /* one weight per kept row for sampling with replacement */
+} fossil_ai_train_shuffle_t;
+
+/* Optional filtering applied by fossil_ai_train_dataset_attach. */
+typedef struct fossil_ai_train_dedup {
+    int exact;              /* drop rows repeating an earlier row byte for byte */
+    int near;               /* drop rows whose inputs are MinHash-similar to an earlier row */
+    float quantum;          /* input bucket width for near-dup tokens, 0 = resolution */
+    float similarity;       /* estimated Jaccard treated as a near-dup, 0 = 0.9 */
+    size_t bands;           /* LSH bands, 0 = 16 */
+    size_t band_rows;       /* signature values per band, 0 = 4 */
+    size_t workers;         /* 0 = online CPUs */
+} fossil_ai_train_dedup_t;
+
+typedef struct fossil_ai_train_dedup_stats {
+    size_t rows_in;
+    size_t rows_kept;
+    size_t exact_dups;
+    size_t near_dups;
+    size_t candidates;      /* LSH pairs compared */
+    uint64_t elapsed_ns;
+} fossil_ai_train_dedup_stats_t;
+
+/*
+ * Large-batch mode: each step call becomes a micro-batch whose rows are
+ * merged per memory block in thread-local buffers, and the merged updates
+ * are applied in one pass once micro_batches calls have been gathered.
+ * A checkpoint applies pending micro-batches first, so in a ring every rank
+ * checkpoints on the same step.
+ */
+typedef struct fossil_ai_train_accum {
+    size_t micro_batches;   /* step calls per apply, 0 or 1 = off */
+    size_t workers;         /* threads accumulating a micro-batch, 0 = online CPUs */
+    int overlap;            /* apply in the background while the next micro-batch accumulates */
+} fossil_ai_train_accum_t;
+
+/*
+ * Ring link for data-parallel training. exchange sends one frame to the
+ * next rank and receives one from the previous rank; *recv is malloc'd
+ * and released by the caller.
+ */
+typedef struct fossil_ai_train_transport {
+    int (*exchange)(void* ctx,const void* send,size_t send_len,void** recv,size_t* recv_len);
+    void (*close)(void* ctx);
+    void* ctx;
+} fossil_ai_train_transport_t;
+
+/*
+ * Every rank attaches its own shard and steps in lockstep; merged updates
+ * are all-reduced around the ring before each apply, so replicas match.
+ */
+typedef struct fossil_ai_train_dist {
+    size_t rank;
+    size_t world;
+    const char* socket_prefix;  /* rank r listens on "<prefix>.<r>" */
+    int timeout_ms;             /* wait for neighbours, 0 = 10000 */
+    const fossil_ai_train_transport_t* transport; /* replaces the Unix sockets when set */
+} fossil_ai_train_dist_t;
+
+/* Nanoseconds spent in each phase of fossil_ai_train_step. */
+typedef struct fossil_ai_train_phases {
+    uint64_t data_wait_ns;
+    uint64_t hash_ns;
+    uint64_t insert_ns;
+    uint64_t compute_ns;
+    uint64_t audit_ns;
+    uint64_t total_ns;
+    uint64_t rows;
+} fossil_ai_train_phases_t;
+
+typedef struct fossil_ai_train_profile {
+    fossil_ai_train_phases_t last;      /* most recent step */
+    fossil_ai_train_phases_t total;     /* since begin or the last reset */
+    uint64_t steps;
+    double rows_per_sec;
+    uint64_t checkpoints;
+    uint64_t checkpoint_ns;             /* total training stall in checkpoints */
+    uint64_t last_checkpoint_ns;
+} fossil_ai_train_profile_t;
+
+/*
+ * Pass exactly one of config and checkpoint; both or neither is -1. A
+ * checkpoint resumes a new session. A config starts one, or restarts a
+ * finalized one: its dimensions and resolution must match the memory, and
+ * capacity, learning_rate, seed and early_stop replace the old settings.
+ * Returns 1, changing nothing, if the session is still training.
+ */
+int fossil_ai_train_begin(void* model,const fossil_ai_train_config_t* config,const char* checkpoint);
 int fossil_ai_train_step(void* model,const void* batch,size_t rows);
 int fossil_ai_train_finalize(void* model);
+int fossil_ai_train_release(void* model);
+
+/* Writers may run while other threads recall; recall reads the latest published generation. */
+int fossil_ai_train_add_memory(void* model,const float* input,const float* output);
+int fossil_ai_train_publish(void* model);
+int fossil_ai_train_recall(void* model,const float* X,size_t rows,float* out,size_t* hits);
+uint64_t fossil_ai_train_generation(void* model);
 
 int fossil_ai_train_dataset_attach(void* model,const void* data,size_t rows);
+int fossil_ai_train_shuffle_set(void* model,const fossil_ai_train_shuffle_t* shuffle);
+int fossil_ai_train_accum_set(void* model,const fossil_ai_train_accum_t* accum);
+int fossil_ai_train_accum_flush(void* model);
+int fossil_ai_train_dist_join(void* model,const fossil_ai_train_dist_t* dist);
+int fossil_ai_train_dist_leave(void* model);
+int fossil_ai_train_dedup_set(void* model,const fossil_ai_train_dedup_t* dedup);
+int fossil_ai_train_dedup_stats(void* model,fossil_ai_train_dedup_stats_t* out);
+int fossil_ai_train_holdout_attach(void* model,const void* data,size_t rows);
 int fossil_ai_train_validate(void* model);
+int fossil_ai_train_validate_async(void* model,const fossil_ai_train_validation_t* options);
+int fossil_ai_train_validate_wait(void* model);
+int fossil_ai_train_metrics(void* model,fossil_ai_train_metrics_t* out);
+int fossil_ai_train_early_stop_status(void* model,fossil_ai_train_early_stop_status_t* out);
 
 int fossil_ai_train_checkpoint(void* model,const char* path);
 
+int fossil_ai_train_audit_attach(void* model,void* audit_ctx);
+int fossil_ai_train_profile(void* model,fossil_ai_train_profile_t* out);
+int fossil_ai_train_profile_reset(void* model);
+int fossil_ai_train_trace_export(void* model,const char* path);
+
 #ifdef __cplusplus
 }
 #endif
@@ -49,16 +231,67 @@ namespace fossil::ai {
 
 class Train {
 public:
-    static int begin(void* m){ return fossil_ai_train_begin(m); }
+    static int begin(void* m,const fossil_ai_train_config_t* c,const char* ckpt=nullptr){
+        return fossil_ai_train_begin(m,c,ckpt);
+    }
+    static int resume(void* m,const char* ckpt){ return fossil_ai_train_begin(m,nullptr,ckpt); }
     static int step(void* m,const void* b,size_t r){ return fossil_ai_train_step(m,b,r); }
     static int finalize(void* m){ return fossil_ai_train_finalize(m); }
+    static int release(void* m){ return fossil_ai_train_release(m); }
+
+    static int add_memory(void* m,const float* in,const float* out){
+        return fossil_ai_train_add_memory(m,in,out);
+    }
+    static int publish(void* m){ return fossil_ai_train_publish(m); }
+    static int recall(void* m,const float* X,size_t r,float* o,size_t* h=nullptr){
+        return fossil_ai_train_recall(m,X,r,o,h);
+    }
+    static uint64_t generation(void* m){ return fossil_ai_train_generation(m); }
 
     static int dataset_attach(void* m,const void* d,size_t r){
         return fossil_ai_train_dataset_attach(m,d,r);
     }
 
+    static int shuffle_set(void* m,const fossil_ai_train_shuffle_t* s){
+        return fossil_ai_train_shuffle_set(m,s);
+    }
+    static int accum_set(void* m,const fossil_ai_train_accum_t* a){
+        return fossil_ai_train_accum_set(m,a);
+    }
+    static int accum_flush(void* m){
+        return fossil_ai_train_accum_flush(m);
+    }
+    static int dist_join(void* m,const fossil_ai_train_dist_t* d){
+        return fossil_ai_train_dist_join(m,d);
+    }
+    static int dist_leave(void* m){
+        return fossil_ai_train_dist_leave(m);
+    }
+    static int dedup_set(void* m,const fossil_ai_train_dedup_t* d){
+        return fossil_ai_train_dedup_set(m,d);
+    }
+    static int dedup_stats(void* m,fossil_ai_train_dedup_stats_t* out){
+        return fossil_ai_train_dedup_stats(m,out);
+    }
+    static int holdout_attach(void* m,const void* d,size_t r){
+        return fossil_ai_train_holdout_attach(m,d,r);
+    }
+
     static int validate(void* m){ return fossil_ai_train_validate(m); }
+    static int validate_async(void* m,const fossil_ai_train_validation_t* o){
+        return fossil_ai_train_validate_async(m,o);
+    }
+    static int validate_wait(void* m){ return fossil_ai_train_validate_wait(m); }
+    static int metrics(void* m,fossil_ai_train_metrics_t* o){ return fossil_ai_train_metrics(m,o); }
+    static int early_stop_status(void* m,fossil_ai_train_early_stop_status_t* o){
+        return fossil_ai_train_early_stop_status(m,o);
+    }
     static int checkpoint(void* m,const char* p){ return fossil_ai_train_checkpoint(m,p); }
+
+    static int audit_attach(void* m,void* ctx){ return fossil_ai_train_audit_attach(m,ctx); }
+    static int profile(void* m,fossil_ai_train_profile_t* o){ return fossil_ai_train_profile(m,o); }
+    static int profile_reset(void* m){ return fossil_ai_train_profile_reset(m); }
+    static int trace_export(void* m,const char* p){ return fossil_ai_train_trace_export(m,p); }
 };
 
 }
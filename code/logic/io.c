@@ -0,0 +1,756 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#if !defined(_WIN32) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "io.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if !defined(_WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define FOSSIL_AI_IO_HAS_POSIX 1
+#endif
+
+/* io_uring through raw syscalls; only the kernel's UAPI header is needed. */
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define FOSSIL_AI_IO_HAS_URING 1
+#endif
+#endif
+#endif
+
+
+/* =========================================================
+ * Internal State
+ * ========================================================= */
+
+#define FOSSIL_AI_IO_DEPTH       8u
+#define FOSSIL_AI_IO_MAX_DEPTH   64u
+#define FOSSIL_AI_IO_CHUNK       (1024u * 1024u)
+#define FOSSIL_AI_IO_ALIGN       4096u      /* O_DIRECT buffer, offset and length granularity */
+#define FOSSIL_AI_IO_MAX_THREADS 4u
+#define FOSSIL_AI_IO_SYNC_TAG    UINT64_MAX
+#define FOSSIL_AI_IO_BUSY_TRIES  1000u      /* enters refused with EAGAIN or EBUSY, about 1 ms apart */
+
+/* One write in flight: a chunk of copied bytes, or caller memory from write_ref. */
+typedef struct fossil_ai_io_slot {
+    uint8_t* buf;
+    const uint8_t* data;
+    size_t len;
+    size_t done;
+    uint64_t offset;
+    int busy;
+#ifdef FOSSIL_AI_IO_HAS_URING
+    struct iovec iov;
+#endif
+} fossil_ai_io_slot_t;
+
+#ifdef FOSSIL_AI_IO_HAS_URING
+typedef struct fossil_ai_io_ring {
+    int fd;
+    void* sq_ptr;
+    void* cq_ptr;
+    size_t sq_bytes;
+    size_t cq_bytes;
+    struct io_uring_sqe* sqes;
+    size_t sqe_bytes;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe* cqes;
+    unsigned sq_next;           /* tail including entries not yet published */
+    unsigned to_submit;
+    int sync_pending;
+} fossil_ai_io_ring_t;
+#endif
+
+typedef struct fossil_ai_io_writer {
+    int engine;
+    fossil_ai_io_config_t config;
+    size_t depth;
+    fossil_ai_io_slot_t slots[FOSSIL_AI_IO_MAX_DEPTH];
+    int fill;                   /* slot taking copied bytes, -1 if none */
+    uint64_t pos;               /* bytes accepted so far */
+    int rc;
+    FILE* file;                 /* FOSSIL_AI_IO_STDIO */
+#ifdef FOSSIL_AI_IO_HAS_POSIX
+    int fd;
+    int truncate;               /* the padded O_DIRECT tail is cut back on close */
+
+    /* FOSSIL_AI_IO_THREADS; lock also guards busy flags and rc. */
+    pthread_t threads[FOSSIL_AI_IO_MAX_THREADS];
+    size_t thread_count;
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+    size_t queue[FOSSIL_AI_IO_MAX_DEPTH];
+    size_t queue_head;
+    size_t queue_count;
+    int stop;
+#endif
+#ifdef FOSSIL_AI_IO_HAS_URING
+    fossil_ai_io_ring_t ring;
+#endif
+} fossil_ai_io_writer_t;
+
+
+/* =========================================================
+ * io_uring Engine
+ * ========================================================= */
+
+#ifdef FOSSIL_AI_IO_HAS_URING
+
+static unsigned ring_load(const unsigned* p)
+{
+    return atomic_load_explicit((const _Atomic unsigned*)p, memory_order_acquire);
+}
+
+static void ring_store(unsigned* p, unsigned v)
+{
+    atomic_store_explicit((_Atomic unsigned*)p, v, memory_order_release);
+}
+
+static void ring_close(fossil_ai_io_ring_t* r)
+{
+    if (r->sqes)
+        munmap(r->sqes, r->sqe_bytes);
+    if (r->cq_ptr && r->cq_ptr != r->sq_ptr)
+        munmap(r->cq_ptr, r->cq_bytes);
+    if (r->sq_ptr)
+        munmap(r->sq_ptr, r->sq_bytes);
+    if (r->fd >= 0)
+        close(r->fd);
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+}
+
+static int ring_open(fossil_ai_io_ring_t* r, unsigned entries)
+{
+    struct io_uring_params p;
+    memset(r, 0, sizeof(*r));
+    memset(&p, 0, sizeof(p));
+    r->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0)
+        return -1;
+
+    r->sq_bytes = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_bytes = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cq_bytes > r->sq_bytes)
+            r->sq_bytes = r->cq_bytes;
+        r->cq_bytes = r->sq_bytes;
+    }
+    r->sq_ptr = mmap(NULL, r->sq_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ptr == MAP_FAILED) {
+        r->sq_ptr = NULL;
+        ring_close(r);
+        return -1;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cq_ptr = r->sq_ptr;
+    } else {
+        r->cq_ptr = mmap(NULL, r->cq_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         r->fd, IORING_OFF_CQ_RING);
+        if (r->cq_ptr == MAP_FAILED) {
+            r->cq_ptr = NULL;
+            ring_close(r);
+            return -1;
+        }
+    }
+    r->sqe_bytes = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = (struct io_uring_sqe*)mmap(NULL, r->sqe_bytes, PROT_READ | PROT_WRITE,
+                                         MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        r->sqes = NULL;
+        ring_close(r);
+        return -1;
+    }
+
+    uint8_t* sq = (uint8_t*)r->sq_ptr;
+    uint8_t* cq = (uint8_t*)r->cq_ptr;
+    r->sq_head = (unsigned*)(sq + p.sq_off.head);
+    r->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    r->sq_array = (unsigned*)(sq + p.sq_off.array);
+    r->sq_mask = *(unsigned*)(sq + p.sq_off.ring_mask);
+    r->sq_entries = p.sq_entries;
+    r->sq_next = *r->sq_tail;
+    r->cq_head = (unsigned*)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    r->cq_mask = *(unsigned*)(cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    return 0;
+}
+
+/*
+ * Entries never outnumber slots plus the sync, so the queue cannot be full.
+ * They are published to the kernel on the next enter, once filled in.
+ */
+static struct io_uring_sqe* ring_push(fossil_ai_io_ring_t* r)
+{
+    unsigned idx = r->sq_next++ & r->sq_mask;
+    struct io_uring_sqe* sqe = &r->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    r->sq_array[idx] = idx;
+    r->to_submit++;
+    return sqe;
+}
+
+/* 1 if the kernel refused for now; unsubmitted entries stay queued for the next enter. */
+static int ring_enter(fossil_ai_io_ring_t* r, unsigned wait)
+{
+    ring_store(r->sq_tail, r->sq_next);
+    for (;;) {
+        long n = syscall(__NR_io_uring_enter, r->fd, r->to_submit, wait,
+                         wait ? IORING_ENTER_GETEVENTS : 0u, NULL, 0);
+        if (n >= 0) {
+            r->to_submit -= (unsigned)n < r->to_submit ? (unsigned)n : r->to_submit;
+            return 0;
+        }
+        if (errno == EAGAIN || errno == EBUSY)
+            return 1;
+        if (errno != EINTR)
+            return -1;
+    }
+}
+
+static void ring_write(fossil_ai_io_writer_t* w, size_t i)
+{
+    fossil_ai_io_slot_t* s = &w->slots[i];
+    struct io_uring_sqe* sqe = ring_push(&w->ring);
+    s->iov.iov_base = (void*)(s->data + s->done);
+    s->iov.iov_len = s->len - s->done;
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = w->fd;
+    sqe->addr = (uint64_t)(uintptr_t)&s->iov;
+    sqe->len = 1;
+    sqe->off = s->offset + s->done;
+    sqe->user_data = i;
+}
+
+/* Handles every posted completion, resubmitting short writes; returns how many there were. */
+static unsigned ring_complete(fossil_ai_io_writer_t* w)
+{
+    fossil_ai_io_ring_t* r = &w->ring;
+    unsigned head = *r->cq_head, first = head;
+    while (head != ring_load(r->cq_tail)) {
+        const struct io_uring_cqe* cqe = &r->cqes[head & r->cq_mask];
+        uint64_t tag = cqe->user_data;
+        int res = cqe->res;
+        head++;
+
+        if (tag == FOSSIL_AI_IO_SYNC_TAG) {
+            r->sync_pending = 0;
+            if (res < 0)
+                w->rc = -1;
+            continue;
+        }
+        fossil_ai_io_slot_t* s = &w->slots[tag];
+        if (res > 0)
+            s->done += (size_t)res;
+        if (res <= 0 || s->done >= s->len) {
+            if (res < 0 || s->done < s->len)
+                w->rc = -1;
+            s->busy = 0;
+        } else {
+            ring_write(w, (size_t)tag);
+        }
+    }
+    ring_store(r->cq_head, head);
+    return head - first;
+}
+
+/*
+ * Submits queued entries and drains completions, waiting for at least one
+ * when asked. A refused enter (full completion queue, kernel short of
+ * memory) is retried after reaping, a bounded number of times. -1 if the
+ * ring failed or stayed refused and nothing more will complete.
+ */
+static int ring_reap(fossil_ai_io_writer_t* w, int wait)
+{
+    fossil_ai_io_ring_t* r = &w->ring;
+    for (unsigned tries = 0;; ++tries) {
+        int busy = ring_enter(r, wait && ring_load(r->cq_head) == ring_load(r->cq_tail) ? 1u : 0u);
+        if (busy < 0 || (busy && tries == FOSSIL_AI_IO_BUSY_TRIES)) {
+            w->rc = -1;
+            return -1;
+        }
+        unsigned reaped = ring_complete(w);
+        if (!busy)
+            return 0;
+        if (!reaped) {
+            struct timespec pause = { 0, 1000 * 1000 };
+            nanosleep(&pause, NULL);
+        }
+    }
+}
+
+#endif
+
+
+/* =========================================================
+ * Thread Engine
+ * ========================================================= */
+
+#ifdef FOSSIL_AI_IO_HAS_POSIX
+
+static int pwrite_all(int fd, const uint8_t* data, size_t len, uint64_t offset)
+{
+    while (len) {
+        ssize_t n = pwrite(fd, data, len, (off_t)offset);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        data += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return 0;
+}
+
+static void* io_worker(void* arg)
+{
+    fossil_ai_io_writer_t* w = (fossil_ai_io_writer_t*)arg;
+
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (!w->stop && w->queue_count == 0)
+            pthread_cond_wait(&w->work, &w->lock);
+        if (w->queue_count == 0)
+            break;
+        size_t i = w->queue[w->queue_head];
+        w->queue_head = (w->queue_head + 1) % FOSSIL_AI_IO_MAX_DEPTH;
+        w->queue_count--;
+        pthread_mutex_unlock(&w->lock);
+
+        fossil_ai_io_slot_t* s = &w->slots[i];
+        int rc = pwrite_all(w->fd, s->data, s->len, s->offset);
+
+        pthread_mutex_lock(&w->lock);
+        if (rc != 0)
+            w->rc = -1;
+        s->busy = 0;
+        pthread_cond_broadcast(&w->done);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+static int threads_start(fossil_ai_io_writer_t* w)
+{
+    size_t n = w->depth < FOSSIL_AI_IO_MAX_THREADS ? w->depth : FOSSIL_AI_IO_MAX_THREADS;
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->work, NULL);
+    pthread_cond_init(&w->done, NULL);
+    for (size_t t = 0; t < n; ++t) {
+        if (pthread_create(&w->threads[t], NULL, io_worker, w) != 0)
+            break;
+        w->thread_count++;
+    }
+    return w->thread_count ? 0 : -1;
+}
+
+static void threads_stop(fossil_ai_io_writer_t* w)
+{
+    pthread_mutex_lock(&w->lock);
+    w->stop = 1;
+    pthread_cond_broadcast(&w->work);
+    pthread_mutex_unlock(&w->lock);
+    for (size_t t = 0; t < w->thread_count; ++t)
+        pthread_join(w->threads[t], NULL);
+    pthread_cond_destroy(&w->done);
+    pthread_cond_destroy(&w->work);
+    pthread_mutex_destroy(&w->lock);
+}
+
+#endif
+
+
+/* =========================================================
+ * Writer
+ * ========================================================= */
+
+/* A free slot, waiting on completions while every slot is in flight; -1 after a failed write. */
+static int slot_acquire(fossil_ai_io_writer_t* w)
+{
+    for (;;) {
+#ifdef FOSSIL_AI_IO_HAS_POSIX
+        /* Workers set rc and clear busy under the lock. */
+        int locked = w->engine == FOSSIL_AI_IO_THREADS;
+        if (locked)
+            pthread_mutex_lock(&w->lock);
+#endif
+        int rc = w->rc;
+        int found = -1;
+        for (size_t i = 0; i < w->depth && found < 0 && rc == 0; ++i) {
+            if (!w->slots[i].busy)
+                found = (int)i;
+        }
+#ifdef FOSSIL_AI_IO_HAS_POSIX
+        if (locked) {
+            if (found < 0 && rc == 0)
+                pthread_cond_wait(&w->done, &w->lock);
+            pthread_mutex_unlock(&w->lock);
+        }
+#endif
+        if (rc != 0)
+            return -1;
+        if (found >= 0)
+            return found;
+#ifdef FOSSIL_AI_IO_HAS_URING
+        if (w->engine == FOSSIL_AI_IO_URING && ring_reap(w, 1) != 0)
+            return -1;
+#endif
+    }
+}
+
+static void slot_submit(fossil_ai_io_writer_t* w, size_t i)
+{
+    fossil_ai_io_slot_t* s = &w->slots[i];
+    s->done = 0;
+#ifdef FOSSIL_AI_IO_HAS_URING
+    if (w->engine == FOSSIL_AI_IO_URING) {
+        s->busy = 1;
+        ring_write(w, i);
+        ring_reap(w, 0);
+        return;
+    }
+#endif
+#ifdef FOSSIL_AI_IO_HAS_POSIX
+    pthread_mutex_lock(&w->lock);
+    s->busy = 1;
+    w->queue[(w->queue_head + w->queue_count) % FOSSIL_AI_IO_MAX_DEPTH] = i;
+    w->queue_count++;
+    pthread_cond_signal(&w->work);
+    pthread_mutex_unlock(&w->lock);
+#endif
+}
+
+/* Hands the partly filled chunk over; under O_DIRECT its tail is zero-padded to the alignment. */
+static void fill_submit(fossil_ai_io_writer_t* w)
+{
+    if (w->fill < 0)
+        return;
+    fossil_ai_io_slot_t* s = &w->slots[w->fill];
+    w->fill = -1;
+    if (!s->len)
+        return;
+#ifdef FOSSIL_AI_IO_HAS_POSIX
+    if (w->config.direct && s->len % FOSSIL_AI_IO_ALIGN) {
+        size_t padded = (s->len + FOSSIL_AI_IO_ALIGN - 1) / FOSSIL_AI_IO_ALIGN * FOSSIL_AI_IO_ALIGN;
+        memset(s->buf + s->len, 0, padded - s->len);
+        s->len = padded;
+        w->truncate = 1;
+    }
+#endif
+    slot_submit(w, (size_t)(s - w->slots));
+}
+
+static void slots_drain(fossil_ai_io_writer_t* w)
+{
+#ifdef FOSSIL_AI_IO_HAS_URING
+    if (w->engine == FOSSIL_AI_IO_URING) {
+        for (;;) {
+            int busy = w->ring.sync_pending;
+            for (size_t i = 0; i < w->depth && !busy; ++i)
+                busy = w->slots[i].busy;
+            if (!busy || ring_reap(w, 1) != 0)
+                return;
+        }
+    }
+#endif
+#ifdef FOSSIL_AI_IO_HAS_POSIX
+    if (w->engine == FOSSIL_AI_IO_THREADS) {
+        pthread_mutex_lock(&w->lock);
+        for (;;) {
+            int busy = 0;
+            for (size_t i = 0; i < w->depth && !busy; ++i)
+                busy = w->slots[i].busy;
+            if (!busy)
+                break;
+            pthread_cond_wait(&w->done, &w->lock);
+        }
+        pthread_mutex_unlock(&w->lock);
+    }
+#endif
+}
+
+static void writer_free(fossil_ai_io_writer_t* w)
+{
+    for (size_t i = 0; i < w->depth; ++i)
+        free(w->slots[i].buf);
+    free(w);
+}
+
+static int writer_engine(fossil_ai_io_writer_t* w, int engine)
+{
+#ifdef FOSSIL_AI_IO_HAS_URING
+    if (engine == FOSSIL_AI_IO_AUTO || engine == FOSSIL_AI_IO_URING) {
+        if (ring_open(&w->ring, (unsigned)w->depth + 1) == 0)
+            return FOSSIL_AI_IO_URING;
+        if (engine == FOSSIL_AI_IO_URING)
+            return -1;
+    }
+    w->ring.fd = -1;
+#endif
+#ifdef FOSSIL_AI_IO_HAS_POSIX
+    if (engine == FOSSIL_AI_IO_AUTO || engine == FOSSIL_AI_IO_THREADS) {
+        if (threads_start(w) == 0)
+            return FOSSIL_AI_IO_THREADS;
+        threads_stop(w);
+        if (engine == FOSSIL_AI_IO_THREADS)
+            return -1;
+    }
+#endif
+    return engine == FOSSIL_AI_IO_AUTO || engine == FOSSIL_AI_IO_STDIO ? FOSSIL_AI_IO_STDIO : -1;
+}
+
+int fossil_ai_io_create(void** writer, const char* path, const fossil_ai_io_config_t* config)
+{
+    if (!writer || !path)
+        return -1;
+    *writer = NULL;
+    if (config && (config->engine < FOSSIL_AI_IO_AUTO || config->engine > FOSSIL_AI_IO_STDIO ||
+                   config->depth > FOSSIL_AI_IO_MAX_DEPTH))
+        return -1;
+
+    fossil_ai_io_writer_t* w = (fossil_ai_io_writer_t*)calloc(1, sizeof(*w));
+    if (!w)
+        return -2;
+    if (config)
+        w->config = *config;
+    w->depth = w->config.depth ? w->config.depth : FOSSIL_AI_IO_DEPTH;
+    size_t chunk = w->config.chunk_bytes ? w->config.chunk_bytes : FOSSIL_AI_IO_CHUNK;
+    w->config.chunk_bytes = (chunk + FOSSIL_AI_IO_ALIGN - 1) / FOSSIL_AI_IO_ALIGN * FOSSIL_AI_IO_ALIGN;
+    w->fill = -1;
+
+    int engine = writer_engine(w, w->config.engine);
+    if (engine < 0) {
+        free(w);
+        return -1;
+    }
+    w->engine = engine;
+
+    if (engine == FOSSIL_AI_IO_STDIO) {
+        w->config.direct = 0;
+        w->file = fopen(path, "wb");
+        if (!w->file) {
+            free(w);
+            return -1;
+        }
+        *writer = w;
+        return 0;
+    }
+
+#ifdef FOSSIL_AI_IO_HAS_POSIX
+    for (size_t i = 0; i < w->depth; ++i) {
+        void* buf = NULL;
+        if (posix_memalign(&buf, FOSSIL_AI_IO_ALIGN, w->config.chunk_bytes) != 0) {
+            w->rc = -2;
+            break;
+        }
+        w->slots[i].buf = (uint8_t*)buf;
+    }
+
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+    w->fd = w->rc == 0 && w->config.direct ? open(path, flags | O_DIRECT, 0644) : -1;
+#else
+    w->config.direct = 0;
+    w->fd = -1;
+#endif
+    if (w->fd < 0 && w->rc == 0) {
+        w->config.direct = 0;
+        w->fd = open(path, flags, 0644);
+    }
+
+    if (w->rc != 0 || w->fd < 0) {
+        int rc = w->rc ? w->rc : -1;
+        if (w->fd >= 0)
+            close(w->fd);
+#ifdef FOSSIL_AI_IO_HAS_URING
+        if (engine == FOSSIL_AI_IO_URING)
+            ring_close(&w->ring);
+#endif
+        if (engine == FOSSIL_AI_IO_THREADS)
+            threads_stop(w);
+        writer_free(w);
+        return rc;
+    }
+#endif
+    *writer = w;
+    return 0;
+}
+
+int fossil_ai_io_write(void* writer, const void* data, size_t size)
+{
+    fossil_ai_io_writer_t* w = (fossil_ai_io_writer_t*)writer;
+    if (!w || (!data && size))
+        return -1;
+
+    if (w->engine == FOSSIL_AI_IO_STDIO) {
+        if (size && fwrite(data, 1, size, w->file) != size)
+            w->rc = -1;
+        w->pos += size;
+        return w->rc;
+    }
+
+    const uint8_t* p = (const uint8_t*)data;
+    while (size) {
+        if (w->fill < 0) {
+            int i = slot_acquire(w);
+            if (i < 0)
+                return -1;
+            w->fill = i;
+            w->slots[i].data = w->slots[i].buf;
+            w->slots[i].len = 0;
+            w->slots[i].offset = w->pos;
+        }
+        fossil_ai_io_slot_t* s = &w->slots[w->fill];
+        size_t k = w->config.chunk_bytes - s->len < size ? w->config.chunk_bytes - s->len : size;
+        memcpy(s->buf + s->len, p, k);
+        s->len += k;
+        w->pos += k;
+        p += k;
+        size -= k;
+        if (s->len == w->config.chunk_bytes)
+            fill_submit(w);
+    }
+    return 0;
+}
+
+int fossil_ai_io_write_ref(void* writer, const void* data, size_t size)
+{
+    fossil_ai_io_writer_t* w = (fossil_ai_io_writer_t*)writer;
+    if (!w || (!data && size))
+        return -1;
+
+    /* Small pieces and anything O_DIRECT cannot take as is go through the chunks. */
+    if (w->engine == FOSSIL_AI_IO_STDIO || size < w->config.chunk_bytes / 4 ||
+        (w->config.direct && (((uintptr_t)data | size | w->pos) % FOSSIL_AI_IO_ALIGN)))
+        return fossil_ai_io_write(w, data, size);
+
+    fill_submit(w);
+    int i = slot_acquire(w);
+    if (i < 0)
+        return -1;
+    w->slots[i].data = (const uint8_t*)data;
+    w->slots[i].len = size;
+    w->slots[i].offset = w->pos;
+    w->pos += size;
+    slot_submit(w, (size_t)i);
+    return 0;
+}
+
+uint64_t fossil_ai_io_offset(void* writer)
+{
+    fossil_ai_io_writer_t* w = (fossil_ai_io_writer_t*)writer;
+    return w ? w->pos : 0;
+}
+
+int fossil_ai_io_engine(void* writer)
+{
+    fossil_ai_io_writer_t* w = (fossil_ai_io_writer_t*)writer;
+    return w ? w->engine : -1;
+}
+
+int fossil_ai_io_close(void* writer)
+{
+    fossil_ai_io_writer_t* w = (fossil_ai_io_writer_t*)writer;
+    if (!w)
+        return -1;
+
+    if (w->engine == FOSSIL_AI_IO_STDIO) {
+        int rc = w->rc;
+        if (fflush(w->file) != 0)
+            rc = -1;
+#ifdef FOSSIL_AI_IO_HAS_POSIX
+        if (rc == 0 && w->config.sync && fsync(fileno(w->file)) != 0)
+            rc = -1;
+#endif
+        if (fclose(w->file) != 0)
+            rc = -1;
+        free(w);
+        return rc;
+    }
+
+#ifdef FOSSIL_AI_IO_HAS_POSIX
+    fill_submit(w);
+    int synced = 0;
+#ifdef FOSSIL_AI_IO_HAS_URING
+    /* Drained behind every queued write, so one enter covers the tail and the sync. */
+    if (w->engine == FOSSIL_AI_IO_URING && w->config.sync && !w->truncate && w->rc == 0) {
+        struct io_uring_sqe* sqe = ring_push(&w->ring);
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->fd = w->fd;
+        sqe->flags = IOSQE_IO_DRAIN;
+        sqe->user_data = FOSSIL_AI_IO_SYNC_TAG;
+        w->ring.sync_pending = 1;
+        ring_reap(w, 0);
+        synced = 1;
+    }
+#endif
+    slots_drain(w);
+
+    int rc = w->rc;
+    if (rc == 0 && w->truncate && ftruncate(w->fd, (off_t)w->pos) != 0)
+        rc = -1;
+    if (rc == 0 && w->config.sync && !synced && fsync(w->fd) != 0)
+        rc = -1;
+    if (close(w->fd) != 0)
+        rc = -1;
+#ifdef FOSSIL_AI_IO_HAS_URING
+    if (w->engine == FOSSIL_AI_IO_URING)
+        ring_close(&w->ring);
+#endif
+    if (w->engine == FOSSIL_AI_IO_THREADS)
+        threads_stop(w);
+    writer_free(w);
+    return rc;
+#else
+    return -1;
+#endif
+}
@@ -0,0 +1,60 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#ifndef FOSSIL_AI_IO_H
+#define FOSSIL_AI_IO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Sequential file writer used by checkpoints and audit exports. Writes are
+ * queued in chunks and run in the background, on io_uring where the kernel
+ * allows it and on a small thread pool otherwise, so the caller keeps
+ * producing while earlier chunks land. close waits for everything, then
+ * syncs once after the last write. Private to the library.
+ */
+#define FOSSIL_AI_IO_AUTO    0
+#define FOSSIL_AI_IO_URING   1
+#define FOSSIL_AI_IO_THREADS 2
+#define FOSSIL_AI_IO_STDIO   3
+
+typedef struct fossil_ai_io_config {
+    int engine;                 /* FOSSIL_AI_IO_AUTO picks the best available */
+    unsigned depth;             /* chunks in flight, 0 = 8 */
+    size_t chunk_bytes;         /* 0 = 1 MiB, rounded up to 4 KiB */
+    int direct;                 /* O_DIRECT where the filesystem accepts it */
+    int sync;                   /* fsync after the last write on close */
+} fossil_ai_io_config_t;
+
+int fossil_ai_io_create(void** writer,const char* path,const fossil_ai_io_config_t* config);
+int fossil_ai_io_write(void* writer,const void* data,size_t size);
+/* Queues data without copying it; it must stay unchanged until close. */
+int fossil_ai_io_write_ref(void* writer,const void* data,size_t size);
+uint64_t fossil_ai_io_offset(void* writer);
+int fossil_ai_io_engine(void* writer);
+/* Waits for every write and the sync; -1 if any of them failed. */
+int fossil_ai_io_close(void* writer);
+
+#endif
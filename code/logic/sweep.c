@@ -0,0 +1,443 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#if !defined(_WIN32) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "fossil/ai/sweep.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define FOSSIL_AI_SWEEP_HAS_MMAP 1
+#endif
+
+/* =========================================================
+ * Internal State
+ * ========================================================= */
+
+enum {
+    FOSSIL_AI_SWEEP_TRAIN = 0,
+    FOSSIL_AI_SWEEP_VALIDATE = 1
+};
+
+typedef struct fossil_ai_sweep_rank {
+    double loss;
+    size_t variant;
+} fossil_ai_sweep_rank_t;
+
+/*
+ * Every live variant consumes the same batch in the same round, so each
+ * row is loaded once per round and reused from cache by all variants.
+ */
+typedef struct fossil_ai_sweep_state {
+    const fossil_ai_sweep_config_t* config;
+    fossil_ai_sweep_result_t* results;
+    char* handles;          /* one byte per variant, used as model keys */
+    size_t* live;
+    size_t live_count;
+    fossil_ai_sweep_rank_t* ranks; /* scratch for halving, one per variant */
+
+    const float* batch;
+    size_t batch_rows;
+    int phase;
+
+    atomic_size_t next;
+    atomic_int error;
+
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t finished;
+    uint64_t round;
+    size_t busy;
+    int quit;
+} fossil_ai_sweep_state_t;
+
+
+/* =========================================================
+ * Dataset Mapping
+ * ========================================================= */
+
+int fossil_ai_sweep_dataset_map(const char* path, size_t width, fossil_ai_sweep_dataset_t* out)
+{
+    if (!path || !out || width == 0)
+        return -1;
+
+    memset(out, 0, sizeof(*out));
+#ifdef FOSSIL_AI_SWEEP_HAS_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || sb.st_size <= 0) {
+        close(fd);
+        return -1;
+    }
+
+    void* base = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return -1;
+    madvise(base, (size_t)sb.st_size, MADV_SEQUENTIAL);
+    out->size = (size_t)sb.st_size;
+#else
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return -1;
+
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    void* base = len > 0 ? malloc((size_t)len) : NULL;
+    if (!base || fread(base, 1, (size_t)len, f) != (size_t)len) {
+        free(base);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    out->size = (size_t)len;
+#endif
+
+    out->base = base;
+    out->rows = (const float*)base;
+    out->width = width;
+    out->count = out->size / (width * sizeof(float));
+    return out->count ? 0 : -1;
+}
+
+int fossil_ai_sweep_dataset_unmap(fossil_ai_sweep_dataset_t* ds)
+{
+    if (!ds || !ds->base)
+        return -1;
+
+#ifdef FOSSIL_AI_SWEEP_HAS_MMAP
+    munmap(ds->base, ds->size);
+#else
+    free(ds->base);
+#endif
+    memset(ds, 0, sizeof(*ds));
+    return 0;
+}
+
+
+/* =========================================================
+ * Workers
+ * ========================================================= */
+
+static void run_variant(fossil_ai_sweep_state_t* s, size_t v)
+{
+    void* model = &s->handles[v];
+
+    if (s->phase == FOSSIL_AI_SWEEP_TRAIN) {
+        if (s->results[v].finished)
+            return;
+        /* 1: the step ran and the variant's early-stop policy ended its training. */
+        int rc = fossil_ai_train_step(model, s->batch, s->batch_rows);
+        if (rc < 0) {
+            atomic_store(&s->error, -1);
+            return;
+        }
+        s->results[v].steps++;
+        s->results[v].finished = rc == 1;
+        return;
+    }
+
+    fossil_ai_train_metrics_t m;
+    if (fossil_ai_train_validate(model) != 0 || fossil_ai_train_metrics(model, &m) != 0) {
+        atomic_store(&s->error, -1);
+        return;
+    }
+    s->results[v].loss = m.loss;
+    s->results[v].hit_rate = m.hit_rate;
+}
+
+static void* sweep_worker(void* arg)
+{
+    fossil_ai_sweep_state_t* s = (fossil_ai_sweep_state_t*)arg;
+    uint64_t seen = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&s->lock);
+        while (!s->quit && s->round == seen)
+            pthread_cond_wait(&s->start, &s->lock);
+        if (s->quit) {
+            pthread_mutex_unlock(&s->lock);
+            return NULL;
+        }
+        seen = s->round;
+        pthread_mutex_unlock(&s->lock);
+
+        /* Variants are claimed one at a time so a slow one never idles the pool. */
+        for (;;) {
+            size_t i = atomic_fetch_add(&s->next, 1);
+            if (i >= s->live_count)
+                break;
+            run_variant(s, s->live[i]);
+        }
+
+        pthread_mutex_lock(&s->lock);
+        if (--s->busy == 0)
+            pthread_cond_signal(&s->finished);
+        pthread_mutex_unlock(&s->lock);
+    }
+}
+
+static void run_round(fossil_ai_sweep_state_t* s, size_t workers, int phase,
+                      const float* batch, size_t rows, const float* prefetch, size_t prefetch_bytes)
+{
+    pthread_mutex_lock(&s->lock);
+    s->phase = phase;
+    s->batch = batch;
+    s->batch_rows = rows;
+    atomic_store(&s->next, 0);
+    s->busy = workers;
+    s->round++;
+    pthread_cond_broadcast(&s->start);
+    pthread_mutex_unlock(&s->lock);
+
+    /* The loader faults in the next batch while the pool works on this one. */
+#ifdef FOSSIL_AI_SWEEP_HAS_MMAP
+    if (prefetch && prefetch_bytes) {
+        uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+        uintptr_t lo = (uintptr_t)prefetch & ~(page - 1);
+        madvise((void*)lo, (uintptr_t)prefetch + prefetch_bytes - lo, MADV_WILLNEED);
+    }
+#else
+    (void)prefetch;
+    (void)prefetch_bytes;
+#endif
+
+    pthread_mutex_lock(&s->lock);
+    while (s->busy)
+        pthread_cond_wait(&s->finished, &s->lock);
+    pthread_mutex_unlock(&s->lock);
+}
+
+
+/* =========================================================
+ * Successive Halving
+ * ========================================================= */
+
+/* A diverged variant's NaN loss ranks last, which also keeps the order total for qsort. */
+static double rank_loss(double loss)
+{
+    return isnan(loss) ? INFINITY : loss;
+}
+
+static int rank_cmp(const void* a, const void* b)
+{
+    const fossil_ai_sweep_rank_t* x = (const fossil_ai_sweep_rank_t*)a;
+    const fossil_ai_sweep_rank_t* y = (const fossil_ai_sweep_rank_t*)b;
+
+    if (x->loss < y->loss) return -1;
+    if (x->loss > y->loss) return 1;
+    return (x->variant > y->variant) - (x->variant < y->variant);
+}
+
+/*
+ * Keeps the best ceil(n/eta) variants; ties break on variant index. The
+ * rest are released as they drop out, so their memory is back before the
+ * survivors train on.
+ */
+static void halve(fossil_ai_sweep_state_t* s, size_t eta)
+{
+    for (size_t i = 0; i < s->live_count; ++i) {
+        s->ranks[i].loss = rank_loss(s->results[s->live[i]].loss);
+        s->ranks[i].variant = s->live[i];
+    }
+    qsort(s->ranks, s->live_count, sizeof(*s->ranks), rank_cmp);
+    for (size_t i = 0; i < s->live_count; ++i)
+        s->live[i] = s->ranks[i].variant;
+
+    size_t keep = (s->live_count + eta - 1) / eta;
+    if (keep == 0)
+        keep = 1;
+
+    for (size_t i = 0; i < s->live_count; ++i) {
+        size_t v = s->live[i];
+        if (i < keep) {
+            s->results[v].rungs++;
+        } else {
+            s->results[v].stopped = 1;
+            fossil_ai_train_release(&s->handles[v]);
+        }
+    }
+    s->live_count = keep;
+}
+
+
+/* =========================================================
+ * Sweep
+ * ========================================================= */
+
+static size_t online_workers(void)
+{
+#ifdef FOSSIL_AI_SWEEP_HAS_MMAP
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (size_t)n : 1;
+#else
+    return 1;
+#endif
+}
+
+int fossil_ai_sweep_run(const fossil_ai_sweep_config_t* config, fossil_ai_sweep_result_t* results)
+{
+    if (!config || !results || !config->variants || config->variant_count == 0 ||
+        !config->data || !config->data->rows || config->batch_rows == 0 || config->max_steps == 0)
+        return -1;
+
+    const fossil_ai_sweep_dataset_t* data = config->data;
+    const fossil_ai_sweep_dataset_t* holdout = config->holdout ? config->holdout : data;
+    size_t n = config->variant_count;
+    size_t eta = config->eta ? config->eta : 2;
+    size_t workers = config->workers ? config->workers : online_workers();
+    if (workers > n)
+        workers = n;
+
+    for (size_t v = 0; v < n; ++v) {
+        if (config->variants[v].input_dim + config->variants[v].output_dim != data->width)
+            return -1;
+    }
+
+    fossil_ai_sweep_state_t s;
+    memset(&s, 0, sizeof(s));
+    s.config = config;
+    s.results = results;
+    s.handles = (char*)calloc(n, 1);
+    s.live = (size_t*)malloc(n * sizeof(*s.live));
+    s.ranks = (fossil_ai_sweep_rank_t*)malloc(n * sizeof(*s.ranks));
+    pthread_t* threads = (pthread_t*)malloc(workers * sizeof(*threads));
+    if (!s.handles || !s.live || !s.ranks || !threads) {
+        free(s.handles);
+        free(s.live);
+        free(s.ranks);
+        free(threads);
+        return -2;
+    }
+
+    memset(results, 0, n * sizeof(*results));
+    int rc = 0;
+    size_t begun = 0;
+    for (; begun < n && rc == 0; ++begun) {
+        s.live[begun] = begun;
+        rc = fossil_ai_train_begin(&s.handles[begun], &config->variants[begun], NULL);
+        if (rc == 0)
+            rc = fossil_ai_train_holdout_attach(&s.handles[begun], holdout->rows, holdout->count);
+    }
+    s.live_count = n;
+
+    pthread_mutex_init(&s.lock, NULL);
+    pthread_cond_init(&s.start, NULL);
+    pthread_cond_init(&s.finished, NULL);
+    atomic_init(&s.next, 0);
+    atomic_init(&s.error, 0);
+
+    size_t started = 0;
+    for (; started < workers && rc == 0; ++started) {
+        if (pthread_create(&threads[started], NULL, sweep_worker, &s) != 0)
+            break;
+    }
+    if (started == 0)
+        rc = -2;
+
+    size_t cursor = 0;
+    size_t rung = config->rung_steps;
+    size_t width_bytes = data->width * sizeof(float);
+
+    for (size_t step = 1; rc == 0 && step <= config->max_steps; ++step) {
+        if (cursor >= data->count)
+            cursor = 0;
+        size_t rows = data->count - cursor;
+        if (rows > config->batch_rows)
+            rows = config->batch_rows;
+        const float* batch = data->rows + cursor * data->width;
+        cursor += rows;
+
+        size_t ahead = cursor < data->count ? data->count - cursor : 0;
+        if (ahead > config->batch_rows)
+            ahead = config->batch_rows;
+
+        run_round(&s, started, FOSSIL_AI_SWEEP_TRAIN, batch, rows,
+                  data->rows + cursor * data->width, ahead * width_bytes);
+        rc = atomic_load(&s.error);
+
+        size_t running = 0;
+        for (size_t i = 0; i < s.live_count; ++i)
+            running += !results[s.live[i]].finished;
+        if (rc == 0 && running == 0)
+            break;
+
+        if (rc == 0 && rung && step == rung && s.live_count > 1 && step < config->max_steps) {
+            run_round(&s, started, FOSSIL_AI_SWEEP_VALIDATE, NULL, 0, NULL, 0);
+            rc = atomic_load(&s.error);
+            halve(&s, eta);
+            rung *= eta;
+        }
+    }
+
+    if (rc == 0) {
+        run_round(&s, started, FOSSIL_AI_SWEEP_VALIDATE, NULL, 0, NULL, 0);
+        rc = atomic_load(&s.error);
+    }
+
+    pthread_mutex_lock(&s.lock);
+    s.quit = 1;
+    pthread_cond_broadcast(&s.start);
+    pthread_mutex_unlock(&s.lock);
+    for (size_t t = 0; t < started; ++t)
+        pthread_join(threads[t], NULL);
+
+    int best = -1;
+    for (size_t i = 0; rc == 0 && i < s.live_count; ++i) {
+        size_t v = s.live[i];
+        if (best < 0 || rank_loss(results[v].loss) < rank_loss(results[best].loss))
+            best = (int)v;
+    }
+
+    /* Eliminated variants were released by halve. */
+    for (size_t i = 0; i < s.live_count; ++i) {
+        if (s.live[i] < begun)
+            fossil_ai_train_release(&s.handles[s.live[i]]);
+    }
+
+    pthread_cond_destroy(&s.finished);
+    pthread_cond_destroy(&s.start);
+    pthread_mutex_destroy(&s.lock);
+    free(threads);
+    free(s.ranks);
+    free(s.live);
+    free(s.handles);
+    return rc == 0 ? best : rc;
+}
@@ -0,0 +1,3564 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#if !defined(_WIN32) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "fossil/ai/train.h"
+#include "fossil/ai/audit.h"
+#include "io.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if !defined(_WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define FOSSIL_AI_TRAIN_HAS_MMAP 1
+#endif
+
+/* A rank that exits must fail its neighbours' sends, not raise SIGPIPE in them. */
+#if defined(MSG_NOSIGNAL)
+#define FOSSIL_AI_TRAIN_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define FOSSIL_AI_TRAIN_SEND_FLAGS 0
+#endif
+
+/* =========================================================
+ * Internal State
+ * ========================================================= */
+
+#define FOSSIL_AI_TRAIN_CHUNK_BLOCKS   1024u
+#define FOSSIL_AI_TRAIN_SEGMENT_SHIFT  12u
+#define FOSSIL_AI_TRAIN_SEGMENT_SLOTS  (1u << FOSSIL_AI_TRAIN_SEGMENT_SHIFT)
+#define FOSSIL_AI_TRAIN_PAGE           4096u
+#define FOSSIL_AI_TRAIN_CKPT_VERSION   3u
+#define FOSSIL_AI_TRAIN_MAX_WORKERS    64u
+#define FOSSIL_AI_TRAIN_BATCH_ROWS     1024u
+#define FOSSIL_AI_TRAIN_TRACE_EVENTS   4096u
+#define FOSSIL_AI_TRAIN_READER_SLOTS   1024u
+
+static const char FOSSIL_AI_TRAIN_CKPT_MAGIC[8] = { 'F','A','I','C','K','P','T','\0' };
+
+/* A memory block is this header followed by input_dim inputs and output_dim outputs. */
+typedef struct fossil_ai_train_block {
+    uint64_t key;
+    uint32_t hits;
+    uint32_t flags;
+} fossil_ai_train_block_t;
+
+typedef struct fossil_ai_train_slot {
+    uint64_t key;           /* 0 marks an empty slot */
+    uint64_t block;
+} fossil_ai_train_slot_t;
+
+/* A checkpoint mapping outlives the session while snapshots still alias it. */
+typedef struct fossil_ai_train_mapping {
+    void* base;
+    size_t size;
+    atomic_size_t refs;
+} fossil_ai_train_mapping_t;
+
+/*
+ * Chunks and index segments are reference counted so snapshots can share
+ * them; a writer copies any piece it does not hold exclusively.
+ */
+typedef struct fossil_ai_train_chunk {
+    uint8_t* data;
+    fossil_ai_train_mapping_t* map;
+    atomic_size_t refs;
+} fossil_ai_train_chunk_t;
+
+typedef struct fossil_ai_train_segment {
+    fossil_ai_train_slot_t* slots;
+    fossil_ai_train_mapping_t* map;
+    atomic_size_t refs;
+} fossil_ai_train_segment_t;
+
+typedef struct fossil_ai_train_store {
+    size_t input_dim;
+    size_t output_dim;
+    float resolution;
+    size_t stride;
+
+    fossil_ai_train_chunk_t** chunks;
+    size_t chunk_count;
+    size_t chunk_cap;
+    size_t block_count;
+
+    fossil_ai_train_segment_t** segments;
+    size_t index_capacity;
+    size_t index_used;
+    int index_ready;
+} fossil_ai_train_store_t;
+
+typedef struct fossil_ai_train_job {
+    void* model;
+    fossil_ai_train_store_t* snapshot;
+    const float* data;
+    size_t rows;
+    uint64_t step;
+    uint64_t seed;
+    fossil_ai_train_validation_t options;
+    struct fossil_ai_train_state* owner;
+    pthread_t thread;
+    atomic_int done;
+} fossil_ai_train_job_t;
+
+enum {
+    FOSSIL_AI_TRAIN_TRACE_STEP = 0,
+    FOSSIL_AI_TRAIN_TRACE_CHECKPOINT = 1
+};
+
+typedef struct fossil_ai_train_trace_event {
+    uint64_t start_ns;
+    uint64_t step;
+    int kind;
+    fossil_ai_train_phases_t phases;
+} fossil_ai_train_trace_event_t;
+
+/*
+ * A published, immutable view of the memory store. Readers pin the global
+ * epoch while they use one; retired generations are freed once every
+ * pinned epoch is newer than the retirement.
+ */
+typedef struct fossil_ai_train_generation {
+    fossil_ai_train_store_t* store;
+    uint64_t id;
+    uint64_t retired_at;
+    struct fossil_ai_train_generation* next;
+} fossil_ai_train_generation_t;
+
+/* Merged rows per memory block: first input followed by the summed targets. */
+typedef struct fossil_ai_train_accum_buf {
+    size_t* slots;          /* entry index + 1, 0 = empty */
+    size_t cap;
+    uint64_t* keys;
+    uint32_t* counts;
+    float* rows;
+    size_t n;
+    size_t entry_cap;
+} fossil_ai_train_accum_buf_t;
+
+typedef struct fossil_ai_train_accum_bank {
+    fossil_ai_train_accum_buf_t bufs[FOSSIL_AI_TRAIN_MAX_WORKERS]; /* one per worker */
+    fossil_ai_train_accum_buf_t merged;
+    size_t micro;
+    uint64_t apply_ns;
+    int rc;
+} fossil_ai_train_accum_bank_t;
+
+typedef struct fossil_ai_train_state {
+    void* model;
+    fossil_ai_train_config_t config;
+    int active;
+
+    fossil_ai_train_store_t store;
+    fossil_ai_train_mapping_t* map;
+
+    const float* data;
+    size_t rows;
+    const float* holdout;
+    size_t holdout_rows;
+    uint64_t cursor;
+    uint64_t epoch;
+    uint64_t rng;
+    uint64_t steps;
+
+    fossil_ai_train_shuffle_t shuffle;
+    float* gather;
+    size_t* group_perm;
+    uint64_t group_epoch;   /* epoch + 1 the group permutation was built for */
+    size_t group_last;      /* where the last physical group landed in group_perm */
+    size_t* window_perm;
+    uint64_t window_id;     /* (epoch, window) + 1 the window permutation belongs to */
+    size_t* order;          /* full epoch order, only when stratifying */
+    uint64_t order_epoch;
+    double* alias_prob;
+    size_t* alias_idx;
+
+    int dedup_on;
+    fossil_ai_train_dedup_t dedup;
+    fossil_ai_train_dedup_stats_t dedup_stats;
+    float* kept;            /* owned copy of the rows that survived dedup */
+
+    fossil_ai_train_accum_t accum;
+    fossil_ai_train_accum_bank_t* banks[2];
+    size_t bank;            /* bank currently accumulating */
+    pthread_t apply_thread;
+    int applying;           /* the other bank is being applied in the background */
+    atomic_size_t applied_blocks; /* block count as of the last finished apply */
+
+    fossil_ai_train_transport_t link;
+    size_t rank;
+    size_t world;           /* 0 = not distributed */
+
+    pthread_mutex_t write_lock; /* serializes writers; readers never take it */
+    pthread_mutex_t checkpoint_lock; /* one checkpoint file is written at a time */
+    _Atomic(fossil_ai_train_generation_t*) current;
+    fossil_ai_train_generation_t* retired;
+    uint64_t generation;
+    atomic_int serving;
+
+    pthread_mutex_t lock;   /* guards metrics against validation workers */
+    fossil_ai_train_metrics_t metrics;
+    fossil_ai_train_job_t* job;
+    fossil_ai_train_early_stop_status_t stop;
+
+    void* audit;
+    uint64_t keys[FOSSIL_AI_TRAIN_BATCH_ROWS];
+    size_t targets[FOSSIL_AI_TRAIN_BATCH_ROWS];
+
+    fossil_ai_train_profile_t profile;
+    fossil_ai_train_trace_event_t* trace;
+    size_t trace_head;
+    size_t trace_count;
+
+    struct fossil_ai_train_state* next;
+} fossil_ai_train_state_t;
+
+/* On-disk checkpoint header. Regions start on page boundaries so they map in place. */
+typedef struct fossil_ai_train_ckpt_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t input_dim;
+    uint64_t output_dim;
+    uint64_t capacity;
+    float learning_rate;
+    float resolution;
+    uint64_t seed;
+    uint64_t rng;
+    uint64_t cursor;
+    uint64_t epoch;
+    uint64_t steps;
+    uint64_t block_count;
+    uint64_t block_stride;
+    uint64_t chunk_blocks;
+    uint64_t blocks_offset;
+    uint64_t index_capacity;
+    uint64_t index_used;
+    uint64_t index_offset;
+    uint64_t file_size;
+    uint64_t shuffle_group_rows;
+    uint64_t shuffle_window_rows;
+    uint64_t shuffle_seed;
+    int64_t shuffle_stratify;
+    uint64_t stop_patience;
+    double stop_min_delta;
+    int64_t stop_metric;
+    uint64_t stop_min_interval;
+    uint64_t stop_max_interval;
+    uint64_t stop_sample_rows;
+    double stop_best;
+    uint64_t stop_best_step;
+    uint64_t stop_bad;
+    uint64_t stop_interval;
+    uint64_t stop_next_step;
+    uint64_t stop_validations;
+} fossil_ai_train_ckpt_header_t;
+
+static fossil_ai_train_state_t* g_train_states = NULL;
+static pthread_rwlock_t g_train_registry = PTHREAD_RWLOCK_INITIALIZER;
+
+/* Reader epochs: 0 marks an idle slot, owners are claimed once per thread. */
+static atomic_uint_fast64_t g_train_epoch = 1;
+static atomic_uint_fast64_t g_train_reader_epochs[FOSSIL_AI_TRAIN_READER_SLOTS];
+static atomic_int g_train_reader_owned[FOSSIL_AI_TRAIN_READER_SLOTS];
+static pthread_key_t g_train_reader_key;
+static pthread_once_t g_train_reader_once = PTHREAD_ONCE_INIT;
+
+
+/* =========================================================
+ * Helpers
+ * ========================================================= */
+
+static fossil_ai_train_state_t* find_state_locked(void* model, fossil_ai_train_state_t** prev)
+{
+    fossil_ai_train_state_t* p = g_train_states;
+    fossil_ai_train_state_t* last = NULL;
+
+    while (p) {
+        if (p->model == model) {
+            if (prev) *prev = last;
+            return p;
+        }
+        last = p;
+        p = p->next;
+    }
+    return NULL;
+}
+
+/* Callers must not release a model while other threads still use it. */
+static fossil_ai_train_state_t* find_state(void* model, fossil_ai_train_state_t** prev)
+{
+    pthread_rwlock_rdlock(&g_train_registry);
+    fossil_ai_train_state_t* ts = find_state_locked(model, prev);
+    pthread_rwlock_unlock(&g_train_registry);
+    return ts;
+}
+
+static uint64_t train_rng_next(uint64_t* state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec t;
+#ifdef FOSSIL_AI_TRAIN_HAS_MMAP
+    clock_gettime(CLOCK_MONOTONIC, &t);
+#else
+    timespec_get(&t, TIME_UTC);
+#endif
+    return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+static size_t round_up(size_t v, size_t a)
+{
+    return (v + a - 1) / a * a;
+}
+
+static size_t row_width(const fossil_ai_train_store_t* s)
+{
+    return s->input_dim + s->output_dim;
+}
+
+static uint64_t hash_input(const fossil_ai_train_store_t* s, const float* input)
+{
+    uint64_t h = 0xCBF29CE484222325ull;
+    float res = s->resolution;
+
+    for (size_t i = 0; i < s->input_dim; ++i) {
+        int64_t q;
+        if (res > 0.0f) {
+            q = (int64_t)floorf(input[i] / res);
+        } else {
+            int32_t bits;
+            memcpy(&bits, &input[i], sizeof(bits));
+            q = bits;
+        }
+        for (int b = 0; b < 8; ++b) {
+            h ^= (uint8_t)(q >> (b * 8));
+            h *= 0x100000001B3ull;
+        }
+    }
+    return h ? h : 1;
+}
+
+static fossil_ai_train_block_t* block_at(const fossil_ai_train_store_t* s, size_t idx)
+{
+    const fossil_ai_train_chunk_t* c = s->chunks[idx / FOSSIL_AI_TRAIN_CHUNK_BLOCKS];
+    return (fossil_ai_train_block_t*)(c->data + (idx % FOSSIL_AI_TRAIN_CHUNK_BLOCKS) * s->stride);
+}
+
+static float* block_input(fossil_ai_train_block_t* b)
+{
+    return (float*)(b + 1);
+}
+
+static float* block_output(const fossil_ai_train_store_t* s, fossil_ai_train_block_t* b)
+{
+    return (float*)(b + 1) + s->input_dim;
+}
+
+static fossil_ai_train_slot_t* slot_at(const fossil_ai_train_store_t* s, size_t i)
+{
+    return &s->segments[i >> FOSSIL_AI_TRAIN_SEGMENT_SHIFT]
+                ->slots[i & (FOSSIL_AI_TRAIN_SEGMENT_SLOTS - 1)];
+}
+
+
+/* =========================================================
+ * Shared Pieces
+ * ========================================================= */
+
+static void mapping_release(fossil_ai_train_mapping_t* m)
+{
+    if (!m || atomic_fetch_sub_explicit(&m->refs, 1, memory_order_acq_rel) != 1)
+        return;
+
+#ifdef FOSSIL_AI_TRAIN_HAS_MMAP
+    munmap(m->base, m->size);
+#else
+    free(m->base);
+#endif
+    free(m);
+}
+
+static fossil_ai_train_chunk_t* chunk_new(uint8_t* data, fossil_ai_train_mapping_t* map)
+{
+    fossil_ai_train_chunk_t* c = (fossil_ai_train_chunk_t*)malloc(sizeof(*c));
+    if (!c)
+        return NULL;
+
+    c->data = data;
+    c->map = map;
+    atomic_init(&c->refs, 1);
+    if (map)
+        atomic_fetch_add_explicit(&map->refs, 1, memory_order_relaxed);
+    return c;
+}
+
+static void chunk_release(fossil_ai_train_chunk_t* c)
+{
+    if (!c || atomic_fetch_sub_explicit(&c->refs, 1, memory_order_acq_rel) != 1)
+        return;
+
+    if (c->map)
+        mapping_release(c->map);
+    else
+        free(c->data);
+    free(c);
+}
+
+static fossil_ai_train_segment_t* segment_new(fossil_ai_train_slot_t* slots,
+                                              fossil_ai_train_mapping_t* map)
+{
+    fossil_ai_train_segment_t* s = (fossil_ai_train_segment_t*)malloc(sizeof(*s));
+    if (!s)
+        return NULL;
+
+    s->slots = slots;
+    s->map = map;
+    atomic_init(&s->refs, 1);
+    if (map)
+        atomic_fetch_add_explicit(&map->refs, 1, memory_order_relaxed);
+    return s;
+}
+
+static void segment_release(fossil_ai_train_segment_t* s)
+{
+    if (!s || atomic_fetch_sub_explicit(&s->refs, 1, memory_order_acq_rel) != 1)
+        return;
+
+    if (s->map)
+        mapping_release(s->map);
+    else
+        free(s->slots);
+    free(s);
+}
+
+/* Mapped pieces are private copy-on-write mappings, so only sharing forces a copy. */
+static int chunk_own(fossil_ai_train_store_t* st, size_t c)
+{
+    fossil_ai_train_chunk_t* old = st->chunks[c];
+    if (atomic_load_explicit(&old->refs, memory_order_acquire) == 1)
+        return 0;
+
+    size_t bytes = FOSSIL_AI_TRAIN_CHUNK_BLOCKS * st->stride;
+    uint8_t* data = (uint8_t*)malloc(bytes);
+    if (!data)
+        return -2;
+    memcpy(data, old->data, bytes);
+
+    fossil_ai_train_chunk_t* fresh = chunk_new(data, NULL);
+    if (!fresh) {
+        free(data);
+        return -2;
+    }
+    st->chunks[c] = fresh;
+    chunk_release(old);
+    return 0;
+}
+
+static int segment_own(fossil_ai_train_store_t* st, size_t s)
+{
+    fossil_ai_train_segment_t* old = st->segments[s];
+    if (atomic_load_explicit(&old->refs, memory_order_acquire) == 1)
+        return 0;
+
+    fossil_ai_train_slot_t* slots = (fossil_ai_train_slot_t*)
+        malloc(FOSSIL_AI_TRAIN_SEGMENT_SLOTS * sizeof(fossil_ai_train_slot_t));
+    if (!slots)
+        return -2;
+    memcpy(slots, old->slots, FOSSIL_AI_TRAIN_SEGMENT_SLOTS * sizeof(fossil_ai_train_slot_t));
+
+    fossil_ai_train_segment_t* fresh = segment_new(slots, NULL);
+    if (!fresh) {
+        free(slots);
+        return -2;
+    }
+    st->segments[s] = fresh;
+    segment_release(old);
+    return 0;
+}
+
+
+/* =========================================================
+ * Key Index
+ * ========================================================= */
+
+static void index_free(fossil_ai_train_segment_t** segs, size_t capacity)
+{
+    if (!segs)
+        return;
+    for (size_t s = 0; s < capacity / FOSSIL_AI_TRAIN_SEGMENT_SLOTS; ++s)
+        segment_release(segs[s]);
+    free(segs);
+}
+
+static fossil_ai_train_segment_t** index_alloc(size_t capacity)
+{
+    size_t n = capacity / FOSSIL_AI_TRAIN_SEGMENT_SLOTS;
+    fossil_ai_train_segment_t** segs =
+        (fossil_ai_train_segment_t**)calloc(n, sizeof(*segs));
+    if (!segs)
+        return NULL;
+
+    for (size_t s = 0; s < n; ++s) {
+        fossil_ai_train_slot_t* slots = (fossil_ai_train_slot_t*)
+            calloc(FOSSIL_AI_TRAIN_SEGMENT_SLOTS, sizeof(fossil_ai_train_slot_t));
+        segs[s] = slots ? segment_new(slots, NULL) : NULL;
+        if (!segs[s]) {
+            free(slots);
+            index_free(segs, capacity);
+            return NULL;
+        }
+    }
+    return segs;
+}
+
+static int index_place(fossil_ai_train_store_t* st, uint64_t key, uint64_t block)
+{
+    size_t mask = st->index_capacity - 1;
+    size_t i = (size_t)key & mask;
+
+    for (;;) {
+        fossil_ai_train_slot_t* s = slot_at(st, i);
+        if (s->key == 0 || s->key == key) {
+            int rc = segment_own(st, i >> FOSSIL_AI_TRAIN_SEGMENT_SHIFT);
+            if (rc != 0)
+                return rc;
+            s = slot_at(st, i);
+            if (s->key == 0)
+                st->index_used++;
+            s->key = key;
+            s->block = block;
+            return 0;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+static int index_rebuild(fossil_ai_train_store_t* st, size_t capacity)
+{
+    fossil_ai_train_segment_t** segs = index_alloc(capacity);
+    if (!segs)
+        return -2;
+
+    fossil_ai_train_segment_t** old = st->segments;
+    size_t old_capacity = st->index_capacity;
+
+    st->segments = segs;
+    st->index_capacity = capacity;
+    st->index_used = 0;
+    for (size_t i = 0; i < st->block_count; ++i)
+        index_place(st, block_at(st, i)->key, i);
+
+    index_free(old, old_capacity);
+    st->index_ready = 1;
+    return 0;
+}
+
+/* Checkpoints may omit the index; it is then rebuilt on first use. */
+static int index_ensure(fossil_ai_train_store_t* st)
+{
+    if (st->index_ready)
+        return 0;
+
+    size_t capacity = FOSSIL_AI_TRAIN_SEGMENT_SLOTS;
+    while (capacity < st->block_count * 2)
+        capacity <<= 1;
+    return index_rebuild(st, capacity);
+}
+
+/* A resumed index is aliased unchecked, so probes are bounded and stale blocks read as misses. */
+static size_t index_find(const fossil_ai_train_store_t* st, uint64_t key)
+{
+    size_t mask = st->index_capacity - 1;
+    size_t i = (size_t)key & mask;
+
+    for (size_t probes = 0; probes < st->index_capacity; ++probes) {
+        const fossil_ai_train_slot_t* s = slot_at(st, i);
+        if (s->key == 0)
+            return SIZE_MAX;
+        if (s->key == key)
+            return s->block < st->block_count ? (size_t)s->block : SIZE_MAX;
+        i = (i + 1) & mask;
+    }
+    return SIZE_MAX;
+}
+
+static size_t index_lookup(fossil_ai_train_store_t* st, uint64_t key)
+{
+    if (index_ensure(st) != 0)
+        return SIZE_MAX;
+    return index_find(st, key);
+}
+
+static int index_insert(fossil_ai_train_store_t* st, uint64_t key, size_t block)
+{
+    int rc = index_ensure(st);
+    if (rc != 0)
+        return rc;
+
+    if ((st->index_used + 1) * 10 > st->index_capacity * 7) {
+        rc = index_rebuild(st, st->index_capacity * 2);
+        if (rc != 0)
+            return rc;
+    }
+    return index_place(st, key, block);
+}
+
+
+/* =========================================================
+ * Memory Store
+ * ========================================================= */
+
+static int store_append(fossil_ai_train_store_t* st, uint64_t key, const float* row)
+{
+    size_t idx = st->block_count;
+    size_t c = idx / FOSSIL_AI_TRAIN_CHUNK_BLOCKS;
+
+    if (c == st->chunk_count) {
+        if (st->chunk_count == st->chunk_cap) {
+            size_t cap = st->chunk_cap ? st->chunk_cap * 2 : 8;
+            fossil_ai_train_chunk_t** chunks = (fossil_ai_train_chunk_t**)
+                realloc(st->chunks, cap * sizeof(*chunks));
+            if (!chunks)
+                return -2;
+            st->chunks = chunks;
+            st->chunk_cap = cap;
+        }
+        uint8_t* data = (uint8_t*)calloc(FOSSIL_AI_TRAIN_CHUNK_BLOCKS, st->stride);
+        fossil_ai_train_chunk_t* chunk = data ? chunk_new(data, NULL) : NULL;
+        if (!chunk) {
+            free(data);
+            return -2;
+        }
+        st->chunks[c] = chunk;
+        st->chunk_count++;
+    } else {
+        int rc = chunk_own(st, c);
+        if (rc != 0)
+            return rc;
+    }
+
+    fossil_ai_train_block_t* b = block_at(st, idx);
+    b->key = key;
+    b->hits = 1;
+    b->flags = 0;
+    memcpy(block_input(b), row, row_width(st) * sizeof(float));
+
+    int rc = index_insert(st, key, idx);
+    if (rc != 0)
+        return rc;
+
+    st->block_count++;
+    return 0;
+}
+
+/*
+ * Rows are applied in three passes per tile: hash every input, resolve or
+ * insert every block, then blend revisited outputs in row order. The result
+ * matches row-at-a-time application and each pass is timed separately.
+ */
+static int apply_rows(fossil_ai_train_state_t* ts, const float* rows, size_t n,
+                      fossil_ai_train_phases_t* ph)
+{
+    fossil_ai_train_store_t* st = &ts->store;
+    size_t width = row_width(st);
+    float lr = ts->config.learning_rate;
+
+    for (size_t off = 0; off < n; off += FOSSIL_AI_TRAIN_BATCH_ROWS) {
+        size_t m = n - off < FOSSIL_AI_TRAIN_BATCH_ROWS ? n - off : FOSSIL_AI_TRAIN_BATCH_ROWS;
+        const float* tile = rows + off * width;
+        uint64_t t0 = now_ns();
+
+        for (size_t i = 0; i < m; ++i)
+            ts->keys[i] = hash_input(st, tile + i * width);
+        uint64_t t1 = now_ns();
+
+        for (size_t i = 0; i < m; ++i) {
+            size_t idx = index_lookup(st, ts->keys[i]);
+            int rc = 0;
+
+            ts->targets[i] = SIZE_MAX;
+            if (idx == SIZE_MAX) {
+                if (!ts->config.capacity || st->block_count < ts->config.capacity)
+                    rc = store_append(st, ts->keys[i], tile + i * width);
+            } else {
+                rc = chunk_own(st, idx / FOSSIL_AI_TRAIN_CHUNK_BLOCKS);
+                ts->targets[i] = idx;
+            }
+            if (rc != 0)
+                return rc;
+        }
+        uint64_t t2 = now_ns();
+
+        for (size_t i = 0; i < m; ++i) {
+            if (ts->targets[i] == SIZE_MAX)
+                continue;
+            fossil_ai_train_block_t* b = block_at(st, ts->targets[i]);
+            float* out = block_output(st, b);
+            const float* target = tile + i * width + st->input_dim;
+
+            for (size_t j = 0; j < st->output_dim; ++j)
+                out[j] += lr * (target[j] - out[j]);
+            b->hits++;
+        }
+        uint64_t t3 = now_ns();
+
+        ph->hash_ns += t1 - t0;
+        ph->insert_ns += t2 - t1;
+        ph->compute_ns += t3 - t2;
+    }
+
+    ph->rows += n;
+    return 0;
+}
+
+static void store_free(fossil_ai_train_store_t* st)
+{
+    for (size_t c = 0; c < st->chunk_count; ++c)
+        chunk_release(st->chunks[c]);
+    free(st->chunks);
+    index_free(st->segments, st->index_capacity);
+    memset(st, 0, sizeof(*st));
+}
+
+/* A snapshot shares every chunk and segment; later writes copy what they touch. */
+static fossil_ai_train_store_t* store_snapshot(fossil_ai_train_store_t* st)
+{
+    if (index_ensure(st) != 0)
+        return NULL;
+
+    fossil_ai_train_store_t* snap = (fossil_ai_train_store_t*)calloc(1, sizeof(*snap));
+    if (!snap)
+        return NULL;
+
+    *snap = *st;
+    snap->chunk_cap = st->chunk_count;
+    snap->chunks = (fossil_ai_train_chunk_t**)calloc(st->chunk_count + 1, sizeof(*snap->chunks));
+    size_t segs = st->index_capacity / FOSSIL_AI_TRAIN_SEGMENT_SLOTS;
+    snap->segments = (fossil_ai_train_segment_t**)calloc(segs + 1, sizeof(*snap->segments));
+    if (!snap->chunks || !snap->segments) {
+        free(snap->chunks);
+        free(snap->segments);
+        free(snap);
+        return NULL;
+    }
+
+    for (size_t c = 0; c < st->chunk_count; ++c) {
+        snap->chunks[c] = st->chunks[c];
+        atomic_fetch_add_explicit(&st->chunks[c]->refs, 1, memory_order_relaxed);
+    }
+    for (size_t s = 0; s < segs; ++s) {
+        snap->segments[s] = st->segments[s];
+        atomic_fetch_add_explicit(&st->segments[s]->refs, 1, memory_order_relaxed);
+    }
+    return snap;
+}
+
+
+/* =========================================================
+ * Generations
+ * ========================================================= */
+
+static void reader_slot_free(void* slot)
+{
+    size_t i = (size_t)(uintptr_t)slot - 1;
+    atomic_store(&g_train_reader_epochs[i], 0);
+    atomic_store(&g_train_reader_owned[i], 0);
+}
+
+static void reader_key_init(void)
+{
+    pthread_key_create(&g_train_reader_key, reader_slot_free);
+}
+
+static atomic_uint_fast64_t* reader_slot(void)
+{
+    pthread_once(&g_train_reader_once, reader_key_init);
+
+    uintptr_t slot = (uintptr_t)pthread_getspecific(g_train_reader_key);
+    if (slot)
+        return &g_train_reader_epochs[slot - 1];
+
+    for (size_t i = 0; i < FOSSIL_AI_TRAIN_READER_SLOTS; ++i) {
+        int expected = 0;
+        if (atomic_compare_exchange_strong(&g_train_reader_owned[i], &expected, 1)) {
+            pthread_setspecific(g_train_reader_key, (void*)(uintptr_t)(i + 1));
+            return &g_train_reader_epochs[i];
+        }
+    }
+    return NULL;
+}
+
+static fossil_ai_train_generation_t* reader_enter(fossil_ai_train_state_t* ts,
+                                                  atomic_uint_fast64_t* slot)
+{
+    atomic_store(slot, atomic_load(&g_train_epoch));
+    return atomic_load(&ts->current);
+}
+
+static void reader_exit(atomic_uint_fast64_t* slot)
+{
+    atomic_store_explicit(slot, 0, memory_order_release);
+}
+
+static void generation_free(fossil_ai_train_generation_t* g)
+{
+    store_free(g->store);
+    free(g->store);
+    free(g);
+}
+
+static void reclaim(fossil_ai_train_state_t* ts, int force)
+{
+    uint64_t oldest = UINT64_MAX;
+    for (size_t i = 0; i < FOSSIL_AI_TRAIN_READER_SLOTS && !force; ++i) {
+        uint64_t e = atomic_load(&g_train_reader_epochs[i]);
+        if (e && e < oldest)
+            oldest = e;
+    }
+
+    fossil_ai_train_generation_t** link = &ts->retired;
+    while (*link) {
+        fossil_ai_train_generation_t* g = *link;
+        if (force || g->retired_at < oldest) {
+            *link = g->next;
+            generation_free(g);
+        } else {
+            link = &g->next;
+        }
+    }
+}
+
+/* Publishes the working store; later writes copy whatever this generation shares. */
+static int publish(fossil_ai_train_state_t* ts)
+{
+    fossil_ai_train_generation_t* g =
+        (fossil_ai_train_generation_t*)calloc(1, sizeof(*g));
+    if (!g)
+        return -2;
+
+    g->store = store_snapshot(&ts->store);
+    if (!g->store) {
+        free(g);
+        return -2;
+    }
+    g->id = ++ts->generation;
+
+    fossil_ai_train_generation_t* old = atomic_exchange(&ts->current, g);
+    if (old) {
+        old->retired_at = atomic_fetch_add(&g_train_epoch, 1);
+        old->next = ts->retired;
+        ts->retired = old;
+    }
+    reclaim(ts, 0);
+    return 0;
+}
+
+/* Generations are only published per write once a reader has shown up. */
+static int publish_if_serving(fossil_ai_train_state_t* ts)
+{
+    if (!atomic_load_explicit(&ts->serving, memory_order_relaxed))
+        return 0;
+    return publish(ts);
+}
+
+static int accum_join(fossil_ai_train_state_t* ts);
+
+/*
+ * Nothing is pinned until the first reader: a published generation shares
+ * every chunk, and training alone would then copy each one it touches.
+ */
+static int serving_start(fossil_ai_train_state_t* ts)
+{
+    if (atomic_load_explicit(&ts->serving, memory_order_acquire))
+        return 0;
+
+    pthread_mutex_lock(&ts->write_lock);
+    int rc = 0;
+    if (!atomic_load_explicit(&ts->serving, memory_order_relaxed)) {
+        /* A background apply may still be writing the store. */
+        accum_join(ts);
+        rc = publish(ts);
+        if (rc == 0)
+            atomic_store_explicit(&ts->serving, 1, memory_order_release);
+    }
+    pthread_mutex_unlock(&ts->write_lock);
+    return rc;
+}
+
+
+/* =========================================================
+ * Checkpoint Resume
+ * ========================================================= */
+
+static fossil_ai_train_mapping_t* map_checkpoint(const char* path)
+{
+    fossil_ai_train_mapping_t* m = (fossil_ai_train_mapping_t*)calloc(1, sizeof(*m));
+    if (!m)
+        return NULL;
+    atomic_init(&m->refs, 1);
+
+#ifdef FOSSIL_AI_TRAIN_HAS_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        free(m);
+        return NULL;
+    }
+
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || (size_t)sb.st_size < sizeof(fossil_ai_train_ckpt_header_t)) {
+        close(fd);
+        free(m);
+        return NULL;
+    }
+
+    /* Private writable mapping: pages load on first touch and copy on first write. */
+    void* base = mmap(NULL, (size_t)sb.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        free(m);
+        return NULL;
+    }
+
+    m->base = base;
+    m->size = (size_t)sb.st_size;
+    return m;
+#else
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        free(m);
+        return NULL;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    void* buf = len >= (long)sizeof(fossil_ai_train_ckpt_header_t) ? malloc((size_t)len) : NULL;
+    if (!buf || fread(buf, 1, (size_t)len, f) != (size_t)len) {
+        free(buf);
+        fclose(f);
+        free(m);
+        return NULL;
+    }
+    fclose(f);
+
+    m->base = buf;
+    m->size = (size_t)len;
+    return m;
+#endif
+}
+
+/* Every size and offset is checked against the mapping before anything in it is aliased. */
+static int checkpoint_valid(const fossil_ai_train_ckpt_header_t* h, size_t size)
+{
+    if (memcmp(h->magic, FOSSIL_AI_TRAIN_CKPT_MAGIC, sizeof(h->magic)) != 0 ||
+        h->version != FOSSIL_AI_TRAIN_CKPT_VERSION ||
+        h->header_size != sizeof(*h) ||
+        h->file_size != size ||
+        h->chunk_blocks != FOSSIL_AI_TRAIN_CHUNK_BLOCKS ||
+        h->input_dim == 0 || h->output_dim == 0 ||
+        h->input_dim > UINT32_MAX || h->output_dim > UINT32_MAX)
+        return 0;
+
+    uint64_t stride = round_up(sizeof(fossil_ai_train_block_t)
+                               + (size_t)(h->input_dim + h->output_dim) * sizeof(float), 8);
+    if (h->block_stride != stride ||
+        (h->capacity && h->block_count > h->capacity) ||
+        h->shuffle_stratify < -1 || h->shuffle_stratify >= (int64_t)h->output_dim ||
+        (h->stop_metric != FOSSIL_AI_TRAIN_METRIC_LOSS &&
+         h->stop_metric != FOSSIL_AI_TRAIN_METRIC_HIT_RATE))
+        return 0;
+
+    uint64_t chunk_bytes = FOSSIL_AI_TRAIN_CHUNK_BLOCKS * stride;
+    if (h->blocks_offset < sizeof(*h) || h->blocks_offset % 8 || h->blocks_offset > size ||
+        h->block_count > (size - h->blocks_offset) / stride)
+        return 0;
+    uint64_t chunks = (h->block_count + FOSSIL_AI_TRAIN_CHUNK_BLOCKS - 1) / FOSSIL_AI_TRAIN_CHUNK_BLOCKS;
+    if (chunks > (size - h->blocks_offset) / chunk_bytes)
+        return 0;
+
+    if (!h->index_offset && !h->index_capacity)
+        return 1;
+    uint64_t blocks_end = h->blocks_offset + chunks * chunk_bytes;
+    return h->index_offset && h->index_capacity &&
+           (h->index_capacity & (h->index_capacity - 1)) == 0 &&
+           h->index_capacity % FOSSIL_AI_TRAIN_SEGMENT_SLOTS == 0 &&
+           h->index_offset % sizeof(uint64_t) == 0 &&
+           h->index_offset >= blocks_end && h->index_offset <= size &&
+           h->index_capacity <= (size - h->index_offset) / sizeof(fossil_ai_train_slot_t) &&
+           h->index_used <= h->index_capacity && h->index_used * 10 <= h->index_capacity * 7;
+}
+
+static int resume_state(fossil_ai_train_state_t* ts, const char* path)
+{
+    ts->map = map_checkpoint(path);
+    if (!ts->map)
+        return -1;
+
+    fossil_ai_train_store_t* st = &ts->store;
+    const fossil_ai_train_ckpt_header_t* h = (const fossil_ai_train_ckpt_header_t*)ts->map->base;
+    uint8_t* base = (uint8_t*)ts->map->base;
+
+    if (!checkpoint_valid(h, ts->map->size))
+        return -3;
+
+    ts->config.input_dim = (size_t)h->input_dim;
+    ts->config.output_dim = (size_t)h->output_dim;
+    ts->config.capacity = (size_t)h->capacity;
+    ts->config.learning_rate = h->learning_rate;
+    ts->config.resolution = h->resolution;
+    ts->config.seed = h->seed;
+    ts->rng = h->rng;
+    ts->cursor = h->cursor;
+    ts->epoch = h->epoch;
+    ts->steps = h->steps;
+    ts->shuffle.group_rows = (size_t)h->shuffle_group_rows;
+    ts->shuffle.window_rows = (size_t)h->shuffle_window_rows;
+    ts->shuffle.seed = h->shuffle_seed;
+    ts->shuffle.stratify_output = (int)h->shuffle_stratify;
+    ts->shuffle.stratify = h->shuffle_stratify >= 0;
+    ts->config.early_stop.patience = (size_t)h->stop_patience;
+    ts->config.early_stop.min_delta = h->stop_min_delta;
+    ts->config.early_stop.metric = (int)h->stop_metric;
+    ts->config.early_stop.min_interval = h->stop_min_interval;
+    ts->config.early_stop.max_interval = h->stop_max_interval;
+    ts->config.early_stop.sample_rows = (size_t)h->stop_sample_rows;
+    ts->stop.best = h->stop_best;
+    ts->stop.best_step = h->stop_best_step;
+    ts->stop.bad = (size_t)h->stop_bad;
+    ts->stop.interval = h->stop_interval;
+    ts->stop.next_step = h->stop_next_step;
+    ts->stop.validations = h->stop_validations;
+
+    st->input_dim = ts->config.input_dim;
+    st->output_dim = ts->config.output_dim;
+    st->resolution = ts->config.resolution;
+    st->stride = (size_t)h->block_stride;
+
+    size_t chunks = ((size_t)h->block_count + FOSSIL_AI_TRAIN_CHUNK_BLOCKS - 1)
+                  / FOSSIL_AI_TRAIN_CHUNK_BLOCKS;
+    size_t chunk_bytes = FOSSIL_AI_TRAIN_CHUNK_BLOCKS * st->stride;
+
+    st->chunk_cap = chunks ? chunks : 8;
+    st->chunks = (fossil_ai_train_chunk_t**)calloc(st->chunk_cap, sizeof(*st->chunks));
+    if (!st->chunks)
+        return -2;
+    for (size_t c = 0; c < chunks; ++c) {
+        st->chunks[c] = chunk_new(base + h->blocks_offset + c * chunk_bytes, ts->map);
+        if (!st->chunks[c])
+            return -2;
+        st->chunk_count++;
+    }
+    st->block_count = (size_t)h->block_count;
+
+    /* The stored index is aliased segment by segment; nothing is rehashed here. */
+    if (h->index_capacity) {
+        size_t n = (size_t)h->index_capacity / FOSSIL_AI_TRAIN_SEGMENT_SLOTS;
+        st->segments = (fossil_ai_train_segment_t**)calloc(n, sizeof(*st->segments));
+        if (!st->segments)
+            return -2;
+        st->index_capacity = (size_t)h->index_capacity;
+        for (size_t s = 0; s < n; ++s) {
+            st->segments[s] = segment_new((fossil_ai_train_slot_t*)(base + h->index_offset)
+                                          + s * FOSSIL_AI_TRAIN_SEGMENT_SLOTS, ts->map);
+            if (!st->segments[s])
+                return -2;
+        }
+        st->index_used = (size_t)h->index_used;
+        st->index_ready = 1;
+    }
+    return 0;
+}
+
+
+/* =========================================================
+ * Validation
+ * ========================================================= */
+
+typedef struct fossil_ai_train_partial {
+    const fossil_ai_train_store_t* store;
+    const float* data;
+    const size_t* picks;    /* sampled row indices, NULL for a contiguous range */
+    size_t begin;
+    size_t end;
+    double loss;
+    double loss_sq;
+    size_t hits;
+} fossil_ai_train_partial_t;
+
+static void score_rows(fossil_ai_train_partial_t* p)
+{
+    const fossil_ai_train_store_t* st = p->store;
+    size_t width = row_width(st);
+    size_t outs = st->output_dim;
+
+    for (size_t i = p->begin; i < p->end; ++i) {
+        const float* row = p->data + (p->picks ? p->picks[i] : i) * width;
+        const float* target = row + st->input_dim;
+        size_t idx = index_find(st, hash_input(st, row));
+        const float* pred = NULL;
+
+        if (idx != SIZE_MAX && idx < st->block_count) {
+            pred = block_output(st, block_at(st, idx));
+            p->hits++;
+        }
+
+        double err = 0.0;
+        for (size_t j = 0; j < outs; ++j) {
+            double d = (double)target[j] - (pred ? (double)pred[j] : 0.0);
+            err += d * d;
+        }
+        err /= (double)outs;
+        p->loss += err;
+        p->loss_sq += err * err;
+    }
+}
+
+static void* score_worker(void* arg)
+{
+    score_rows((fossil_ai_train_partial_t*)arg);
+    return NULL;
+}
+
+static size_t online_workers(void)
+{
+#ifdef FOSSIL_AI_TRAIN_HAS_MMAP
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (size_t)n : 1;
+#else
+    return 1;
+#endif
+}
+
+/* Partials are reduced in worker order so results do not depend on scheduling. */
+static void score_store(const fossil_ai_train_store_t* st, const float* data, size_t rows,
+                        const size_t* picks, size_t workers, double z,
+                        fossil_ai_train_metrics_t* out)
+{
+    fossil_ai_train_partial_t parts[FOSSIL_AI_TRAIN_MAX_WORKERS];
+    pthread_t threads[FOSSIL_AI_TRAIN_MAX_WORKERS];
+    int started[FOSSIL_AI_TRAIN_MAX_WORKERS];
+
+    if (workers == 0)
+        workers = 1;
+    if (workers > FOSSIL_AI_TRAIN_MAX_WORKERS)
+        workers = FOSSIL_AI_TRAIN_MAX_WORKERS;
+    if (workers > rows)
+        workers = rows ? rows : 1;
+
+    for (size_t w = 0; w < workers; ++w) {
+        memset(&parts[w], 0, sizeof(parts[w]));
+        parts[w].store = st;
+        parts[w].data = data;
+        parts[w].picks = picks;
+        parts[w].begin = rows * w / workers;
+        parts[w].end = rows * (w + 1) / workers;
+        started[w] = w > 0 && pthread_create(&threads[w], NULL, score_worker, &parts[w]) == 0;
+        if (w > 0 && !started[w])
+            score_rows(&parts[w]);
+    }
+    score_rows(&parts[0]);
+
+    double loss = 0.0, loss_sq = 0.0;
+    size_t hits = 0;
+    for (size_t w = 0; w < workers; ++w) {
+        if (w > 0 && started[w])
+            pthread_join(threads[w], NULL);
+        loss += parts[w].loss;
+        loss_sq += parts[w].loss_sq;
+        hits += parts[w].hits;
+    }
+
+    double n = rows ? (double)rows : 1.0;
+    out->loss = loss / n;
+    out->hit_rate = (double)hits / n;
+    out->rows = rows;
+    out->sampled = picks != NULL;
+    out->loss_ci = 0.0;
+    out->hit_rate_ci = 0.0;
+
+    if (picks && rows > 1) {
+        double var = (loss_sq - loss * loss / n) / (n - 1.0);
+        double p = out->hit_rate;
+        out->loss_ci = z * sqrt(var > 0.0 ? var / n : 0.0);
+        out->hit_rate_ci = z * sqrt(p * (1.0 - p) / n);
+    }
+}
+
+static void* validate_job(void* arg)
+{
+    fossil_ai_train_job_t* job = (fossil_ai_train_job_t*)arg;
+    fossil_ai_train_metrics_t m;
+    size_t* picks = NULL;
+    size_t rows = job->rows;
+
+    memset(&m, 0, sizeof(m));
+    if (job->options.sample_rows && job->options.sample_rows < job->rows) {
+        uint64_t rng = job->seed ^ (job->step * 0xD1B54A32D192ED03ull);
+        rows = job->options.sample_rows;
+        picks = (size_t*)malloc(rows * sizeof(*picks));
+        if (picks) {
+            for (size_t i = 0; i < rows; ++i)
+                picks[i] = (size_t)(train_rng_next(&rng) % job->rows);
+        } else {
+            rows = job->rows;
+        }
+    }
+
+    score_store(job->snapshot, job->data, rows, picks, job->options.workers,
+                job->options.z > 0.0 ? job->options.z : 1.96, &m);
+    m.step = job->step;
+    free(picks);
+
+    pthread_mutex_lock(&job->owner->lock);
+    job->owner->metrics = m;
+    pthread_mutex_unlock(&job->owner->lock);
+
+    if (job->options.on_done)
+        job->options.on_done(job->model, &m, job->options.user);
+
+    store_free(job->snapshot);
+    free(job->snapshot);
+    job->snapshot = NULL;
+    atomic_store_explicit(&job->done, 1, memory_order_release);
+    return NULL;
+}
+
+static void job_join(fossil_ai_train_state_t* ts)
+{
+    if (!ts->job)
+        return;
+    pthread_join(ts->job->thread, NULL);
+    free(ts->job);
+    ts->job = NULL;
+}
+
+static void validation_source(const fossil_ai_train_state_t* ts, const float** data, size_t* rows)
+{
+    if (ts->holdout) {
+        *data = ts->holdout;
+        *rows = ts->holdout_rows;
+    } else {
+        *data = ts->data;
+        *rows = ts->rows;
+    }
+}
+
+
+/* =========================================================
+ * Shuffle Engine
+ * ========================================================= */
+
+static uint64_t mix64(uint64_t a, uint64_t b)
+{
+    uint64_t s = a ^ (b * 0x9E3779B97F4A7C15ull);
+    return train_rng_next(&s);
+}
+
+static void shuffle_free(fossil_ai_train_state_t* ts)
+{
+    free(ts->group_perm);
+    free(ts->window_perm);
+    free(ts->order);
+    free(ts->alias_prob);
+    free(ts->alias_idx);
+    ts->group_perm = NULL;
+    ts->window_perm = NULL;
+    ts->order = NULL;
+    ts->alias_prob = NULL;
+    ts->alias_idx = NULL;
+    ts->group_epoch = 0;
+    ts->window_id = 0;
+    ts->order_epoch = 0;
+}
+
+static void permute(size_t* v, size_t n, uint64_t rng)
+{
+    for (size_t i = 0; i < n; ++i)
+        v[i] = i;
+    for (size_t i = n; i > 1; --i) {
+        size_t j = (size_t)(train_rng_next(&rng) % i);
+        size_t t = v[i - 1];
+        v[i - 1] = v[j];
+        v[j] = t;
+    }
+}
+
+static size_t group_rows(const fossil_ai_train_state_t* ts)
+{
+    size_t g = ts->shuffle.group_rows;
+    return g && g < ts->rows ? g : ts->rows;
+}
+
+/* Walker alias table so each weighted draw costs O(1). */
+static int alias_build(fossil_ai_train_state_t* ts)
+{
+    size_t n = ts->rows;
+    const float* w = ts->shuffle.weights;
+    double sum = 0.0;
+
+    for (size_t i = 0; i < n; ++i)
+        sum += w[i] > 0.0f ? (double)w[i] : 0.0;
+    if (sum <= 0.0)
+        return -1;
+
+    ts->alias_prob = (double*)malloc(n * sizeof(double));
+    ts->alias_idx = (size_t*)malloc(n * sizeof(size_t));
+    size_t* work = (size_t*)malloc(n * sizeof(size_t));
+    if (!ts->alias_prob || !ts->alias_idx || !work) {
+        free(ts->alias_prob);
+        free(ts->alias_idx);
+        free(work);
+        ts->alias_prob = NULL;
+        ts->alias_idx = NULL;
+        return -2;
+    }
+
+    size_t small = 0, large = n;
+    for (size_t i = 0; i < n; ++i) {
+        ts->alias_prob[i] = (w[i] > 0.0f ? (double)w[i] : 0.0) * (double)n / sum;
+        ts->alias_idx[i] = i;
+        if (ts->alias_prob[i] < 1.0)
+            work[small++] = i;
+        else
+            work[--large] = i;
+    }
+    while (small && large < n) {
+        size_t s = work[--small];
+        size_t l = work[large];
+        ts->alias_idx[s] = l;
+        ts->alias_prob[l] -= 1.0 - ts->alias_prob[s];
+        if (ts->alias_prob[l] < 1.0) {
+            large++;
+            work[small++] = l;
+        }
+    }
+    while (small)
+        ts->alias_prob[work[--small]] = 1.0;
+    while (large < n)
+        ts->alias_prob[work[large++]] = 1.0;
+
+    free(work);
+    return 0;
+}
+
+/* Maps an epoch position through the window shuffle and the group permutation. */
+static size_t block_order(fossil_ai_train_state_t* ts, size_t pos)
+{
+    size_t rows = ts->rows;
+    size_t win = ts->shuffle.window_rows;
+    size_t q = pos;
+
+    if (win > 1) {
+        size_t w = pos / win;
+        size_t base = w * win;
+        size_t len = rows - base < win ? rows - base : win;
+        uint64_t id = ((ts->epoch << 32) ^ (uint64_t)w) + 1;
+
+        if (ts->window_id != id) {
+            permute(ts->window_perm, len,
+                    mix64(mix64(ts->shuffle.seed, ts->epoch), (uint64_t)w + 1));
+            ts->window_id = id;
+        }
+        q = base + ts->window_perm[pos - base];
+    }
+
+    size_t g = group_rows(ts);
+    size_t groups = (rows + g - 1) / g;
+    if (groups < 2)
+        return q;
+
+    if (ts->group_epoch != ts->epoch + 1) {
+        permute(ts->group_perm, groups, mix64(ts->shuffle.seed, ts->epoch));
+        ts->group_epoch = ts->epoch + 1;
+        for (size_t i = 0; i < groups; ++i) {
+            if (ts->group_perm[i] == groups - 1)
+                ts->group_last = i;
+        }
+    }
+
+    /* Only the last physical group can be short. */
+    size_t last = rows - (groups - 1) * g;
+    size_t pp = ts->group_last;
+
+    size_t k, off;
+    if (q < pp * g) {
+        k = q / g;
+        off = q % g;
+    } else if (q < pp * g + last) {
+        k = pp;
+        off = q - pp * g;
+    } else {
+        size_t r = q - pp * g - last;
+        k = pp + 1 + r / g;
+        off = r % g;
+    }
+    return ts->group_perm[k] * g + off;
+}
+
+static int stratum_cmp(const void* a, const void* b)
+{
+    const int64_t* x = (const int64_t*)a;
+    const int64_t* y = (const int64_t*)b;
+    if (x[0] != y[0])
+        return x[0] < y[0] ? -1 : 1;
+    return (x[1] > y[1]) - (x[1] < y[1]);
+}
+
+/*
+ * Stratified order: the block-shuffled order split by stratum, then merged
+ * so every prefix holds each stratum close to its share of the epoch.
+ */
+static int order_build(fossil_ai_train_state_t* ts)
+{
+    size_t rows = ts->rows;
+    size_t width = row_width(&ts->store);
+    size_t col = ts->store.input_dim + (size_t)ts->shuffle.stratify_output;
+    int64_t* keyed = (int64_t*)malloc(rows * 2 * sizeof(int64_t));
+    if (!keyed)
+        return -2;
+
+    for (size_t i = 0; i < rows; ++i) {
+        size_t phys = block_order(ts, i);
+        keyed[2 * i] = (int64_t)lroundf(ts->data[phys * width + col]);
+        keyed[2 * i + 1] = (int64_t)phys;
+    }
+    qsort(keyed, rows, 2 * sizeof(int64_t), stratum_cmp);
+
+    /* Physical rows inside a stratum keep their block-shuffled position order. */
+    size_t strata = 0;
+    for (size_t i = 0; i < rows; ++i) {
+        if (i == 0 || keyed[2 * i] != keyed[2 * (i - 1)])
+            strata++;
+    }
+
+    size_t* begin = (size_t*)malloc((strata + 1) * sizeof(size_t));
+    size_t* taken = (size_t*)calloc(strata, sizeof(size_t));
+    size_t* seq = (size_t*)malloc(rows * sizeof(size_t));
+    if (!begin || !taken || !seq) {
+        free(begin);
+        free(taken);
+        free(seq);
+        free(keyed);
+        return -2;
+    }
+
+    for (size_t i = 0, s = 0; i < rows; ++i) {
+        if (i == 0 || keyed[2 * i] != keyed[2 * (i - 1)])
+            begin[s++] = i;
+    }
+    begin[strata] = rows;
+
+    /* Recover the shuffled sequence for each stratum from the position order. */
+    size_t* pos_of = (size_t*)malloc(rows * sizeof(size_t));
+    if (!pos_of) {
+        free(begin);
+        free(taken);
+        free(seq);
+        free(keyed);
+        return -2;
+    }
+    for (size_t i = 0; i < rows; ++i)
+        pos_of[block_order(ts, i)] = i;
+    for (size_t s = 0; s < strata; ++s) {
+        for (size_t i = begin[s]; i < begin[s + 1]; ++i)
+            keyed[2 * i + 1] = (int64_t)pos_of[(size_t)keyed[2 * i + 1]];
+        qsort(keyed + 2 * begin[s], begin[s + 1] - begin[s], 2 * sizeof(int64_t), stratum_cmp);
+    }
+    free(pos_of);
+
+    for (size_t t = 0; t < rows; ++t) {
+        size_t best = 0;
+        double deficit = -1e300;
+        for (size_t s = 0; s < strata; ++s) {
+            size_t n = begin[s + 1] - begin[s];
+            if (taken[s] == n)
+                continue;
+            double d = (double)(t + 1) * (double)n / (double)rows - (double)taken[s];
+            if (d > deficit) {
+                deficit = d;
+                best = s;
+            }
+        }
+        size_t at = begin[best] + taken[best]++;
+        seq[t] = block_order(ts, (size_t)keyed[2 * at + 1]);
+    }
+
+    free(ts->order);
+    ts->order = seq;
+    ts->order_epoch = ts->epoch + 1;
+    free(begin);
+    free(taken);
+    free(keyed);
+    return 0;
+}
+
+static int shuffle_active(const fossil_ai_train_state_t* ts)
+{
+    const fossil_ai_train_shuffle_t* s = &ts->shuffle;
+    return s->weights || s->stratify_output >= 0 || s->window_rows > 1 ||
+           (s->group_rows && s->group_rows < ts->rows);
+}
+
+static int shuffle_prepare(fossil_ai_train_state_t* ts)
+{
+    size_t width = row_width(&ts->store);
+    size_t g = group_rows(ts);
+
+    if (!ts->gather) {
+        ts->gather = (float*)malloc(FOSSIL_AI_TRAIN_BATCH_ROWS * width * sizeof(float));
+        if (!ts->gather)
+            return -2;
+    }
+    if (!ts->group_perm) {
+        ts->group_perm = (size_t*)malloc(((ts->rows + g - 1) / g) * sizeof(size_t));
+        if (!ts->group_perm)
+            return -2;
+    }
+    if (!ts->window_perm && ts->shuffle.window_rows > 1) {
+        ts->window_perm = (size_t*)malloc(ts->shuffle.window_rows * sizeof(size_t));
+        if (!ts->window_perm)
+            return -2;
+    }
+    if (ts->shuffle.weights && !ts->alias_prob)
+        return alias_build(ts);
+    if (ts->shuffle.stratify_output >= 0 && ts->order_epoch != ts->epoch + 1)
+        return order_build(ts);
+    return 0;
+}
+
+static size_t shuffle_row(fossil_ai_train_state_t* ts, size_t pos)
+{
+    if (ts->shuffle.weights) {
+        /* The column and the coin come from separate draws so they are independent. */
+        uint64_t base = mix64(ts->shuffle.seed, ts->epoch);
+        size_t i = (size_t)(mix64(base, 2 * (uint64_t)pos + 1) % ts->rows);
+        double u = (double)(mix64(base, 2 * (uint64_t)pos + 2) >> 11) * (1.0 / 9007199254740992.0);
+        return u < ts->alias_prob[i] ? i : ts->alias_idx[i];
+    }
+    if (ts->order)
+        return ts->order[pos];
+    return block_order(ts, pos);
+}
+
+/*
+ * Returns the next run of attached rows, advancing the loader. Sequential
+ * order is zero-copy; shuffled orders gather up to one tile of rows.
+ */
+static const float* next_rows(fossil_ai_train_state_t* ts, size_t want, size_t* got)
+{
+    if (ts->cursor >= ts->rows) {
+        ts->cursor = 0;
+        ts->epoch++;
+    }
+
+    size_t n = ts->rows - (size_t)ts->cursor;
+    if (n > want)
+        n = want;
+    size_t width = row_width(&ts->store);
+
+    if (!shuffle_active(ts)) {
+        const float* p = ts->data + (size_t)ts->cursor * width;
+        ts->cursor += n;
+        *got = n;
+        return p;
+    }
+
+    *got = 0;
+    if (shuffle_prepare(ts) != 0)
+        return NULL;
+    if (n > FOSSIL_AI_TRAIN_BATCH_ROWS)
+        n = FOSSIL_AI_TRAIN_BATCH_ROWS;
+
+    for (size_t i = 0; i < n; ++i) {
+        size_t phys = shuffle_row(ts, (size_t)ts->cursor + i);
+        memcpy(ts->gather + i * width, ts->data + phys * width, width * sizeof(float));
+    }
+    ts->cursor += n;
+    *got = n;
+    return ts->gather;
+}
+
+int fossil_ai_train_shuffle_set(void* model, const fossil_ai_train_shuffle_t* shuffle)
+{
+    fossil_ai_train_state_t* ts = find_state(model, NULL);
+    if (!ts)
+        return -1;
+
+    pthread_mutex_lock(&ts->write_lock);
+    int rc = 0;
+    if (shuffle && shuffle->stratify &&
+        (shuffle->stratify_output < 0 || shuffle->stratify_output >= (int)ts->store.output_dim)) {
+        rc = -1;
+    } else {
+        shuffle_free(ts);
+        if (shuffle)
+            ts->shuffle = *shuffle;
+        else
+            memset(&ts->shuffle, 0, sizeof(ts->shuffle));
+        /* Internally the column alone says whether to stratify, as in checkpoints. */
+        if (!ts->shuffle.stratify)
+            ts->shuffle.stratify_output = -1;
+    }
+    pthread_mutex_unlock(&ts->write_lock);
+    return rc;
+}
+
+/* =========================================================
+ * Deduplication
+ * ========================================================= */
+
+typedef struct fossil_ai_train_dedup_part {
+    const fossil_ai_train_state_t* ts;
+    const fossil_ai_train_dedup_t* opt;
+    uint64_t* hashes;
+    uint32_t* sigs;
+    uint8_t* drop;
+    size_t begin;
+    size_t end;
+    size_t shard;
+    size_t shards;
+    int rc;
+} fossil_ai_train_dedup_part_t;
+
+static uint64_t hash_row(const float* row, size_t width)
+{
+    const uint8_t* b = (const uint8_t*)row;
+    uint64_t h = 0xCBF29CE484222325ull;
+
+    for (size_t i = 0; i < width * sizeof(float); ++i) {
+        h ^= b[i];
+        h *= 0x100000001B3ull;
+    }
+    return h;
+}
+
+static size_t dedup_sig_len(const fossil_ai_train_dedup_t* d)
+{
+    return (d->bands ? d->bands : 16) * (d->band_rows ? d->band_rows : 4);
+}
+
+static void* dedup_hash_worker(void* arg)
+{
+    fossil_ai_train_dedup_part_t* p = (fossil_ai_train_dedup_part_t*)arg;
+    size_t width = row_width(&p->ts->store);
+
+    for (size_t i = p->begin; i < p->end; ++i)
+        p->hashes[i] = hash_row(p->ts->data + i * width, width);
+    return NULL;
+}
+
+/*
+ * Each worker owns the rows whose hash falls in its shard and scans them
+ * in row order, so the first copy is kept no matter how work is scheduled.
+ */
+static void* dedup_exact_worker(void* arg)
+{
+    fossil_ai_train_dedup_part_t* p = (fossil_ai_train_dedup_part_t*)arg;
+    const fossil_ai_train_state_t* ts = p->ts;
+    size_t width = row_width(&ts->store);
+    size_t count = 0;
+
+    for (size_t i = 0; i < ts->rows; ++i)
+        count += p->hashes[i] % p->shards == p->shard;
+
+    size_t cap = 16;
+    while (cap < count * 2)
+        cap <<= 1;
+    size_t* table = (size_t*)calloc(cap, sizeof(size_t));
+    if (!table) {
+        p->rc = -2;
+        return NULL;
+    }
+
+    for (size_t i = 0; i < ts->rows; ++i) {
+        uint64_t h = p->hashes[i];
+        if (h % p->shards != p->shard)
+            continue;
+        size_t slot = (size_t)(h >> 17) & (cap - 1);
+        for (;;) {
+            size_t at = table[slot];
+            if (at == 0) {
+                table[slot] = i + 1;
+                break;
+            }
+            if (p->hashes[at - 1] == h &&
+                memcmp(ts->data + (at - 1) * width, ts->data + i * width,
+                       width * sizeof(float)) == 0) {
+                p->drop[i] = 1;
+                break;
+            }
+            slot = (slot + 1) & (cap - 1);
+        }
+    }
+    free(table);
+    return NULL;
+}
+
+/* Tokens are (dimension, bucket) pairs, so Jaccard is the share of matching buckets. */
+static void* dedup_minhash_worker(void* arg)
+{
+    fossil_ai_train_dedup_part_t* p = (fossil_ai_train_dedup_part_t*)arg;
+    const fossil_ai_train_store_t* st = &p->ts->store;
+    size_t width = row_width(st);
+    size_t k = dedup_sig_len(p->opt);
+    float q = p->opt->quantum > 0.0f ? p->opt->quantum : st->resolution;
+
+    for (size_t i = p->begin; i < p->end; ++i) {
+        uint32_t* sig = p->sigs + i * k;
+        if (p->drop[i])
+            continue;
+        for (size_t h = 0; h < k; ++h)
+            sig[h] = UINT32_MAX;
+        const float* row = p->ts->data + i * width;
+        for (size_t j = 0; j < st->input_dim; ++j) {
+            int64_t b = q > 0.0f ? (int64_t)floorf(row[j] / q) : (int64_t)lroundf(row[j]);
+            uint64_t tok = mix64((uint64_t)j + 1, (uint64_t)b);
+            for (size_t h = 0; h < k; ++h) {
+                uint32_t v = (uint32_t)(mix64(tok, (uint64_t)h + 1) >> 32);
+                if (v < sig[h])
+                    sig[h] = v;
+            }
+        }
+    }
+    return NULL;
+}
+
+static int dedup_run(fossil_ai_train_dedup_part_t* parts, size_t workers, void* (*fn)(void*))
+{
+    pthread_t threads[FOSSIL_AI_TRAIN_MAX_WORKERS];
+    int started[FOSSIL_AI_TRAIN_MAX_WORKERS];
+    int rc = 0;
+
+    for (size_t w = 1; w < workers; ++w) {
+        started[w] = pthread_create(&threads[w], NULL, fn, &parts[w]) == 0;
+        if (!started[w])
+            fn(&parts[w]);
+    }
+    fn(&parts[0]);
+    for (size_t w = 0; w < workers; ++w) {
+        if (w > 0 && started[w])
+            pthread_join(threads[w], NULL);
+        if (parts[w].rc != 0)
+            rc = parts[w].rc;
+    }
+    return rc;
+}
+
+static int band_cmp(const void* a, const void* b)
+{
+    const uint64_t* x = (const uint64_t*)a;
+    const uint64_t* y = (const uint64_t*)b;
+    if (x[0] != y[0])
+        return x[0] < y[0] ? -1 : 1;
+    return (x[1] > y[1]) - (x[1] < y[1]);
+}
+
+/* Rows sharing a band bucket are checked against up to eight kept rows of that bucket. */
+static int dedup_near(fossil_ai_train_state_t* ts, const uint32_t* sigs, uint8_t* drop,
+                      fossil_ai_train_dedup_stats_t* st)
+{
+    const fossil_ai_train_dedup_t* d = &ts->dedup;
+    size_t bands = d->bands ? d->bands : 16;
+    size_t r = d->band_rows ? d->band_rows : 4;
+    size_t k = bands * r;
+    double need = d->similarity > 0.0f ? (double)d->similarity : 0.9;
+    uint64_t* keyed = (uint64_t*)malloc(ts->rows * 2 * sizeof(uint64_t));
+    if (!keyed)
+        return -2;
+
+    for (size_t b = 0; b < bands; ++b) {
+        size_t n = 0;
+        for (size_t i = 0; i < ts->rows; ++i) {
+            if (drop[i])
+                continue;
+            uint64_t h = 0xCBF29CE484222325ull ^ b;
+            for (size_t j = 0; j < r; ++j)
+                h = mix64(h, sigs[i * k + b * r + j]);
+            keyed[2 * n] = h;
+            keyed[2 * n + 1] = i;
+            n++;
+        }
+        qsort(keyed, n, 2 * sizeof(uint64_t), band_cmp);
+
+        for (size_t g = 0; g < n;) {
+            size_t e = g + 1;
+            while (e < n && keyed[2 * e] == keyed[2 * g])
+                e++;
+            size_t reps[8];
+            size_t nreps = 0;
+            for (size_t a = g; a < e; ++a) {
+                size_t row = (size_t)keyed[2 * a + 1];
+                int dup = 0;
+                for (size_t x = 0; x < nreps && !dup; ++x) {
+                    size_t same = 0;
+                    for (size_t h = 0; h < k; ++h)
+                        same += sigs[reps[x] * k + h] == sigs[row * k + h];
+                    st->candidates++;
+                    dup = (double)same >= need * (double)k;
+                }
+                if (dup) {
+                    drop[row] = 2;
+                    st->near_dups++;
+                } else if (nreps < 8) {
+                    reps[nreps++] = row;
+                }
+            }
+            g = e;
+        }
+    }
+    free(keyed);
+    return 0;
+}
+
+/* Filters the attached rows into an owned, compacted copy. */
+static int dedup_rows(fossil_ai_train_state_t* ts)
+{
+    fossil_ai_train_dedup_part_t parts[FOSSIL_AI_TRAIN_MAX_WORKERS];
+    fossil_ai_train_dedup_stats_t st;
+    const fossil_ai_train_dedup_t* d = &ts->dedup;
+    size_t rows = ts->rows;
+    size_t width = row_width(&ts->store);
+    size_t workers = d->workers ? d->workers : online_workers();
+    uint64_t start = now_ns();
+    int rc = 0;
+
+    if (workers > FOSSIL_AI_TRAIN_MAX_WORKERS)
+        workers = FOSSIL_AI_TRAIN_MAX_WORKERS;
+    if (workers > rows)
+        workers = rows;
+
+    memset(&st, 0, sizeof(st));
+    st.rows_in = rows;
+    uint8_t* drop = (uint8_t*)calloc(rows, 1);
+    uint64_t* hashes = d->exact ? (uint64_t*)malloc(rows * sizeof(uint64_t)) : NULL;
+    uint32_t* sigs = d->near ? (uint32_t*)malloc(rows * dedup_sig_len(d) * sizeof(uint32_t)) : NULL;
+    if (!drop || (d->exact && !hashes) || (d->near && !sigs)) {
+        rc = -2;
+        goto done;
+    }
+
+    for (size_t w = 0; w < workers; ++w) {
+        memset(&parts[w], 0, sizeof(parts[w]));
+        parts[w].ts = ts;
+        parts[w].opt = d;
+        parts[w].hashes = hashes;
+        parts[w].sigs = sigs;
+        parts[w].drop = drop;
+        parts[w].begin = rows * w / workers;
+        parts[w].end = rows * (w + 1) / workers;
+        parts[w].shard = w;
+        parts[w].shards = workers;
+    }
+
+    if (d->exact) {
+        dedup_run(parts, workers, dedup_hash_worker);
+        rc = dedup_run(parts, workers, dedup_exact_worker);
+        if (rc != 0)
+            goto done;
+        for (size_t i = 0; i < rows; ++i)
+            st.exact_dups += drop[i];
+    }
+    if (d->near) {
+        dedup_run(parts, workers, dedup_minhash_worker);
+        rc = dedup_near(ts, sigs, drop, &st);
+        if (rc != 0)
+            goto done;
+    }
+
+    st.rows_kept = rows - st.exact_dups - st.near_dups;
+    if (st.rows_kept < rows) {
+        ts->kept = (float*)malloc(st.rows_kept * width * sizeof(float));
+        if (!ts->kept) {
+            rc = -2;
+            goto done;
+        }
+        size_t n = 0;
+        for (size_t i = 0; i < rows; ++i) {
+            if (!drop[i])
+                memcpy(ts->kept + (n++) * width, ts->data + i * width, width * sizeof(float));
+        }
+        ts->data = ts->kept;
+        ts->rows = n;
+    }
+
+done:
+    if (rc != 0) {
+        ts->data = NULL;
+        ts->rows = 0;
+    }
+    st.elapsed_ns = now_ns() - start;
+    ts->dedup_stats = st;
+    free(drop);
+    free(hashes);
+    free(sigs);
+    return rc;
+}
+
+/* =========================================================
+ * Accumulation
+ * ========================================================= */
+
+static void accum_buf_free(fossil_ai_train_accum_buf_t* b)
+{
+    free(b->slots);
+    free(b->keys);
+    free(b->counts);
+    free(b->rows);
+    memset(b, 0, sizeof(*b));
+}
+
+static void accum_buf_clear(fossil_ai_train_accum_buf_t* b)
+{
+    if (b->n)
+        memset(b->slots, 0, b->cap * sizeof(size_t));
+    b->n = 0;
+}
+
+static size_t accum_slot(const fossil_ai_train_accum_buf_t* b, uint64_t key)
+{
+    size_t i = (size_t)(key >> 7) & (b->cap - 1);
+    while (b->slots[i] && b->keys[b->slots[i] - 1] != key)
+        i = (i + 1) & (b->cap - 1);
+    return i;
+}
+
+static int accum_grow(fossil_ai_train_accum_buf_t* b, size_t width)
+{
+    if (b->n == b->entry_cap) {
+        size_t cap = b->entry_cap ? b->entry_cap * 2 : 256;
+        uint64_t* keys = (uint64_t*)realloc(b->keys, cap * sizeof(uint64_t));
+        if (keys)
+            b->keys = keys;
+        uint32_t* counts = (uint32_t*)realloc(b->counts, cap * sizeof(uint32_t));
+        if (counts)
+            b->counts = counts;
+        float* rows = (float*)realloc(b->rows, cap * width * sizeof(float));
+        if (rows)
+            b->rows = rows;
+        if (!keys || !counts || !rows)
+            return -2;
+        b->entry_cap = cap;
+    }
+
+    if ((b->n + 1) * 10 > b->cap * 7) {
+        size_t cap = b->cap ? b->cap * 2 : 512;
+        size_t* slots = (size_t*)calloc(cap, sizeof(size_t));
+        if (!slots)
+            return -2;
+        free(b->slots);
+        b->slots = slots;
+        b->cap = cap;
+        for (size_t e = 0; e < b->n; ++e)
+            b->slots[accum_slot(b, b->keys[e])] = e + 1;
+    }
+    return 0;
+}
+
+static int accum_add(fossil_ai_train_accum_buf_t* b, size_t in, size_t width,
+                     uint64_t key, const float* row, uint32_t count)
+{
+    int rc = accum_grow(b, width);
+    if (rc != 0)
+        return rc;
+
+    size_t slot = accum_slot(b, key);
+    if (!b->slots[slot]) {
+        b->keys[b->n] = key;
+        b->counts[b->n] = count;
+        memcpy(b->rows + b->n * width, row, width * sizeof(float));
+        b->slots[slot] = ++b->n;
+        return 0;
+    }
+
+    size_t e = b->slots[slot] - 1;
+    float* sum = b->rows + e * width + in;
+    for (size_t j = in; j < width; ++j)
+        *sum++ += row[j];
+    b->counts[e] += count;
+    return 0;
+}
+
+/* =========================================================
+ * Distributed
+ * ========================================================= */
+
+#ifdef FOSSIL_AI_TRAIN_HAS_MMAP
+typedef struct fossil_ai_train_socket_link {
+    int next;
+    int prev;
+    int timeout_ms;
+} fossil_ai_train_socket_link_t;
+
+/* Sends and receives at once so neither side stalls on a full socket buffer. */
+static int socket_exchange(void* ctx, const void* data, size_t send_len,
+                           void** recv, size_t* recv_len)
+{
+    fossil_ai_train_socket_link_t* l = (fossil_ai_train_socket_link_t*)ctx;
+    uint64_t out_len = send_len, in_len = 0;
+    size_t sent = 0, got = 0;
+    uint8_t* in = NULL;
+
+    *recv = NULL;
+    *recv_len = 0;
+    while (sent < 8 + send_len || got < 8 + in_len || got < 8) {
+        struct pollfd fds[2];
+        nfds_t n = 0;
+        if (sent < 8 + send_len)
+            fds[n++] = (struct pollfd){ l->next, POLLOUT, 0 };
+        if (got < 8 || got < 8 + in_len)
+            fds[n++] = (struct pollfd){ l->prev, POLLIN, 0 };
+        int ready = poll(fds, n, l->timeout_ms);
+        if (ready <= 0) {
+            if (ready < 0 && errno == EINTR)
+                continue;
+            free(in);
+            return -1;
+        }
+
+        for (nfds_t i = 0; i < n; ++i) {
+            if (!fds[i].revents)
+                continue;
+            ssize_t k;
+            if (fds[i].fd == l->next && fds[i].events == POLLOUT) {
+                if (sent < 8)
+                    k = send(l->next, (const uint8_t*)&out_len + sent, 8 - sent,
+                             FOSSIL_AI_TRAIN_SEND_FLAGS);
+                else
+                    k = send(l->next, (const uint8_t*)data + (sent - 8), send_len - (sent - 8),
+                             FOSSIL_AI_TRAIN_SEND_FLAGS);
+                if (k < 0 && errno != EAGAIN && errno != EINTR) {
+                    free(in);
+                    return -1;
+                }
+                sent += k > 0 ? (size_t)k : 0;
+            } else {
+                if (got < 8)
+                    k = read(l->prev, (uint8_t*)&in_len + got, 8 - got);
+                else
+                    k = read(l->prev, in + (got - 8), (size_t)in_len - (got - 8));
+                if (k == 0 || (k < 0 && errno != EAGAIN && errno != EINTR)) {
+                    free(in);
+                    return -1;
+                }
+                got += k > 0 ? (size_t)k : 0;
+                if (got == 8 && !in) {
+                    in = (uint8_t*)malloc(in_len ? (size_t)in_len : 1);
+                    if (!in)
+                        return -2;
+                }
+            }
+        }
+    }
+
+    *recv = in;
+    *recv_len = (size_t)in_len;
+    return 0;
+}
+
+static void socket_close(void* ctx)
+{
+    fossil_ai_train_socket_link_t* l = (fossil_ai_train_socket_link_t*)ctx;
+    if (l->next >= 0)
+        close(l->next);
+    if (l->prev >= 0)
+        close(l->prev);
+    free(l);
+}
+
+static int socket_address(struct sockaddr_un* addr, const char* prefix, size_t rank)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    int n = snprintf(addr->sun_path, sizeof(addr->sun_path), "%s.%zu", prefix, rank);
+    return n > 0 && (size_t)n < sizeof(addr->sun_path) ? 0 : -1;
+}
+
+/* Listens for the previous rank, then connects to the next one, retrying until it is up. */
+static int socket_link_open(const fossil_ai_train_dist_t* d, fossil_ai_train_transport_t* out)
+{
+    int timeout = d->timeout_ms > 0 ? d->timeout_ms : 10000;
+    struct sockaddr_un self, next;
+    if (!d->socket_prefix || socket_address(&self, d->socket_prefix, d->rank) != 0 ||
+        socket_address(&next, d->socket_prefix, (d->rank + 1) % d->world) != 0)
+        return -1;
+
+    fossil_ai_train_socket_link_t* l = (fossil_ai_train_socket_link_t*)malloc(sizeof(*l));
+    if (!l)
+        return -2;
+    l->next = -1;
+    l->prev = -1;
+    l->timeout_ms = timeout;
+
+    int lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(self.sun_path);
+    if (lfd < 0 || bind(lfd, (struct sockaddr*)&self, sizeof(self)) != 0 || listen(lfd, 1) != 0) {
+        if (lfd >= 0)
+            close(lfd);
+        free(l);
+        return -1;
+    }
+
+    uint64_t deadline = now_ns() + (uint64_t)timeout * 1000000ull;
+    while (l->next < 0 && now_ns() < deadline) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr*)&next, sizeof(next)) == 0) {
+            l->next = fd;
+            break;
+        }
+        if (fd >= 0)
+            close(fd);
+        struct timespec pause = { 0, 10 * 1000 * 1000 };
+        nanosleep(&pause, NULL);
+    }
+
+    struct pollfd pfd = { lfd, POLLIN, 0 };
+    if (l->next >= 0 && poll(&pfd, 1, timeout) == 1)
+        l->prev = accept(lfd, NULL, NULL);
+    close(lfd);
+    unlink(self.sun_path);
+    if (l->next < 0 || l->prev < 0) {
+        socket_close(l);
+        return -1;
+    }
+
+    fcntl(l->next, F_SETFL, fcntl(l->next, F_GETFL) | O_NONBLOCK);
+    fcntl(l->prev, F_SETFL, fcntl(l->prev, F_GETFL) | O_NONBLOCK);
+#if defined(SO_NOSIGPIPE)
+    int on = 1;
+    setsockopt(l->next, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    out->exchange = socket_exchange;
+    out->close = socket_close;
+    out->ctx = l;
+    return 0;
+}
+#endif
+
+static void dist_close(fossil_ai_train_state_t* ts)
+{
+    if (ts->link.close)
+        ts->link.close(ts->link.ctx);
+    memset(&ts->link, 0, sizeof(ts->link));
+    ts->world = 0;
+    ts->rank = 0;
+}
+
+/* Frame: entry count, then key, count and one row of floats per entry. */
+static size_t dist_entry_bytes(size_t width)
+{
+    return sizeof(uint64_t) + sizeof(uint32_t) + width * sizeof(float);
+}
+
+static void* dist_pack(const fossil_ai_train_accum_buf_t* b, size_t width, size_t* len)
+{
+    size_t eb = dist_entry_bytes(width);
+    uint8_t* p = (uint8_t*)malloc(8 + b->n * eb);
+    if (!p)
+        return NULL;
+
+    uint64_t n = b->n;
+    memcpy(p, &n, 8);
+    uint8_t* at = p + 8;
+    for (size_t e = 0; e < b->n; ++e) {
+        memcpy(at, &b->keys[e], sizeof(uint64_t));
+        memcpy(at + 8, &b->counts[e], sizeof(uint32_t));
+        memcpy(at + 12, b->rows + e * width, width * sizeof(float));
+        at += eb;
+    }
+    *len = 8 + b->n * eb;
+    return p;
+}
+
+/*
+ * Merges a received frame. Targets are summed; when ranks disagree on the
+ * stored input the bytewise smaller one wins, so arrival order is irrelevant.
+ */
+static int dist_merge(fossil_ai_train_accum_buf_t* b, size_t in, size_t width,
+                      const uint8_t* p, size_t len)
+{
+    size_t eb = dist_entry_bytes(width);
+    uint64_t n;
+    if (len < 8)
+        return -3;
+    memcpy(&n, p, 8);
+    if (n > (len - 8) / eb || len != 8 + n * eb)
+        return -3;
+
+    float row_stack[64];
+    float* row = width <= 64 ? row_stack : (float*)malloc(width * sizeof(float));
+    if (!row)
+        return -2;
+
+    int rc = 0;
+    for (uint64_t i = 0; i < n && rc == 0; ++i) {
+        const uint8_t* at = p + 8 + i * eb;
+        uint64_t key;
+        uint32_t count;
+        memcpy(&key, at, 8);
+        memcpy(&count, at + 8, 4);
+        memcpy(row, at + 12, width * sizeof(float));
+
+        size_t have = b->cap ? b->slots[accum_slot(b, key)] : 0;
+        if (have) {
+            float* cur = b->rows + (have - 1) * width;
+            if (memcmp(row, cur, in * sizeof(float)) < 0)
+                memcpy(cur, row, in * sizeof(float));
+        }
+        rc = accum_add(b, in, width, key, row, count);
+    }
+    if (row != row_stack)
+        free(row);
+    return rc;
+}
+
+/*
+ * Ring all-reduce over key-hash segments: a reduce-scatter leaves rank r
+ * owning segment r + 1, and an all-gather circulates the finished segments.
+ * Each segment is always summed in the same ring order and the result is
+ * rebuilt in segment order, so every rank applies identical updates.
+ */
+static int dist_allreduce(fossil_ai_train_state_t* ts, fossil_ai_train_accum_buf_t* m)
+{
+    size_t p = ts->world;
+    size_t r = ts->rank;
+    size_t in = ts->store.input_dim;
+    size_t width = row_width(&ts->store);
+    int rc = 0;
+
+    if (p < 2)
+        return 0;
+
+    fossil_ai_train_accum_buf_t* seg = (fossil_ai_train_accum_buf_t*)calloc(p, sizeof(*seg));
+    if (!seg)
+        return -2;
+    for (size_t e = 0; e < m->n && rc == 0; ++e)
+        rc = accum_add(&seg[(m->keys[e] >> 32) % p], in, width, m->keys[e],
+                       m->rows + e * width, m->counts[e]);
+
+    for (size_t t = 0; t < 2 * (p - 1) && rc == 0; ++t) {
+        int gather = t >= p - 1;
+        size_t k = gather ? t - (p - 1) : t;
+        size_t out_seg = gather ? (r + 1 + p - k) % p : (r + p - k) % p;
+        size_t in_seg = (out_seg + p - 1) % p;
+        size_t len = 0, got = 0;
+        void* frame = dist_pack(&seg[out_seg], width, &len);
+        void* recv = NULL;
+        if (!frame) {
+            rc = -2;
+            break;
+        }
+
+        rc = ts->link.exchange(ts->link.ctx, frame, len, &recv, &got);
+        free(frame);
+        if (rc == 0) {
+            if (gather)
+                accum_buf_clear(&seg[in_seg]);
+            rc = dist_merge(&seg[in_seg], in, width, (const uint8_t*)recv, got);
+        }
+        free(recv);
+    }
+
+    accum_buf_clear(m);
+    for (size_t k = 0; k < p; ++k) {
+        for (size_t e = 0; e < seg[k].n && rc == 0; ++e)
+            rc = accum_add(m, in, width, seg[k].keys[e], seg[k].rows + e * width, seg[k].counts[e]);
+        accum_buf_free(&seg[k]);
+    }
+    free(seg);
+    return rc;
+}
+
+/*
+ * Averages each rank's validation score, weighted by the rows it scored,
+ * so every rank takes the same early-stop decision. Scores circulate the
+ * ring tagged by rank and are summed in rank order, giving identical sums.
+ */
+static int dist_score(fossil_ai_train_state_t* ts, double* score, double* weight)
+{
+    typedef struct { uint64_t rank; double sum; double weight; } piece_t;
+    size_t p = ts->world;
+    int rc = 0;
+
+    if (p < 2)
+        return 0;
+
+    piece_t* all = (piece_t*)calloc(p, sizeof(*all));
+    if (!all)
+        return -2;
+    piece_t piece = { ts->rank, *score * *weight, *weight };
+    all[ts->rank] = piece;
+    for (size_t t = 0; t + 1 < p && rc == 0; ++t) {
+        void* recv = NULL;
+        size_t got = 0;
+        rc = ts->link.exchange(ts->link.ctx, &piece, sizeof(piece), &recv, &got);
+        if (rc == 0 && got != sizeof(piece))
+            rc = -3;
+        if (rc == 0) {
+            memcpy(&piece, recv, sizeof(piece));
+            if (piece.rank >= p)
+                rc = -3;
+            else
+                all[piece.rank] = piece;
+        }
+        free(recv);
+    }
+
+    double sum = 0.0, total = 0.0;
+    for (size_t r = 0; r < p; ++r) {
+        sum += all[r].sum;
+        total += all[r].weight;
+    }
+    free(all);
+    if (rc == 0) {
+        *score = total > 0.0 ? sum / total : 0.0;
+        *weight = total;
+    }
+    return rc;
+}
+
+/* =========================================================
+ * Accumulated Apply
+ * ========================================================= */
+
+typedef struct fossil_ai_train_accum_part {
+    const fossil_ai_train_store_t* store;
+    fossil_ai_train_accum_buf_t* buf;
+    const float* rows;
+    size_t begin;
+    size_t end;
+    int rc;
+} fossil_ai_train_accum_part_t;
+
+static void* accum_worker(void* arg)
+{
+    fossil_ai_train_accum_part_t* p = (fossil_ai_train_accum_part_t*)arg;
+    const fossil_ai_train_store_t* st = p->store;
+    size_t width = row_width(st);
+
+    for (size_t i = p->begin; i < p->end && p->rc == 0; ++i) {
+        const float* row = p->rows + i * width;
+        p->rc = accum_add(p->buf, st->input_dim, width, hash_input(st, row), row, 1);
+    }
+    return NULL;
+}
+
+/* Rows are split into contiguous ranges, each merged into its worker's buffer. */
+static int accum_rows(fossil_ai_train_state_t* ts, fossil_ai_train_accum_bank_t* bank,
+                      const float* rows, size_t n)
+{
+    fossil_ai_train_accum_part_t parts[FOSSIL_AI_TRAIN_MAX_WORKERS];
+    pthread_t threads[FOSSIL_AI_TRAIN_MAX_WORKERS];
+    int started[FOSSIL_AI_TRAIN_MAX_WORKERS];
+    size_t workers = ts->accum.workers ? ts->accum.workers : online_workers();
+    int rc = 0;
+
+    if (workers > FOSSIL_AI_TRAIN_MAX_WORKERS)
+        workers = FOSSIL_AI_TRAIN_MAX_WORKERS;
+    if (workers > n / 256)
+        workers = n / 256 ? n / 256 : 1;
+
+    for (size_t w = 0; w < workers; ++w) {
+        parts[w].store = &ts->store;
+        parts[w].buf = &bank->bufs[w];
+        parts[w].rows = rows;
+        parts[w].begin = n * w / workers;
+        parts[w].end = n * (w + 1) / workers;
+        parts[w].rc = 0;
+        started[w] = w > 0 && pthread_create(&threads[w], NULL, accum_worker, &parts[w]) == 0;
+        if (w > 0 && !started[w])
+            accum_worker(&parts[w]);
+    }
+    accum_worker(&parts[0]);
+
+    for (size_t w = 0; w < workers; ++w) {
+        if (w > 0 && started[w])
+            pthread_join(threads[w], NULL);
+        if (parts[w].rc != 0)
+            rc = parts[w].rc;
+    }
+    return rc;
+}
+
+/*
+ * Buffers are merged in worker order, then each block moves toward the mean
+ * of its merged targets as far as count sequential blends would have taken it.
+ */
+static int accum_apply(fossil_ai_train_state_t* ts, fossil_ai_train_accum_bank_t* bank)
+{
+    fossil_ai_train_store_t* st = &ts->store;
+    fossil_ai_train_accum_buf_t* m = &bank->merged;
+    size_t in = st->input_dim;
+    size_t width = row_width(st);
+    float lr = ts->config.learning_rate;
+    uint64_t start = now_ns();
+    int rc = 0;
+
+    accum_buf_clear(m);
+    for (size_t w = 0; w < FOSSIL_AI_TRAIN_MAX_WORKERS && rc == 0; ++w) {
+        fossil_ai_train_accum_buf_t* b = &bank->bufs[w];
+        for (size_t e = 0; e < b->n && rc == 0; ++e)
+            rc = accum_add(m, in, width, b->keys[e], b->rows + e * width, b->counts[e]);
+        accum_buf_clear(b);
+    }
+    if (rc == 0)
+        rc = dist_allreduce(ts, m);
+
+    for (size_t e = 0; e < m->n && rc == 0; ++e) {
+        float* row = m->rows + e * width;
+        float inv = 1.0f / (float)m->counts[e];
+        for (size_t j = in; j < width; ++j)
+            row[j] *= inv;
+
+        size_t idx = index_lookup(st, m->keys[e]);
+        if (idx == SIZE_MAX) {
+            if (ts->config.capacity && st->block_count >= ts->config.capacity)
+                continue;
+            rc = store_append(st, m->keys[e], row);
+            if (rc == 0)
+                block_at(st, st->block_count - 1)->hits = m->counts[e];
+        } else {
+            rc = chunk_own(st, idx / FOSSIL_AI_TRAIN_CHUNK_BLOCKS);
+            if (rc != 0)
+                break;
+            fossil_ai_train_block_t* b = block_at(st, idx);
+            float* out = block_output(st, b);
+            float a = 1.0f - powf(1.0f - lr, (float)m->counts[e]);
+            for (size_t j = 0; j < st->output_dim; ++j)
+                out[j] += a * (row[in + j] - out[j]);
+            b->hits += m->counts[e];
+        }
+    }
+
+    if (rc == 0)
+        rc = publish_if_serving(ts);
+    atomic_store_explicit(&ts->applied_blocks, st->block_count, memory_order_release);
+    bank->micro = 0;
+    bank->rc = rc;
+    bank->apply_ns = now_ns() - start;
+    return rc;
+}
+
+static void* accum_apply_job(void* arg)
+{
+    fossil_ai_train_state_t* ts = (fossil_ai_train_state_t*)arg;
+    accum_apply(ts, ts->banks[ts->bank ^ 1]);
+    return NULL;
+}
+
+/* Waits for a background apply; writers call this before touching the store. */
+static int accum_join(fossil_ai_train_state_t* ts)
+{
+    if (!ts->applying)
+        return 0;
+
+    fossil_ai_train_accum_bank_t* bank = ts->banks[ts->bank ^ 1];
+    pthread_join(ts->apply_thread, NULL);
+    ts->applying = 0;
+    ts->profile.total.compute_ns += bank->apply_ns;
+    return bank->rc;
+}
+
+static int accum_flush(fossil_ai_train_state_t* ts)
+{
+    int rc = accum_join(ts);
+    fossil_ai_train_accum_bank_t* bank = ts->banks[ts->bank];
+
+    if (rc == 0 && bank && bank->micro) {
+        rc = accum_apply(ts, bank);
+        ts->profile.total.compute_ns += bank->apply_ns;
+    }
+    return rc;
+}
+
+static void accum_free(fossil_ai_train_state_t* ts)
+{
+    accum_join(ts);
+    for (size_t k = 0; k < 2; ++k) {
+        fossil_ai_train_accum_bank_t* bank = ts->banks[k];
+        if (!bank)
+            continue;
+        for (size_t w = 0; w < FOSSIL_AI_TRAIN_MAX_WORKERS; ++w)
+            accum_buf_free(&bank->bufs[w]);
+        accum_buf_free(&bank->merged);
+        free(bank);
+        ts->banks[k] = NULL;
+    }
+}
+
+/* Gathers one micro-batch; applies once enough have accumulated. */
+static int accum_step(fossil_ai_train_state_t* ts, const float* rows, size_t n,
+                      fossil_ai_train_phases_t* ph, int last)
+{
+    if (!ts->banks[ts->bank]) {
+        ts->banks[ts->bank] = (fossil_ai_train_accum_bank_t*)calloc(1, sizeof(fossil_ai_train_accum_bank_t));
+        if (!ts->banks[ts->bank])
+            return -2;
+    }
+
+    fossil_ai_train_accum_bank_t* bank = ts->banks[ts->bank];
+    uint64_t t0 = now_ns();
+    int rc = accum_rows(ts, bank, rows, n);
+    ph->hash_ns += now_ns() - t0;
+    ph->rows += n;
+    if (rc != 0 || !last || ++bank->micro < ts->accum.micro_batches)
+        return rc;
+
+    rc = accum_join(ts);
+    if (rc != 0)
+        return rc;
+
+    if (ts->accum.overlap) {
+        fossil_ai_train_accum_bank_t** other = &ts->banks[ts->bank ^ 1];
+        if (!*other)
+            *other = (fossil_ai_train_accum_bank_t*)calloc(1, sizeof(fossil_ai_train_accum_bank_t));
+        if (*other) {
+            ts->bank ^= 1;
+            atomic_store_explicit(&ts->applied_blocks, ts->store.block_count, memory_order_relaxed);
+            if (pthread_create(&ts->apply_thread, NULL, accum_apply_job, ts) == 0) {
+                ts->applying = 1;
+                return 0;
+            }
+            ts->bank ^= 1;
+        }
+    }
+
+    rc = accum_apply(ts, bank);
+    ph->compute_ns += bank->apply_ns;
+    return rc;
+}
+
+int fossil_ai_train_accum_set(void* model, const fossil_ai_train_accum_t* accum)
+{
+    fossil_ai_train_state_t* ts = find_state(model, NULL);
+    if (!ts)
+        return -1;
+
+    pthread_mutex_lock(&ts->write_lock);
+    int rc = accum_flush(ts);
+    if (accum)
+        ts->accum = *accum;
+    else
+        memset(&ts->accum, 0, sizeof(ts->accum));
+    pthread_mutex_unlock(&ts->write_lock);
+    return rc;
+}
+
+int fossil_ai_train_accum_flush(void* model)
+{
+    fossil_ai_train_state_t* ts = find_state(model, NULL);
+    if (!ts)
+        return -1;
+
+    pthread_mutex_lock(&ts->write_lock);
+    int rc = accum_flush(ts);
+    pthread_mutex_unlock(&ts->write_lock);
+    return rc;
+}
+
+int fossil_ai_train_dist_join(void* model, const fossil_ai_train_dist_t* dist)
+{
+    fossil_ai_train_state_t* ts = find_state(model, NULL);
+    if (!ts || !dist || dist->world == 0 || dist->rank >= dist->world)
+        return -1;
+
+    pthread_mutex_lock(&ts->write_lock);
+    int rc = accum_flush(ts);
+    if (rc == 0) {
+        dist_close(ts);
+        if (dist->transport) {
+            ts->link = *dist->transport;
+        } else if (dist->world > 1) {
+#ifdef FOSSIL_AI_TRAIN_HAS_MMAP
+            rc = socket_link_open(dist, &ts->link);
+#else
+            rc = -1;
+#endif
+        }
+    }
+    if (rc == 0) {
+        ts->rank = dist->rank;
+        ts->world = dist->world;
+    }
+    pthread_mutex_unlock(&ts->write_lock);
+    return rc;
+}
+
+int fossil_ai_train_dist_leave(void* model)
+{
+    fossil_ai_train_state_t* ts = find_state(model, NULL);
+    if (!ts)
+        return -1;
+
+    pthread_mutex_lock(&ts->write_lock);
+    int rc = accum_flush(ts);
+    dist_close(ts);
+    pthread_mutex_unlock(&ts->write_lock);
+    return rc;
+}
+
+/* =========================================================
+ * Lifecycle
+ * ========================================================= */
+
+int fossil_ai_train_begin(void* model, const fossil_ai_train_config_t* config, const char* checkpoint)
+{
+    if (!model || !config == !checkpoint)
+        return -1;
+
+    fossil_ai_train_state_t* ts = find_state(model, NULL);
+    if (ts) {
+        if (checkpoint)
+            return ts->active ? 1 : -1;
+        pthread_mutex_lock(&ts->write_lock);
+        int rc = ts->active ? 1 : 0; /* 1 = already training */
+        if (config->input_dim != ts->store.input_dim || config->output_dim != ts->store.output_dim ||
+            config->resolution != ts->store.resolution) {
+            rc = -1;
+        } else if (rc == 0) {
+            /* The store, cursor and generator carry on; only the policy fields are new. */
+            ts->config = *config;
+            ts->active = 1;
+            ts->stop.stopped = 0;
+            ts->stop.bad = 0;
+        }
+        pthread_mutex_unlock(&ts->write_lock);
+        return rc;
+    }
+
+    if (config && (config->input_dim == 0 || config->output_dim == 0))
+        return -1;
+
+    ts = (fossil_ai_train_state_t*)calloc(1, sizeof(*ts));
+    if (!ts)
+        return -2;
+    ts->model = model;
+
+    if (checkpoint) {
+        int rc = resume_state(ts, checkpoint);
+        if (rc != 0) {
+            store_free(&ts->store);
+            mapping_release(ts->map);
+            free(ts);
+            return rc;
+        }
+    } else {
+        ts->config = *config;
+        ts->store.input_dim = config->input_dim;
+        ts->store.output_dim = config->output_dim;
+        ts->store.resolution = config->resolution;
+        ts->store.stride = round_up(sizeof(fossil_ai_train_block_t)
+                                    + row_width(&ts->store) * sizeof(float), 8);
+        ts->rng = config->seed;
+        ts->shuffle.stratify_output = -1;
+    }
+
+    pthread_mutex_init(&ts->lock, NULL);
+    pthread_mutex_init(&ts->write_lock, NULL);
+    pthread_mutex_init(&ts->checkpoint_lock, NULL);
+    atomic_init(&ts->current, NULL);
+    atomic_init(&ts->serving, 0);
+    ts->active = 1;
+
+    pthread_rwlock_wrlock(&g_train_registry);
+    if (find_state_locked(model, NULL)) {
+        pthread_rwlock_unlock(&g_train_registry);
+        store_free(&ts->store);
+        mapping_release(ts->map);
+        free(ts);
+        return 1;
+    }
+    ts->next = g_train_states;
+    g_train_states = ts;
+    pthread_rwlock_unlock(&g_train_registry);
+    return 0;
+}
+
+int fossil_ai_train_finalize(void* model)
+{
+    fossil_ai_train_state_t* ts = find_state(model, NULL);
+    if (!ts)
+        return -1;
+
+    pthread_mutex_lock(&ts->write_lock);
+    int rc = ts->active ? 0 : -1;
+    if (rc == 0) {
+        job_join(ts);
+        rc = accum_flush(ts);
+        ts->active = 0;
+        if (rc == 0)
+            rc = publish_if_serving(ts);
+    }
+    pthread_mutex_unlock(&ts->write_lock);
+    return rc;
+}
+
+int fossil_ai_train_release(void* model)
+{
+    pthread_rwlock_wrlock(&g_train_registry);
+    fossil_ai_train_state_t* prev = NULL;
+    fossil_ai_train_state_t* ts = find_state_locked(model, &prev);
+    if (!ts) {
+        pthread_rwlock_unlock(&g_train_registry);
+        return -1;
+    }
+
+    if (prev)
+        prev->next = ts->next;
+    else
+        g_train_states = ts->next;
+    pthread_rwlock_unlock(&g_train_registry);
+
+    job_join(ts);
+    accum_free(ts);
+    dist_close(ts);
+    if (atomic_load(&ts->current))
+        generation_free(atomic_load(&ts->current));
+    reclaim(ts, 1);
+    store_free(&ts->store);
+    mapping_release(ts->map);
+    shuffle_free(ts);
+    free(ts->gather);
+    free(ts->kept);
+    free(ts->trace);
+    pthread_mutex_destroy(&ts->checkpoint_lock);
+    pthread_mutex_destroy(&ts->write_lock);
+    pthread_mutex_destroy(&ts->lock);
+    free(ts);
+    return 0;
+}
+
+
+/* =========================================================
+ * Training
+ * ========================================================= */
+
+static void trace_push(fossil_ai_train_state_t* ts, int kind, uint64_t start,
+                       const fossil_ai_train_phases_t* ph)
+{
+    if (!ts->trace) {
+        ts->trace = (fossil_ai_train_trace_event_t*)
+            calloc(FOSSIL_AI_TRAIN_TRACE_EVENTS, sizeof(*ts->trace));
+        if (!ts->trace)
+            return;
+    }
+
+    fossil_ai_train_trace_event_t* e = &ts->trace[ts->trace_head];
+    e->start_ns = start;
+    e->step = ts->steps;
+    e->kind = kind;
+    e->phases = *ph;
+
+    ts->trace_head = (ts->trace_head + 1) % FOSSIL_AI_TRAIN_TRACE_EVENTS;
+    if (ts->trace_count < FOSSIL_AI_TRAIN_TRACE_EVENTS)
+        ts->trace_count++;
+}
+
+static void phases_add(fossil_ai_train_phases_t* into, const fossil_ai_train_phases_t* ph)
+{
+    into->data_wait_ns += ph->data_wait_ns;
+    into->hash_ns += ph->hash_ns;
+    into->insert_ns += ph->insert_ns;
+    into->compute_ns += ph->compute_ns;
+    into->audit_ns += ph->audit_ns;
+    into->total_ns += ph->total_ns;
+    into->rows += ph->rows;
+}
+
+static void early_stop_score(fossil_ai_train_state_t* ts, fossil_ai_train_metrics_t* m)
+{
+    const fossil_ai_train_early_stop_t* es = &ts->config.early_stop;
+    const float* data;
+    size_t rows;
+    size_t* picks = NULL;
+
+    validation_source(ts, &data, &rows);
+    if (es->sample_rows && es->sample_rows < rows) {
+        uint64_t rng = ts->config.seed ^ (ts->steps * 0xD1B54A32D192ED03ull);
+        picks = (size_t*)malloc(es->sample_rows * sizeof(*picks));
+        if (picks) {
+            for (size_t i = 0; i < es->sample_rows; ++i)
+                picks[i] = (size_t)(train_rng_next(&rng) % rows);
+        }
+    }
+
+    memset(m, 0, sizeof(*m));
+    score_store(&ts->store, data, picks ? es->sample_rows : rows, picks,
+                online_workers(), 1.96, m);
+    m->step = ts->steps;
+    free(picks);
+}
+
+/*
+ * Validates when due, adapts the interval and finalizes once patience runs
+ * out. Ranks of a ring validate on the same steps, even those without data,
+ * and decide on the score averaged across them, so they stop together.
+ */
+static int early_stop_check(fossil_ai_train_state_t* ts)
+{
+    const fossil_ai_train_early_stop_t* es = &ts->config.early_stop;
+    fossil_ai_train_early_stop_status_t* s = &ts->stop;
+    uint64_t lo = es->min_interval ? es->min_interval : 1;
+    uint64_t hi = es->max_interval ? es->max_interval : 64 * lo;
+    const float* data;
+    size_t rows;
+
+    validation_source(ts, &data, &rows);
+    if (!es->patience || (ts->world < 2 && (!data || rows == 0)))
+        return 0;
+    if (!s->interval) {
+        s->interval = lo;
+        s->next_step = ts->steps + lo;
+    }
+    if (ts->steps < s->next_step)
+        return 0;
+    int rc = accum_join(ts);
+    if (rc == 0 && index_ensure(&ts->store) != 0)
+        rc = -2;
+    if (rc != 0)
+        return rc;
+
+    fossil_ai_train_metrics_t m;
+    memset(&m, 0, sizeof(m));
+    if (data && rows) {
+        early_stop_score(ts, &m);
+        pthread_mutex_lock(&ts->lock);
+        ts->metrics = m;
+        pthread_mutex_unlock(&ts->lock);
+    }
+
+    /* Scores are oriented so that larger is better. */
+    double v = es->metric == FOSSIL_AI_TRAIN_METRIC_HIT_RATE ? m.hit_rate : -m.loss;
+    double weight = (double)m.rows;
+    rc = dist_score(ts, &v, &weight);
+    if (rc != 0)
+        return rc;
+    if (weight <= 0.0) {
+        s->next_step = ts->steps + s->interval;
+        return 0;
+    }
+    double gain = s->validations ? v - s->best : INFINITY;
+    s->validations++;
+
+    if (gain > es->min_delta) {
+        s->best = v;
+        s->best_step = ts->steps;
+        s->bad = 0;
+        if (gain > 4.0 * es->min_delta && s->validations > 1)
+            s->interval = s->interval * 2 < hi ? s->interval * 2 : hi;
+        else
+            s->interval = s->interval / 2 > lo ? s->interval / 2 : lo;
+    } else {
+        s->bad++;
+        s->interval = s->interval / 2 > lo ? s->interval / 2 : lo;
+    }
+    s->next_step = ts->steps + s->interval;
+
+    if (s->bad < es->patience)
+        return 0;
+
+    s->stopped = 1;
+    job_join(ts);
+    rc = accum_flush(ts);
+    ts->active = 0;
+    if (rc == 0)
+        rc = publish(ts);
+    return rc == 0 ? 1 : rc;
+}
+
+static int train_step_locked(fossil_ai_train_state_t* ts, const void* batch, size_t rows)
+{
+    if (!ts->active)
+        return -1;
+
+    fossil_ai_train_phases_t ph;
+    memset(&ph, 0, sizeof(ph));
+    uint64_t start = now_ns();
+    int rc = 0;
+
+    int accum = ts->accum.micro_batches > 1 || ts->world > 1;
+
+    if (batch) {
+        rc = accum ? accum_step(ts, (const float*)batch, rows, &ph, 1)
+                   : apply_rows(ts, (const float*)batch, rows, &ph);
+    } else {
+        if (!ts->data || ts->rows == 0)
+            return -1;
+        while (rows && rc == 0) {
+            size_t got = 0;
+            uint64_t t0 = now_ns();
+            const float* p = next_rows(ts, rows, &got);
+            ph.data_wait_ns += now_ns() - t0;
+            if (!p)
+                rc = -2;
+            else if (accum)
+                rc = accum_step(ts, p, got, &ph, got == rows);
+            else
+                rc = apply_rows(ts, p, got, &ph);
+            rows -= got;
+        }
+    }
+    if (rc == 0 && !accum)
+        rc = publish_if_serving(ts);
+    if (rc != 0)
+        return rc;
+
+    ts->steps++;
+    if (ts->audit) {
+        uint64_t t0 = now_ns();
+        size_t blocks = ts->applying
+            ? atomic_load_explicit(&ts->applied_blocks, memory_order_acquire)
+            : ts->store.block_count;
+        uint64_t record[3] = { ts->steps, ph.rows, blocks };
+        fossil_ai_audit_record(ts->audit, "fossil.train.step", record, sizeof(record));
+        ph.audit_ns = now_ns() - t0;
+    }
+
+    ph.total_ns = now_ns() - start;
+    ts->profile.last = ph;
+    phases_add(&ts->profile.total, &ph);
+    ts->profile.steps++;
+    trace_push(ts, FOSSIL_AI_TRAIN_TRACE_STEP, start, &ph);
+    return early_stop_check(ts);
+}
+
+int fossil_ai_train_step(void* model, const void* batch, size_t rows)
+{
+    fossil_ai_train_state_t* ts = find_state(model, NULL);
+    if (!ts)
+        return -1;
+
+    pthread_mutex_lock(&ts->write_lock);
+    int rc = train_step_locked(ts, batch, rows);
+    pthread_mutex_unlock(&ts->write_lock);
+    return rc;
+}
+
+int fossil_ai_train_add_memory(void* model, const float* input, const float* output)
+{
+    fossil_ai_train_state_t* ts = find_state(model, NULL);
+    if (!ts || !input || !output)
+        return -1;
+
+    pthread_mutex_lock(&ts->write_lock);
+    accum_join(ts);
+    fossil_ai_train_store_t* st = &ts->store;
+    fossil_ai_train_phases_t ph;
+    float row_stack[64];
+    float* row = row_width(st) <= 64 ? row_stack : (float*)malloc(row_width(st) * sizeof(float));
+    int rc = -2;
+
+    memset(&ph, 0, sizeof(ph));
+    if (row) {
+        memcpy(row, input, st->input_dim * sizeof(float));
+        memcpy(row + st->input_dim, output, st->output_dim * sizeof(float));
+        rc = apply_rows(ts, row, 1, &ph);
+        if (rc == 0)
+            rc = publish_if_serving(ts);
+        if (row != row_stack)
+            free(row);
+    }
+    pthread_mutex_unlock(&ts->write_lock);
+    return rc;
+}
+
+int fossil_ai_train_publish(void* model)
+{
+    fossil_ai_train_state_t* ts = find_state(model, NULL);
+    if (!ts)
+        return -1;
+
+    pthread_mutex_lock(&ts->write_lock);
+    int rc = accum_join(ts);
+    if (rc == 0)
+        rc = publish(ts);
+    pthread_mutex_unlock(&ts->write_lock);
+    return rc;
+}
+
+
+/* =========================================================
+ * Serving
+ * ========================================================= */
+
+static size_t recall_rows(const fossil_ai_train_store_t* st, const float* X, size_t rows,
+                          float* out)
+{
+    size_t hits = 0;
+
+    for (size_t r = 0; r < rows; ++r) {
+        const float* input = X + r * st->input_dim;
+        float* dst = out + r * st->output_dim;
+        size_t idx = index_find(st, hash_input(st, input));
+
+        if (idx != SIZE_MAX && idx < st->block_count) {
+            memcpy(dst, block_output(st, block_at(st, idx)), st->output_dim * sizeof(float));
+            hits++;
+        } else {
+            memset(dst, 0, st->output_dim * sizeof(float));
+        }
+    }
+    return hits;
+}
+
+/* Wait-free against writers: readers only pin an epoch and read a published generation. */
+int fossil_ai_train_recall(void* model, const float* X, size_t rows, float* out, size_t* hits)
+{
+    fossil_ai_train_state_t* ts = find_state(model, NULL);
+    if (!ts || !X || !out)
+        return -1;
+
+    atomic_uint_fast64_t* slot = reader_slot();
+    if (!slot || serving_start(ts) != 0)
+        return -2;
+
+    fossil_ai_train_generation_t* g = reader_enter(ts, slot);
+    size_t n = recall_rows(g->store, X, rows, out);
+    reader_exit(slot);
+
+    if (hits)
+        *hits = n;
+    return 0;
+}
+
+uint64_t fossil_ai_train_generation(void* model)
+{
+    fossil_ai_train_state_t* ts = find_state(model, NULL);
+    if (!ts)
+        return 0;
+
+    atomic_uint_fast64_t* slot = reader_slot();
+    if (!slot || serving_start(ts) != 0)
+        return 0;
+
+    uint64_t id = reader_enter(ts, slot)->id;
+    reader_exit(slot);
+    return id;
+}
+
+int fossil_ai_train_dataset_attach(void* model, const void* data, size_t rows)
+{
+    fossil_ai_train_state_t* ts = find_state(model, NULL);
+    if (!ts || !data || rows == 0)
+        return -1;
+
+    /* The caller keeps the rows alive; a resumed cursor stays valid for the same data. */
+    pthread_mutex_lock(&ts->write_lock);
+    job_join(ts);
+    free(ts->kept);
+    ts->kept = NULL;
+    ts->data = (const float*)data;
+    ts->rows = rows;
+    int rc = ts->dedup_on ? dedup_rows(ts) : 0;
+    if (ts->cursor > ts->rows)
+        ts->cursor = 0;
+    shuffle_free(ts);
+    pthread_mutex_unlock(&ts->write_lock);
+    return rc;
+}
+
+int fossil_ai_train_dedup_set(void* model, const fossil_ai_train_dedup_t* dedup)
+{
+    fossil_ai_train_state_t* ts = find_state(model, NULL);
+    if (!ts)
+        return -1;
+    if (dedup && (dedup->similarity < 0.0f || dedup->similarity > 1.0f || dedup->quantum < 0.0f))
+        return -1;
+
+    pthread_mutex_lock(&ts->write_lock);
+    ts->dedup_on = dedup && (dedup->exact || dedup->near);
+    if (dedup)
+        ts->dedup = *dedup;
+    pthread_mutex_unlock(&ts->write_lock);
+    return 0;
+}
+
+int fossil_ai_train_dedup_stats(void* model, fossil_ai_train_dedup_stats_t* out)
+{
+    fossil_ai_train_state_t* ts = find_state(model, NULL);
+    if (!ts || !out)
+        return -1;
+
+    pthread_mutex_lock(&ts->write_lock);
+    *out = ts->dedup_stats;
+    pthread_mutex_unlock(&ts->write_lock);
+    return 0;
+}
+
+int fossil_ai_train_holdout_attach(void* model, const void* data, size_t rows)
+{
+    fossil_ai_train_state_t* ts = find_state(model, NULL);
+    if (!ts || (!data && rows))
+        return -1;
+
+    pthread_mutex_lock(&ts->write_lock);
+    job_join(ts);
+    ts->holdout = (const float*)data;
+    ts->holdout_rows = data ? rows : 0;
+    pthread_mutex_unlock(&ts->write_lock);
+    return 0;
+}
+
+int fossil_ai_train_validate(void* model)
+{
+    fossil_ai_train_state_t* ts = find_state(model, NULL);
+    if (!ts)
+        return -1;
+
+    pthread_mutex_lock(&ts->write_lock);
+    accum_join(ts);
+    const float* data;
+    size_t rows;
+    validation_source(ts, &data, &rows);
+    if (!data || rows == 0 || index_ensure(&ts->store) != 0) {
+        pthread_mutex_unlock(&ts->write_lock);
+        return -1;
+    }
+
+    fossil_ai_train_metrics_t m;
+    memset(&m, 0, sizeof(m));
+    score_store(&ts->store, data, rows, NULL, 1, 0.0, &m);
+    m.step = ts->steps;
+    pthread_mutex_unlock(&ts->write_lock);
+
+    pthread_mutex_lock(&ts->lock);
+    ts->metrics = m;
+    pthread_mutex_unlock(&ts->lock);
+    return 0;
+}
+
+static int validate_async_locked(fossil_ai_train_state_t* ts, void* model,
+                                 const fossil_ai_train_validation_t* options)
+{
+    if (ts->job) {
+        if (!atomic_load_explicit(&ts->job->done, memory_order_acquire))
+            return 1; /* previous validation still running */
+        job_join(ts);
+    }
+    accum_join(ts);
+
+    const float* data;
+    size_t rows;
+    validation_source(ts, &data, &rows);
+    if (!data || rows == 0)
+        return -1;
+
+    fossil_ai_train_job_t* job = (fossil_ai_train_job_t*)calloc(1, sizeof(*job));
+    if (!job)
+        return -2;
+
+    job->snapshot = store_snapshot(&ts->store);
+    if (!job->snapshot) {
+        free(job);
+        return -2;
+    }
+    job->model = model;
+    job->owner = ts;
+    job->data = data;
+    job->rows = rows;
+    job->step = ts->steps;
+    job->seed = ts->config.seed;
+    if (options)
+        job->options = *options;
+    if (job->options.workers == 0)
+        job->options.workers = online_workers();
+    atomic_init(&job->done, 0);
+
+    if (pthread_create(&job->thread, NULL, validate_job, job) != 0) {
+        store_free(job->snapshot);
+        free(job->snapshot);
+        free(job);
+        return -2;
+    }
+    ts->job = job;
+    return 0;
+}
+
+int fossil_ai_train_validate_async(void* model, const fossil_ai_train_validation_t* options)
+{
+    fossil_ai_train_state_t* ts = find_state(model, NULL);
+    if (!ts)
+        return -1;
+
+    pthread_mutex_lock(&ts->write_lock);
+    int rc = validate_async_locked(ts, model, options);
+    pthread_mutex_unlock(&ts->write_lock);
+    return rc;
+}
+
+int fossil_ai_train_validate_wait(void* model)
+{
+    fossil_ai_train_state_t* ts = find_state(model, NULL);
+    if (!ts)
+        return -1;
+
+    pthread_mutex_lock(&ts->write_lock);
+    job_join(ts);
+    pthread_mutex_unlock(&ts->write_lock);
+    return 0;
+}
+
+int fossil_ai_train_metrics(void* model, fossil_ai_train_metrics_t* out)
+{
+    fossil_ai_train_state_t* ts = find_state(model, NULL);
+    if (!ts || !out)
+        return -1;
+
+    pthread_mutex_lock(&ts->lock);
+    *out = ts->metrics;
+    pthread_mutex_unlock(&ts->lock);
+    return 0;
+}
+
+int fossil_ai_train_early_stop_status(void* model, fossil_ai_train_early_stop_status_t* out)
+{
+    fossil_ai_train_state_t* ts = find_state(model, NULL);
+    if (!ts || !out)
+        return -1;
+
+    pthread_mutex_lock(&ts->write_lock);
+    *out = ts->stop;
+    if (out->validations)
+        out->best = ts->config.early_stop.metric == FOSSIL_AI_TRAIN_METRIC_HIT_RATE
+                  ? out->best : -out->best;
+    pthread_mutex_unlock(&ts->write_lock);
+    return 0;
+}
+
+
+/* =========================================================
+ * Checkpoint
+ * ========================================================= */
+
+static int write_zeros(void* w, size_t n)
+{
+    static const uint8_t zero[FOSSIL_AI_TRAIN_PAGE] = {0};
+    while (n) {
+        size_t k = n < sizeof(zero) ? n : sizeof(zero);
+        if (fossil_ai_io_write(w, zero, k) != 0)
+            return -1;
+        n -= k;
+    }
+    return 0;
+}
+
+static void checkpoint_header(const fossil_ai_train_state_t* ts, const fossil_ai_train_store_t* st,
+                              fossil_ai_train_ckpt_header_t* out)
+{
+    size_t chunk_bytes = FOSSIL_AI_TRAIN_CHUNK_BLOCKS * st->stride;
+    size_t blocks_offset = FOSSIL_AI_TRAIN_PAGE;
+    size_t index_offset = round_up(blocks_offset + st->chunk_count * chunk_bytes,
+                                   FOSSIL_AI_TRAIN_PAGE);
+    size_t index_bytes = st->index_capacity * sizeof(fossil_ai_train_slot_t);
+
+    fossil_ai_train_ckpt_header_t h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, FOSSIL_AI_TRAIN_CKPT_MAGIC, sizeof(h.magic));
+    h.version = FOSSIL_AI_TRAIN_CKPT_VERSION;
+    h.header_size = (uint32_t)sizeof(h);
+    h.input_dim = ts->config.input_dim;
+    h.output_dim = ts->config.output_dim;
+    h.capacity = ts->config.capacity;
+    h.learning_rate = ts->config.learning_rate;
+    h.resolution = ts->config.resolution;
+    h.seed = ts->config.seed;
+    h.rng = ts->rng;
+    h.cursor = ts->cursor;
+    h.epoch = ts->epoch;
+    h.steps = ts->steps;
+    h.block_count = st->block_count;
+    h.block_stride = st->stride;
+    h.chunk_blocks = FOSSIL_AI_TRAIN_CHUNK_BLOCKS;
+    h.blocks_offset = blocks_offset;
+    h.index_capacity = st->index_capacity;
+    h.index_used = st->index_used;
+    h.index_offset = index_bytes ? index_offset : 0;
+    h.file_size = index_offset + index_bytes;
+    h.shuffle_group_rows = ts->shuffle.group_rows;
+    h.shuffle_window_rows = ts->shuffle.window_rows;
+    h.shuffle_seed = ts->shuffle.seed;
+    h.shuffle_stratify = ts->shuffle.stratify_output;
+    h.stop_patience = ts->config.early_stop.patience;
+    h.stop_min_delta = ts->config.early_stop.min_delta;
+    h.stop_metric = ts->config.early_stop.metric;
+    h.stop_min_interval = ts->config.early_stop.min_interval;
+    h.stop_max_interval = ts->config.early_stop.max_interval;
+    h.stop_sample_rows = ts->config.early_stop.sample_rows;
+    h.stop_best = ts->stop.best;
+    h.stop_best_step = ts->stop.best_step;
+    h.stop_bad = ts->stop.bad;
+    h.stop_interval = ts->stop.interval;
+    h.stop_next_step = ts->stop.next_step;
+    h.stop_validations = ts->stop.validations;
+    *out = h;
+}
+
+/* Writes a store snapshot; training may continue while this runs. */
+static int write_checkpoint(const fossil_ai_train_ckpt_header_t* h, const fossil_ai_train_store_t* st,
+                            const char* path)
+{
+    size_t chunk_bytes = FOSSIL_AI_TRAIN_CHUNK_BLOCKS * st->stride;
+    size_t blocks_offset = (size_t)h->blocks_offset;
+    size_t index_offset = round_up(blocks_offset + st->chunk_count * chunk_bytes,
+                                   FOSSIL_AI_TRAIN_PAGE);
+
+    /* Written beside the target and renamed so a crash never leaves a torn checkpoint. */
+    size_t plen = strlen(path);
+    char* tmp = (char*)malloc(plen + 5);
+    if (!tmp)
+        return -2;
+    memcpy(tmp, path, plen);
+    memcpy(tmp + plen, ".tmp", 5);
+
+    /*
+     * The snapshot holds a reference on every chunk and index segment until
+     * the writer closes, so they are queued in place rather than copied.
+     */
+    fossil_ai_io_config_t io;
+    void* w = NULL;
+    memset(&io, 0, sizeof(io));
+#ifdef FOSSIL_AI_TRAIN_HAS_MMAP
+    io.sync = 1;
+#endif
+    if (fossil_ai_io_create(&w, tmp, &io) != 0) {
+        free(tmp);
+        return -1;
+    }
+
+    int rc = 0;
+    if (fossil_ai_io_write(w, h, sizeof(*h)) != 0 || write_zeros(w, blocks_offset - sizeof(*h)) != 0)
+        rc = -1;
+
+    /* Every chunk is written at full size so a resumed session can append in place. */
+    for (size_t c = 0; c < st->chunk_count && rc == 0; ++c) {
+        if (fossil_ai_io_write_ref(w, st->chunks[c]->data, chunk_bytes) != 0)
+            rc = -1;
+    }
+    if (rc == 0)
+        rc = write_zeros(w, index_offset - (blocks_offset + st->chunk_count * chunk_bytes));
+
+    size_t segs = st->index_capacity / FOSSIL_AI_TRAIN_SEGMENT_SLOTS;
+    for (size_t s = 0; s < segs && rc == 0; ++s) {
+        if (fossil_ai_io_write_ref(w, st->segments[s]->slots,
+                                   sizeof(fossil_ai_train_slot_t) * FOSSIL_AI_TRAIN_SEGMENT_SLOTS) != 0)
+            rc = -1;
+    }
+
+    if (fossil_ai_io_close(w) != 0)
+        rc = -1;
+
+    if (rc == 0 && rename(tmp, path) != 0)
+        rc = -1;
+    if (rc != 0)
+        remove(tmp);
+
+    free(tmp);
+    return rc;
+}
+
+int fossil_ai_train_checkpoint(void* model, const char* path)
+{
+    fossil_ai_train_state_t* ts = find_state(model, NULL);
+    if (!ts || !path)
+        return -1;
+
+    pthread_mutex_lock(&ts->checkpoint_lock);
+    pthread_mutex_lock(&ts->write_lock);
+    uint64_t start = now_ns();
+    /* The cursor has moved past rows still pending in micro-batches, so they are applied first. */
+    int rc = accum_flush(ts);
+    if (rc != 0) {
+        pthread_mutex_unlock(&ts->write_lock);
+        pthread_mutex_unlock(&ts->checkpoint_lock);
+        return rc;
+    }
+    fossil_ai_train_ckpt_header_t h;
+    fossil_ai_train_store_t* snap = store_snapshot(&ts->store);
+    if (snap)
+        checkpoint_header(ts, snap, &h);
+    uint64_t stall = now_ns() - start;
+    pthread_mutex_unlock(&ts->write_lock);
+
+    rc = -2;
+    if (snap) {
+        rc = write_checkpoint(&h, snap, path);
+        store_free(snap);
+        free(snap);
+    }
+
+    fossil_ai_train_phases_t ph;
+    memset(&ph, 0, sizeof(ph));
+    ph.total_ns = now_ns() - start;
+    pthread_mutex_lock(&ts->write_lock);
+    ts->profile.checkpoints++;
+    ts->profile.checkpoint_ns += stall;
+    ts->profile.last_checkpoint_ns = stall;
+    trace_push(ts, FOSSIL_AI_TRAIN_TRACE_CHECKPOINT, start, &ph);
+    pthread_mutex_unlock(&ts->write_lock);
+    pthread_mutex_unlock(&ts->checkpoint_lock);
+    return rc;
+}
+
+
+/* =========================================================
+ * Instrumentation
+ * ========================================================= */
+
+int fossil_ai_train_audit_attach(void* model, void* audit_ctx)
+{
+    fossil_ai_train_state_t* ts = find_state(model, NULL);
+    if (!ts)
+        return -1;
+
+    pthread_mutex_lock(&ts->write_lock);
+    ts->audit = audit_ctx;
+    pthread_mutex_unlock(&ts->write_lock);
+    return 0;
+}
+
+int fossil_ai_train_profile(void* model, fossil_ai_train_profile_t* out)
+{
+    fossil_ai_train_state_t* ts = find_state(model, NULL);
+    if (!ts || !out)
+        return -1;
+
+    pthread_mutex_lock(&ts->write_lock);
+    *out = ts->profile;
+    pthread_mutex_unlock(&ts->write_lock);
+    out->rows_per_sec = out->total.total_ns
+        ? (double)out->total.rows * 1e9 / (double)out->total.total_ns
+        : 0.0;
+    return 0;
+}
+
+int fossil_ai_train_profile_reset(void* model)
+{
+    fossil_ai_train_state_t* ts = find_state(model, NULL);
+    if (!ts)
+        return -1;
+
+    pthread_mutex_lock(&ts->write_lock);
+    memset(&ts->profile, 0, sizeof(ts->profile));
+    ts->trace_head = 0;
+    ts->trace_count = 0;
+    pthread_mutex_unlock(&ts->write_lock);
+    return 0;
+}
+
+/*
+ * Writes the retained events in Chrome trace-event JSON; phases are laid out back to back.
+ * The events are copied under the write lock so the file is written without it.
+ */
+int fossil_ai_train_trace_export(void* model, const char* path)
+{
+    fossil_ai_train_state_t* ts = find_state(model, NULL);
+    if (!ts || !path)
+        return -1;
+
+    fossil_ai_train_trace_event_t* events = NULL;
+    size_t count = 0;
+
+    pthread_mutex_lock(&ts->write_lock);
+    if (ts->trace_count) {
+        events = (fossil_ai_train_trace_event_t*)malloc(ts->trace_count * sizeof(*events));
+        if (!events) {
+            pthread_mutex_unlock(&ts->write_lock);
+            return -2;
+        }
+        size_t first = (ts->trace_head + FOSSIL_AI_TRAIN_TRACE_EVENTS - ts->trace_count)
+                     % FOSSIL_AI_TRAIN_TRACE_EVENTS;
+        for (; count < ts->trace_count; ++count)
+            events[count] = ts->trace[(first + count) % FOSSIL_AI_TRAIN_TRACE_EVENTS];
+    }
+    pthread_mutex_unlock(&ts->write_lock);
+
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        free(events);
+        return -1;
+    }
+
+    static const char* names[5] = { "data_wait", "hash", "insert", "compute", "audit" };
+    int sep = 0;
+
+    fprintf(f, "{\"traceEvents\":[");
+    for (size_t n = 0; n < count; ++n) {
+        const fossil_ai_train_trace_event_t* e = &events[n];
+        const fossil_ai_train_phases_t* ph = &e->phases;
+        double ts_us = (double)e->start_ns / 1000.0;
+
+        if (e->kind == FOSSIL_AI_TRAIN_TRACE_CHECKPOINT) {
+            fprintf(f, "%s{\"name\":\"checkpoint\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+                       "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"step\":%llu}}",
+                    sep ? "," : "", ts_us, (double)ph->total_ns / 1000.0,
+                    (unsigned long long)e->step);
+            sep = 1;
+            continue;
+        }
+
+        fprintf(f, "%s{\"name\":\"train_step\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+                   "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"step\":%llu,\"rows\":%llu}}",
+                sep ? "," : "", ts_us, (double)ph->total_ns / 1000.0,
+                (unsigned long long)e->step, (unsigned long long)ph->rows);
+        sep = 1;
+
+        uint64_t parts[5] = { ph->data_wait_ns, ph->hash_ns, ph->insert_ns,
+                              ph->compute_ns, ph->audit_ns };
+        double at = ts_us;
+        for (int i = 0; i < 5; ++i) {
+            if (!parts[i])
+                continue;
+            fprintf(f, ",{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+                       "\"ts\":%.3f,\"dur\":%.3f}",
+                    names[i], at, (double)parts[i] / 1000.0);
+            at += (double)parts[i] / 1000.0;
+        }
+    }
+    fprintf(f, "],\"displayTimeUnit\":\"ns\"}\n");
+    free(events);
+
+    return fclose(f) == 0 ? 0 : -1;
+}
@@ -0,0 +1,1728 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#include <fossil/pizza/framework.h>
+#include "fossil/ai/audit.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Utilities
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// Setup steps for things like test fixtures and
+// mock objects are set here.
+// * * * * * * * * * * * * * * * * * * * * * * * *
+
+#define AUDIT_TEST_LOG "fossil_ai_audit_test.log"
+#define AUDIT_TEST_LOG_B "fossil_ai_audit_test_b.log"
+#define AUDIT_TEST_SEGMENTS "fossil_ai_audit_test_seg"
+#define AUDIT_TEST_SEGMENT_MAX 256
+#define AUDIT_TEST_MARK "audit-test-marker"
+
+FOSSIL_SUITE(c_audit_fixture);
+
+static void segments_remove(void) {
+    remove(AUDIT_TEST_SEGMENTS ".idx");
+    for (int i = 0; i < AUDIT_TEST_SEGMENT_MAX; ++i) {
+        char path[64];
+        snprintf(path, sizeof(path), "%s.%08d.log", AUDIT_TEST_SEGMENTS, i);
+        remove(path);
+    }
+}
+
+FOSSIL_SETUP(c_audit_fixture) {
+    // Setup the test fixture
+}
+
+FOSSIL_TEARDOWN(c_audit_fixture) {
+    remove(AUDIT_TEST_LOG);
+    remove(AUDIT_TEST_LOG_B);
+    segments_remove();
+}
+
+static void* audit_open(void) {
+    fossil_ai_audit_config_t config;
+    void* ctx = NULL;
+    memset(&config, 0, sizeof(config));
+    if (fossil_ai_audit_begin_ex(&ctx, &config) != 0)
+        return NULL;
+    return ctx;
+}
+
+static void* audit_open_segments(size_t segment_bytes, int compress) {
+    fossil_ai_audit_config_t config;
+    void* ctx = NULL;
+    memset(&config, 0, sizeof(config));
+    config.segments = AUDIT_TEST_SEGMENTS;
+    config.segment_bytes = segment_bytes;
+    config.compress = compress;
+    if (fossil_ai_audit_begin_ex(&ctx, &config) != 0)
+        return NULL;
+    return ctx;
+}
+
+static int audit_fill(void* ctx, int count) {
+    for (int i = 0; i < count; ++i) {
+        char payload[64];
+        int len = snprintf(payload, sizeof(payload), "%s %d", AUDIT_TEST_MARK, i);
+        if (fossil_ai_audit_record(ctx, "test.record", payload, (size_t)len) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+static long file_find(const char* path, const char* needle) {
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return -1;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char* buf = (char*)malloc((size_t)size);
+    long at = -1;
+    if (buf && fread(buf, 1, (size_t)size, f) == (size_t)size) {
+        size_t n = strlen(needle);
+        for (long i = 0; i + (long)n <= size; ++i) {
+            if (memcmp(buf + i, needle, n) == 0) {
+                at = i;
+                break;
+            }
+        }
+    }
+    free(buf);
+    fclose(f);
+    return at;
+}
+
+static long file_size(const char* path) {
+    FILE* f = fopen(path, "rb");
+    long size = -1;
+    if (f) {
+        fseek(f, 0, SEEK_END);
+        size = ftell(f);
+        fclose(f);
+    }
+    return size;
+}
+
+static int file_flip(const char* path, long offset) {
+    FILE* f = fopen(path, "r+b");
+    if (!f)
+        return -1;
+    fseek(f, offset, SEEK_SET);
+    int ch = fgetc(f);
+    fseek(f, offset, SEEK_SET);
+    fputc(ch ^ 1, f);
+    return fclose(f);
+}
+
+/* Reads what was written to a temporary stream back as a NUL-terminated string. */
+static char* stream_text(FILE* f) {
+    long size = ftell(f);
+    char* buf = size >= 0 ? (char*)malloc((size_t)size + 1) : NULL;
+    rewind(f);
+    if (buf && fread(buf, 1, (size_t)size, f) == (size_t)size) {
+        buf[size] = '\0';
+    } else {
+        free(buf);
+        buf = NULL;
+    }
+    return buf;
+}
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Cases
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// The test cases below are provided as samples, inspired
+// by the Meson build system's approach of using test cases
+// as samples for library usage.
+// * * * * * * * * * * * * * * * * * * * * * * * *
+
+// ======================================================
+// Record / Flush / Verify
+// ======================================================
+
+FOSSIL_TEST(c_test_audit_record_flush_verify) {
+    void* ctx = audit_open();
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx == NULL)
+        return;
+
+    fossil_ai_audit_stats_t stats;
+    ASSUME_ITS_TRUE(audit_fill(ctx, 500) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_flush(ctx) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_stats(ctx, &stats) == 0);
+    ASSUME_ITS_TRUE(stats.records == 500);
+    ASSUME_ITS_TRUE(fossil_ai_audit_export(ctx, AUDIT_TEST_LOG) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify(AUDIT_TEST_LOG) == 0);
+    fossil_ai_audit_end(ctx);
+}
+
+FOSSIL_TEST(c_test_audit_record_inference_verify) {
+    void* ctx = audit_open();
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx == NULL)
+        return;
+
+    float input[4] = { 1.0f, 2.0f, 3.0f, 4.0f };
+    float output[2] = { 0.5f, 0.25f };
+    ASSUME_ITS_TRUE(fossil_ai_audit_record_inference(ctx, NULL, input, sizeof(input),
+                                                     output, sizeof(output)) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_export(ctx, AUDIT_TEST_LOG) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify(AUDIT_TEST_LOG) == 0);
+    fossil_ai_audit_end(ctx);
+}
+
+FOSSIL_TEST(c_test_audit_hash_only_verify) {
+    void* ctx = audit_open();
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx == NULL)
+        return;
+
+    fossil_ai_audit_stats_t stats;
+    ASSUME_ITS_TRUE(fossil_ai_audit_set_level(ctx, FOSSIL_AI_AUDIT_HASH_ONLY, 1.0) == 0);
+    ASSUME_ITS_TRUE(audit_fill(ctx, 100) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_flush(ctx) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_stats(ctx, &stats) == 0);
+    ASSUME_ITS_TRUE(stats.omitted == 100);
+    ASSUME_ITS_TRUE(fossil_ai_audit_export(ctx, AUDIT_TEST_LOG) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify(AUDIT_TEST_LOG) == 0);
+    ASSUME_ITS_TRUE(file_find(AUDIT_TEST_LOG, AUDIT_TEST_MARK) < 0);
+    fossil_ai_audit_end(ctx);
+}
+
+FOSSIL_TEST(c_test_audit_invalid_arguments) {
+    void* ctx = audit_open();
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx == NULL)
+        return;
+
+    ASSUME_ITS_TRUE(fossil_ai_audit_record(NULL, "k", "x", 1) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_audit_flush(NULL) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_audit_set_level(ctx, 9, 1.0) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_audit_set_level(ctx, FOSSIL_AI_AUDIT_SAMPLED, 1.5) == -1);
+    ASSUME_ITS_FALSE(fossil_ai_audit_verify("nonexistent_audit.log") == 0);
+    fossil_ai_audit_end(ctx);
+}
+
+#ifdef __linux__
+FOSSIL_TEST(c_test_audit_journal_failure_is_sticky) {
+    fossil_ai_audit_config_t config;
+    void* ctx = NULL;
+    char payload[4096];
+
+    memset(&config, 0, sizeof(config));
+    memset(payload, 0, sizeof(payload));
+    config.journal = "/dev/full";
+    config.sync = 1;
+    ASSUME_ITS_TRUE(fossil_ai_audit_begin_ex(&ctx, &config) == 0);
+    if (ctx == NULL)
+        return;
+
+    for (int i = 0; i < 4; ++i)
+        fossil_ai_audit_record(ctx, "test.record", payload, sizeof(payload));
+    ASSUME_ITS_TRUE(fossil_ai_audit_flush(ctx) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_audit_record(ctx, "test.record", "x", 1) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_audit_export(ctx, AUDIT_TEST_LOG) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_audit_end(ctx) == -1);
+}
+#endif
+
+// ======================================================
+// Concurrent Recording
+// ======================================================
+
+#if !defined(_WIN32)
+#define AUDIT_TEST_THREADS 8
+#define AUDIT_TEST_PER_THREAD 2000
+
+typedef struct audit_writer {
+    void* ctx;
+    int id;
+    int rc;
+} audit_writer_t;
+
+static void* audit_writer_main(void* arg) {
+    audit_writer_t* w = (audit_writer_t*)arg;
+    for (int i = 0; i < AUDIT_TEST_PER_THREAD && w->rc == 0; ++i) {
+        int value = w->id << 16 | i;
+        w->rc = fossil_ai_audit_record(w->ctx, "test.thread", &value, sizeof(value));
+    }
+    return NULL;
+}
+
+/* Records from AUDIT_TEST_THREADS threads at once; 0 when every record went in. */
+static int audit_fill_threads(void* ctx) {
+    audit_writer_t writers[AUDIT_TEST_THREADS];
+    pthread_t threads[AUDIT_TEST_THREADS];
+    int rc = 0;
+    for (int t = 0; t < AUDIT_TEST_THREADS; ++t) {
+        writers[t].ctx = ctx;
+        writers[t].id = t;
+        writers[t].rc = 0;
+        if (pthread_create(&threads[t], NULL, audit_writer_main, &writers[t]) != 0) {
+            audit_writer_main(&writers[t]);
+            writers[t].id = -1;
+        }
+    }
+    for (int t = 0; t < AUDIT_TEST_THREADS; ++t) {
+        if (writers[t].id >= 0)
+            pthread_join(threads[t], NULL);
+        rc |= writers[t].rc;
+    }
+    return rc;
+}
+
+typedef struct audit_merged {
+    uint64_t count;
+    int gaps;                   /* seq did not follow on from the record before */
+    int reordered;              /* a thread's records came out of its own order */
+    int next[AUDIT_TEST_THREADS];
+} audit_merged_t;
+
+static int audit_check_merged(const fossil_ai_audit_item_t* item, void* user) {
+    audit_merged_t* m = (audit_merged_t*)user;
+    int value = -1;
+    if (item->seq != m->count)
+        m->gaps++;
+    if (item->data && item->size == sizeof(value))
+        memcpy(&value, item->data, sizeof(value));
+    int t = value >> 16;
+    if (value < 0 || t >= AUDIT_TEST_THREADS || (value & 0xFFFF) != m->next[t])
+        m->reordered++;
+    else
+        m->next[t]++;
+    m->count++;
+    return 0;
+}
+
+FOSSIL_TEST(c_test_audit_threads_merge_in_order) {
+    fossil_ai_audit_config_t config;
+    fossil_ai_audit_stats_t stats;
+    audit_merged_t merged;
+    void* ctx = NULL;
+
+    // Small buffers make writers wait on the flusher as well.
+    memset(&config, 0, sizeof(config));
+    config.buffer_bytes = 4096;
+    ASSUME_ITS_TRUE(fossil_ai_audit_begin_ex(&ctx, &config) == 0);
+    if (ctx == NULL)
+        return;
+
+    ASSUME_ITS_TRUE(audit_fill_threads(ctx) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_flush(ctx) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_stats(ctx, &stats) == 0);
+    ASSUME_ITS_TRUE(stats.records == AUDIT_TEST_THREADS * AUDIT_TEST_PER_THREAD);
+    ASSUME_ITS_TRUE(stats.groups > 0 && stats.groups < stats.records);
+    ASSUME_ITS_TRUE(fossil_ai_audit_export(ctx, AUDIT_TEST_LOG) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_end(ctx) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify(AUDIT_TEST_LOG) == 0);
+
+    // The log holds one gap-free sequence, and each thread's records keep their order.
+    memset(&merged, 0, sizeof(merged));
+    ASSUME_ITS_TRUE(fossil_ai_audit_query(AUDIT_TEST_LOG, NULL, 0, UINT64_MAX,
+                                          audit_check_merged, &merged) == 0);
+    ASSUME_ITS_TRUE(merged.count == AUDIT_TEST_THREADS * AUDIT_TEST_PER_THREAD);
+    ASSUME_ITS_TRUE(merged.gaps == 0);
+    ASSUME_ITS_TRUE(merged.reordered == 0);
+}
+
+FOSSIL_TEST(c_test_audit_journal_group_commit) {
+    fossil_ai_audit_config_t config;
+    fossil_ai_audit_stats_t stats;
+    void* ctx = NULL;
+
+    memset(&config, 0, sizeof(config));
+    config.journal = AUDIT_TEST_LOG_B;
+    config.sync = 1;
+    ASSUME_ITS_TRUE(fossil_ai_audit_begin_ex(&ctx, &config) == 0);
+    if (ctx == NULL)
+        return;
+
+    ASSUME_ITS_TRUE(audit_fill_threads(ctx) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_flush(ctx) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_stats(ctx, &stats) == 0);
+    ASSUME_ITS_TRUE(stats.records == AUDIT_TEST_THREADS * AUDIT_TEST_PER_THREAD);
+    // One fdatasync per group, and groups batch many records.
+    ASSUME_ITS_TRUE(stats.syncs == stats.groups);
+    ASSUME_ITS_TRUE(stats.groups < stats.records);
+    ASSUME_ITS_TRUE(fossil_ai_audit_end(ctx) == 0);
+
+    ASSUME_ITS_TRUE(file_size(AUDIT_TEST_LOG_B) == (long)stats.bytes);
+}
+#endif
+
+// ======================================================
+// Binary Log Format
+// ======================================================
+
+#define AUDIT_TEST_FOOTER_BYTES 128   /* magic, three counters and three hashes */
+
+typedef struct audit_payload {
+    size_t count;
+    int same;
+    const unsigned char* want;
+    size_t want_size;
+} audit_payload_t;
+
+static int audit_match_payload(const fossil_ai_audit_item_t* item, void* user) {
+    audit_payload_t* p = (audit_payload_t*)user;
+    p->count++;
+    p->same &= item->data && item->size == p->want_size &&
+               memcmp(item->data, p->want, p->want_size) == 0;
+    return 0;
+}
+
+FOSSIL_TEST(c_test_audit_binary_framing) {
+    static const unsigned char raw[8] = { 0, '\n', 0xFF, ' ', 0, '\r', 0x80, 0 };
+    audit_payload_t seen;
+    void* ctx = audit_open();
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx == NULL)
+        return;
+
+    for (int i = 0; i < 50; ++i)
+        ASSUME_ITS_TRUE(fossil_ai_audit_record(ctx, "bin", raw, sizeof(raw)) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_export(ctx, AUDIT_TEST_LOG) == 0);
+    fossil_ai_audit_end(ctx);
+
+    // A fixed header up front and the footer closing the file.
+    long size = file_size(AUDIT_TEST_LOG);
+    ASSUME_ITS_TRUE(file_find(AUDIT_TEST_LOG, "FAIAUDT") == 0);
+    ASSUME_ITS_TRUE(file_find(AUDIT_TEST_LOG, "FAIAEND") == size - AUDIT_TEST_FOOTER_BYTES);
+
+    // Length-prefixed records carry any byte, newlines and NULs included.
+    memset(&seen, 0, sizeof(seen));
+    seen.same = 1;
+    seen.want = raw;
+    seen.want_size = sizeof(raw);
+    ASSUME_ITS_TRUE(fossil_ai_audit_query(AUDIT_TEST_LOG, "bin", 0, UINT64_MAX,
+                                          audit_match_payload, &seen) == 0);
+    ASSUME_ITS_TRUE(seen.count == 50);
+    ASSUME_ITS_TRUE(seen.same);
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify(AUDIT_TEST_LOG) == 0);
+}
+
+FOSSIL_TEST(c_test_audit_binary_empty) {
+    audit_payload_t seen;
+    void* ctx = audit_open();
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx == NULL)
+        return;
+
+    ASSUME_ITS_TRUE(fossil_ai_audit_export(ctx, AUDIT_TEST_LOG) == 0);
+    fossil_ai_audit_end(ctx);
+    memset(&seen, 0, sizeof(seen));
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify(AUDIT_TEST_LOG) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_query(AUDIT_TEST_LOG, NULL, 0, UINT64_MAX,
+                                          audit_match_payload, &seen) == 0);
+    ASSUME_ITS_TRUE(seen.count == 0);
+}
+
+FOSSIL_TEST(c_test_audit_binary_rejects_foreign) {
+    audit_payload_t seen;
+    void* ctx = audit_open();
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx == NULL)
+        return;
+
+    ASSUME_ITS_TRUE(audit_fill(ctx, 20) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_export(ctx, AUDIT_TEST_LOG) == 0);
+    fossil_ai_audit_end(ctx);
+
+    // A text log of the old kind, then an empty file.
+    FILE* f = fopen(AUDIT_TEST_LOG_B, "wb");
+    if (f) {
+        fputs("0 1700000000 test.record " AUDIT_TEST_MARK " 0\n", f);
+        fclose(f);
+    }
+    memset(&seen, 0, sizeof(seen));
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify(AUDIT_TEST_LOG_B) == -3);
+    ASSUME_ITS_TRUE(fossil_ai_audit_diff(AUDIT_TEST_LOG, AUDIT_TEST_LOG_B, NULL) == -3);
+    ASSUME_ITS_FALSE(fossil_ai_audit_query(AUDIT_TEST_LOG_B, NULL, 0, UINT64_MAX,
+                                           audit_match_payload, &seen) == 0);
+    ASSUME_ITS_TRUE(seen.count == 0);
+    f = fopen(AUDIT_TEST_LOG_B, "wb");
+    if (f)
+        fclose(f);
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify(AUDIT_TEST_LOG_B) == -3);
+
+    // The footer must close the file.
+    ASSUME_ITS_TRUE(file_flip(AUDIT_TEST_LOG, file_size(AUDIT_TEST_LOG) - AUDIT_TEST_FOOTER_BYTES) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify(AUDIT_TEST_LOG) == -3);
+}
+
+// ======================================================
+// Tamper Detection
+// ======================================================
+
+FOSSIL_TEST(c_test_audit_tamper_payload) {
+    void* ctx = audit_open();
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx == NULL)
+        return;
+
+    ASSUME_ITS_TRUE(audit_fill(ctx, 200) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_export(ctx, AUDIT_TEST_LOG) == 0);
+    fossil_ai_audit_end(ctx);
+
+    long at = file_find(AUDIT_TEST_LOG, AUDIT_TEST_MARK " 150");
+    ASSUME_ITS_TRUE(at > 0);
+    if (at <= 0)
+        return;
+    ASSUME_ITS_TRUE(file_flip(AUDIT_TEST_LOG, at) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify(AUDIT_TEST_LOG) == 1);
+}
+
+FOSSIL_TEST(c_test_audit_tamper_truncated) {
+    void* ctx = audit_open();
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx == NULL)
+        return;
+
+    ASSUME_ITS_TRUE(audit_fill(ctx, 200) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_export(ctx, AUDIT_TEST_LOG) == 0);
+    fossil_ai_audit_end(ctx);
+
+    long at = file_find(AUDIT_TEST_LOG, AUDIT_TEST_MARK " 100");
+    ASSUME_ITS_TRUE(at > 0);
+    FILE* f = fopen(AUDIT_TEST_LOG, "rb");
+    char* head = (char*)malloc((size_t)at);
+    size_t got = f && head ? fread(head, 1, (size_t)at, f) : 0;
+    if (f)
+        fclose(f);
+    f = fopen(AUDIT_TEST_LOG, "wb");
+    if (f) {
+        fwrite(head, 1, got, f);
+        fclose(f);
+    }
+    free(head);
+    ASSUME_ITS_FALSE(fossil_ai_audit_verify(AUDIT_TEST_LOG) == 0);
+}
+
+FOSSIL_TEST(c_test_audit_tamper_across_tasks) {
+    static const char* marks[3] = { AUDIT_TEST_MARK " 3", AUDIT_TEST_MARK " 9000",
+                                    AUDIT_TEST_MARK " 19999" };
+    void* ctx = audit_open();
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx == NULL)
+        return;
+
+    // Enough records for several verification tasks; damage is caught in each.
+    ASSUME_ITS_TRUE(audit_fill(ctx, 20000) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_export(ctx, AUDIT_TEST_LOG) == 0);
+    fossil_ai_audit_end(ctx);
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify(AUDIT_TEST_LOG) == 0);
+
+    for (int m = 0; m < 3; ++m) {
+        long at = file_find(AUDIT_TEST_LOG, marks[m]);
+        ASSUME_ITS_TRUE(at > 0);
+        if (at <= 0)
+            continue;
+        ASSUME_ITS_TRUE(file_flip(AUDIT_TEST_LOG, at) == 0);
+        ASSUME_ITS_TRUE(fossil_ai_audit_verify(AUDIT_TEST_LOG) == 1);
+        ASSUME_ITS_TRUE(file_flip(AUDIT_TEST_LOG, at) == 0);
+        ASSUME_ITS_TRUE(fossil_ai_audit_verify(AUDIT_TEST_LOG) == 0);
+    }
+}
+
+// ======================================================
+// Inclusion / Consistency Proofs
+// ======================================================
+
+FOSSIL_TEST(c_test_audit_inclusion_proof) {
+    void* ctx = audit_open();
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx == NULL)
+        return;
+
+    uint8_t root[FOSSIL_AI_AUDIT_HASH_SIZE];
+    uint8_t leaf[FOSSIL_AI_AUDIT_HASH_SIZE];
+    uint8_t proof[FOSSIL_AI_AUDIT_PROOF_MAX * FOSSIL_AI_AUDIT_HASH_SIZE];
+    uint64_t size = 0;
+    size_t count = 0;
+    int ok = 1, caught = 1;
+
+    ASSUME_ITS_TRUE(audit_fill(ctx, 37) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_root(ctx, &size, root) == 0);
+    ASSUME_ITS_TRUE(size == 37);
+    for (uint64_t i = 0; i < size; ++i) {
+        ok &= fossil_ai_audit_leaf(ctx, i, leaf) == 0;
+        ok &= fossil_ai_audit_inclusion_proof(ctx, i, size, proof, &count) == 0;
+        ok &= fossil_ai_audit_verify_inclusion(leaf, i, size, proof, count, root) == 0;
+        proof[0] ^= 1;
+        caught &= fossil_ai_audit_verify_inclusion(leaf, i, size, proof, count, root) == 1;
+    }
+    ASSUME_ITS_TRUE(ok);
+    ASSUME_ITS_TRUE(caught);
+    ASSUME_ITS_FALSE(fossil_ai_audit_inclusion_proof(ctx, size, size, proof, &count) == 0);
+    fossil_ai_audit_end(ctx);
+}
+
+FOSSIL_TEST(c_test_audit_consistency_proof) {
+    void* ctx = audit_open();
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx == NULL)
+        return;
+
+    uint8_t roots[41][FOSSIL_AI_AUDIT_HASH_SIZE];
+    uint8_t proof[FOSSIL_AI_AUDIT_PROOF_MAX * FOSSIL_AI_AUDIT_HASH_SIZE];
+    uint64_t size = 0;
+    size_t count = 0;
+    int ok = 1, caught = 1;
+
+    ok &= fossil_ai_audit_root(ctx, &size, roots[0]) == 0;
+    for (int i = 1; i <= 40; ++i) {
+        ok &= audit_fill(ctx, 1) == 0;
+        ok &= fossil_ai_audit_root(ctx, &size, roots[i]) == 0 && size == (uint64_t)i;
+    }
+    for (uint64_t a = 1; a <= 40; ++a) {
+        for (uint64_t b = a; b <= 40; ++b) {
+            ok &= fossil_ai_audit_consistency_proof(ctx, a, b, proof, &count) == 0;
+            ok &= fossil_ai_audit_verify_consistency(a, roots[a], b, roots[b], proof, count) == 0;
+            if (a < b)
+                caught &= fossil_ai_audit_verify_consistency(a, roots[a], b, roots[b - 1],
+                                                             proof, count) == 1;
+        }
+    }
+    ASSUME_ITS_TRUE(ok);
+    ASSUME_ITS_TRUE(caught);
+
+    ASSUME_ITS_TRUE(fossil_ai_audit_export(ctx, AUDIT_TEST_LOG) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify_from(AUDIT_TEST_LOG, 20, roots[20]) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify_from(AUDIT_TEST_LOG, 20, roots[21]) == 1);
+    fossil_ai_audit_end(ctx);
+}
+
+FOSSIL_TEST(c_test_audit_verify_from_skips_history) {
+    uint8_t root[FOSSIL_AI_AUDIT_HASH_SIZE];
+    uint64_t size = 0;
+    int ok = 1;
+    void* ctx = audit_open();
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx == NULL)
+        return;
+
+    ASSUME_ITS_TRUE(audit_fill(ctx, 12000) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_root(ctx, &size, root) == 0);
+    ASSUME_ITS_TRUE(size == 12000);
+    for (int i = 0; i < 8000; ++i) {
+        char payload[32];
+        int len = snprintf(payload, sizeof(payload), "late %d", i);
+        ok &= fossil_ai_audit_record(ctx, "test.late", payload, (size_t)len) == 0;
+    }
+    ASSUME_ITS_TRUE(ok);
+    ASSUME_ITS_TRUE(fossil_ai_audit_export(ctx, AUDIT_TEST_LOG) == 0);
+    fossil_ai_audit_end(ctx);
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify_from(AUDIT_TEST_LOG, size, root) == 0);
+
+    // Damage below the trusted size is only found by a full pass.
+    long old_at = file_find(AUDIT_TEST_LOG, AUDIT_TEST_MARK " 100");
+    ASSUME_ITS_TRUE(old_at > 0);
+    ASSUME_ITS_TRUE(file_flip(AUDIT_TEST_LOG, old_at) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify_from(AUDIT_TEST_LOG, size, root) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify(AUDIT_TEST_LOG) == 1);
+
+    long new_at = file_find(AUDIT_TEST_LOG, "late 3000");
+    ASSUME_ITS_TRUE(new_at > 0);
+    ASSUME_ITS_TRUE(file_flip(AUDIT_TEST_LOG, new_at) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify_from(AUDIT_TEST_LOG, size, root) == 1);
+
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify_from(AUDIT_TEST_LOG, 20001, root) == 1);
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify_from(AUDIT_TEST_LOG, size, NULL) == -1);
+}
+
+// ======================================================
+// Diff
+// ======================================================
+
+/* Exports count fill records, with record changed (if >= 0) altered and an extra one appended. */
+static int audit_log(const char* path, int count, int changed, int extra) {
+    void* ctx = audit_open();
+    int rc = ctx ? 0 : -1;
+    for (int i = 0; i < count && rc == 0; ++i) {
+        char payload[64];
+        int len = snprintf(payload, sizeof(payload), "%s %d%s", AUDIT_TEST_MARK, i,
+                           i == changed ? " changed" : "");
+        rc = fossil_ai_audit_record(ctx, "test.record", payload, (size_t)len);
+    }
+    if (rc == 0 && extra)
+        rc = fossil_ai_audit_record(ctx, "test.extra", "x", 1);
+    if (rc == 0)
+        rc = fossil_ai_audit_export(ctx, path);
+    if (ctx)
+        fossil_ai_audit_end(ctx);
+    return rc;
+}
+
+FOSSIL_TEST(c_test_audit_diff_same) {
+    FILE* out = tmpfile();
+    ASSUME_NOT_CNULL(out);
+    if (out == NULL)
+        return;
+
+    // Separate sessions stamp different times; only content counts.
+    ASSUME_ITS_TRUE(audit_log(AUDIT_TEST_LOG, 300, -1, 0) == 0);
+    ASSUME_ITS_TRUE(audit_log(AUDIT_TEST_LOG_B, 300, -1, 0) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_diff(AUDIT_TEST_LOG, AUDIT_TEST_LOG_B, out) == 0);
+    ASSUME_ITS_TRUE(ftell(out) == 0);
+    fclose(out);
+}
+
+FOSSIL_TEST(c_test_audit_diff_changed_record) {
+    FILE* out = tmpfile();
+    ASSUME_NOT_CNULL(out);
+    if (out == NULL)
+        return;
+
+    ASSUME_ITS_TRUE(audit_log(AUDIT_TEST_LOG, 300, -1, 0) == 0);
+    ASSUME_ITS_TRUE(audit_log(AUDIT_TEST_LOG_B, 300, 77, 0) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_diff(AUDIT_TEST_LOG, AUDIT_TEST_LOG_B, out) == 1);
+    char* text = stream_text(out);
+    ASSUME_NOT_CNULL(text);
+    if (text) {
+        ASSUME_ITS_TRUE(strcmp(text, "- 77 test.record\n+ 77 test.record\n") == 0);
+        free(text);
+    }
+    fclose(out);
+}
+
+FOSSIL_TEST(c_test_audit_diff_appended_record) {
+    FILE* out = tmpfile();
+    ASSUME_NOT_CNULL(out);
+    if (out == NULL)
+        return;
+
+    ASSUME_ITS_TRUE(audit_log(AUDIT_TEST_LOG, 300, -1, 0) == 0);
+    ASSUME_ITS_TRUE(audit_log(AUDIT_TEST_LOG_B, 300, -1, 1) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_diff(AUDIT_TEST_LOG, AUDIT_TEST_LOG_B, out) == 1);
+    char* text = stream_text(out);
+    ASSUME_NOT_CNULL(text);
+    if (text) {
+        ASSUME_ITS_TRUE(strcmp(text, "+ 300 test.extra\n") == 0);
+        free(text);
+    }
+    fclose(out);
+}
+
+FOSSIL_TEST(c_test_audit_diff_damaged) {
+    ASSUME_ITS_TRUE(audit_log(AUDIT_TEST_LOG, 10, -1, 0) == 0);
+    FILE* f = fopen(AUDIT_TEST_LOG_B, "wb");
+    ASSUME_NOT_CNULL(f);
+    if (f) {
+        fputs("not an audit log", f);
+        fclose(f);
+    }
+    ASSUME_ITS_TRUE(fossil_ai_audit_diff(AUDIT_TEST_LOG, AUDIT_TEST_LOG_B, NULL) == -3);
+    ASSUME_ITS_TRUE(fossil_ai_audit_diff(AUDIT_TEST_LOG, NULL, NULL) == -1);
+    ASSUME_ITS_FALSE(fossil_ai_audit_diff(AUDIT_TEST_LOG, "nonexistent_audit.log", NULL) == 0);
+}
+
+// ======================================================
+// Segments
+// ======================================================
+
+/*
+ * Fills in flushed batches. The flusher seals after each commit, so by the
+ * time a batch is flushed every earlier batch is in a sealed segment.
+ */
+static int audit_fill_batches(void* ctx, int batches, int count) {
+    for (int b = 0; b < batches; ++b) {
+        for (int i = 0; i < count; ++i) {
+            char payload[64];
+            int len = snprintf(payload, sizeof(payload), "%s %d", AUDIT_TEST_MARK, b * count + i);
+            if (fossil_ai_audit_record(ctx, "test.record", payload, (size_t)len) != 0)
+                return -1;
+        }
+        if (fossil_ai_audit_flush(ctx) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+/* Finds the first sealed segment holding needle; fills path and returns the offset. */
+static long segment_find(const char* needle, char* path, size_t cap) {
+    for (int i = 0; i < AUDIT_TEST_SEGMENT_MAX; ++i) {
+        snprintf(path, cap, "%s.%08d.log", AUDIT_TEST_SEGMENTS, i);
+        long at = file_find(path, needle);
+        if (at >= 0)
+            return at;
+    }
+    return -1;
+}
+
+FOSSIL_TEST(c_test_audit_segments_rotate_verify) {
+    void* ctx = audit_open_segments(4096, 0);
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx == NULL)
+        return;
+
+    fossil_ai_audit_stats_t stats;
+    ASSUME_ITS_TRUE(audit_fill(ctx, 3000) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_end(ctx) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify_segments(AUDIT_TEST_SEGMENTS) == 0);
+
+    // A second session resumes the numbering and the chain.
+    ctx = audit_open_segments(4096, 0);
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx == NULL)
+        return;
+    ASSUME_ITS_TRUE(audit_fill_batches(ctx, 5, 200) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_stats(ctx, &stats) == 0);
+    ASSUME_ITS_TRUE(stats.segments > 1);
+    ASSUME_ITS_TRUE(fossil_ai_audit_end(ctx) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify_segments(AUDIT_TEST_SEGMENTS) == 0);
+}
+
+FOSSIL_TEST(c_test_audit_segments_export_reads_back) {
+    void* ctx = audit_open_segments(4096, 0);
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx == NULL)
+        return;
+
+    uint64_t size = 0;
+    uint8_t root[FOSSIL_AI_AUDIT_HASH_SIZE];
+    ASSUME_ITS_TRUE(audit_fill_batches(ctx, 10, 200) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_root(ctx, &size, root) == 0);
+    ASSUME_ITS_TRUE(size == 2000);
+
+    // Sealed records have left memory; export reads them back from their segments.
+    ASSUME_ITS_TRUE(fossil_ai_audit_export(ctx, AUDIT_TEST_LOG) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify(AUDIT_TEST_LOG) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify_from(AUDIT_TEST_LOG, size, root) == 0);
+    ASSUME_ITS_TRUE(file_find(AUDIT_TEST_LOG, AUDIT_TEST_MARK " 0") >= 0);
+    ASSUME_ITS_TRUE(file_find(AUDIT_TEST_LOG, AUDIT_TEST_MARK " 1999") >= 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_end(ctx) == 0);
+}
+
+FOSSIL_TEST(c_test_audit_segments_tamper) {
+    char path[64];
+    void* ctx = audit_open_segments(4096, 0);
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx == NULL)
+        return;
+
+    ASSUME_ITS_TRUE(audit_fill_batches(ctx, 10, 200) == 0);
+    long at = segment_find(AUDIT_TEST_MARK " 10", path, sizeof(path));
+    ASSUME_ITS_TRUE(at > 0);
+    if (at <= 0) {
+        fossil_ai_audit_end(ctx);
+        return;
+    }
+    ASSUME_ITS_TRUE(file_flip(path, at) == 0);
+
+    // Neither the verifier nor an export may pass the altered record on.
+    ASSUME_ITS_FALSE(fossil_ai_audit_export(ctx, AUDIT_TEST_LOG) == 0);
+    fossil_ai_audit_end(ctx);
+    ASSUME_ITS_FALSE(fossil_ai_audit_verify_segments(AUDIT_TEST_SEGMENTS) == 0);
+    ASSUME_ITS_FALSE(fossil_ai_audit_verify_segments("nonexistent_audit_seg") == 0);
+}
+
+// ======================================================
+// Query / Lookup
+// ======================================================
+
+#define AUDIT_TEST_QUERY_MAX 3000
+
+typedef struct audit_hits {
+    size_t count;
+    size_t limit;               /* stop after this many, 0 = never */
+    int ordered;
+    uint64_t last_seq;
+    uint64_t times[AUDIT_TEST_QUERY_MAX];
+    int values[AUDIT_TEST_QUERY_MAX];
+} audit_hits_t;
+
+static int audit_collect(const fossil_ai_audit_item_t* item, void* user) {
+    audit_hits_t* h = (audit_hits_t*)user;
+    if (h->count > 0 && item->seq <= h->last_seq)
+        h->ordered = 0;
+    h->last_seq = item->seq;
+    if (h->count < AUDIT_TEST_QUERY_MAX) {
+        h->times[h->count] = item->time_ns;
+        h->values[h->count] = -1;
+        if (item->data && item->size == sizeof(int))
+            memcpy(&h->values[h->count], item->data, sizeof(int));
+    }
+    h->count++;
+    return h->limit && h->count >= h->limit;
+}
+
+static audit_hits_t* audit_hits_new(void) {
+    audit_hits_t* h = (audit_hits_t*)calloc(1, sizeof(audit_hits_t));
+    if (h)
+        h->ordered = 1;
+    return h;
+}
+
+/* Records i = 0..count-1 under keys "a.x", "b.y" and "c" in turn. */
+static int audit_fill_keyed(void* ctx, int count) {
+    static const char* keys[3] = { "a.x", "b.y", "c" };
+    for (int i = 0; i < count; ++i) {
+        if (fossil_ai_audit_record(ctx, keys[i % 3], &i, sizeof(i)) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+FOSSIL_TEST(c_test_audit_query_prefix) {
+    void* ctx = audit_open();
+    audit_hits_t* h = audit_hits_new();
+    ASSUME_NOT_CNULL(ctx);
+    ASSUME_NOT_CNULL(h);
+    if (ctx == NULL || h == NULL) {
+        free(h);
+        return;
+    }
+
+    ASSUME_ITS_TRUE(audit_fill_keyed(ctx, 3000) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_export(ctx, AUDIT_TEST_LOG) == 0);
+    fossil_ai_audit_end(ctx);
+
+    ASSUME_ITS_TRUE(fossil_ai_audit_query(AUDIT_TEST_LOG, "b", 0, UINT64_MAX, audit_collect, h) == 0);
+    ASSUME_ITS_TRUE(h->count == 1000);
+    ASSUME_ITS_TRUE(h->ordered);
+    ASSUME_ITS_TRUE(h->values[0] == 1 && h->values[999] == 2998);
+
+    memset(h, 0, sizeof(*h));
+    h->ordered = 1;
+    ASSUME_ITS_TRUE(fossil_ai_audit_query(AUDIT_TEST_LOG, NULL, 0, UINT64_MAX, audit_collect, h) == 0);
+    ASSUME_ITS_TRUE(h->count == 3000);
+    ASSUME_ITS_TRUE(h->ordered);
+
+    // A window from the middle record's time holds exactly the records stamped since.
+    uint64_t t0 = h->times[1500];
+    size_t expect = 0;
+    for (size_t i = 0; i < 3000; ++i)
+        expect += h->times[i] >= t0;
+    memset(h, 0, sizeof(*h));
+    ASSUME_ITS_TRUE(fossil_ai_audit_query(AUDIT_TEST_LOG, NULL, t0, UINT64_MAX, audit_collect, h) == 0);
+    ASSUME_ITS_TRUE(h->count == expect);
+    memset(h, 0, sizeof(*h));
+    ASSUME_ITS_TRUE(fossil_ai_audit_query(AUDIT_TEST_LOG, NULL, 0, 1, audit_collect, h) == 0);
+    ASSUME_ITS_TRUE(h->count == 0);
+
+    memset(h, 0, sizeof(*h));
+    h->limit = 3;
+    ASSUME_ITS_TRUE(fossil_ai_audit_query(AUDIT_TEST_LOG, NULL, 0, UINT64_MAX, audit_collect, h) == 0);
+    ASSUME_ITS_TRUE(h->count == 3);
+    free(h);
+}
+
+FOSSIL_TEST(c_test_audit_lookup_exact) {
+    void* ctx = audit_open();
+    audit_hits_t* h = audit_hits_new();
+    ASSUME_NOT_CNULL(ctx);
+    ASSUME_NOT_CNULL(h);
+    if (ctx == NULL || h == NULL) {
+        free(h);
+        return;
+    }
+
+    ASSUME_ITS_TRUE(audit_fill_keyed(ctx, 300) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_export(ctx, AUDIT_TEST_LOG) == 0);
+    fossil_ai_audit_end(ctx);
+
+    ASSUME_ITS_TRUE(fossil_ai_audit_lookup(AUDIT_TEST_LOG, "c", 0, UINT64_MAX, audit_collect, h) == 0);
+    ASSUME_ITS_TRUE(h->count == 100);
+    ASSUME_ITS_TRUE(h->values[0] == 2);
+    memset(h, 0, sizeof(*h));
+    ASSUME_ITS_TRUE(fossil_ai_audit_lookup(AUDIT_TEST_LOG, "b", 0, UINT64_MAX, audit_collect, h) == 0);
+    ASSUME_ITS_TRUE(h->count == 0);
+    memset(h, 0, sizeof(*h));
+    ASSUME_ITS_TRUE(fossil_ai_audit_lookup(AUDIT_TEST_LOG, "missing", 0, UINT64_MAX, audit_collect, h) == 0);
+    ASSUME_ITS_TRUE(h->count == 0);
+
+    ASSUME_ITS_TRUE(fossil_ai_audit_lookup(AUDIT_TEST_LOG, NULL, 0, UINT64_MAX, audit_collect, h) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_audit_query(AUDIT_TEST_LOG, NULL, 0, UINT64_MAX, NULL, h) == -1);
+    ASSUME_ITS_FALSE(fossil_ai_audit_query("nonexistent_audit.log", NULL, 0, UINT64_MAX, audit_collect, h) == 0);
+    free(h);
+}
+
+FOSSIL_TEST(c_test_audit_query_segments) {
+    void* ctx = audit_open_segments(4096, 0);
+    audit_hits_t* h = audit_hits_new();
+    ASSUME_NOT_CNULL(ctx);
+    ASSUME_NOT_CNULL(h);
+    if (ctx == NULL || h == NULL) {
+        free(h);
+        return;
+    }
+
+    // Two sessions on one prefix; queries span every segment of both.
+    ASSUME_ITS_TRUE(audit_fill_keyed(ctx, 1500) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_end(ctx) == 0);
+    ctx = audit_open_segments(4096, 0);
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx != NULL) {
+        ASSUME_ITS_TRUE(audit_fill_keyed(ctx, 1500) == 0);
+        ASSUME_ITS_TRUE(fossil_ai_audit_end(ctx) == 0);
+    }
+
+    ASSUME_ITS_TRUE(fossil_ai_audit_query(AUDIT_TEST_SEGMENTS, "a.", 0, UINT64_MAX, audit_collect, h) == 0);
+    ASSUME_ITS_TRUE(h->count == 1000);
+    memset(h, 0, sizeof(*h));
+    ASSUME_ITS_TRUE(fossil_ai_audit_lookup(AUDIT_TEST_SEGMENTS, "c", 0, UINT64_MAX, audit_collect, h) == 0);
+    ASSUME_ITS_TRUE(h->count == 1000);
+    free(h);
+}
+
+// ======================================================
+// Compressed Segments
+// ======================================================
+
+/* Total bytes across the sealed segment files; the largest one is named in path. */
+static long segments_size(char* path, size_t cap) {
+    long total = 0, largest = -1;
+    for (int i = 0; i < AUDIT_TEST_SEGMENT_MAX; ++i) {
+        char name[64];
+        snprintf(name, sizeof(name), "%s.%08d.log", AUDIT_TEST_SEGMENTS, i);
+        FILE* f = fopen(name, "rb");
+        if (!f)
+            continue;
+        fseek(f, 0, SEEK_END);
+        long size = ftell(f);
+        fclose(f);
+        total += size;
+        if (size > largest && path) {
+            largest = size;
+            snprintf(path, cap, "%s", name);
+        }
+    }
+    return total;
+}
+
+FOSSIL_TEST(c_test_audit_compressed_smaller) {
+    long plain = 0, packed = 0;
+    for (int compress = 0; compress < 2; ++compress) {
+        void* ctx = audit_open_segments(16 * 1024, compress);
+        ASSUME_NOT_CNULL(ctx);
+        if (ctx == NULL)
+            return;
+        ASSUME_ITS_TRUE(audit_fill_batches(ctx, 8, 500) == 0);
+        ASSUME_ITS_TRUE(fossil_ai_audit_end(ctx) == 0);
+        ASSUME_ITS_TRUE(fossil_ai_audit_verify_segments(AUDIT_TEST_SEGMENTS) == 0);
+        if (compress)
+            packed = segments_size(NULL, 0);
+        else
+            plain = segments_size(NULL, 0);
+        segments_remove();
+    }
+    // Keys and payload text repeat from record to record; the hashes do not compress.
+    ASSUME_ITS_TRUE(plain > 0 && packed > 0);
+    ASSUME_ITS_TRUE(packed < plain / 4 * 3);
+}
+
+FOSSIL_TEST(c_test_audit_compressed_read_back) {
+    audit_hits_t* h = audit_hits_new();
+    void* ctx = audit_open_segments(16 * 1024, 1);
+    ASSUME_NOT_CNULL(ctx);
+    ASSUME_NOT_CNULL(h);
+    if (ctx == NULL || h == NULL) {
+        free(h);
+        if (ctx)
+            fossil_ai_audit_end(ctx);
+        return;
+    }
+
+    ASSUME_ITS_TRUE(audit_fill_batches(ctx, 8, 500) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_export(ctx, AUDIT_TEST_LOG) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify(AUDIT_TEST_LOG) == 0);
+    ASSUME_ITS_TRUE(file_find(AUDIT_TEST_LOG, AUDIT_TEST_MARK " 0") >= 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_end(ctx) == 0);
+
+    ASSUME_ITS_TRUE(fossil_ai_audit_query(AUDIT_TEST_SEGMENTS, "test.", 0, UINT64_MAX, audit_collect, h) == 0);
+    ASSUME_ITS_TRUE(h->count == 4000);
+    ASSUME_ITS_TRUE(h->ordered);
+    free(h);
+}
+
+FOSSIL_TEST(c_test_audit_compressed_tamper) {
+    char path[64];
+    void* ctx = audit_open_segments(16 * 1024, 1);
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx == NULL)
+        return;
+
+    ASSUME_ITS_TRUE(audit_fill_batches(ctx, 8, 500) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_end(ctx) == 0);
+    long size = segments_size(path, sizeof(path));
+    ASSUME_ITS_TRUE(size > 0);
+    if (size <= 0)
+        return;
+
+    // Flip a byte inside the compressed body of the largest segment.
+    FILE* f = fopen(path, "rb");
+    long len = 0;
+    if (f) {
+        fseek(f, 0, SEEK_END);
+        len = ftell(f);
+        fclose(f);
+    }
+    ASSUME_ITS_TRUE(file_flip(path, len * 3 / 4) == 0);
+    ASSUME_ITS_FALSE(fossil_ai_audit_verify_segments(AUDIT_TEST_SEGMENTS) == 0);
+}
+
+// ======================================================
+// Replay
+// ======================================================
+
+/* A stand-in model: the output is a byte mix of the input, so replays reproduce it. */
+typedef struct audit_model {
+    int drift;                  /* alter every 50th decision and fail every 100th */
+} audit_model_t;
+
+static size_t audit_decide(const int* input, unsigned char* out) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < 3; ++i)
+        h = (h ^ (uint32_t)input[i]) * 16777619u;
+    size_t n = 8 + h % 8;
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = (unsigned char)(h >> 24);
+        h = h * 1103515245u + 12345u;
+    }
+    return n;
+}
+
+static int audit_infer(void* model, const void* input, size_t input_size, void* output,
+                       size_t output_cap, size_t* output_size, void* user) {
+    const audit_model_t* m = (const audit_model_t*)model;
+    int in[3];
+    unsigned char out[16];
+    (void)user;
+    if (input_size != sizeof(in))
+        return -1;
+    memcpy(in, input, sizeof(in));
+    if (m->drift && in[0] % 100 == 99)
+        return -1;
+    size_t n = audit_decide(in, out);
+    if (n > output_cap)
+        return -1;
+    if (m->drift && in[0] % 50 == 7)
+        out[0] ^= 1;
+    memcpy(output, out, n);
+    *output_size = n;
+    return 0;
+}
+
+typedef struct audit_mismatches {
+    size_t count;
+    int ordered;
+    uint64_t last_seq;
+} audit_mismatches_t;
+
+static void audit_mismatch(const fossil_ai_audit_item_t* item, const void* recorded, size_t recorded_size,
+                           const void* replayed, size_t replayed_size, void* user) {
+    audit_mismatches_t* m = (audit_mismatches_t*)user;
+    (void)recorded;
+    (void)recorded_size;
+    (void)replayed;
+    (void)replayed_size;
+    if (m->count > 0 && item->seq <= m->last_seq)
+        m->ordered = 0;
+    m->last_seq = item->seq;
+    m->count++;
+}
+
+/* Records count decisions, with unrelated records mixed in, to ctx. */
+static int audit_fill_decisions(void* ctx, int count) {
+    for (int i = 0; i < count; ++i) {
+        int in[3] = { i, i * 3, 7 };
+        unsigned char out[16];
+        size_t n = audit_decide(in, out);
+        if (fossil_ai_audit_record_inference(ctx, NULL, in, sizeof(in), out, n) != 0)
+            return -1;
+        if (i % 7 == 0 && fossil_ai_audit_record(ctx, "test.other", &i, sizeof(i)) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+FOSSIL_TEST(c_test_audit_replay_reproduces) {
+    audit_model_t model = { 0 };
+    audit_mismatches_t seen = { 0, 1, 0 };
+    fossil_ai_audit_replay_stats_t stats;
+    fossil_ai_audit_replay_t options;
+    void* ctx = audit_open();
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx == NULL)
+        return;
+
+    ASSUME_ITS_TRUE(audit_fill_decisions(ctx, 2000) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_export(ctx, AUDIT_TEST_LOG) == 0);
+    fossil_ai_audit_end(ctx);
+
+    memset(&options, 0, sizeof(options));
+    options.infer = audit_infer;
+    options.mismatch = audit_mismatch;
+    options.user = &seen;
+    options.workers = 4;
+    options.stats = &stats;
+    ASSUME_ITS_TRUE(fossil_ai_audit_replay(AUDIT_TEST_LOG, &model, &options) == 0);
+    ASSUME_ITS_TRUE(stats.replayed == 2000);
+    ASSUME_ITS_TRUE(stats.matched == 2000);
+    ASSUME_ITS_TRUE(seen.count == 0);
+}
+
+FOSSIL_TEST(c_test_audit_replay_reports_drift) {
+    audit_model_t model = { 1 };
+    audit_mismatches_t seen = { 0, 1, 0 };
+    fossil_ai_audit_replay_stats_t stats;
+    fossil_ai_audit_replay_t options;
+    void* ctx = audit_open();
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx == NULL)
+        return;
+
+    ASSUME_ITS_TRUE(audit_fill_decisions(ctx, 2000) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_export(ctx, AUDIT_TEST_LOG) == 0);
+    fossil_ai_audit_end(ctx);
+
+    // 40 altered and 20 failed decisions, reported in record order across workers.
+    memset(&options, 0, sizeof(options));
+    options.infer = audit_infer;
+    options.mismatch = audit_mismatch;
+    options.user = &seen;
+    options.workers = 4;
+    options.stats = &stats;
+    ASSUME_ITS_TRUE(fossil_ai_audit_replay(AUDIT_TEST_LOG, &model, &options) == 1);
+    ASSUME_ITS_TRUE(stats.replayed == 2000);
+    ASSUME_ITS_TRUE(stats.mismatched == 40);
+    ASSUME_ITS_TRUE(stats.failed == 20);
+    ASSUME_ITS_TRUE(stats.matched == 2000 - 60);
+    ASSUME_ITS_TRUE(seen.count == 60);
+    ASSUME_ITS_TRUE(seen.ordered);
+}
+
+FOSSIL_TEST(c_test_audit_replay_segments) {
+    audit_model_t model = { 0 };
+    fossil_ai_audit_replay_stats_t stats;
+    fossil_ai_audit_replay_t options;
+    void* ctx = audit_open_segments(16 * 1024, 1);
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx == NULL)
+        return;
+
+    ASSUME_ITS_TRUE(audit_fill_decisions(ctx, 2000) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_end(ctx) == 0);
+
+    memset(&options, 0, sizeof(options));
+    options.infer = audit_infer;
+    options.stats = &stats;
+    ASSUME_ITS_TRUE(fossil_ai_audit_replay(AUDIT_TEST_SEGMENTS, &model, &options) == 0);
+    ASSUME_ITS_TRUE(stats.replayed == 2000);
+    ASSUME_ITS_TRUE(stats.matched == 2000);
+
+    // A prefix no segment holds replays nothing.
+    options.key_prefix = "test.none";
+    ASSUME_ITS_TRUE(fossil_ai_audit_replay(AUDIT_TEST_SEGMENTS, &model, &options) == 0);
+    ASSUME_ITS_TRUE(stats.replayed == 0);
+    options.infer = NULL;
+    ASSUME_ITS_TRUE(fossil_ai_audit_replay(AUDIT_TEST_SEGMENTS, &model, &options) == -1);
+}
+
+// ======================================================
+// Gathered Records
+// ======================================================
+
+typedef struct audit_expect {
+    const unsigned char* data;
+    size_t size;
+    size_t seen;
+    size_t same;
+} audit_expect_t;
+
+static int audit_compare(const fossil_ai_audit_item_t* item, void* user) {
+    audit_expect_t* e = (audit_expect_t*)user;
+    e->seen++;
+    if (item->data && item->size == e->size && memcmp(item->data, e->data, e->size) == 0)
+        e->same++;
+    return 0;
+}
+
+FOSSIL_TEST(c_test_audit_recordv_matches_record) {
+    static const char head[] = "header:", body[] = "body bytes", tail[] = ":tail";
+    fossil_ai_audit_iovec_t iov[4] = {
+        { head, sizeof(head) - 1 }, { NULL, 0 }, { body, sizeof(body) - 1 }, { tail, sizeof(tail) - 1 }
+    };
+    char joined[64];
+    int len = snprintf(joined, sizeof(joined), "%s%s%s", head, body, tail);
+    void* a = audit_open();
+    void* b = audit_open();
+    ASSUME_NOT_CNULL(a);
+    ASSUME_NOT_CNULL(b);
+    if (a == NULL || b == NULL) {
+        if (a)
+            fossil_ai_audit_end(a);
+        if (b)
+            fossil_ai_audit_end(b);
+        return;
+    }
+
+    // Gathered pieces commit the same leaf content as the joined payload.
+    for (int i = 0; i < 50; ++i) {
+        ASSUME_ITS_TRUE(fossil_ai_audit_record(a, "test.record", joined, (size_t)len) == 0);
+        ASSUME_ITS_TRUE(fossil_ai_audit_recordv(b, "test.record", iov, 4) == 0);
+    }
+    ASSUME_ITS_TRUE(fossil_ai_audit_export(a, AUDIT_TEST_LOG) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_export(b, AUDIT_TEST_LOG_B) == 0);
+    fossil_ai_audit_end(a);
+    fossil_ai_audit_end(b);
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify(AUDIT_TEST_LOG_B) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_diff(AUDIT_TEST_LOG, AUDIT_TEST_LOG_B, NULL) == 0);
+
+    audit_expect_t e = { (const unsigned char*)joined, (size_t)len, 0, 0 };
+    ASSUME_ITS_TRUE(fossil_ai_audit_query(AUDIT_TEST_LOG_B, NULL, 0, UINT64_MAX, audit_compare, &e) == 0);
+    ASSUME_ITS_TRUE(e.seen == 50 && e.same == 50);
+}
+
+FOSSIL_TEST(c_test_audit_recordv_large) {
+    const size_t piece = 100 * 1024;
+    unsigned char* big = (unsigned char*)malloc(3 * piece);
+    void* ctx = audit_open();
+    ASSUME_NOT_CNULL(big);
+    ASSUME_NOT_CNULL(ctx);
+    if (big == NULL || ctx == NULL) {
+        free(big);
+        if (ctx)
+            fossil_ai_audit_end(ctx);
+        return;
+    }
+    for (size_t i = 0; i < 3 * piece; ++i)
+        big[i] = (unsigned char)(i * 31 + (i >> 9));
+
+    // Larger than the default 256 KiB thread buffer, so it cannot be staged in one piece.
+    fossil_ai_audit_iovec_t iov[3] = { { big, piece }, { big + piece, piece }, { big + 2 * piece, piece } };
+    ASSUME_ITS_TRUE(fossil_ai_audit_recordv(ctx, "test.large", iov, 3) == 0);
+    ASSUME_ITS_TRUE(audit_fill(ctx, 10) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_export(ctx, AUDIT_TEST_LOG) == 0);
+    fossil_ai_audit_end(ctx);
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify(AUDIT_TEST_LOG) == 0);
+
+    audit_expect_t e = { big, 3 * piece, 0, 0 };
+    ASSUME_ITS_TRUE(fossil_ai_audit_lookup(AUDIT_TEST_LOG, "test.large", 0, UINT64_MAX, audit_compare, &e) == 0);
+    ASSUME_ITS_TRUE(e.seen == 1 && e.same == 1);
+    free(big);
+}
+
+FOSSIL_TEST(c_test_audit_recordv_invalid) {
+    fossil_ai_audit_iovec_t bad[2] = { { "x", 1 }, { NULL, 4 } };
+    fossil_ai_audit_stats_t stats;
+    void* ctx = audit_open();
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx == NULL)
+        return;
+
+    ASSUME_ITS_TRUE(fossil_ai_audit_recordv(ctx, "test.record", NULL, 1) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_audit_recordv(ctx, "test.record", bad, 2) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_audit_recordv(ctx, NULL, bad, 1) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_audit_recordv(NULL, "test.record", bad, 1) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_audit_recordv(ctx, "test.empty", NULL, 0) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_flush(ctx) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_stats(ctx, &stats) == 0);
+    ASSUME_ITS_TRUE(stats.records == 1);
+    fossil_ai_audit_end(ctx);
+}
+
+// ======================================================
+// Sampled Level
+// ======================================================
+
+typedef struct audit_kept {
+    size_t kept;
+    size_t omitted;
+    size_t malformed;
+    size_t pairs_split;         /* identical neighbours that were not treated alike */
+    int last_omitted;
+    size_t index;
+} audit_kept_t;
+
+static int audit_count_kept(const fossil_ai_audit_item_t* item, void* user) {
+    audit_kept_t* k = (audit_kept_t*)user;
+    int omitted = item->digest != NULL;
+    if (omitted ? item->data != NULL : item->data == NULL)
+        k->malformed++;
+    if (item->size != 16)
+        k->malformed++;
+    if (k->index % 2 == 1 && omitted != k->last_omitted)
+        k->pairs_split++;
+    k->last_omitted = omitted;
+    k->index++;
+    if (omitted)
+        k->omitted++;
+    else
+        k->kept++;
+    return 0;
+}
+
+/* Records every 16-byte payload twice in a row under a ctx at level/rate, then exports it. */
+static int audit_sampled_log(int level, double rate, fossil_ai_audit_stats_t* stats) {
+    fossil_ai_audit_config_t config;
+    void* ctx = NULL;
+    memset(&config, 0, sizeof(config));
+    config.level = level;
+    config.sample_rate = rate;
+    if (fossil_ai_audit_begin_ex(&ctx, &config) != 0)
+        return -1;
+    int rc = 0;
+    for (int i = 0; i < 1000 && rc == 0; ++i) {
+        unsigned char payload[16];
+        memset(payload, 0, sizeof(payload));
+        memcpy(payload, &i, sizeof(i));
+        rc = fossil_ai_audit_record(ctx, "test.record", payload, sizeof(payload));
+        if (rc == 0)
+            rc = fossil_ai_audit_record(ctx, "test.record", payload, sizeof(payload));
+    }
+    if (rc == 0)
+        rc = fossil_ai_audit_flush(ctx);
+    if (rc == 0)
+        rc = fossil_ai_audit_stats(ctx, stats);
+    if (rc == 0 && level != FOSSIL_AI_AUDIT_OFF)
+        rc = fossil_ai_audit_export(ctx, AUDIT_TEST_LOG);
+    fossil_ai_audit_end(ctx);
+    return rc;
+}
+
+FOSSIL_TEST(c_test_audit_sampled_share) {
+    fossil_ai_audit_stats_t stats;
+    audit_kept_t k;
+
+    ASSUME_ITS_TRUE(audit_sampled_log(FOSSIL_AI_AUDIT_SAMPLED, 0.25, &stats) == 0);
+    ASSUME_ITS_TRUE(stats.records == 2000);
+    ASSUME_ITS_TRUE(stats.omitted > 1200 && stats.omitted < 1800);
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify(AUDIT_TEST_LOG) == 0);
+
+    // The sample is a hash of key and payload, so a repeated record is treated alike.
+    memset(&k, 0, sizeof(k));
+    ASSUME_ITS_TRUE(fossil_ai_audit_query(AUDIT_TEST_LOG, NULL, 0, UINT64_MAX, audit_count_kept, &k) == 0);
+    ASSUME_ITS_TRUE(k.omitted == stats.omitted);
+    ASSUME_ITS_TRUE(k.kept + k.omitted == 2000);
+    ASSUME_ITS_TRUE(k.malformed == 0);
+    ASSUME_ITS_TRUE(k.pairs_split == 0);
+}
+
+FOSSIL_TEST(c_test_audit_sampled_bounds) {
+    fossil_ai_audit_stats_t stats;
+
+    ASSUME_ITS_TRUE(audit_sampled_log(FOSSIL_AI_AUDIT_SAMPLED, 1.0, &stats) == 0);
+    ASSUME_ITS_TRUE(stats.omitted == 0);
+    ASSUME_ITS_TRUE(audit_sampled_log(FOSSIL_AI_AUDIT_SAMPLED, 0.0, &stats) == 0);
+    ASSUME_ITS_TRUE(stats.omitted == 2000);
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify(AUDIT_TEST_LOG) == 0);
+    ASSUME_ITS_TRUE(audit_sampled_log(FOSSIL_AI_AUDIT_OFF, 0.0, &stats) == 0);
+    ASSUME_ITS_TRUE(stats.records == 0);
+    ASSUME_ITS_TRUE(stats.dropped == 2000);
+}
+
+FOSSIL_TEST(c_test_audit_level_switch) {
+    fossil_ai_audit_config_t config;
+    fossil_ai_audit_stats_t stats;
+    void* ctx = audit_open();
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx == NULL)
+        return;
+
+    ASSUME_ITS_TRUE(audit_fill(ctx, 10) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_set_level(ctx, FOSSIL_AI_AUDIT_SAMPLED, 0.0) == 0);
+    ASSUME_ITS_TRUE(audit_fill(ctx, 10) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_set_level(ctx, FOSSIL_AI_AUDIT_OFF, 0.0) == 0);
+    ASSUME_ITS_TRUE(audit_fill(ctx, 10) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_flush(ctx) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_stats(ctx, &stats) == 0);
+    ASSUME_ITS_TRUE(stats.records == 20);
+    ASSUME_ITS_TRUE(stats.omitted == 10);
+    ASSUME_ITS_TRUE(stats.dropped == 10);
+    ASSUME_ITS_TRUE(fossil_ai_audit_export(ctx, AUDIT_TEST_LOG) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify(AUDIT_TEST_LOG) == 0);
+    fossil_ai_audit_end(ctx);
+
+    memset(&config, 0, sizeof(config));
+    config.level = 7;
+    ASSUME_ITS_TRUE(fossil_ai_audit_begin_ex(&ctx, &config) == -1);
+    config.level = FOSSIL_AI_AUDIT_SAMPLED;
+    config.sample_rate = -0.5;
+    ASSUME_ITS_TRUE(fossil_ai_audit_begin_ex(&ctx, &config) == -1);
+}
+
+// ======================================================
+// Streamed Export
+// ======================================================
+
+typedef struct audit_sink {
+    unsigned char* data;
+    size_t size;
+    size_t cap;
+    size_t largest;             /* biggest piece handed over */
+    int pieces_left;            /* abort after this many, 0 = never */
+} audit_sink_t;
+
+static int audit_sink_put(audit_sink_t* sink, const void* data, size_t size) {
+    if (sink->size + size > sink->cap) {
+        size_t cap = (sink->size + size) * 2;
+        unsigned char* grown = (unsigned char*)realloc(sink->data, cap);
+        if (!grown)
+            return -1;
+        sink->data = grown;
+        sink->cap = cap;
+    }
+    memcpy(sink->data + sink->size, data, size);
+    sink->size += size;
+    return 0;
+}
+
+static int audit_sink_write(const void* data, size_t size, void* user) {
+    audit_sink_t* sink = (audit_sink_t*)user;
+    if (size > sink->largest)
+        sink->largest = size;
+    if (sink->pieces_left && --sink->pieces_left == 0)
+        return 1;
+    return audit_sink_put(sink, data, size);
+}
+
+/* Loads a whole file into sink. */
+static int audit_sink_file(audit_sink_t* sink, const char* path) {
+    unsigned char buf[4096];
+    size_t n;
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return -1;
+    int rc = 0;
+    while (rc == 0 && (n = fread(buf, 1, sizeof(buf), f)) > 0)
+        rc = audit_sink_put(sink, buf, n);
+    fclose(f);
+    return rc;
+}
+
+static int audit_sink_same(const audit_sink_t* a, const audit_sink_t* b) {
+    return a->size == b->size && a->size > 0 && memcmp(a->data, b->data, a->size) == 0;
+}
+
+/* Records payloads of varied size under two keys; a few MiB in all. */
+static int audit_fill_varied(void* ctx, int count) {
+    unsigned char payload[300];
+    for (int i = 0; i < count; ++i) {
+        memset(payload, i, sizeof(payload));
+        if (fossil_ai_audit_record(ctx, i % 3 ? "a.x" : "b.y", payload, (size_t)(i * 37) % 300) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+FOSSIL_TEST(c_test_audit_export_stream_same_bytes) {
+    audit_sink_t want, got, aborted;
+    void* ctx = audit_open();
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx == NULL)
+        return;
+
+    memset(&want, 0, sizeof(want));
+    memset(&got, 0, sizeof(got));
+    memset(&aborted, 0, sizeof(aborted));
+    ASSUME_ITS_TRUE(audit_fill_varied(ctx, 20000) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_export(ctx, AUDIT_TEST_LOG) == 0);
+    ASSUME_ITS_TRUE(audit_sink_file(&want, AUDIT_TEST_LOG) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_export_stream(ctx, audit_sink_write, &got) == 0);
+    ASSUME_ITS_TRUE(audit_sink_same(&want, &got));
+    ASSUME_ITS_TRUE(got.largest <= 256 * 1024);
+
+    // A nonzero return from the writer abandons the export.
+    aborted.pieces_left = 2;
+    ASSUME_ITS_TRUE(fossil_ai_audit_export_stream(ctx, audit_sink_write, &aborted) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_audit_export_stream(ctx, NULL, NULL) == -1);
+    fossil_ai_audit_end(ctx);
+    free(want.data);
+    free(got.data);
+    free(aborted.data);
+}
+
+#if !defined(_WIN32)
+typedef struct audit_pipe_reader {
+    int fd;
+    audit_sink_t sink;
+} audit_pipe_reader_t;
+
+static void* audit_pipe_drain(void* arg) {
+    audit_pipe_reader_t* r = (audit_pipe_reader_t*)arg;
+    unsigned char buf[4096];
+    ssize_t n;
+    // Read in small bites, so the writer keeps finding the pipe full.
+    while ((n = read(r->fd, buf, sizeof(buf))) > 0) {
+        if (audit_sink_put(&r->sink, buf, (size_t)n) != 0)
+            break;
+    }
+    return NULL;
+}
+
+/* Runs export_fd (ctx set) or send (path set) into a non-blocking pipe drained by a thread. */
+static int audit_through_pipe(void* ctx, const char* path, audit_sink_t* out) {
+    audit_pipe_reader_t r;
+    pthread_t thread;
+    int fds[2];
+    if (pipe(fds) != 0)
+        return -1;
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+    memset(&r, 0, sizeof(r));
+    r.fd = fds[0];
+    if (pthread_create(&thread, NULL, audit_pipe_drain, &r) != 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    int rc = ctx ? fossil_ai_audit_export_fd(ctx, fds[1]) : fossil_ai_audit_send(path, fds[1]);
+    close(fds[1]);
+    pthread_join(thread, NULL);
+    close(fds[0]);
+    *out = r.sink;
+    return rc;
+}
+
+FOSSIL_TEST(c_test_audit_export_fd_pipe) {
+    audit_sink_t want, got;
+    void* ctx = audit_open();
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx == NULL)
+        return;
+
+    memset(&want, 0, sizeof(want));
+    ASSUME_ITS_TRUE(audit_fill_varied(ctx, 20000) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_export(ctx, AUDIT_TEST_LOG) == 0);
+    ASSUME_ITS_TRUE(audit_sink_file(&want, AUDIT_TEST_LOG) == 0);
+    ASSUME_ITS_TRUE(audit_through_pipe(ctx, NULL, &got) == 0);
+    ASSUME_ITS_TRUE(audit_sink_same(&want, &got));
+    ASSUME_ITS_TRUE(fossil_ai_audit_export_fd(ctx, -1) == -1);
+    fossil_ai_audit_end(ctx);
+    free(want.data);
+    free(got.data);
+}
+
+FOSSIL_TEST(c_test_audit_send_file) {
+    audit_sink_t want, piped, copied;
+    void* ctx = audit_open();
+    ASSUME_NOT_CNULL(ctx);
+    if (ctx == NULL)
+        return;
+
+    memset(&want, 0, sizeof(want));
+    memset(&copied, 0, sizeof(copied));
+    ASSUME_ITS_TRUE(audit_fill_varied(ctx, 20000) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_export(ctx, AUDIT_TEST_LOG) == 0);
+    fossil_ai_audit_end(ctx);
+    ASSUME_ITS_TRUE(audit_sink_file(&want, AUDIT_TEST_LOG) == 0);
+
+    ASSUME_ITS_TRUE(audit_through_pipe(NULL, AUDIT_TEST_LOG, &piped) == 0);
+    ASSUME_ITS_TRUE(audit_sink_same(&want, &piped));
+
+    int fd = open(AUDIT_TEST_LOG_B, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ASSUME_ITS_TRUE(fd >= 0);
+    if (fd >= 0) {
+        ASSUME_ITS_TRUE(fossil_ai_audit_send(AUDIT_TEST_LOG, fd) == 0);
+        close(fd);
+    }
+    ASSUME_ITS_TRUE(audit_sink_file(&copied, AUDIT_TEST_LOG_B) == 0);
+    ASSUME_ITS_TRUE(audit_sink_same(&want, &copied));
+    ASSUME_ITS_TRUE(fossil_ai_audit_verify(AUDIT_TEST_LOG_B) == 0);
+
+    ASSUME_ITS_FALSE(fossil_ai_audit_send("nonexistent_audit.log", 1) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_audit_send(AUDIT_TEST_LOG, -1) == -1);
+    free(want.data);
+    free(piped.data);
+    free(copied.data);
+}
+#endif
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Pool
+// * * * * * * * * * * * * * * * * * * * * * * * *
+FOSSIL_TEST_GROUP(c_audit_tests) {
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_record_flush_verify);
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_record_inference_verify);
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_hash_only_verify);
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_invalid_arguments);
+#ifdef __linux__
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_journal_failure_is_sticky);
+#endif
+
+#if !defined(_WIN32)
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_threads_merge_in_order);
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_journal_group_commit);
+#endif
+
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_binary_framing);
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_binary_empty);
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_binary_rejects_foreign);
+
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_tamper_payload);
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_tamper_truncated);
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_tamper_across_tasks);
+
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_inclusion_proof);
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_consistency_proof);
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_verify_from_skips_history);
+
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_diff_same);
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_diff_changed_record);
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_diff_appended_record);
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_diff_damaged);
+
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_segments_rotate_verify);
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_segments_export_reads_back);
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_segments_tamper);
+
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_query_prefix);
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_lookup_exact);
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_query_segments);
+
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_compressed_smaller);
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_compressed_read_back);
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_compressed_tamper);
+
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_replay_reproduces);
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_replay_reports_drift);
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_replay_segments);
+
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_recordv_matches_record);
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_recordv_large);
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_recordv_invalid);
+
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_sampled_share);
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_sampled_bounds);
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_level_switch);
+
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_export_stream_same_bytes);
+#if !defined(_WIN32)
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_export_fd_pipe);
+    FOSSIL_TEST_ADD(c_audit_fixture, c_test_audit_send_file);
+#endif
+
+    FOSSIL_TEST_REGISTER(c_audit_fixture);
+} // end of tests
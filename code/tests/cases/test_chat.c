@@ -0,0 +1,272 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#include <fossil/pizza/framework.h>
+#include "fossil/ai/chat.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Utilities
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// Setup steps for things like test fixtures and
+// mock objects are set here.
+// * * * * * * * * * * * * * * * * * * * * * * * *
+
+static void* g_chat = NULL;
+
+FOSSIL_SUITE(c_chat_fixture);
+
+FOSSIL_SETUP(c_chat_fixture) {
+    g_chat = NULL;
+    fossil_ai_chat_session_open(&g_chat);
+}
+
+FOSSIL_TEARDOWN(c_chat_fixture) {
+    fossil_ai_chat_session_close(g_chat);
+    g_chat = NULL;
+}
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Cases
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// The test cases below are provided as samples, inspired
+// by the Meson build system's approach of using test cases
+// as samples for library usage.
+// * * * * * * * * * * * * * * * * * * * * * * * *
+
+// ======================================================
+// Receive
+// ======================================================
+
+FOSSIL_TEST(c_test_chat_receive_empty) {
+    char buf[32] = "stale";
+    ASSUME_NOT_CNULL(g_chat);
+    ASSUME_ITS_TRUE(fossil_ai_chat_receive(g_chat, buf, sizeof(buf)) == 1);
+    ASSUME_ITS_TRUE(buf[0] == '\0');
+}
+
+FOSSIL_TEST(c_test_chat_receive_skips_user) {
+    char buf[32];
+    ASSUME_NOT_CNULL(g_chat);
+    ASSUME_ITS_TRUE(fossil_ai_chat_send(g_chat, "user", "question") == 0);
+    ASSUME_ITS_TRUE(fossil_ai_chat_receive(g_chat, buf, sizeof(buf)) == 1);
+    ASSUME_ITS_TRUE(fossil_ai_chat_send(g_chat, "assistant", "answer") == 0);
+    ASSUME_ITS_TRUE(fossil_ai_chat_send(g_chat, "user", "follow-up") == 0);
+    ASSUME_ITS_TRUE(fossil_ai_chat_receive(g_chat, buf, sizeof(buf)) == 0);
+    ASSUME_ITS_TRUE(strcmp(buf, "answer") == 0);
+}
+
+FOSSIL_TEST(c_test_chat_receive_truncates) {
+    char buf[4];
+    ASSUME_NOT_CNULL(g_chat);
+    ASSUME_ITS_TRUE(fossil_ai_chat_send(g_chat, "assistant", "hello") == 0);
+    ASSUME_ITS_TRUE(fossil_ai_chat_receive(g_chat, buf, sizeof(buf)) == 0);
+    ASSUME_ITS_TRUE(strcmp(buf, "hel") == 0);
+    ASSUME_ITS_TRUE(fossil_ai_chat_receive(g_chat, buf, 1) == 0);
+    ASSUME_ITS_TRUE(buf[0] == '\0');
+    ASSUME_ITS_TRUE(fossil_ai_chat_receive(g_chat, buf, 0) == -1);
+}
+
+FOSSIL_TEST(c_test_chat_receive_after_prune) {
+    char buf[32];
+    ASSUME_NOT_CNULL(g_chat);
+    ASSUME_ITS_TRUE(fossil_ai_chat_send(g_chat, "assistant", "old reply") == 0);
+    ASSUME_ITS_TRUE(fossil_ai_chat_send(g_chat, "user", "newer") == 0);
+    ASSUME_ITS_TRUE(fossil_ai_chat_history_prune(g_chat, 1) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_chat_receive(g_chat, buf, sizeof(buf)) == 1);
+}
+
+// ======================================================
+// Prune
+// ======================================================
+
+FOSSIL_TEST(c_test_chat_prune_keeps_newest) {
+    char buf[256];
+    ASSUME_NOT_CNULL(g_chat);
+    for (int i = 0; i < 100; ++i) {
+        char msg[16];
+        snprintf(msg, sizeof(msg), "m%d", i);
+        ASSUME_ITS_TRUE(fossil_ai_chat_send(g_chat, i % 2 ? "assistant" : "user", msg) == 0);
+    }
+    ASSUME_ITS_TRUE(fossil_ai_chat_history_prune(g_chat, 2) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_chat_render(g_chat, buf, sizeof(buf)) == 0);
+    ASSUME_ITS_TRUE(strcmp(buf, "user: m98\nassistant: m99\n") == 0);
+}
+
+FOSSIL_TEST(c_test_chat_prune_more_than_held) {
+    char buf[64];
+    ASSUME_NOT_CNULL(g_chat);
+    ASSUME_ITS_TRUE(fossil_ai_chat_send(g_chat, "user", "only") == 0);
+    ASSUME_ITS_TRUE(fossil_ai_chat_history_prune(g_chat, 10) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_chat_render(g_chat, buf, sizeof(buf)) == 0);
+    ASSUME_ITS_TRUE(strcmp(buf, "user: only\n") == 0);
+}
+
+FOSSIL_TEST(c_test_chat_prune_all_then_send) {
+    char buf[64];
+    ASSUME_NOT_CNULL(g_chat);
+    ASSUME_ITS_TRUE(fossil_ai_chat_send(g_chat, "assistant", "gone") == 0);
+    ASSUME_ITS_TRUE(fossil_ai_chat_history_prune(g_chat, 0) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_chat_render(g_chat, buf, sizeof(buf)) == 0);
+    ASSUME_ITS_TRUE(buf[0] == '\0');
+    ASSUME_ITS_TRUE(fossil_ai_chat_receive(g_chat, buf, sizeof(buf)) == 1);
+    ASSUME_ITS_TRUE(fossil_ai_chat_send(g_chat, "assistant", "back") == 0);
+    ASSUME_ITS_TRUE(fossil_ai_chat_receive(g_chat, buf, sizeof(buf)) == 0);
+    ASSUME_ITS_TRUE(strcmp(buf, "back") == 0);
+}
+
+FOSSIL_TEST(c_test_chat_prune_large_messages) {
+    size_t big = 100 * 1024;
+    char* msg = (char*)malloc(big + 1);
+    char buf[32];
+    ASSUME_NOT_CNULL(g_chat);
+    ASSUME_NOT_CNULL(msg);
+    if (msg == NULL)
+        return;
+    memset(msg, 'x', big);
+    msg[big] = '\0';
+    for (int i = 0; i < 20; ++i) {
+        ASSUME_ITS_TRUE(fossil_ai_chat_send(g_chat, "assistant", msg) == 0);
+        ASSUME_ITS_TRUE(fossil_ai_chat_history_prune(g_chat, 1) == 0);
+    }
+    ASSUME_ITS_TRUE(fossil_ai_chat_receive(g_chat, buf, sizeof(buf)) == 0);
+    ASSUME_ITS_TRUE(strlen(buf) == sizeof(buf) - 1);
+    free(msg);
+}
+
+FOSSIL_TEST(c_test_chat_prune_long_session) {
+    static char msg[6000];
+    static char want[3][6000];
+    static char buf[20000];
+    static char expect[20000];
+    ASSUME_NOT_CNULL(g_chat);
+
+    // Sizes vary so appends wrap the ring and cross arena chunks many times over.
+    for (int i = 0; i < 5000; ++i) {
+        size_t len = (size_t)(i * 7919) % 5000 + 1;
+        memset(msg, 'a' + i % 26, len);
+        msg[len] = '\0';
+        if (fossil_ai_chat_send(g_chat, "assistant", msg) != 0 ||
+            fossil_ai_chat_history_prune(g_chat, 3) != 0) {
+            ASSUME_ITS_TRUE(0);
+            return;
+        }
+        memcpy(want[i % 3], msg, len + 1);
+    }
+
+    size_t at = 0;
+    for (int i = 4997; i < 5000; ++i)
+        at += (size_t)snprintf(expect + at, sizeof(expect) - at, "assistant: %s\n", want[i % 3]);
+    ASSUME_ITS_TRUE(fossil_ai_chat_render(g_chat, buf, sizeof(buf)) == 0);
+    ASSUME_ITS_TRUE(strcmp(buf, expect) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_chat_receive(g_chat, buf, sizeof(buf)) == 0);
+    ASSUME_ITS_TRUE(strcmp(buf, want[4999 % 3]) == 0);
+}
+
+FOSSIL_TEST(c_test_chat_prune_keeps_order_after_wrap) {
+    char buf[256];
+    ASSUME_NOT_CNULL(g_chat);
+    for (int round = 0; round < 50; ++round) {
+        for (int i = 0; i < 7; ++i) {
+            char msg[16];
+            snprintf(msg, sizeof(msg), "r%dm%d", round, i);
+            ASSUME_ITS_TRUE(fossil_ai_chat_send(g_chat, i % 2 ? "assistant" : "user", msg) == 0);
+        }
+        ASSUME_ITS_TRUE(fossil_ai_chat_history_prune(g_chat, 2) == 0);
+    }
+    ASSUME_ITS_TRUE(fossil_ai_chat_send(g_chat, "user", "last") == 0);
+    ASSUME_ITS_TRUE(fossil_ai_chat_render(g_chat, buf, sizeof(buf)) == 0);
+    ASSUME_ITS_TRUE(strcmp(buf, "assistant: r49m5\nuser: r49m6\nuser: last\n") == 0);
+}
+
+// ======================================================
+// Render
+// ======================================================
+
+FOSSIL_TEST(c_test_chat_render_lines) {
+    char buf[64];
+    ASSUME_NOT_CNULL(g_chat);
+    ASSUME_ITS_TRUE(fossil_ai_chat_send(g_chat, "user", "hi") == 0);
+    ASSUME_ITS_TRUE(fossil_ai_chat_send(g_chat, "assistant", "") == 0);
+    ASSUME_ITS_TRUE(fossil_ai_chat_render(g_chat, buf, sizeof(buf)) == 0);
+    ASSUME_ITS_TRUE(strcmp(buf, "user: hi\nassistant: \n") == 0);
+}
+
+FOSSIL_TEST(c_test_chat_render_truncates) {
+    char buf[8];
+    ASSUME_NOT_CNULL(g_chat);
+    ASSUME_ITS_TRUE(fossil_ai_chat_send(g_chat, "user", "hello there") == 0);
+    ASSUME_ITS_TRUE(fossil_ai_chat_render(g_chat, buf, sizeof(buf)) == 1);
+    ASSUME_ITS_TRUE(strcmp(buf, "user: h") == 0);
+    ASSUME_ITS_TRUE(fossil_ai_chat_render(g_chat, buf, 1) == 1);
+    ASSUME_ITS_TRUE(buf[0] == '\0');
+}
+
+FOSSIL_TEST(c_test_chat_render_exact_fit) {
+    char buf[13];   // "user: 12345\n" and its terminator
+    ASSUME_NOT_CNULL(g_chat);
+    ASSUME_ITS_TRUE(fossil_ai_chat_send(g_chat, "user", "12345") == 0);
+    ASSUME_ITS_TRUE(fossil_ai_chat_render(g_chat, buf, sizeof(buf)) == 0);
+    ASSUME_ITS_TRUE(strcmp(buf, "user: 12345\n") == 0);
+    ASSUME_ITS_TRUE(fossil_ai_chat_render(g_chat, buf, sizeof(buf) - 1) == 1);
+    ASSUME_ITS_TRUE(strcmp(buf, "user: 12345") == 0);
+}
+
+FOSSIL_TEST(c_test_chat_invalid_arguments) {
+    char buf[8];
+    ASSUME_ITS_TRUE(fossil_ai_chat_session_open(NULL) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_chat_send(NULL, "user", "x") == -1);
+    ASSUME_ITS_TRUE(fossil_ai_chat_receive(NULL, buf, sizeof(buf)) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_chat_history_prune(NULL, 0) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_chat_render(NULL, buf, sizeof(buf)) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_chat_render(g_chat, buf, 0) == -1);
+}
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Pool
+// * * * * * * * * * * * * * * * * * * * * * * * *
+FOSSIL_TEST_GROUP(c_chat_tests) {
+    FOSSIL_TEST_ADD(c_chat_fixture, c_test_chat_receive_empty);
+    FOSSIL_TEST_ADD(c_chat_fixture, c_test_chat_receive_skips_user);
+    FOSSIL_TEST_ADD(c_chat_fixture, c_test_chat_receive_truncates);
+    FOSSIL_TEST_ADD(c_chat_fixture, c_test_chat_receive_after_prune);
+
+    FOSSIL_TEST_ADD(c_chat_fixture, c_test_chat_prune_keeps_newest);
+    FOSSIL_TEST_ADD(c_chat_fixture, c_test_chat_prune_more_than_held);
+    FOSSIL_TEST_ADD(c_chat_fixture, c_test_chat_prune_all_then_send);
+    FOSSIL_TEST_ADD(c_chat_fixture, c_test_chat_prune_large_messages);
+    FOSSIL_TEST_ADD(c_chat_fixture, c_test_chat_prune_long_session);
+    FOSSIL_TEST_ADD(c_chat_fixture, c_test_chat_prune_keeps_order_after_wrap);
+
+    FOSSIL_TEST_ADD(c_chat_fixture, c_test_chat_render_lines);
+    FOSSIL_TEST_ADD(c_chat_fixture, c_test_chat_render_truncates);
+    FOSSIL_TEST_ADD(c_chat_fixture, c_test_chat_render_exact_fit);
+    FOSSIL_TEST_ADD(c_chat_fixture, c_test_chat_invalid_arguments);
+
+    FOSSIL_TEST_REGISTER(c_chat_fixture);
+} // end of tests
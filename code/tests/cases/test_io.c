@@ -0,0 +1,223 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#include <fossil/pizza/framework.h>
+#include "io.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Utilities
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// Setup steps for things like test fixtures and
+// mock objects are set here.
+// * * * * * * * * * * * * * * * * * * * * * * * *
+
+#define IO_TEST_FILE "fossil_ai_io_test.bin"
+#define IO_TEST_BYTES (3u * 1024u * 1024u + 123u)
+
+static unsigned char* g_io_data = NULL;
+
+FOSSIL_SUITE(c_io_fixture);
+
+FOSSIL_SETUP(c_io_fixture) {
+    g_io_data = (unsigned char*)malloc(IO_TEST_BYTES);
+    if (g_io_data != NULL) {
+        for (size_t i = 0; i < IO_TEST_BYTES; ++i)
+            g_io_data[i] = (unsigned char)((i * 2654435761u) >> 13);
+    }
+}
+
+FOSSIL_TEARDOWN(c_io_fixture) {
+    free(g_io_data);
+    g_io_data = NULL;
+    remove(IO_TEST_FILE);
+}
+
+static int file_matches(const char* path, const unsigned char* want, size_t n) {
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return 0;
+    unsigned char* got = (unsigned char*)malloc(n + 1);
+    size_t r = got ? fread(got, 1, n + 1, f) : 0;
+    fclose(f);
+    int same = got && r == n && memcmp(got, want, n) == 0;
+    free(got);
+    return same;
+}
+
+/*
+ * Writes the fixture in pieces of growing size, copied below 64 KiB and
+ * queued by reference above, so both paths cross chunk boundaries.
+ * 1 = engine not available here, 0 = written and read back, -1 = failed.
+ */
+static int io_roundtrip(int engine, int direct, int* used) {
+    fossil_ai_io_config_t config;
+    void* w = NULL;
+
+    memset(&config, 0, sizeof(config));
+    config.engine = engine;
+    config.direct = direct;
+    config.sync = 1;
+    config.chunk_bytes = 64 * 1024;
+    config.depth = 4;
+    if (fossil_ai_io_create(&w, IO_TEST_FILE, &config) != 0)
+        return 1;
+    *used = fossil_ai_io_engine(w);
+
+    int rc = 0;
+    size_t off = 0, step = 1;
+    while (off < IO_TEST_BYTES) {
+        size_t k = step < IO_TEST_BYTES - off ? step : IO_TEST_BYTES - off;
+        if (k >= 64 * 1024)
+            rc |= fossil_ai_io_write_ref(w, g_io_data + off, k);
+        else
+            rc |= fossil_ai_io_write(w, g_io_data + off, k);
+        off += k;
+        step = step * 3 + 7;
+        if (step > 1024 * 1024)
+            step = 1;
+    }
+    if (fossil_ai_io_offset(w) != IO_TEST_BYTES)
+        rc = -1;
+    if (fossil_ai_io_close(w) != 0)
+        rc = -1;
+    if (rc == 0 && !file_matches(IO_TEST_FILE, g_io_data, IO_TEST_BYTES))
+        rc = -1;
+    return rc;
+}
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Cases
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// The test cases below are provided as samples, inspired
+// by the Meson build system's approach of using test cases
+// as samples for library usage.
+// * * * * * * * * * * * * * * * * * * * * * * * *
+
+// ======================================================
+// Writer Engines
+// ======================================================
+
+FOSSIL_TEST(c_test_io_engine_auto) {
+    int used = -1;
+    ASSUME_NOT_CNULL(g_io_data);
+    ASSUME_ITS_TRUE(io_roundtrip(FOSSIL_AI_IO_AUTO, 0, &used) == 0);
+    ASSUME_ITS_TRUE(used == FOSSIL_AI_IO_URING || used == FOSSIL_AI_IO_THREADS ||
+                    used == FOSSIL_AI_IO_STDIO);
+}
+
+FOSSIL_TEST(c_test_io_engine_uring) {
+    int used = -1;
+    ASSUME_NOT_CNULL(g_io_data);
+    int rc = io_roundtrip(FOSSIL_AI_IO_URING, 0, &used);
+    // io_uring may be unavailable or disabled; then create refuses it.
+    ASSUME_ITS_TRUE(rc == 1 || (rc == 0 && used == FOSSIL_AI_IO_URING));
+}
+
+FOSSIL_TEST(c_test_io_engine_threads) {
+    int used = -1;
+    ASSUME_NOT_CNULL(g_io_data);
+    ASSUME_ITS_TRUE(io_roundtrip(FOSSIL_AI_IO_THREADS, 0, &used) == 0);
+    ASSUME_ITS_TRUE(used == FOSSIL_AI_IO_THREADS);
+}
+
+FOSSIL_TEST(c_test_io_engine_stdio) {
+    int used = -1;
+    ASSUME_NOT_CNULL(g_io_data);
+    ASSUME_ITS_TRUE(io_roundtrip(FOSSIL_AI_IO_STDIO, 0, &used) == 0);
+    ASSUME_ITS_TRUE(used == FOSSIL_AI_IO_STDIO);
+}
+
+FOSSIL_TEST(c_test_io_engine_direct) {
+    static const int engines[3] = { FOSSIL_AI_IO_URING, FOSSIL_AI_IO_THREADS, FOSSIL_AI_IO_STDIO };
+    ASSUME_NOT_CNULL(g_io_data);
+    for (int e = 0; e < 3; ++e) {
+        int used = -1;
+        int rc = io_roundtrip(engines[e], 1, &used);
+        ASSUME_ITS_TRUE(rc == 0 || (rc == 1 && engines[e] == FOSSIL_AI_IO_URING));
+    }
+}
+
+FOSSIL_TEST(c_test_io_empty_file) {
+    void* w = NULL;
+    ASSUME_ITS_TRUE(fossil_ai_io_create(&w, IO_TEST_FILE, NULL) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_io_offset(w) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_io_close(w) == 0);
+    ASSUME_ITS_TRUE(file_matches(IO_TEST_FILE, (const unsigned char*)"", 0));
+}
+
+#ifdef __linux__
+FOSSIL_TEST(c_test_io_write_failure) {
+    static const int engines[3] = { FOSSIL_AI_IO_URING, FOSSIL_AI_IO_THREADS, FOSSIL_AI_IO_STDIO };
+    fossil_ai_io_config_t config;
+    ASSUME_NOT_CNULL(g_io_data);
+    if (g_io_data == NULL)
+        return;
+
+    // Every write to /dev/full fails; close reports it whichever engine ran it.
+    for (int e = 0; e < 3; ++e) {
+        void* w = NULL;
+        memset(&config, 0, sizeof(config));
+        config.engine = engines[e];
+        config.chunk_bytes = 64 * 1024;
+        if (fossil_ai_io_create(&w, "/dev/full", &config) != 0) {
+            ASSUME_ITS_TRUE(engines[e] == FOSSIL_AI_IO_URING);
+            continue;
+        }
+        fossil_ai_io_write(w, g_io_data, 1024 * 1024);
+        fossil_ai_io_write_ref(w, g_io_data, IO_TEST_BYTES);
+        ASSUME_ITS_TRUE(fossil_ai_io_close(w) == -1);
+    }
+}
+#endif
+
+FOSSIL_TEST(c_test_io_invalid_arguments) {
+    void* w = NULL;
+    ASSUME_ITS_FALSE(fossil_ai_io_create(NULL, IO_TEST_FILE, NULL) == 0);
+    ASSUME_ITS_FALSE(fossil_ai_io_create(&w, NULL, NULL) == 0);
+    ASSUME_ITS_FALSE(fossil_ai_io_create(&w, "nonexistent_dir/io.bin", NULL) == 0);
+    ASSUME_ITS_CNULL(w);
+}
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Pool
+// * * * * * * * * * * * * * * * * * * * * * * * *
+FOSSIL_TEST_GROUP(c_io_tests) {
+    FOSSIL_TEST_ADD(c_io_fixture, c_test_io_engine_auto);
+    FOSSIL_TEST_ADD(c_io_fixture, c_test_io_engine_uring);
+    FOSSIL_TEST_ADD(c_io_fixture, c_test_io_engine_threads);
+    FOSSIL_TEST_ADD(c_io_fixture, c_test_io_engine_stdio);
+    FOSSIL_TEST_ADD(c_io_fixture, c_test_io_engine_direct);
+    FOSSIL_TEST_ADD(c_io_fixture, c_test_io_empty_file);
+#ifdef __linux__
+    FOSSIL_TEST_ADD(c_io_fixture, c_test_io_write_failure);
+#endif
+    FOSSIL_TEST_ADD(c_io_fixture, c_test_io_invalid_arguments);
+
+    FOSSIL_TEST_REGISTER(c_io_fixture);
+} // end of tests
@@ -0,0 +1,251 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#include <fossil/pizza/framework.h>
+#include "fossil/ai/sweep.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Utilities
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// Setup steps for things like test fixtures and
+// mock objects are set here.
+// * * * * * * * * * * * * * * * * * * * * * * * *
+
+#define SWEEP_TEST_FILE "fossil_ai_sweep_test.bin"
+#define SWEEP_TEST_ROWS 4000
+#define SWEEP_TEST_WIDTH 5  /* four inputs, one output */
+#define SWEEP_TEST_VARIANTS 6
+
+static float g_sweep_rows[SWEEP_TEST_ROWS * SWEEP_TEST_WIDTH];
+static fossil_ai_sweep_dataset_t g_sweep_data;
+
+FOSSIL_SUITE(c_sweep_fixture);
+
+FOSSIL_SETUP(c_sweep_fixture) {
+    // The target is the sum of the inputs, so coarser variants lose more.
+    uint32_t r = 1u;
+    for (size_t i = 0; i < SWEEP_TEST_ROWS; ++i) {
+        float sum = 0.0f;
+        for (size_t j = 0; j < 4; ++j) {
+            r = r * 1103515245u + 12345u;
+            g_sweep_rows[i * SWEEP_TEST_WIDTH + j] = (float)((r >> 16) % 400) / 100.0f;
+            sum += g_sweep_rows[i * SWEEP_TEST_WIDTH + j];
+        }
+        g_sweep_rows[i * SWEEP_TEST_WIDTH + 4] = sum;
+    }
+    memset(&g_sweep_data, 0, sizeof(g_sweep_data));
+    g_sweep_data.rows = g_sweep_rows;
+    g_sweep_data.count = SWEEP_TEST_ROWS;
+    g_sweep_data.width = SWEEP_TEST_WIDTH;
+}
+
+FOSSIL_TEARDOWN(c_sweep_fixture) {
+    remove(SWEEP_TEST_FILE);
+}
+
+static fossil_ai_train_config_t sweep_variant(size_t k) {
+    fossil_ai_train_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.input_dim = 4;
+    config.output_dim = 1;
+    config.learning_rate = 0.1f + 0.15f * (float)k;
+    config.resolution = 0.25f;
+    config.seed = 7;
+    return config;
+}
+
+static fossil_ai_sweep_config_t sweep_config(const fossil_ai_train_config_t* variants, size_t count) {
+    fossil_ai_sweep_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.variants = variants;
+    config.variant_count = count;
+    config.data = &g_sweep_data;
+    config.batch_rows = 200;
+    config.rung_steps = 2;
+    config.max_steps = 20;
+    return config;
+}
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Cases
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// The test cases below are provided as samples, inspired
+// by the Meson build system's approach of using test cases
+// as samples for library usage.
+// * * * * * * * * * * * * * * * * * * * * * * * *
+
+// ======================================================
+// Halving
+// ======================================================
+
+FOSSIL_TEST(c_test_sweep_halving_keeps_one) {
+    fossil_ai_train_config_t variants[SWEEP_TEST_VARIANTS];
+    fossil_ai_sweep_result_t results[SWEEP_TEST_VARIANTS];
+    for (size_t k = 0; k < SWEEP_TEST_VARIANTS; ++k)
+        variants[k] = sweep_variant(k);
+    fossil_ai_sweep_config_t config = sweep_config(variants, SWEEP_TEST_VARIANTS);
+
+    // Rungs at steps 2, 4 and 8 leave 3, 2 and then 1 of the 6 variants.
+    int best = fossil_ai_sweep_run(&config, results);
+    ASSUME_ITS_TRUE(best >= 0 && best < SWEEP_TEST_VARIANTS);
+    if (best < 0)
+        return;
+    size_t stopped = 0;
+    for (size_t k = 0; k < SWEEP_TEST_VARIANTS; ++k) {
+        stopped += (size_t)results[k].stopped;
+        if (results[k].stopped)
+            ASSUME_ITS_TRUE(results[k].steps < config.max_steps);
+    }
+    ASSUME_ITS_TRUE(stopped == SWEEP_TEST_VARIANTS - 1);
+    ASSUME_ITS_FALSE(results[best].stopped);
+    ASSUME_ITS_TRUE(results[best].steps == config.max_steps);
+    ASSUME_ITS_TRUE(results[best].rungs == 3);
+}
+
+FOSSIL_TEST(c_test_sweep_workers_agree) {
+    fossil_ai_train_config_t variants[SWEEP_TEST_VARIANTS];
+    fossil_ai_sweep_result_t one[SWEEP_TEST_VARIANTS], many[SWEEP_TEST_VARIANTS];
+    for (size_t k = 0; k < SWEEP_TEST_VARIANTS; ++k)
+        variants[k] = sweep_variant(k);
+    fossil_ai_sweep_config_t config = sweep_config(variants, SWEEP_TEST_VARIANTS);
+
+    // Each variant trains on one thread at a time, so scheduling cannot change its result.
+    config.workers = 1;
+    int a = fossil_ai_sweep_run(&config, one);
+    config.workers = 3;
+    int b = fossil_ai_sweep_run(&config, many);
+    ASSUME_ITS_TRUE(a >= 0);
+    ASSUME_ITS_TRUE(a == b);
+    for (size_t k = 0; k < SWEEP_TEST_VARIANTS; ++k) {
+        ASSUME_ITS_TRUE(one[k].loss == many[k].loss);
+        ASSUME_ITS_TRUE(one[k].steps == many[k].steps);
+        ASSUME_ITS_TRUE(one[k].stopped == many[k].stopped);
+    }
+}
+
+FOSSIL_TEST(c_test_sweep_diverged_variant_loses) {
+    fossil_ai_train_config_t variants[2];
+    fossil_ai_sweep_result_t results[2];
+    variants[0] = sweep_variant(0);
+    variants[1] = sweep_variant(1);
+    // A NaN blend factor poisons every revisited block, so variant 0 scores NaN.
+    variants[0].learning_rate = NAN;
+    fossil_ai_sweep_config_t config = sweep_config(variants, 2);
+
+    ASSUME_ITS_TRUE(fossil_ai_sweep_run(&config, results) == 1);
+    ASSUME_ITS_TRUE(results[0].stopped);
+    ASSUME_ITS_FALSE(results[1].stopped);
+}
+
+FOSSIL_TEST(c_test_sweep_early_stop_finishes) {
+    fossil_ai_train_config_t variants[2];
+    fossil_ai_sweep_result_t results[2];
+    for (size_t k = 0; k < 2; ++k) {
+        variants[k] = sweep_variant(k);
+        variants[k].early_stop.patience = 2;
+        variants[k].early_stop.min_delta = 1e-3;
+    }
+    fossil_ai_sweep_config_t config = sweep_config(variants, 2);
+    config.rung_steps = 0;
+    config.max_steps = 500;
+
+    // Without rungs only the variants' own policies can end the sweep early.
+    int best = fossil_ai_sweep_run(&config, results);
+    ASSUME_ITS_TRUE(best == 0 || best == 1);
+    for (size_t k = 0; k < 2; ++k) {
+        ASSUME_ITS_TRUE(results[k].finished);
+        ASSUME_ITS_FALSE(results[k].stopped);
+        ASSUME_ITS_TRUE(results[k].steps < config.max_steps);
+    }
+}
+
+// ======================================================
+// Dataset
+// ======================================================
+
+FOSSIL_TEST(c_test_sweep_dataset_map) {
+    fossil_ai_train_config_t variants[2];
+    fossil_ai_sweep_result_t results[2];
+    fossil_ai_sweep_dataset_t mapped;
+    FILE* f = fopen(SWEEP_TEST_FILE, "wb");
+    ASSUME_NOT_CNULL(f);
+    if (!f)
+        return;
+    ASSUME_ITS_TRUE(fwrite(g_sweep_rows, sizeof(g_sweep_rows), 1, f) == 1);
+    fclose(f);
+
+    ASSUME_ITS_TRUE(fossil_ai_sweep_dataset_map(SWEEP_TEST_FILE, SWEEP_TEST_WIDTH, &mapped) == 0);
+    ASSUME_ITS_TRUE(mapped.count == SWEEP_TEST_ROWS);
+    ASSUME_ITS_TRUE(mapped.width == SWEEP_TEST_WIDTH);
+    ASSUME_ITS_TRUE(memcmp(mapped.rows, g_sweep_rows, sizeof(g_sweep_rows)) == 0);
+
+    variants[0] = sweep_variant(0);
+    variants[1] = sweep_variant(3);
+    fossil_ai_sweep_config_t config = sweep_config(variants, 2);
+    config.data = &mapped;
+    int best = fossil_ai_sweep_run(&config, results);
+    ASSUME_ITS_TRUE(best == 0 || best == 1);
+    ASSUME_ITS_TRUE(fossil_ai_sweep_dataset_unmap(&mapped) == 0);
+}
+
+FOSSIL_TEST(c_test_sweep_invalid_arguments) {
+    fossil_ai_train_config_t variants[1];
+    fossil_ai_sweep_result_t results[1];
+    fossil_ai_sweep_dataset_t mapped;
+    variants[0] = sweep_variant(0);
+    fossil_ai_sweep_config_t config = sweep_config(variants, 1);
+
+    ASSUME_ITS_TRUE(fossil_ai_sweep_run(NULL, results) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_sweep_run(&config, NULL) == -1);
+    config.batch_rows = 0;
+    ASSUME_ITS_TRUE(fossil_ai_sweep_run(&config, results) == -1);
+    config = sweep_config(variants, 1);
+    variants[0].input_dim = 3;
+    ASSUME_ITS_TRUE(fossil_ai_sweep_run(&config, results) == -1);
+
+    ASSUME_ITS_TRUE(fossil_ai_sweep_dataset_map("nonexistent_sweep.bin", 5, &mapped) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_sweep_dataset_map(SWEEP_TEST_FILE, 0, &mapped) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_sweep_dataset_unmap(NULL) == -1);
+}
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Pool
+// * * * * * * * * * * * * * * * * * * * * * * * *
+FOSSIL_TEST_GROUP(c_sweep_tests) {
+    FOSSIL_TEST_ADD(c_sweep_fixture, c_test_sweep_halving_keeps_one);
+    FOSSIL_TEST_ADD(c_sweep_fixture, c_test_sweep_workers_agree);
+    FOSSIL_TEST_ADD(c_sweep_fixture, c_test_sweep_diverged_variant_loses);
+    FOSSIL_TEST_ADD(c_sweep_fixture, c_test_sweep_early_stop_finishes);
+
+    FOSSIL_TEST_ADD(c_sweep_fixture, c_test_sweep_dataset_map);
+    FOSSIL_TEST_ADD(c_sweep_fixture, c_test_sweep_invalid_arguments);
+
+    FOSSIL_TEST_REGISTER(c_sweep_fixture);
+} // end of tests
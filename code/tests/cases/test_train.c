@@ -0,0 +1,1260 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#include <fossil/pizza/framework.h>
+#include "fossil/ai/train.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Utilities
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// Setup steps for things like test fixtures and
+// mock objects are set here.
+// * * * * * * * * * * * * * * * * * * * * * * * *
+
+#define TRAIN_TEST_CKPT "fossil_ai_train_test.ckpt"
+#define TRAIN_TEST_TRACE "fossil_ai_train_test.json"
+#define TRAIN_TEST_RING "fossil_ai_train_test.ring"
+#define TRAIN_TEST_ROWS 4096
+#define TRAIN_TEST_WIDTH 3  /* two inputs, one output */
+
+static float g_train_rows[TRAIN_TEST_ROWS * TRAIN_TEST_WIDTH];
+
+FOSSIL_SUITE(c_train_fixture);
+
+FOSSIL_SETUP(c_train_fixture) {
+    // Few distinct inputs with varying targets, so row order shows in the result.
+    uint32_t r = 12345u;
+    for (size_t i = 0; i < TRAIN_TEST_ROWS; ++i) {
+        r = r * 1103515245u + 12345u;
+        g_train_rows[i * TRAIN_TEST_WIDTH] = (float)(i % 16);
+        g_train_rows[i * TRAIN_TEST_WIDTH + 1] = (float)((i / 16) % 8);
+        g_train_rows[i * TRAIN_TEST_WIDTH + 2] = (float)(r >> 16) / 65536.0f;
+    }
+}
+
+FOSSIL_TEARDOWN(c_train_fixture) {
+    remove(TRAIN_TEST_CKPT);
+    remove(TRAIN_TEST_TRACE);
+}
+
+static fossil_ai_train_config_t train_config(void) {
+    fossil_ai_train_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.input_dim = 2;
+    config.output_dim = 1;
+    config.learning_rate = 0.3f;
+    config.resolution = 1.0f;
+    config.seed = 7;
+    return config;
+}
+
+static int train_epoch(void* model, const fossil_ai_train_shuffle_t* shuffle) {
+    fossil_ai_train_config_t config = train_config();
+    if (fossil_ai_train_begin(model, &config, NULL) != 0 ||
+        fossil_ai_train_dataset_attach(model, g_train_rows, TRAIN_TEST_ROWS) != 0)
+        return -1;
+    if (shuffle && fossil_ai_train_shuffle_set(model, shuffle) != 0)
+        return -1;
+    for (size_t done = 0; done < TRAIN_TEST_ROWS; done += 256) {
+        if (fossil_ai_train_step(model, NULL, 256) != 0)
+            return -1;
+    }
+    return fossil_ai_train_finalize(model);
+}
+
+static int train_recall(void* model, float* out, size_t* hits) {
+    float in[TRAIN_TEST_ROWS * 2];
+    for (size_t i = 0; i < TRAIN_TEST_ROWS; ++i) {
+        in[i * 2] = g_train_rows[i * TRAIN_TEST_WIDTH];
+        in[i * 2 + 1] = g_train_rows[i * TRAIN_TEST_WIDTH + 1];
+    }
+    return fossil_ai_train_recall(model, in, TRAIN_TEST_ROWS, out, hits);
+}
+
+/* Flips one byte at offset (if >= 0) and keeps the first keep bytes (all if < 0). */
+static int file_corrupt(const char* path, long offset, long keep) {
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return -1;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char* buf = (char*)malloc((size_t)size);
+    size_t got = buf ? fread(buf, 1, (size_t)size, f) : 0;
+    fclose(f);
+    if (got != (size_t)size) {
+        free(buf);
+        return -1;
+    }
+    if (offset >= 0)
+        buf[offset] ^= 1;
+    f = fopen(path, "wb");
+    size_t n = keep >= 0 ? (size_t)keep : (size_t)size;
+    int rc = f && fwrite(buf, 1, n, f) == n ? 0 : -1;
+    if (f)
+        fclose(f);
+    free(buf);
+    return rc;
+}
+
+/* Reads a whole text file into a NUL-terminated buffer the caller frees. */
+static char* file_text(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char* buf = size >= 0 ? (char*)malloc((size_t)size + 1) : NULL;
+    if (buf && fread(buf, 1, (size_t)size, f) == (size_t)size) {
+        buf[size] = '\0';
+    } else {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    return buf;
+}
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Cases
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// The test cases below are provided as samples, inspired
+// by the Meson build system's approach of using test cases
+// as samples for library usage.
+// * * * * * * * * * * * * * * * * * * * * * * * *
+
+// ======================================================
+// Checkpoint
+// ======================================================
+
+FOSSIL_TEST(c_test_train_checkpoint_resume) {
+    static float before[TRAIN_TEST_ROWS], after[TRAIN_TEST_ROWS];
+    int model = 0, resumed = 0;
+    size_t hits = 0, resumed_hits = 0;
+
+    ASSUME_ITS_TRUE(train_epoch(&model, NULL) == 0);
+    ASSUME_ITS_TRUE(train_recall(&model, before, &hits) == 0);
+    ASSUME_ITS_TRUE(hits == TRAIN_TEST_ROWS);
+    ASSUME_ITS_TRUE(fossil_ai_train_checkpoint(&model, TRAIN_TEST_CKPT) == 0);
+    fossil_ai_train_release(&model);
+
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&resumed, NULL, TRAIN_TEST_CKPT) == 0);
+    ASSUME_ITS_TRUE(train_recall(&resumed, after, &resumed_hits) == 0);
+    ASSUME_ITS_TRUE(resumed_hits == hits);
+    ASSUME_ITS_TRUE(memcmp(before, after, sizeof(before)) == 0);
+
+    ASSUME_ITS_TRUE(fossil_ai_train_dataset_attach(&resumed, g_train_rows, TRAIN_TEST_ROWS) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_step(&resumed, NULL, 256) == 0);
+    fossil_ai_train_release(&resumed);
+}
+
+FOSSIL_TEST(c_test_train_checkpoint_bad_magic) {
+    int model = 0, resumed = 0;
+    ASSUME_ITS_TRUE(train_epoch(&model, NULL) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_checkpoint(&model, TRAIN_TEST_CKPT) == 0);
+    fossil_ai_train_release(&model);
+
+    ASSUME_ITS_TRUE(file_corrupt(TRAIN_TEST_CKPT, 0, -1) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&resumed, NULL, TRAIN_TEST_CKPT) == -3);
+}
+
+FOSSIL_TEST(c_test_train_checkpoint_truncated) {
+    int model = 0, resumed = 0;
+    ASSUME_ITS_TRUE(train_epoch(&model, NULL) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_checkpoint(&model, TRAIN_TEST_CKPT) == 0);
+    fossil_ai_train_release(&model);
+
+    FILE* f = fopen(TRAIN_TEST_CKPT, "rb");
+    long size = 0;
+    if (f) {
+        fseek(f, 0, SEEK_END);
+        size = ftell(f);
+        fclose(f);
+    }
+    ASSUME_ITS_TRUE(size > 0);
+    ASSUME_ITS_TRUE(file_corrupt(TRAIN_TEST_CKPT, -1, size / 2) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&resumed, NULL, TRAIN_TEST_CKPT) == -3);
+}
+
+FOSSIL_TEST(c_test_train_checkpoint_missing) {
+    int resumed = 0;
+    ASSUME_ITS_FALSE(fossil_ai_train_begin(&resumed, NULL, "nonexistent_train.ckpt") == 0);
+}
+
+/* Starts a session on the fixture and runs steps batches of 256 rows. */
+static int train_steps(void* model, size_t steps) {
+    fossil_ai_train_config_t config = train_config();
+    if (fossil_ai_train_begin(model, &config, NULL) != 0 ||
+        fossil_ai_train_dataset_attach(model, g_train_rows, TRAIN_TEST_ROWS) != 0)
+        return -1;
+    for (size_t i = 0; i < steps; ++i) {
+        if (fossil_ai_train_step(model, NULL, 256) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+FOSSIL_TEST(c_test_train_checkpoint_continues) {
+    static float straight[TRAIN_TEST_ROWS], resumed_out[TRAIN_TEST_ROWS];
+    int model = 0, resumed = 0;
+    size_t hits = 0;
+
+    // The cursor and generator come back, so a resumed run matches an unbroken one.
+    ASSUME_ITS_TRUE(train_steps(&model, 6) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_checkpoint(&model, TRAIN_TEST_CKPT) == 0);
+    for (int i = 0; i < 10; ++i)
+        ASSUME_ITS_TRUE(fossil_ai_train_step(&model, NULL, 256) == 0);
+    ASSUME_ITS_TRUE(train_recall(&model, straight, &hits) == 0);
+    fossil_ai_train_release(&model);
+
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&resumed, NULL, TRAIN_TEST_CKPT) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_dataset_attach(&resumed, g_train_rows, TRAIN_TEST_ROWS) == 0);
+    for (int i = 0; i < 10; ++i)
+        ASSUME_ITS_TRUE(fossil_ai_train_step(&resumed, NULL, 256) == 0);
+    ASSUME_ITS_TRUE(train_recall(&resumed, resumed_out, &hits) == 0);
+    ASSUME_ITS_TRUE(memcmp(straight, resumed_out, sizeof(straight)) == 0);
+    fossil_ai_train_release(&resumed);
+}
+
+FOSSIL_TEST(c_test_train_checkpoint_over_mapped) {
+    static float before[TRAIN_TEST_ROWS], after[TRAIN_TEST_ROWS];
+    int model = 0, resumed = 0, again = 0;
+    size_t hits = 0;
+
+    ASSUME_ITS_TRUE(train_epoch(&model, NULL) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_checkpoint(&model, TRAIN_TEST_CKPT) == 0);
+    fossil_ai_train_release(&model);
+
+    // Blocks still alias the mapped file while training writes to them and the
+    // same path is replaced underneath.
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&resumed, NULL, TRAIN_TEST_CKPT) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_dataset_attach(&resumed, g_train_rows, TRAIN_TEST_ROWS) == 0);
+    for (int i = 0; i < 8; ++i)
+        ASSUME_ITS_TRUE(fossil_ai_train_step(&resumed, NULL, 256) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_finalize(&resumed) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_checkpoint(&resumed, TRAIN_TEST_CKPT) == 0);
+    ASSUME_ITS_TRUE(train_recall(&resumed, before, &hits) == 0);
+    fossil_ai_train_release(&resumed);
+
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&again, NULL, TRAIN_TEST_CKPT) == 0);
+    ASSUME_ITS_TRUE(train_recall(&again, after, &hits) == 0);
+    ASSUME_ITS_TRUE(hits == TRAIN_TEST_ROWS);
+    ASSUME_ITS_TRUE(memcmp(before, after, sizeof(before)) == 0);
+    fossil_ai_train_release(&again);
+}
+
+FOSSIL_TEST(c_test_train_checkpoint_begin_conflicts) {
+    fossil_ai_train_config_t config = train_config();
+    int model = 0;
+
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&model, NULL, NULL) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&model, &config, TRAIN_TEST_CKPT) == -1);
+    ASSUME_ITS_TRUE(train_epoch(&model, NULL) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_checkpoint(&model, TRAIN_TEST_CKPT) == 0);
+
+    // A live session is not replaced by a checkpoint, nor by a config of another shape.
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&model, NULL, TRAIN_TEST_CKPT) == -1);
+    config.input_dim = 3;
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&model, &config, NULL) == -1);
+    config = train_config();
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&model, &config, NULL) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&model, &config, NULL) == 1);
+    fossil_ai_train_release(&model);
+}
+
+// ======================================================
+// Shuffle
+// ======================================================
+
+FOSSIL_TEST(c_test_train_shuffle_deterministic) {
+    static float a[TRAIN_TEST_ROWS], b[TRAIN_TEST_ROWS], c[TRAIN_TEST_ROWS];
+    fossil_ai_train_shuffle_t shuffle;
+    int m1 = 0, m2 = 0, m3 = 0;
+    size_t hits = 0;
+
+    memset(&shuffle, 0, sizeof(shuffle));
+    shuffle.group_rows = 100;
+    shuffle.window_rows = 64;
+    shuffle.seed = 42;
+
+    ASSUME_ITS_TRUE(train_epoch(&m1, &shuffle) == 0);
+    ASSUME_ITS_TRUE(train_epoch(&m2, &shuffle) == 0);
+    shuffle.seed = 43;
+    ASSUME_ITS_TRUE(train_epoch(&m3, &shuffle) == 0);
+
+    ASSUME_ITS_TRUE(train_recall(&m1, a, &hits) == 0);
+    ASSUME_ITS_TRUE(train_recall(&m2, b, &hits) == 0);
+    ASSUME_ITS_TRUE(train_recall(&m3, c, &hits) == 0);
+    ASSUME_ITS_TRUE(memcmp(a, b, sizeof(a)) == 0);
+    ASSUME_ITS_FALSE(memcmp(a, c, sizeof(a)) == 0);
+
+    fossil_ai_train_release(&m1);
+    fossil_ai_train_release(&m2);
+    fossil_ai_train_release(&m3);
+}
+
+FOSSIL_TEST(c_test_train_shuffle_weighted_deterministic) {
+    static float a[TRAIN_TEST_ROWS], b[TRAIN_TEST_ROWS];
+    static float weights[TRAIN_TEST_ROWS];
+    fossil_ai_train_shuffle_t shuffle;
+    int m1 = 0, m2 = 0;
+    size_t hits = 0;
+
+    for (size_t i = 0; i < TRAIN_TEST_ROWS; ++i)
+        weights[i] = (float)(1 + i % 3);
+    memset(&shuffle, 0, sizeof(shuffle));
+    shuffle.seed = 9;
+    shuffle.weights = weights;
+
+    ASSUME_ITS_TRUE(train_epoch(&m1, &shuffle) == 0);
+    ASSUME_ITS_TRUE(train_epoch(&m2, &shuffle) == 0);
+    ASSUME_ITS_TRUE(train_recall(&m1, a, &hits) == 0);
+    ASSUME_ITS_TRUE(train_recall(&m2, b, &hits) == 0);
+    ASSUME_ITS_TRUE(memcmp(a, b, sizeof(a)) == 0);
+
+    fossil_ai_train_release(&m1);
+    fossil_ai_train_release(&m2);
+}
+
+FOSSIL_TEST(c_test_train_shuffle_zeroed_is_sequential) {
+    static float a[TRAIN_TEST_ROWS], b[TRAIN_TEST_ROWS], c[TRAIN_TEST_ROWS];
+    fossil_ai_train_shuffle_t shuffle;
+    int m1 = 0, m2 = 0, m3 = 0;
+    size_t hits = 0;
+
+    // A zeroed config keeps file order and does not stratify on column 0.
+    memset(&shuffle, 0, sizeof(shuffle));
+    ASSUME_ITS_TRUE(train_epoch(&m1, NULL) == 0);
+    ASSUME_ITS_TRUE(train_epoch(&m2, &shuffle) == 0);
+    shuffle.seed = 5;
+    ASSUME_ITS_TRUE(train_epoch(&m3, &shuffle) == 0);
+
+    ASSUME_ITS_TRUE(train_recall(&m1, a, &hits) == 0);
+    ASSUME_ITS_TRUE(train_recall(&m2, b, &hits) == 0);
+    ASSUME_ITS_TRUE(train_recall(&m3, c, &hits) == 0);
+    ASSUME_ITS_TRUE(memcmp(a, b, sizeof(a)) == 0);
+    ASSUME_ITS_TRUE(memcmp(a, c, sizeof(a)) == 0);
+
+    fossil_ai_train_release(&m1);
+    fossil_ai_train_release(&m2);
+    fossil_ai_train_release(&m3);
+}
+
+FOSSIL_TEST(c_test_train_shuffle_stratified) {
+    static float a[TRAIN_TEST_ROWS], b[TRAIN_TEST_ROWS], plain[TRAIN_TEST_ROWS];
+    fossil_ai_train_shuffle_t shuffle;
+    int m1 = 0, m2 = 0, m3 = 0;
+    size_t hits = 0;
+
+    memset(&shuffle, 0, sizeof(shuffle));
+    shuffle.group_rows = 128;
+    shuffle.window_rows = 32;
+    shuffle.seed = 11;
+    ASSUME_ITS_TRUE(train_epoch(&m3, &shuffle) == 0);
+    shuffle.stratify = 1;
+    shuffle.stratify_output = 0;
+    ASSUME_ITS_TRUE(train_epoch(&m1, &shuffle) == 0);
+    ASSUME_ITS_TRUE(train_epoch(&m2, &shuffle) == 0);
+
+    ASSUME_ITS_TRUE(train_recall(&m1, a, &hits) == 0);
+    ASSUME_ITS_TRUE(hits == TRAIN_TEST_ROWS);
+    ASSUME_ITS_TRUE(train_recall(&m2, b, &hits) == 0);
+    ASSUME_ITS_TRUE(train_recall(&m3, plain, &hits) == 0);
+    ASSUME_ITS_TRUE(memcmp(a, b, sizeof(a)) == 0);
+    ASSUME_ITS_FALSE(memcmp(a, plain, sizeof(a)) == 0);
+
+    fossil_ai_train_release(&m1);
+    fossil_ai_train_release(&m2);
+    fossil_ai_train_release(&m3);
+}
+
+FOSSIL_TEST(c_test_train_shuffle_resumes_order) {
+    static float straight[TRAIN_TEST_ROWS], resumed_out[TRAIN_TEST_ROWS];
+    fossil_ai_train_config_t config = train_config();
+    fossil_ai_train_shuffle_t shuffle;
+    int model = 0, resumed = 0;
+    size_t hits = 0;
+
+    memset(&shuffle, 0, sizeof(shuffle));
+    shuffle.group_rows = 100;
+    shuffle.window_rows = 50;
+    shuffle.seed = 3;
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&model, &config, NULL) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_dataset_attach(&model, g_train_rows, TRAIN_TEST_ROWS) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_shuffle_set(&model, &shuffle) == 0);
+    for (int i = 0; i < 5; ++i)
+        ASSUME_ITS_TRUE(fossil_ai_train_step(&model, NULL, 256) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_checkpoint(&model, TRAIN_TEST_CKPT) == 0);
+    for (int i = 0; i < 20; ++i)
+        ASSUME_ITS_TRUE(fossil_ai_train_step(&model, NULL, 256) == 0);
+    ASSUME_ITS_TRUE(train_recall(&model, straight, &hits) == 0);
+    fossil_ai_train_release(&model);
+
+    // The shuffle settings travel in the checkpoint; only the rows are attached again.
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&resumed, NULL, TRAIN_TEST_CKPT) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_dataset_attach(&resumed, g_train_rows, TRAIN_TEST_ROWS) == 0);
+    for (int i = 0; i < 20; ++i)
+        ASSUME_ITS_TRUE(fossil_ai_train_step(&resumed, NULL, 256) == 0);
+    ASSUME_ITS_TRUE(train_recall(&resumed, resumed_out, &hits) == 0);
+    ASSUME_ITS_TRUE(memcmp(straight, resumed_out, sizeof(straight)) == 0);
+    fossil_ai_train_release(&resumed);
+}
+
+FOSSIL_TEST(c_test_train_shuffle_invalid_stratum) {
+    fossil_ai_train_config_t config = train_config();
+    fossil_ai_train_shuffle_t shuffle;
+    int model = 0;
+
+    memset(&shuffle, 0, sizeof(shuffle));
+    shuffle.stratify = 1;
+    shuffle.stratify_output = 1;    // only one output column
+    ASSUME_ITS_TRUE(fossil_ai_train_shuffle_set(&model, &shuffle) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&model, &config, NULL) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_shuffle_set(&model, &shuffle) == -1);
+    shuffle.stratify_output = -1;
+    ASSUME_ITS_TRUE(fossil_ai_train_shuffle_set(&model, &shuffle) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_train_shuffle_set(&model, NULL) == 0);
+    fossil_ai_train_release(&model);
+}
+
+// ======================================================
+// Dedup
+// ======================================================
+
+FOSSIL_TEST(c_test_train_dedup_exact_counts) {
+    static float rows[TRAIN_TEST_ROWS * TRAIN_TEST_WIDTH];
+    fossil_ai_train_config_t config = train_config();
+    fossil_ai_train_dedup_t dedup;
+    fossil_ai_train_dedup_stats_t stats;
+    int model = 0;
+
+    // Every odd row repeats the row before it.
+    for (size_t i = 0; i < TRAIN_TEST_ROWS; ++i) {
+        size_t src = i & ~(size_t)1;
+        rows[i * TRAIN_TEST_WIDTH] = (float)src;
+        rows[i * TRAIN_TEST_WIDTH + 1] = (float)(src * 7 % 13);
+        rows[i * TRAIN_TEST_WIDTH + 2] = (float)(src % 5);
+    }
+    memset(&dedup, 0, sizeof(dedup));
+    dedup.exact = 1;
+
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&model, &config, NULL) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_dedup_set(&model, &dedup) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_dataset_attach(&model, rows, TRAIN_TEST_ROWS) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_dedup_stats(&model, &stats) == 0);
+    ASSUME_ITS_TRUE(stats.rows_in == TRAIN_TEST_ROWS);
+    ASSUME_ITS_TRUE(stats.exact_dups == TRAIN_TEST_ROWS / 2);
+    ASSUME_ITS_TRUE(stats.near_dups == 0);
+    ASSUME_ITS_TRUE(stats.rows_kept == TRAIN_TEST_ROWS / 2);
+
+    dedup.workers = 1;
+    ASSUME_ITS_TRUE(fossil_ai_train_dedup_set(&model, &dedup) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_dataset_attach(&model, rows, TRAIN_TEST_ROWS) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_dedup_stats(&model, &stats) == 0);
+    ASSUME_ITS_TRUE(stats.rows_kept == TRAIN_TEST_ROWS / 2);
+    fossil_ai_train_release(&model);
+}
+
+FOSSIL_TEST(c_test_train_dedup_unique_rows) {
+    static float rows[TRAIN_TEST_ROWS * TRAIN_TEST_WIDTH];
+    fossil_ai_train_config_t config = train_config();
+    fossil_ai_train_dedup_t dedup;
+    fossil_ai_train_dedup_stats_t stats;
+    int model = 0;
+
+    // Inputs repeat but every target differs, so no row repeats byte for byte.
+    memcpy(rows, g_train_rows, sizeof(rows));
+    for (size_t i = 0; i < TRAIN_TEST_ROWS; ++i)
+        rows[i * TRAIN_TEST_WIDTH + 2] = (float)i;
+    memset(&dedup, 0, sizeof(dedup));
+    dedup.exact = 1;
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&model, &config, NULL) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_dedup_set(&model, &dedup) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_dataset_attach(&model, rows, TRAIN_TEST_ROWS) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_dedup_stats(&model, &stats) == 0);
+    ASSUME_ITS_TRUE(stats.exact_dups == 0);
+    ASSUME_ITS_TRUE(stats.rows_kept == TRAIN_TEST_ROWS);
+    fossil_ai_train_release(&model);
+}
+
+/* Attaches the fixture through dedup and reads the resulting stats. */
+static int train_dedup_fixture(void* model, const fossil_ai_train_dedup_t* dedup,
+                               fossil_ai_train_dedup_stats_t* stats) {
+    fossil_ai_train_config_t config = train_config();
+    if (fossil_ai_train_begin(model, &config, NULL) < 0 ||
+        fossil_ai_train_dedup_set(model, dedup) != 0 ||
+        fossil_ai_train_dataset_attach(model, g_train_rows, TRAIN_TEST_ROWS) != 0)
+        return -1;
+    return fossil_ai_train_dedup_stats(model, stats);
+}
+
+FOSSIL_TEST(c_test_train_dedup_near_inputs) {
+    static float out[TRAIN_TEST_ROWS];
+    fossil_ai_train_dedup_t dedup;
+    fossil_ai_train_dedup_stats_t stats;
+    int model = 0;
+    size_t hits = 0;
+
+    // The fixture repeats 128 input pairs; targets almost always differ, so
+    // nearly every repeat is near rather than exact.
+    memset(&dedup, 0, sizeof(dedup));
+    dedup.exact = 1;
+    dedup.near = 1;
+    ASSUME_ITS_TRUE(train_dedup_fixture(&model, &dedup, &stats) == 0);
+    ASSUME_ITS_TRUE(stats.rows_in == TRAIN_TEST_ROWS);
+    ASSUME_ITS_TRUE(stats.exact_dups < 8);
+    ASSUME_ITS_TRUE(stats.exact_dups + stats.near_dups == TRAIN_TEST_ROWS - 128);
+    ASSUME_ITS_TRUE(stats.rows_kept == 128);
+    ASSUME_ITS_TRUE(stats.candidates >= stats.near_dups);
+
+    // The kept rows still cover every input.
+    ASSUME_ITS_TRUE(fossil_ai_train_step(&model, NULL, 128) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_finalize(&model) == 0);
+    ASSUME_ITS_TRUE(train_recall(&model, out, &hits) == 0);
+    ASSUME_ITS_TRUE(hits == TRAIN_TEST_ROWS);
+    fossil_ai_train_release(&model);
+}
+
+FOSSIL_TEST(c_test_train_dedup_near_quantum) {
+    fossil_ai_train_dedup_t dedup;
+    fossil_ai_train_dedup_stats_t one, many;
+    int m1 = 0, m2 = 0;
+
+    // Buckets of width 4 fold the 16 x 8 inputs into 4 x 2 groups.
+    memset(&dedup, 0, sizeof(dedup));
+    dedup.near = 1;
+    dedup.quantum = 4.0f;
+    dedup.workers = 1;
+    ASSUME_ITS_TRUE(train_dedup_fixture(&m1, &dedup, &one) == 0);
+    dedup.workers = 4;
+    ASSUME_ITS_TRUE(train_dedup_fixture(&m2, &dedup, &many) == 0);
+    ASSUME_ITS_TRUE(one.rows_kept == 8);
+    ASSUME_ITS_TRUE(many.rows_kept == one.rows_kept);
+    ASSUME_ITS_TRUE(many.near_dups == one.near_dups);
+    fossil_ai_train_release(&m1);
+    fossil_ai_train_release(&m2);
+}
+
+FOSSIL_TEST(c_test_train_dedup_invalid_arguments) {
+    fossil_ai_train_config_t config = train_config();
+    fossil_ai_train_dedup_t dedup;
+    fossil_ai_train_dedup_stats_t stats;
+    int model = 0;
+
+    memset(&dedup, 0, sizeof(dedup));
+    ASSUME_ITS_TRUE(fossil_ai_train_dedup_set(&model, &dedup) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_train_dedup_stats(&model, &stats) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&model, &config, NULL) == 0);
+    dedup.near = 1;
+    dedup.similarity = 1.5f;
+    ASSUME_ITS_TRUE(fossil_ai_train_dedup_set(&model, &dedup) == -1);
+    dedup.similarity = 0.0f;
+    dedup.quantum = -1.0f;
+    ASSUME_ITS_TRUE(fossil_ai_train_dedup_set(&model, &dedup) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_train_dedup_stats(&model, NULL) == -1);
+    fossil_ai_train_release(&model);
+}
+
+// ======================================================
+// Validation
+// ======================================================
+
+static int g_validated = 0;
+static fossil_ai_train_metrics_t g_validation;
+
+static void on_validated(void* model, const fossil_ai_train_metrics_t* metrics, void* user) {
+    (void)model;
+    (void)user;
+    g_validated++;
+    g_validation = *metrics;
+}
+
+/* Trains on the first half of the fixture and holds out the second. */
+static int train_holdout(void* model) {
+    fossil_ai_train_config_t config = train_config();
+    const size_t half = TRAIN_TEST_ROWS / 2;
+    if (fossil_ai_train_begin(model, &config, NULL) != 0 ||
+        fossil_ai_train_dataset_attach(model, g_train_rows, half) != 0 ||
+        fossil_ai_train_holdout_attach(model, g_train_rows + half * TRAIN_TEST_WIDTH, half) != 0)
+        return -1;
+    return fossil_ai_train_step(model, NULL, 512);
+}
+
+FOSSIL_TEST(c_test_train_validate_async_matches_sync) {
+    fossil_ai_train_validation_t options;
+    fossil_ai_train_metrics_t sync;
+    int model = 0;
+
+    memset(&options, 0, sizeof(options));
+    options.workers = 3;
+    options.on_done = on_validated;
+    g_validated = 0;
+
+    ASSUME_ITS_TRUE(train_holdout(&model) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_validate(&model) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_metrics(&model, &sync) == 0);
+
+    // Steps taken while the job runs must not leak into its snapshot.
+    ASSUME_ITS_TRUE(fossil_ai_train_validate_async(&model, &options) == 0);
+    for (int i = 0; i < 4; ++i)
+        ASSUME_ITS_TRUE(fossil_ai_train_step(&model, NULL, 256) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_validate_wait(&model) == 0);
+
+    ASSUME_ITS_TRUE(g_validated == 1);
+    // Workers sum their shares separately, so only rounding may differ.
+    ASSUME_ITS_TRUE(g_validation.loss - sync.loss < 1e-9 && sync.loss - g_validation.loss < 1e-9);
+    ASSUME_ITS_TRUE(g_validation.hit_rate == sync.hit_rate);
+    ASSUME_ITS_TRUE(g_validation.rows == TRAIN_TEST_ROWS / 2);
+    ASSUME_ITS_FALSE(g_validation.sampled);
+    fossil_ai_train_release(&model);
+}
+
+FOSSIL_TEST(c_test_train_validate_async_sampled) {
+    fossil_ai_train_validation_t options;
+    int model = 0;
+
+    memset(&options, 0, sizeof(options));
+    options.sample_rows = 256;
+    options.on_done = on_validated;
+    g_validated = 0;
+
+    ASSUME_ITS_TRUE(train_holdout(&model) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_validate_async(&model, &options) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_validate_wait(&model) == 0);
+    ASSUME_ITS_TRUE(g_validated == 1);
+    ASSUME_ITS_TRUE(g_validation.sampled);
+    ASSUME_ITS_TRUE(g_validation.rows == 256);
+    ASSUME_ITS_TRUE(g_validation.loss_ci >= 0.0);
+    ASSUME_ITS_TRUE(g_validation.hit_rate_ci >= 0.0);
+    fossil_ai_train_release(&model);
+}
+
+FOSSIL_TEST(c_test_train_validate_async_release_joins) {
+    fossil_ai_train_validation_t options;
+    int model = 0;
+
+    memset(&options, 0, sizeof(options));
+    options.on_done = on_validated;
+    g_validated = 0;
+
+    ASSUME_ITS_TRUE(train_holdout(&model) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_validate_async(&model, &options) == 0);
+    fossil_ai_train_release(&model);
+    ASSUME_ITS_TRUE(g_validated == 1);
+    ASSUME_ITS_TRUE(fossil_ai_train_validate_wait(&model) == -1);
+}
+
+// ======================================================
+// Profile
+// ======================================================
+
+FOSSIL_TEST(c_test_train_profile_counts_steps) {
+    fossil_ai_train_config_t config = train_config();
+    fossil_ai_train_profile_t profile;
+    int model = 0;
+
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&model, &config, NULL) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_dataset_attach(&model, g_train_rows, TRAIN_TEST_ROWS) == 0);
+    for (int i = 0; i < 8; ++i)
+        ASSUME_ITS_TRUE(fossil_ai_train_step(&model, NULL, 256) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_checkpoint(&model, TRAIN_TEST_CKPT) == 0);
+
+    ASSUME_ITS_TRUE(fossil_ai_train_profile(&model, &profile) == 0);
+    ASSUME_ITS_TRUE(profile.steps == 8);
+    ASSUME_ITS_TRUE(profile.total.rows == 8 * 256);
+    ASSUME_ITS_TRUE(profile.last.rows == 256);
+    ASSUME_ITS_TRUE(profile.total.total_ns > 0);
+    ASSUME_ITS_TRUE(profile.total.hash_ns <= profile.total.total_ns);
+    ASSUME_ITS_TRUE(profile.total.insert_ns <= profile.total.total_ns);
+    ASSUME_ITS_TRUE(profile.total.compute_ns <= profile.total.total_ns);
+    ASSUME_ITS_TRUE(profile.total.audit_ns == 0);
+    ASSUME_ITS_TRUE(profile.rows_per_sec > 0.0);
+    ASSUME_ITS_TRUE(profile.checkpoints == 1);
+    ASSUME_ITS_TRUE(profile.checkpoint_ns > 0);
+    ASSUME_ITS_TRUE(profile.last_checkpoint_ns == profile.checkpoint_ns);
+
+    ASSUME_ITS_TRUE(fossil_ai_train_profile_reset(&model) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_profile(&model, &profile) == 0);
+    ASSUME_ITS_TRUE(profile.steps == 0);
+    ASSUME_ITS_TRUE(profile.total.rows == 0);
+    ASSUME_ITS_TRUE(profile.checkpoints == 0);
+    ASSUME_ITS_TRUE(profile.rows_per_sec == 0.0);
+    fossil_ai_train_release(&model);
+}
+
+FOSSIL_TEST(c_test_train_trace_export) {
+    fossil_ai_train_config_t config = train_config();
+    int model = 0;
+
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&model, &config, NULL) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_dataset_attach(&model, g_train_rows, TRAIN_TEST_ROWS) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_step(&model, NULL, 256) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_checkpoint(&model, TRAIN_TEST_CKPT) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_trace_export(&model, TRAIN_TEST_TRACE) == 0);
+
+    char* text = file_text(TRAIN_TEST_TRACE);
+    ASSUME_NOT_CNULL(text);
+    if (text) {
+        ASSUME_ITS_TRUE(strncmp(text, "{\"traceEvents\":[", 16) == 0);
+        ASSUME_NOT_CNULL(strstr(text, "\"name\":\"compute\""));
+        ASSUME_NOT_CNULL(strstr(text, "\"name\":\"checkpoint\""));
+        free(text);
+    }
+
+    // After a reset the trace starts over empty.
+    ASSUME_ITS_TRUE(fossil_ai_train_profile_reset(&model) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_trace_export(&model, TRAIN_TEST_TRACE) == 0);
+    text = file_text(TRAIN_TEST_TRACE);
+    ASSUME_NOT_CNULL(text);
+    if (text) {
+        ASSUME_ITS_TRUE(strstr(text, "\"name\"") == NULL);
+        free(text);
+    }
+    ASSUME_ITS_TRUE(fossil_ai_train_trace_export(&model, "nonexistent_dir/trace.json") == -1);
+    fossil_ai_train_release(&model);
+    ASSUME_ITS_TRUE(fossil_ai_train_trace_export(&model, TRAIN_TEST_TRACE) == -1);
+}
+
+// ======================================================
+// Serving
+// ======================================================
+
+FOSSIL_TEST(c_test_train_add_memory_published) {
+    fossil_ai_train_config_t config = train_config();
+    const float input[2] = { 3.0f, 4.0f };
+    const float output[1] = { 0.5f };
+    float out[1] = { 0.0f };
+    size_t hits = 1;
+    int model = 0;
+
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&model, &config, NULL) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_recall(&model, input, 1, out, &hits) == 0);
+    ASSUME_ITS_TRUE(hits == 0);
+    uint64_t before = fossil_ai_train_generation(&model);
+
+    // Once readers are serving, every write publishes a new generation.
+    ASSUME_ITS_TRUE(fossil_ai_train_add_memory(&model, input, output) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_generation(&model) > before);
+    ASSUME_ITS_TRUE(fossil_ai_train_recall(&model, input, 1, out, &hits) == 0);
+    ASSUME_ITS_TRUE(hits == 1);
+    ASSUME_ITS_TRUE(out[0] == 0.5f);
+    fossil_ai_train_release(&model);
+}
+
+typedef struct train_reader {
+    void* model;
+    atomic_int* stop;
+    size_t calls;
+    int failed;
+} train_reader_t;
+
+static void* train_read_loop(void* arg) {
+    static const size_t rows = 64;
+    train_reader_t* rd = (train_reader_t*)arg;
+    float in[64 * 2], out[64];
+    uint64_t last = 0;
+
+    for (size_t i = 0; i < rows; ++i) {
+        in[i * 2] = g_train_rows[i * TRAIN_TEST_WIDTH];
+        in[i * 2 + 1] = g_train_rows[i * TRAIN_TEST_WIDTH + 1];
+    }
+    while (!atomic_load(rd->stop) || rd->calls == 0) {
+        size_t hits = 0;
+        uint64_t gen = fossil_ai_train_generation(rd->model);
+        if (gen < last || fossil_ai_train_recall(rd->model, in, rows, out, &hits) != 0)
+            rd->failed = 1;
+        // Targets lie in [0, 1) and blends stay there, so a torn block would show.
+        for (size_t i = 0; i < hits && i < rows; ++i) {
+            if (!(out[i] >= 0.0f && out[i] < 1.0f))
+                rd->failed = 1;
+        }
+        last = gen;
+        rd->calls++;
+    }
+    return NULL;
+}
+
+FOSSIL_TEST(c_test_train_recall_while_training) {
+    static float out[TRAIN_TEST_ROWS];
+    fossil_ai_train_config_t config = train_config();
+    train_reader_t readers[3];
+    pthread_t threads[3];
+    atomic_int stop;
+    size_t hits = 0;
+    int model = 0;
+
+    atomic_init(&stop, 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&model, &config, NULL) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_dataset_attach(&model, g_train_rows, TRAIN_TEST_ROWS) == 0);
+    for (int i = 0; i < 3; ++i) {
+        readers[i].model = &model;
+        readers[i].stop = &stop;
+        readers[i].calls = 0;
+        readers[i].failed = 0;
+        ASSUME_ITS_TRUE(pthread_create(&threads[i], NULL, train_read_loop, &readers[i]) == 0);
+    }
+    for (size_t done = 0; done < TRAIN_TEST_ROWS; done += 256)
+        ASSUME_ITS_TRUE(fossil_ai_train_step(&model, NULL, 256) == 0);
+    atomic_store(&stop, 1);
+    for (int i = 0; i < 3; ++i) {
+        pthread_join(threads[i], NULL);
+        ASSUME_ITS_FALSE(readers[i].failed);
+    }
+
+    ASSUME_ITS_TRUE(fossil_ai_train_publish(&model) == 0);
+    ASSUME_ITS_TRUE(train_recall(&model, out, &hits) == 0);
+    ASSUME_ITS_TRUE(hits == TRAIN_TEST_ROWS);
+    fossil_ai_train_release(&model);
+}
+
+// ======================================================
+// Accumulation
+// ======================================================
+
+static int train_accum_epoch(void* model, const fossil_ai_train_accum_t* accum) {
+    fossil_ai_train_config_t config = train_config();
+    if (fossil_ai_train_begin(model, &config, NULL) != 0 ||
+        fossil_ai_train_dataset_attach(model, g_train_rows, TRAIN_TEST_ROWS) != 0 ||
+        fossil_ai_train_accum_set(model, accum) != 0)
+        return -1;
+    for (size_t done = 0; done < TRAIN_TEST_ROWS; done += 256) {
+        if (fossil_ai_train_step(model, NULL, 256) != 0)
+            return -1;
+    }
+    return fossil_ai_train_finalize(model);
+}
+
+FOSSIL_TEST(c_test_train_accum_workers_agree) {
+    static float a[TRAIN_TEST_ROWS], b[TRAIN_TEST_ROWS], c[TRAIN_TEST_ROWS];
+    fossil_ai_train_accum_t accum;
+    int m1 = 0, m2 = 0, m3 = 0;
+    size_t hits = 0;
+
+    // Merges are per block in row order, so threads and overlap cannot change them.
+    memset(&accum, 0, sizeof(accum));
+    accum.micro_batches = 4;
+    accum.workers = 1;
+    ASSUME_ITS_TRUE(train_accum_epoch(&m1, &accum) == 0);
+    accum.workers = 3;
+    ASSUME_ITS_TRUE(train_accum_epoch(&m2, &accum) == 0);
+    accum.overlap = 1;
+    ASSUME_ITS_TRUE(train_accum_epoch(&m3, &accum) == 0);
+
+    ASSUME_ITS_TRUE(train_recall(&m1, a, &hits) == 0);
+    ASSUME_ITS_TRUE(hits == TRAIN_TEST_ROWS);
+    ASSUME_ITS_TRUE(train_recall(&m2, b, &hits) == 0);
+    ASSUME_ITS_TRUE(train_recall(&m3, c, &hits) == 0);
+    ASSUME_ITS_TRUE(memcmp(a, b, sizeof(a)) == 0);
+    ASSUME_ITS_TRUE(memcmp(a, c, sizeof(a)) == 0);
+
+    fossil_ai_train_release(&m1);
+    fossil_ai_train_release(&m2);
+    fossil_ai_train_release(&m3);
+}
+
+FOSSIL_TEST(c_test_train_accum_flush_applies) {
+    static float out[TRAIN_TEST_ROWS];
+    fossil_ai_train_config_t config = train_config();
+    fossil_ai_train_accum_t accum;
+    size_t hits = 1;
+    int model = 0;
+
+    memset(&accum, 0, sizeof(accum));
+    accum.micro_batches = 4;
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&model, &config, NULL) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_dataset_attach(&model, g_train_rows, TRAIN_TEST_ROWS) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_accum_set(&model, &accum) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_step(&model, NULL, 256) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_step(&model, NULL, 256) == 0);
+
+    // Two of four micro-batches are gathered; nothing is applied yet.
+    ASSUME_ITS_TRUE(train_recall(&model, out, &hits) == 0);
+    ASSUME_ITS_TRUE(hits == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_accum_flush(&model) == 0);
+    ASSUME_ITS_TRUE(train_recall(&model, out, &hits) == 0);
+    ASSUME_ITS_TRUE(hits > 0);
+    fossil_ai_train_release(&model);
+}
+
+FOSSIL_TEST(c_test_train_accum_checkpoint_pending) {
+    static float before[TRAIN_TEST_ROWS], after[TRAIN_TEST_ROWS];
+    fossil_ai_train_config_t config = train_config();
+    fossil_ai_train_accum_t accum;
+    size_t hits = 0, resumed_hits = 0;
+    int model = 0, resumed = 0;
+
+    memset(&accum, 0, sizeof(accum));
+    accum.micro_batches = 4;
+    accum.overlap = 1;
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&model, &config, NULL) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_dataset_attach(&model, g_train_rows, TRAIN_TEST_ROWS) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_accum_set(&model, &accum) == 0);
+    for (int i = 0; i < 6; ++i)
+        ASSUME_ITS_TRUE(fossil_ai_train_step(&model, NULL, 256) == 0);
+
+    // The checkpoint applies the two pending micro-batches before it writes.
+    ASSUME_ITS_TRUE(fossil_ai_train_checkpoint(&model, TRAIN_TEST_CKPT) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&resumed, NULL, TRAIN_TEST_CKPT) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_accum_flush(&model) == 0);
+    ASSUME_ITS_TRUE(train_recall(&model, before, &hits) == 0);
+    ASSUME_ITS_TRUE(train_recall(&resumed, after, &resumed_hits) == 0);
+    ASSUME_ITS_TRUE(hits == resumed_hits);
+    ASSUME_ITS_TRUE(memcmp(before, after, sizeof(before)) == 0);
+
+    fossil_ai_train_release(&model);
+    fossil_ai_train_release(&resumed);
+}
+
+// ======================================================
+// Distributed
+// ======================================================
+
+/* One rank of a two-rank ring, trained on its half of the fixture in its own thread. */
+typedef struct train_rank {
+    int model;
+    fossil_ai_train_config_t config;
+    fossil_ai_train_dist_t dist;
+    size_t max_steps;
+    size_t steps;
+    int rc;
+} train_rank_t;
+
+static void* train_rank_main(void* arg) {
+    train_rank_t* rk = (train_rank_t*)arg;
+    const size_t half = TRAIN_TEST_ROWS / 2;
+    const float* shard = g_train_rows + rk->dist.rank * half * TRAIN_TEST_WIDTH;
+
+    rk->rc = fossil_ai_train_begin(&rk->model, &rk->config, NULL);
+    if (rk->rc == 0)
+        rk->rc = fossil_ai_train_dataset_attach(&rk->model, shard, half);
+    if (rk->rc == 0)
+        rk->rc = fossil_ai_train_holdout_attach(&rk->model, shard, half);
+    if (rk->rc == 0)
+        rk->rc = fossil_ai_train_dist_join(&rk->model, &rk->dist);
+    for (rk->steps = 0; rk->rc == 0 && rk->steps < rk->max_steps; ) {
+        rk->steps++;
+        rk->rc = fossil_ai_train_step(&rk->model, NULL, 256);
+    }
+    if (rk->rc == 0)
+        rk->rc = fossil_ai_train_finalize(&rk->model);
+    if (rk->rc == 1)
+        rk->rc = 0; /* early stop finalized the session */
+    if (fossil_ai_train_dist_leave(&rk->model) != 0)
+        rk->rc = -1;
+    return NULL;
+}
+
+static int train_ring(train_rank_t* ranks) {
+    pthread_t threads[2];
+    int started = 0;
+    for (; started < 2; ++started) {
+        if (pthread_create(&threads[started], NULL, train_rank_main, &ranks[started]) != 0)
+            break;
+    }
+    for (int i = 0; i < started; ++i)
+        pthread_join(threads[i], NULL);
+    return started == 2 && ranks[0].rc == 0 && ranks[1].rc == 0 ? 0 : -1;
+}
+
+static void train_rank_init(train_rank_t* rk, size_t rank) {
+    memset(rk, 0, sizeof(*rk));
+    rk->config = train_config();
+    rk->dist.rank = rank;
+    rk->dist.world = 2;
+    rk->dist.socket_prefix = TRAIN_TEST_RING;
+    rk->max_steps = TRAIN_TEST_ROWS / 2 / 256;
+}
+
+/* In-process ring: each rank's inbox holds at most one frame. */
+typedef struct train_mailbox {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    void* frame[2];
+    size_t len[2];
+} train_mailbox_t;
+
+typedef struct train_port {
+    train_mailbox_t* box;
+    size_t rank;
+} train_port_t;
+
+static int mailbox_exchange(void* ctx, const void* send, size_t send_len, void** recv, size_t* recv_len) {
+    train_port_t* port = (train_port_t*)ctx;
+    train_mailbox_t* box = port->box;
+    size_t next = 1 - port->rank;
+    void* copy = malloc(send_len ? send_len : 1);
+    if (!copy)
+        return -2;
+    memcpy(copy, send, send_len);
+
+    // A rank that left the ring early would strand its neighbour; time out instead.
+    struct timespec deadline;
+    timespec_get(&deadline, TIME_UTC);
+    deadline.tv_sec += 10;
+    int rc = 0;
+
+    pthread_mutex_lock(&box->lock);
+    while (box->frame[next] && rc == 0)
+        rc = pthread_cond_timedwait(&box->changed, &box->lock, &deadline);
+    if (rc == 0) {
+        box->frame[next] = copy;
+        box->len[next] = send_len;
+        copy = NULL;
+        pthread_cond_broadcast(&box->changed);
+    }
+    while (!box->frame[port->rank] && rc == 0)
+        rc = pthread_cond_timedwait(&box->changed, &box->lock, &deadline);
+    if (rc == 0) {
+        *recv = box->frame[port->rank];
+        *recv_len = box->len[port->rank];
+        box->frame[port->rank] = NULL;
+        pthread_cond_broadcast(&box->changed);
+    }
+    pthread_mutex_unlock(&box->lock);
+    free(copy);
+    return rc == 0 ? 0 : -1;
+}
+
+FOSSIL_TEST(c_test_train_dist_replicas_match) {
+    static float a[TRAIN_TEST_ROWS], b[TRAIN_TEST_ROWS];
+    train_rank_t ranks[2];
+    size_t hits_a = 0, hits_b = 0;
+
+    train_rank_init(&ranks[0], 0);
+    train_rank_init(&ranks[1], 1);
+    ASSUME_ITS_TRUE(train_ring(ranks) == 0);
+
+    // Each rank saw half the rows, but the all-reduce hands both every update.
+    ASSUME_ITS_TRUE(train_recall(&ranks[0].model, a, &hits_a) == 0);
+    ASSUME_ITS_TRUE(train_recall(&ranks[1].model, b, &hits_b) == 0);
+    ASSUME_ITS_TRUE(hits_a == TRAIN_TEST_ROWS);
+    ASSUME_ITS_TRUE(hits_a == hits_b);
+    ASSUME_ITS_TRUE(memcmp(a, b, sizeof(a)) == 0);
+
+    fossil_ai_train_release(&ranks[0].model);
+    fossil_ai_train_release(&ranks[1].model);
+}
+
+FOSSIL_TEST(c_test_train_dist_transport_early_stop) {
+    static float a[TRAIN_TEST_ROWS], b[TRAIN_TEST_ROWS];
+    fossil_ai_train_transport_t transports[2];
+    fossil_ai_train_early_stop_status_t status[2];
+    train_mailbox_t box;
+    train_port_t ports[2];
+    train_rank_t ranks[2];
+    size_t hits = 0;
+
+    memset(&box, 0, sizeof(box));
+    pthread_mutex_init(&box.lock, NULL);
+    pthread_cond_init(&box.changed, NULL);
+    for (size_t r = 0; r < 2; ++r) {
+        ports[r].box = &box;
+        ports[r].rank = r;
+        transports[r].exchange = mailbox_exchange;
+        transports[r].close = NULL;
+        transports[r].ctx = &ports[r];
+        train_rank_init(&ranks[r], r);
+        ranks[r].dist.socket_prefix = NULL;
+        ranks[r].dist.transport = &transports[r];
+        ranks[r].config.early_stop.patience = 2;
+        ranks[r].config.early_stop.min_delta = 1e-3;
+        ranks[r].max_steps = 200;
+    }
+    ASSUME_ITS_TRUE(train_ring(ranks) == 0);
+
+    // The shards differ, but the averaged metric makes both ranks stop on the same step.
+    ASSUME_ITS_TRUE(fossil_ai_train_early_stop_status(&ranks[0].model, &status[0]) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_early_stop_status(&ranks[1].model, &status[1]) == 0);
+    ASSUME_ITS_TRUE(status[0].stopped && status[1].stopped);
+    ASSUME_ITS_TRUE(ranks[0].steps == ranks[1].steps);
+    ASSUME_ITS_TRUE(ranks[0].steps < ranks[0].max_steps);
+    ASSUME_ITS_TRUE(status[0].best == status[1].best);
+    ASSUME_ITS_TRUE(train_recall(&ranks[0].model, a, &hits) == 0);
+    ASSUME_ITS_TRUE(train_recall(&ranks[1].model, b, &hits) == 0);
+    ASSUME_ITS_TRUE(memcmp(a, b, sizeof(a)) == 0);
+
+    fossil_ai_train_release(&ranks[0].model);
+    fossil_ai_train_release(&ranks[1].model);
+    free(box.frame[0]);
+    free(box.frame[1]);
+    pthread_cond_destroy(&box.changed);
+    pthread_mutex_destroy(&box.lock);
+}
+
+FOSSIL_TEST(c_test_train_dist_invalid_arguments) {
+    fossil_ai_train_config_t config = train_config();
+    fossil_ai_train_dist_t dist;
+    int model = 0;
+
+    memset(&dist, 0, sizeof(dist));
+    ASSUME_ITS_TRUE(fossil_ai_train_dist_join(&model, &dist) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&model, &config, NULL) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_dist_join(&model, NULL) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_train_dist_join(&model, &dist) == -1);
+    dist.world = 2;
+    dist.rank = 2;
+    ASSUME_ITS_TRUE(fossil_ai_train_dist_join(&model, &dist) == -1);
+    dist.world = 1;
+    dist.rank = 0;
+    ASSUME_ITS_TRUE(fossil_ai_train_dist_join(&model, &dist) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_dist_leave(&model) == 0);
+    fossil_ai_train_release(&model);
+}
+
+// ======================================================
+// Early Stop
+// ======================================================
+
+/* Steps until the policy ends the session; returns the step that returned 1, 0 if none did. */
+static size_t train_until_stopped(void* model, const fossil_ai_train_config_t* config, size_t max_steps) {
+    const size_t half = TRAIN_TEST_ROWS / 2;
+    if (fossil_ai_train_begin(model, config, NULL) != 0 ||
+        fossil_ai_train_dataset_attach(model, g_train_rows, half) != 0 ||
+        fossil_ai_train_holdout_attach(model, g_train_rows + half * TRAIN_TEST_WIDTH, half) != 0)
+        return 0;
+    for (size_t k = 1; k <= max_steps; ++k) {
+        int rc = fossil_ai_train_step(model, NULL, 256);
+        if (rc != 0)
+            return rc == 1 ? k : 0;
+    }
+    return 0;
+}
+
+FOSSIL_TEST(c_test_train_early_stop_finalizes) {
+    fossil_ai_train_config_t config = train_config();
+    fossil_ai_train_early_stop_status_t status;
+    int model = 0;
+
+    config.early_stop.patience = 3;
+    config.early_stop.min_delta = 1e-3;
+    config.early_stop.min_interval = 1;
+    config.early_stop.max_interval = 8;
+
+    size_t stopped_at = train_until_stopped(&model, &config, 500);
+    ASSUME_ITS_TRUE(stopped_at > 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_early_stop_status(&model, &status) == 0);
+    ASSUME_ITS_TRUE(status.stopped);
+    ASSUME_ITS_TRUE(status.bad == 3);
+    ASSUME_ITS_TRUE(status.validations > 3);
+    ASSUME_ITS_TRUE(status.best_step < stopped_at);
+    ASSUME_ITS_TRUE(status.interval >= 1 && status.interval <= 8);
+    // The best loss is reported as a loss, not as the negated score.
+    ASSUME_ITS_TRUE(status.best >= 0.0);
+
+    // The session is finalized: steps are refused until it restarts.
+    ASSUME_ITS_TRUE(fossil_ai_train_step(&model, NULL, 256) == -1);
+    ASSUME_ITS_TRUE(fossil_ai_train_begin(&model, &config, NULL) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_early_stop_status(&model, &status) == 0);
+    ASSUME_ITS_FALSE(status.stopped);
+    ASSUME_ITS_TRUE(fossil_ai_train_step(&model, NULL, 256) == 0);
+    fossil_ai_train_release(&model);
+}
+
+FOSSIL_TEST(c_test_train_early_stop_deterministic) {
+    fossil_ai_train_config_t config = train_config();
+    int m1 = 0, m2 = 0;
+
+    config.early_stop.patience = 2;
+    config.early_stop.metric = FOSSIL_AI_TRAIN_METRIC_HIT_RATE;
+    config.early_stop.min_delta = 1e-3;
+    config.early_stop.sample_rows = 512;
+
+    size_t a = train_until_stopped(&m1, &config, 500);
+    size_t b = train_until_stopped(&m2, &config, 500);
+    ASSUME_ITS_TRUE(a > 0);
+    ASSUME_ITS_TRUE(a == b);
+    fossil_ai_train_release(&m1);
+    fossil_ai_train_release(&m2);
+}
+
+FOSSIL_TEST(c_test_train_early_stop_off) {
+    fossil_ai_train_config_t config = train_config();
+    fossil_ai_train_early_stop_status_t status;
+    int model = 0;
+
+    ASSUME_ITS_TRUE(train_until_stopped(&model, &config, 64) == 0);
+    ASSUME_ITS_TRUE(fossil_ai_train_early_stop_status(&model, &status) == 0);
+    ASSUME_ITS_FALSE(status.stopped);
+    ASSUME_ITS_TRUE(status.validations == 0);
+    fossil_ai_train_release(&model);
+}
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Pool
+// * * * * * * * * * * * * * * * * * * * * * * * *
+FOSSIL_TEST_GROUP(c_train_tests) {
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_checkpoint_resume);
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_checkpoint_bad_magic);
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_checkpoint_truncated);
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_checkpoint_missing);
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_checkpoint_continues);
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_checkpoint_over_mapped);
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_checkpoint_begin_conflicts);
+
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_shuffle_deterministic);
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_shuffle_weighted_deterministic);
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_shuffle_zeroed_is_sequential);
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_shuffle_stratified);
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_shuffle_resumes_order);
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_shuffle_invalid_stratum);
+
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_dedup_exact_counts);
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_dedup_unique_rows);
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_dedup_near_inputs);
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_dedup_near_quantum);
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_dedup_invalid_arguments);
+
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_validate_async_matches_sync);
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_validate_async_sampled);
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_validate_async_release_joins);
+
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_profile_counts_steps);
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_trace_export);
+
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_add_memory_published);
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_recall_while_training);
+
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_accum_workers_agree);
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_accum_flush_applies);
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_accum_checkpoint_pending);
+
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_dist_replicas_match);
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_dist_transport_early_stop);
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_dist_invalid_arguments);
+
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_early_stop_finalizes);
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_early_stop_deterministic);
+    FOSSIL_TEST_ADD(c_train_fixture, c_test_train_early_stop_off);
+
+    FOSSIL_TEST_REGISTER(c_train_fixture);
+} // end of tests